@@ -10,6 +10,10 @@ class GPin(gobject.GObject, hal.Pin):
 
     REGISTRY = []
     UPDATE = False
+    # with the notify component loaded, pins are watched through it
+    # instead of being looked at every 100 ms
+    NOTIFIER = None
+    WATCHED = {}
 
     def __init__(self, *a, **kw):
         gobject.GObject.__init__(self)
@@ -40,6 +44,34 @@ class GPin(gobject.GObject, hal.Pin):
             self.REGISTRY.remove(p)
         return self.UPDATE
 
+    def watch(self, comp, name):
+        """Have the notify component report the changes of this pin,
+        whose full name is name, if it is loaded"""
+        if GPin.NOTIFIER is None:
+            try:
+                GPin.NOTIFIER = _hal.notifier(comp)
+            except _hal.error:
+                GPin.NOTIFIER = False
+            else:
+                gobject.io_add_watch(GPin.NOTIFIER.fileno(), gobject.IO_IN,
+                    GPin.notified)
+        if not GPin.NOTIFIER:
+            return
+        try:
+            GPin.NOTIFIER.add(name)
+        except (NameError, _hal.error):
+            return
+        GPin.WATCHED.setdefault(name, []).append(self)
+        if self in self.REGISTRY:
+            self.REGISTRY.remove(self)
+
+    @classmethod
+    def notified(self, fd, condition):
+        for name, value in GPin.NOTIFIER.read():
+            for p in GPin.WATCHED.get(name, ()):
+                p.update()
+        return True
+
     @classmethod
     def update_start(self, timeout=100):
         if GPin.UPDATE:
@@ -57,8 +89,12 @@ class GComponent:
             comp = comp.comp
         self.comp = comp
 
-    def newpin(self, *a, **kw): return GPin(_hal.component.newpin(self.comp, *a, **kw))
-    def getpin(self, *a, **kw): return GPin(_hal.component.getpin(self.comp, *a, **kw))
+    def newpin(self, *a, **kw): return self._watch(GPin(_hal.component.newpin(self.comp, *a, **kw)))
+    def getpin(self, *a, **kw): return self._watch(GPin(_hal.component.getpin(self.comp, *a, **kw)))
+
+    def _watch(self, pin):
+        pin.watch(self.comp, "%s.%s" % (self.comp.getprefix(), pin.get_name()))
+        return pin
 
     def exit(self, *a, **kw): return self.comp.exit(*a, **kw)
 
@@ -0,0 +1,114 @@
+#    Run times of G-code programs, from rs274-cycletime
+#
+#    This program is free software; you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation; either version 2 of the License, or
+#    (at your option) any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program; if not, write to the Free Software
+#    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+"""Runs G-code programs through the interpreter and motion's trajectory
+planner, off line, with rs274-cycletime, and returns how long each would
+run:
+
+    for r in cycletime.estimate("machine.ini", ["a.ngc", "b.ngc"]):
+        print r.file, r.time, r.error
+
+The programs are run in parallel, in processes of their own, since the
+interpreter keeps its state in globals; the gcode module's canon can't
+share a process with motion's planner."""
+
+import os, re, subprocess
+
+class CycleTimeError(Exception): pass
+
+class Estimate:
+    """How long one program runs, in seconds, with lengths and speeds in
+    machine units.  lines maps line numbers to the time spent on them,
+    error is (line, text) if the interpreter stopped on an error, and
+    trace is the name of the velocity trace, if one was asked for."""
+    def __init__(self, file):
+        self.file = file
+        self.time = self.dwell_time = 0.0
+        self.moves = 0
+        self.feed_length = self.traverse_length = self.peak_speed = 0.0
+        self.lines = {}
+        self.error = None
+        self.trace = None
+
+    def __repr__(self):
+        return "<Estimate %s: %.3f s>" % (self.file, self.time)
+
+_head = re.compile(r"^(.*): \d+:[\d.]+ \(([\d.]+) s, ([\d.]+) s dwell\), (\d+) moves$")
+_error = re.compile(r"^  error on line (-?\d+): (.*)$")
+_lengths = re.compile(r"^  feed ([\d.]+), traverse ([\d.]+), peak speed ([\d.]+)/s$")
+_line = re.compile(r"^  line (\d+): ([\d.]+) s$")
+
+def parse(text):
+    """Reads the report of rs274-cycletime -l into a list of Estimate,
+    in the order of the programs"""
+    result = []
+    for l in text.splitlines():
+        m = _head.match(l)
+        if m:
+            e = Estimate(m.group(1))
+            e.time, e.dwell_time = float(m.group(2)), float(m.group(3))
+            e.moves = int(m.group(4))
+            result.append(e)
+            continue
+        if not result: continue
+        e = result[-1]
+        m = _error.match(l)
+        if m:
+            e.error = int(m.group(1)), m.group(2)
+            continue
+        m = _lengths.match(l)
+        if m:
+            e.feed_length, e.traverse_length, e.peak_speed = \
+                map(float, m.groups())
+            continue
+        m = _line.match(l)
+        if m:
+            e.lines[int(m.group(1))] = float(m.group(2))
+    return result
+
+def estimate(inifile, files, tooltable=None, varfile=None, jobs=None,
+        period=None, trace_dir=None, trace_interval=None,
+        program="rs274-cycletime"):
+    """Estimates the run time of every program in files on the machine
+    of inifile.  Programs that can't be run at all raise CycleTimeError;
+    interpreter errors are in Estimate.error."""
+    args = [program, "-l", "-i", inifile]
+    if tooltable: args += ["-t", tooltable]
+    if varfile: args += ["-v", varfile]
+    if jobs: args += ["-j", str(jobs)]
+    if period: args += ["-d", str(period)]
+    if trace_dir:
+        args += ["-T", trace_dir]
+        if trace_interval: args += ["-r", str(trace_interval)]
+    args += list(files)
+    p = subprocess.Popen(args, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    out, err = p.communicate()
+    if p.returncode > 1:
+        raise CycleTimeError(err.strip() or out.strip())
+    result = parse(out)
+    if trace_dir:
+        for e in result:
+            e.trace = os.path.join(trace_dir,
+                os.path.basename(e.file) + ".trace")
+    return result
+
+def read_trace(filename):
+    """Reads a velocity trace into a list of (time, speed, line)"""
+    result = []
+    for l in open(filename):
+        t, v, n = l.split()
+        result.append((float(t), float(v), int(n)))
+    return result
@@ -15,7 +15,7 @@
 #    along with this program; if not, write to the Free Software
 #    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
-from rs274 import Translated, ArcsToSegmentsMixin, OpenGLTk
+from rs274 import Translated, ArcsToSegmentsMixin, OpenGLTk, previewcache
 from minigl import *
 import math
 import glnav
@@ -41,28 +41,26 @@ limiticon = array.array('B',
 class GLCanon(Translated, ArcsToSegmentsMixin):
     lineno = -1
     def __init__(self, colors, geometry, is_foam=0):
-        # traverse list - [line number, [start position], [end position], [tlo x, tlo y, tlo z]]
-        self.traverse = []; self.traverse_append = self.traverse.append
-        # feed list - [line number, [start position], [end position], feedrate, [tlo x, tlo y, tlo z]]
-        self.feed = []; self.feed_append = self.feed.append
-        # arcfeed list - [line number, [start position], [end position], feedrate, [tlo x, tlo y, tlo z]]
-        self.arcfeed = []; self.arcfeed_append = self.arcfeed.append
+        # moves are collected by gcode.parse() into packed arrays, without
+        # calling back into Python; this class keeps the preview's
+        # offsets, feed rate and tool offset up to date.
+        self.preview = gcode.preview()
+        # traverse segments - (line number, (start position), (end position))
+        self.traverse = self.preview.traverse
+        # feed segments - (line number, (start position), (end position), feedrate)
+        self.feed = self.preview.feed
+        # arcfeed segments - (line number, (start position), (end position), feedrate)
+        self.arcfeed = self.preview.arcfeed
         # dwell list - [line number, color, pos x, pos y, pos z, plane]
         self.dwells = []; self.dwells_append = self.dwells.append
         self.choice = None
-        self.feedrate = 1
-        self.lo = (0,) * 9
-        self.first_move = True
         self.geometry = geometry
         self.min_extents = [9e99,9e99,9e99]
         self.max_extents = [-9e99,-9e99,-9e99]
         self.min_extents_notool = [9e99,9e99,9e99]
         self.max_extents_notool = [-9e99,-9e99,-9e99]
         self.colors = colors
-        self.in_arc = 0
-        self.xo = self.yo = self.zo = self.ao = self.bo = self.co = self.uo = self.vo = self.wo = 0
         self.dwell_time = 0
-        self.suppress = 0
         self.g92_offset_x = 0.0
         self.g92_offset_y = 0.0
         self.g92_offset_z = 0.0
@@ -93,8 +91,8 @@ class GLCanon(Translated, ArcsToSegmentsMixin):
             parts = arg.split(",")
             command = parts[1]
             if command == "stop": raise KeyboardInterrupt
-            if command == "hide": self.suppress += 1
-            if command == "show": self.suppress -= 1
+            if command == "hide": self.preview.suppress += 1
+            if command == "show": self.preview.suppress -= 1
             if command == "XY_Z_POS": 
                 if len(parts) > 2 :
                     try:
@@ -151,7 +149,7 @@ class GLCanon(Translated, ArcsToSegmentsMixin):
         return linuxcnc.draw_dwells(self.geometry, dwells, alpha, for_selection, self.is_lathe())
 
     def calc_extents(self):
-        self.min_extents, self.max_extents, self.min_extents_notool, self.max_extents_notool = gcode.calc_extents(self.arcfeed, self.feed, self.traverse)
+        self.min_extents, self.max_extents, self.min_extents_notool, self.max_extents_notool = self.preview.calc_extents()
         if self.is_foam:
             min_z = min(self.foam_z, self.foam_w)
             max_z = max(self.foam_z, self.foam_w)
@@ -162,83 +160,60 @@ class GLCanon(Translated, ArcsToSegmentsMixin):
             self.max_extents_notool = \
                 self.max_extents_notool[0], self.max_extents_notool[1], max_z
     def tool_offset(self, xo, yo, zo, ao, bo, co, uo, vo, wo):
-        self.first_move = True
-        x, y, z, a, b, c, u, v, w = self.lo
-        self.lo = (x - xo + self.xo, y - yo + self.yo, z - zo + self.zo, a - ao + self.ao, b - bo + self.bo, c - bo + self.bo,
-          u - uo + self.uo, v - vo + self.vo, w - wo + self.wo)
-        self.xo = xo
-        self.yo = yo
-        self.zo = zo
-        self.so = ao
-        self.bo = bo
-        self.co = co
-        self.uo = uo
-        self.vo = vo
-        self.wo = wo
+        self.preview.tool_offset(xo, yo, zo, ao, bo, co, uo, vo, wo)
+
+    def set_g5x_offset(self, index, x, y, z, a, b, c, u=0, v=0, w=0):
+        Translated.set_g5x_offset(self, index, x, y, z, a, b, c, u, v, w)
+        self.preview.set_g5x_offset(x, y, z, a, b, c, u, v, w)
+
+    def set_g92_offset(self, x, y, z, a, b, c, u=0, v=0, w=0):
+        Translated.set_g92_offset(self, x, y, z, a, b, c, u, v, w)
+        self.preview.set_g92_offset(x, y, z, a, b, c, u, v, w)
+
+    def set_xy_rotation(self, theta):
+        Translated.set_xy_rotation(self, theta)
+        self.preview.set_xy_rotation(theta)
+
+    def set_plane(self, plane):
+        ArcsToSegmentsMixin.set_plane(self, plane)
+        self.preview.plane = plane
 
     def set_spindle_rate(self, arg): pass
-    def set_feed_rate(self, arg): self.feedrate = arg / 60.
+    def set_feed_rate(self, arg): self.preview.feedrate = arg / 60.
     def select_plane(self, arg): pass
 
     def change_tool(self, arg):
-        self.first_move = True
+        self.preview.first_move = True
 
-    def straight_traverse(self, x,y,z, a,b,c, u, v, w):
-        if self.suppress > 0: return
-        l = self.rotate_and_translate(x,y,z,a,b,c,u,v,w)
-        if not self.first_move:
-                self.traverse_append((self.lineno, self.lo, l, [self.xo, self.yo, self.zo]))
-        self.lo = l
+    # gcode.parse() adds moves to the preview itself; these are for
+    # callers that drive the canon directly
+
+    def straight_traverse(self, *args):
+        self.preview.straight_traverse(self.lineno, *args)
 
     def rigid_tap(self, x, y, z):
-        if self.suppress > 0: return
-        self.first_move = False
-        l = self.rotate_and_translate(x,y,z,0,0,0,0,0,0)[:3]
-        l += [self.lo[3], self.lo[4], self.lo[5],
-               self.lo[6], self.lo[7], self.lo[8]]
-        self.feed_append((self.lineno, self.lo, l, self.feedrate, [self.xo, self.yo, self.zo]))
-#        self.dwells_append((self.lineno, self.colors['dwell'], x + self.offset_x, y + self.offset_y, z + self.offset_z, 0))
-        self.feed_append((self.lineno, l, self.lo, self.feedrate, [self.xo, self.yo, self.zo]))
+        self.preview.rigid_tap(self.lineno, x, y, z)
 
     def arc_feed(self, *args):
-        if self.suppress > 0: return
-        self.first_move = False
-        self.in_arc = True
-        try:
-            ArcsToSegmentsMixin.arc_feed(self, *args)
-        finally:
-            self.in_arc = False
-
-    def straight_arcsegments(self, segs):
-        self.first_move = False
-        lo = self.lo
-        lineno = self.lineno
-        feedrate = self.feedrate
-        to = [self.xo, self.yo, self.zo]
-        append = self.arcfeed_append
-        for l in segs:
-            append((lineno, lo, l, feedrate, to))
-            lo = l
-        self.lo = lo
-
-    def straight_feed(self, x,y,z, a,b,c, u, v, w):
-        if self.suppress > 0: return
-        self.first_move = False
-        l = self.rotate_and_translate(x,y,z,a,b,c,u,v,w)
-        self.feed_append((self.lineno, self.lo, l, self.feedrate, [self.xo, self.yo, self.zo]))
-        self.lo = l
+        self.preview.arcdivision = self.arcdivision
+        self.preview.arc_feed(self.lineno, *args)
+
+    def straight_feed(self, *args):
+        self.preview.straight_feed(self.lineno, *args)
     straight_probe = straight_feed
 
     def user_defined_function(self, i, p, q):
-        if self.suppress > 0: return
+        if self.preview.suppress > 0: return
         color = self.colors['m1xx']
-        self.dwells_append((self.lineno, color, self.lo[0], self.lo[1], self.lo[2], self.state.plane/10-17))
+        lo = self.preview.lo
+        self.dwells_append((self.lineno, color, lo[0], lo[1], lo[2], self.state.plane/10-17))
 
     def dwell(self, arg):
-        if self.suppress > 0: return
+        if self.preview.suppress > 0: return
         self.dwell_time += arg
         color = self.colors['dwell']
-        self.dwells_append((self.lineno, color, self.lo[0], self.lo[1], self.lo[2], self.state.plane/10-17))
+        lo = self.preview.lo
+        self.dwells_append((self.lineno, color, lo[0], lo[1], lo[2], self.state.plane/10-17))
 
 
     def highlight(self, lineno, geometry):
@@ -247,21 +222,11 @@ class GLCanon(Translated, ArcsToSegmentsMixin):
         glColor3f(*c)
         glBegin(GL_LINES)
         coords = []
-        for line in self.traverse:
-            if line[0] != lineno: continue
-            linuxcnc.line9(geometry, line[1], line[2])
-            coords.append(line[1][:3])
-            coords.append(line[2][:3])
-        for line in self.arcfeed:
-            if line[0] != lineno: continue
-            linuxcnc.line9(geometry, line[1], line[2])
-            coords.append(line[1][:3])
-            coords.append(line[2][:3])
-        for line in self.feed:
-            if line[0] != lineno: continue
-            linuxcnc.line9(geometry, line[1], line[2])
-            coords.append(line[1][:3])
-            coords.append(line[2][:3])
+        for segs in self.traverse, self.arcfeed, self.feed:
+            for start, end in segs.select(lineno):
+                linuxcnc.line9(geometry, start, end)
+                coords.append(start[:3])
+                coords.append(end[:3])
         glEnd()
         for line in self.dwells:
             if line[0] != lineno: continue
@@ -372,6 +337,9 @@ class GlCanonDraw:
         'axis_y': (1.00, 0.20, 0.20),
         'grid': (0.15, 0.15, 0.15),
     }
+    # a directory preview-cache keeps previews in, or None
+    preview_cache = None
+
     def __init__(self, s, lp, g=None):
         self.stat = s
         self.lp = lp
@@ -1590,7 +1558,15 @@ class GlCanonDraw:
 
     def load_preview(self, f, canon, unitcode, initcode, interpname=""):
         self.set_canon(canon)
-        result, seq = gcode.parse(f, canon, unitcode, initcode, interpname)
+        canon.preview.arcdivision = canon.arcdivision
+        cached = None
+        if self.preview_cache:
+            cached = previewcache.load(self.preview_cache, f, canon,
+                unitcode, initcode, interpname)
+        if cached:
+            result, seq = cached
+        else:
+            result, seq = gcode.parse(f, canon, unitcode, initcode, interpname)
 
         if result <= gcode.MIN_ERROR:
             self.canon.progress.nextphase(1)
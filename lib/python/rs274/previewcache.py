@@ -0,0 +1,144 @@
+#    A cache of parsed G-code program previews
+#
+#    This program is free software; you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation; either version 2 of the License, or
+#    (at your option) any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program; if not, write to the Free Software
+#    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+"""The preview of a program, as gcode.parse() leaves it in a GLCanon,
+kept in a file of its own in a cache directory: the segments of the
+gcode.preview, packed as they are in memory, and the rest of what the
+GUIs use, the dwells, the result and the foam heights.
+
+preview-cache fills the directory in the background; GlCanonDraw.
+load_preview() looks in it first, when the GUI has one set, and only
+parses the program if it finds nothing for the program as it is now,
+with the settings it would parse it with."""
+
+import os, marshal, hashlib, tempfile
+import linuxcnc, gcode
+
+VERSION = 2
+
+def cache_file(cachedir, filename):
+    """The name of the cache file of a program"""
+    name = hashlib.sha1(os.path.abspath(filename)).hexdigest()
+    return os.path.join(cachedir, name + ".preview")
+
+def _digest(filename):
+    try:
+        return hashlib.sha1(open(filename, "rb").read()).hexdigest()
+    except (IOError, TypeError):
+        return None
+
+_subroutine_dirs = {}
+
+def subroutine_dirs():
+    """The directories in [RS274NGC]SUBROUTINE_PATH of the ini file the
+    interpreter reads, INI_FILE_NAME; relative ones are taken from the
+    directory of the ini file, where LinuxCNC runs"""
+    inipath = os.environ.get("INI_FILE_NAME")
+    if inipath not in _subroutine_dirs:
+        dirs = []
+        if inipath:
+            path = linuxcnc.ini(inipath).find("RS274NGC", "SUBROUTINE_PATH")
+            inidir = os.path.dirname(os.path.abspath(inipath))
+            for d in (path or "").split(":"):
+                if d:
+                    dirs.append(os.path.join(inidir, os.path.expanduser(d)))
+        _subroutine_dirs[inipath] = dirs
+    return _subroutine_dirs[inipath]
+
+def _subroutines():
+    """The names, times and sizes of the files o<name> call can open from
+    SUBROUTINE_PATH; listing the directories is cheap, reading every
+    program for the subroutines it calls would not be"""
+    stamps = []
+    for d in subroutine_dirs():
+        try:
+            names = sorted(os.listdir(d))
+        except OSError:
+            continue
+        for name in names:
+            if not name.endswith(".ngc"): continue
+            try:
+                st = os.stat(os.path.join(d, name))
+            except OSError:
+                continue
+            stamps.append((d, name, st.st_mtime, st.st_size))
+    return hashlib.sha1(repr(stamps)).hexdigest()
+
+def key(filename, canon, unitcode, initcode, interpname=""):
+    """What a preview depends on: the program, the subroutines it may
+    call, the code run before it, and what the canon tells the
+    interpreter, the parameters, tools and units.  A cached preview is
+    used only if its key is the same."""
+    st = os.stat(filename)
+    settings = []
+    for name in ("get_external_length_units", "get_external_angular_units",
+            "get_axis_mask", "get_block_delete"):
+        f = getattr(canon, name, None)
+        settings.append(f and f())
+    tools = repr([tuple(t) for t in getattr(canon, "tools", ())])
+    return (VERSION, os.path.abspath(filename), st.st_mtime, st.st_size,
+        unitcode, initcode, interpname, canon.arcdivision,
+        _digest(getattr(canon, "parameter_file", None)),
+        hashlib.sha1(tools).hexdigest(),
+        getattr(canon, "random", None), tuple(settings), _subroutines())
+
+def save(cachedir, filename, canon, k, result, seq):
+    """Writes the preview canon has after gcode.parse() returned
+    (result, seq), under the key k it was parsed with"""
+    error = ""
+    if result > gcode.MIN_ERROR: error = gcode.strerror(result)
+    meta = marshal.dumps({'key': k, 'result': result, 'seq': seq,
+        'error': error, 'dwells': canon.dwells, 'dwell_time': canon.dwell_time,
+        'foam_z': canon.foam_z, 'foam_w': canon.foam_w})
+    fd, tmp = tempfile.mkstemp(".tmp", ".", cachedir)
+    os.close(fd)
+    try:
+        canon.preview.save(tmp, meta)
+        os.rename(tmp, cache_file(cachedir, filename))
+    except:
+        os.unlink(tmp)
+        raise
+
+def read(filename):
+    """Reads a cache file into a gcode.preview and what was saved with it"""
+    preview = gcode.preview()
+    meta = marshal.loads(preview.load(filename))
+    return preview, meta
+
+def load(cachedir, filename, canon, unitcode, initcode, interpname=""):
+    """Gives canon the cached preview of filename, as gcode.parse() would
+    have left it, and returns (result, seq); or returns None if there is
+    none for the program as it is now.  Programs with errors are parsed
+    again, so that gcode.strerror() has the interpreter's message."""
+    try:
+        k = key(filename, canon, unitcode, initcode, interpname)
+        preview, meta = read(cache_file(cachedir, filename))
+    except (IOError, OSError, ValueError, EOFError, TypeError):
+        return None
+    if meta.get('key') != k or meta['result'] > gcode.MIN_ERROR:
+        return None
+    preview.arcdivision = canon.preview.arcdivision
+    canon.preview = preview
+    canon.traverse = preview.traverse
+    canon.feed = preview.feed
+    canon.arcfeed = preview.arcfeed
+    colors = canon.colors
+    canon.dwells[:] = [(d[0], colors.get(d[1], d[1])) + tuple(d[2:])
+        for d in meta['dwells']]
+    canon.dwell_time = meta['dwell_time']
+    canon.foam_z = meta['foam_z']
+    canon.foam_w = meta['foam_w']
+    return meta['result'], meta['seq']
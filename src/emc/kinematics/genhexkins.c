@@ -54,88 +54,90 @@
 #include "genhexkins.h"
 #include "kinematics.h"             /* these decls, KINEMATICS_FORWARD_FLAGS */
 
-/******************************* MatInvert() ***************************/
+/******************************* LUFactor() ****************************/
 
 /*-----------------------------------------------------------------------------
- This is a function that inverts a 6x6 matrix.
+  The Newton-Raphson loop and the forward Jacobian need J * x, but it is
+  the inverse Jacobian that is easy to compute.  Rather than inverting
+  it, the 6x6 system is factored into LU form with partial pivoting and
+  solved by substitution.  All loop bounds are NUM_STRUTS, so the compiler can
+  unroll them.  The factors are kept by kinematicsForward() to predict
+  the next call's starting point.
 -----------------------------------------------------------------------------*/
 
-static int MatInvert(double J[][NUM_STRUTS], double InvJ[][NUM_STRUTS])
-{
-  double JAug[NUM_STRUTS][12], m, temp;
-  int j, k, n;
-
-  /* This function determines the inverse of a 6x6 matrix using
-     Gauss-Jordan elimination */
-
-  /* Augment the Identity matrix to the Jacobian matrix */
+#define SINGULAR_PIVOT 1e-12
 
-  for (j=0; j<=5; ++j){
-    for (k=0; k<=5; ++k){     /* Assign J matrix to first 6 columns of AugJ */
-      JAug[j][k] = J[j][k];
-    }
-    for(k=6; k<=11; ++k){    /* Assign I matrix to last six columns of AugJ */
-      if (k-6 == j){
-        JAug[j][k]=1;
-      }
-      else{
-        JAug[j][k]=0;
+static int LUFactor(double A[][NUM_STRUTS], int piv[])
+{
+  double m, t, rpivot;
+  int i, j, k, p;
+
+  for (k = 0; k < NUM_STRUTS; k++) {
+    /* take the largest element left in column k as the pivot */
+    p = k;
+    m = fabs(A[k][k]);
+    for (i = k + 1; i < NUM_STRUTS; i++) {
+      if (fabs(A[i][k]) > m) {
+        m = fabs(A[i][k]);
+        p = i;
       }
     }
-  }
-
-  /* Perform Gauss elimination */
-  for (k=0; k<=4; ++k){               /* Pivot        */
-    if ((JAug[k][k]< 0.01) && (JAug[k][k] > -0.01)){
-      for (j=k+1;j<=5; ++j){
-        if ((JAug[j][k]>0.01) || (JAug[j][k]<-0.01)){
-          for (n=0; n<=11;++n){
-            temp = JAug[k][n];
-            JAug[k][n] = JAug[j][n];
-            JAug[j][n] = temp;
-          }
-          break;
-        }
+    if (m < SINGULAR_PIVOT) {
+      return -1;
+    }
+    piv[k] = p;
+    if (p != k) {
+      for (j = 0; j < NUM_STRUTS; j++) {
+        t = A[k][j];
+        A[k][j] = A[p][j];
+        A[p][j] = t;
       }
     }
-    for (j=k+1; j<=5; ++j){            /* Pivot */
-      m = -JAug[j][k] / JAug[k][k];
-      for (n=0; n<=11; ++n){
-        JAug[j][n]=JAug[j][n] + m*JAug[k][n];   /* (Row j) + m * (Row k) */
-        if ((JAug[j][n] < 0.000001) && (JAug[j][n] > -0.000001)){
-          JAug[j][n] = 0;
-        }
+
+    /* eliminate below the pivot, keeping the multipliers as L */
+    rpivot = 1.0 / A[k][k];
+    for (i = k + 1; i < NUM_STRUTS; i++) {
+      m = A[i][k] * rpivot;
+      A[i][k] = m;
+      for (j = k + 1; j < NUM_STRUTS; j++) {
+        A[i][j] -= m * A[k][j];
       }
     }
   }
 
-  /* Normalization of Diagonal Terms */
-  for (j=0; j<=5; ++j){
-    m=1/JAug[j][j];
-    for(k=0; k<=11; ++k){
-      JAug[j][k] = m * JAug[j][k];
+  return 0;
+}
+
+/******************************** LUSolve() *********************************/
+
+/*---------------------------------------------------------------------------
+  Solves A x = b in place, given the factors of A from LUFactor()
+  ---------------------------------------------------------------------------*/
+
+static void LUSolve(double LU[][NUM_STRUTS], const int piv[], double x[])
+{
+  double t;
+  int i, j;
+
+  for (i = 0; i < NUM_STRUTS; i++) {
+    if (piv[i] != i) {
+      t = x[i];
+      x[i] = x[piv[i]];
+      x[piv[i]] = t;
     }
   }
-
-  /* Perform Gauss Jordan Steps */
-  for (k=5; k>=0; --k){
-    for(j=k-1; j>=0; --j){
-      m = -JAug[j][k]/JAug[k][k];
-      for (n=0; n<=11; ++n){
-        JAug[j][n] = JAug[j][n] + m * JAug[k][n];
-      }
+  /* L has a unit diagonal */
+  for (i = 1; i < NUM_STRUTS; i++) {
+    for (j = 0; j < i; j++) {
+      x[i] -= LU[i][j] * x[j];
     }
   }
-
-  /* Assign last 6 columns of JAug to InvJ */
-  for (j=0; j<=5; ++j){
-    for (k=0; k<=5; ++k){
-      InvJ[j][k] = JAug[j][k+6];
-
+  for (i = NUM_STRUTS - 1; i >= 0; i--) {
+    for (j = i + 1; j < NUM_STRUTS; j++) {
+      x[i] -= LU[i][j] * x[j];
     }
+    x[i] /= LU[i][i];
   }
-
-  return 0;			/* FIXME-- check divisors for 0 above */
 }
 
 /******************************** MatMult() *********************************/
@@ -291,26 +293,28 @@ int jacobianInverse(const EmcPose * pos,
 
 /**************************** jacobianForward() ***************************/
 
-/* FIXME-- could use a better implementation than computing the
-   inverse and then inverting it */
 int jacobianForward(const double * joints,
 		    const double * jointvels,
 		    const EmcPose * pos,
 		    EmcPose * vel)
 {
   double InverseJacobian[NUM_STRUTS][NUM_STRUTS];
-  double Jacobian[NUM_STRUTS][NUM_STRUTS];
   double velmatrix[6];
+  int piv[NUM_STRUTS];
+  int i;
 
   if (0 != JInvMat(pos, InverseJacobian)) {
     return -1;
   }
-  if (0 != MatInvert(InverseJacobian, Jacobian)) {
+  if (0 != LUFactor(InverseJacobian, piv)) {
     return -1;
   }
 
-  /* Multiply J[] by jointvels to get vels */
-  MatMult(Jacobian, jointvels, velmatrix);
+  /* solve Jinv[] * vels = jointvels */
+  for (i = 0; i < NUM_STRUTS; i++) {
+    velmatrix[i] = jointvels[i];
+  }
+  LUSolve(InverseJacobian, piv, velmatrix);
   vel->tran.x = velmatrix[0];
   vel->tran.y = velmatrix[1];
   vel->tran.z = velmatrix[2];
@@ -328,7 +332,64 @@ int jacobianForward(const double * joints,
    flags are set to indicate their value appropriate to the world coordinates
    passed in. */
 
+/* Warm start.  Motion calls the forward kinematics every servo cycle,
+   for the commanded and for the feedback position, and passes in the
+   pose it got back the cycle before.  A few of the last solutions are
+   kept along with the joints they were solved for and the factored
+   Jacobian, and when the incoming pose is one of them the estimate is
+   first moved by J * (joints - last joints), i.e. by the joint motion
+   since that call.  That saves the first Newton-Raphson iteration. */
+#define WARM_SLOTS 4
+static struct {
+  EmcPose pos;
+  double joints[NUM_STRUTS];
+  double LU[NUM_STRUTS][NUM_STRUTS];
+  int piv[NUM_STRUTS];
+  int valid;
+} warm[WARM_SLOTS];
+static int warm_next = 0;
+static int warm_start = 1;	/* turned off by the benchmark for comparison */
+
+/* convergence statistics: calls needing 1..ITER_HIST_BINS iterations,
+   and more than that, in the last bin; calls rejected before the first
+   iteration only count as failures */
+#define ITER_HIST_BINS 8
+static struct {
+  unsigned int calls;
+  unsigned int failures;
+  unsigned int warm_starts;
+  unsigned int hist[ITER_HIST_BINS + 1];
+  int last;
+  int max;
+} stats;
+
+#ifdef RTAPI
+static void exportStats(void);
+#endif
+
 static int iteration = 0;	/* global so we can report it */
+
+static void countIterations(int retval, int warmed)
+{
+  stats.calls++;
+  if (retval < 0) {
+    stats.failures++;
+  }
+  if (warmed) {
+    stats.warm_starts++;
+  }
+  if (iteration > 0) {
+    stats.hist[iteration <= ITER_HIST_BINS ? iteration - 1 : ITER_HIST_BINS]++;
+  }
+  stats.last = iteration;
+  if (iteration > stats.max) {
+    stats.max = iteration;
+  }
+#ifdef RTAPI
+  exportStats();
+#endif
+}
+
 int kinematicsForward(const double * joints,
                       EmcPose * pos,
                       const KINEMATICS_FORWARD_FLAGS * fflags,
@@ -338,8 +399,11 @@ int kinematicsForward(const double * joints,
   PmCartesian InvKinStrutVect,InvKinStrutVectUnit;
   PmCartesian q_trans, RMatrix_a, RMatrix_a_cross_Strut;
 
-  double Jacobian[NUM_STRUTS][NUM_STRUTS];
-  double InverseJacobian[NUM_STRUTS][NUM_STRUTS];
+  /* the inverse Jacobian is built in alternate buffers, so the last
+     factored one is still there when the next one shows convergence */
+  double InverseJacobian[2][NUM_STRUTS][NUM_STRUTS];
+  double (*LU)[NUM_STRUTS] = 0;
+  int piv[NUM_STRUTS];
   double InvKinStrutLength, StrutLengthDiff[NUM_STRUTS];
   double delta[NUM_STRUTS];
   double conv_err = 1.0;
@@ -348,7 +412,8 @@ int kinematicsForward(const double * joints,
   PmRpy q_RPY;
 
   int iterate = 1;
-  int i;
+  int i, j, slot;
+  int warmed = 0;
   int retval = 0;
 
 #define HIGH_CONV_CRITERION   (1e-12)
@@ -371,9 +436,23 @@ int kinematicsForward(const double * joints,
       joints[3] <= 0.0 ||
       joints[4] <= 0.0 ||
       joints[5] <= 0.0) {
+    countIterations(-1, 0);
     return -1;
   }
 
+  /* look for the slot holding the pose we were given */
+  for (slot = 0; slot < WARM_SLOTS; slot++) {
+    if (warm[slot].valid &&
+	warm[slot].pos.tran.x == pos->tran.x &&
+	warm[slot].pos.tran.y == pos->tran.y &&
+	warm[slot].pos.tran.z == pos->tran.z &&
+	warm[slot].pos.a == pos->a &&
+	warm[slot].pos.b == pos->b &&
+	warm[slot].pos.c == pos->c) {
+      break;
+    }
+  }
+
   /* assign a,b,c to roll, pitch, yaw angles */
   q_RPY.r = pos->a * PM_PI / 180.0;
   q_RPY.p = pos->b * PM_PI / 180.0;
@@ -384,14 +463,29 @@ int kinematicsForward(const double * joints,
   q_trans.y = pos->tran.y;
   q_trans.z = pos->tran.z;
 
+  if (slot < WARM_SLOTS && warm_start) {
+    /* move the estimate along with the joints */
+    for (i = 0; i < NUM_STRUTS; i++) {
+      delta[i] = joints[i] - warm[slot].joints[i];
+    }
+    LUSolve(warm[slot].LU, warm[slot].piv, delta);
+    q_trans.x += delta[0];
+    q_trans.y += delta[1];
+    q_trans.z += delta[2];
+    q_RPY.r   += delta[3];
+    q_RPY.p   += delta[4];
+    q_RPY.y   += delta[5];
+    warmed = 1;
+  }
+  else if (slot == WARM_SLOTS) {
+    slot = warm_next;
+    warm_next = (warm_next + 1) % WARM_SLOTS;
+  }
+  warm[slot].valid = 0;
+
   /* Enter Newton-Raphson iterative method   */
   while (iterate) {
-    /* check for large error and return error flag if no convergence */
-    if ((conv_err > +LARGE_CONV_ERROR) || 
-	(conv_err < -LARGE_CONV_ERROR)) {
-      /* we can't converge */
-      return -2;
-    };
+    double (*InvJ)[NUM_STRUTS] = InverseJacobian[iteration & 1];
 
     iteration++;
 
@@ -415,6 +509,7 @@ int kinematicsForward(const double * joints,
        convergence criterion and return error flag if it can't */
     if (iteration > FAIL_CONV_ITERATIONS) {
       /* we can't converge */
+      countIterations(-5, warmed);
       return -5;
     }
 
@@ -429,6 +524,7 @@ int kinematicsForward(const double * joints,
       pmCartCartAdd(q_trans, RMatrix_a, &aw);
       pmCartCartSub(aw,b[i], &InvKinStrutVect);
       if (0 != pmCartUnit(InvKinStrutVect, &InvKinStrutVectUnit)) {
+	countIterations(-1, warmed);
 	return -1;
       }
       pmCartMag(InvKinStrutVect, &InvKinStrutLength);
@@ -437,35 +533,33 @@ int kinematicsForward(const double * joints,
       /* Determine RMatrix_a_cross_strut */
       pmCartCartCross(RMatrix_a, InvKinStrutVectUnit, &RMatrix_a_cross_Strut);
 
-      /* Build Inverse Jacobian Matrix */
-      InverseJacobian[i][0] = InvKinStrutVectUnit.x;
-      InverseJacobian[i][1] = InvKinStrutVectUnit.y;
-      InverseJacobian[i][2] = InvKinStrutVectUnit.z;
-      InverseJacobian[i][3] = RMatrix_a_cross_Strut.x;
-      InverseJacobian[i][4] = RMatrix_a_cross_Strut.y;
-      InverseJacobian[i][5] = RMatrix_a_cross_Strut.z;
+      /* Build Inverse Jacobian Matrix.  The rotation columns are
+	 taken with respect to roll, pitch and yaw rather than an
+	 angular velocity, because those are what we iterate on: with
+	 RMatrix = Rz(yaw) Ry(pitch) Rx(roll), the rotation axes for the
+	 three angles are RMatrix.x, Rz(yaw) y and z. */
+      InvJ[i][0] = InvKinStrutVectUnit.x;
+      InvJ[i][1] = InvKinStrutVectUnit.y;
+      InvJ[i][2] = InvKinStrutVectUnit.z;
+      pmCartCartDot(RMatrix_a_cross_Strut, RMatrix.x, &InvJ[i][3]);
+      InvJ[i][4] = RMatrix_a_cross_Strut.y * cos(q_RPY.y) -
+	RMatrix_a_cross_Strut.x * sin(q_RPY.y);
+      InvJ[i][5] = RMatrix_a_cross_Strut.z;
     }
 
-    /* invert Inverse Jacobian */
-    MatInvert(InverseJacobian, Jacobian);
-
-    /* multiply Jacobian by LegLengthDiff */
-    MatMult(Jacobian, StrutLengthDiff, delta);
-
-    /* subtract delta from last iterations pos values */
-    q_trans.x -= delta[0];
-    q_trans.y -= delta[1];
-    q_trans.z -= delta[2];
-    q_RPY.r   -= delta[3];
-    q_RPY.p   -= delta[4];
-    q_RPY.y   -= delta[5];
-
     /* determine value of conv_error (used to determine if no convergence) */
     conv_err = 0.0;
     for (i = 0; i < NUM_STRUTS; i++) {
       conv_err += fabs(StrutLengthDiff[i]);
     }
 
+    /* check for large error and return error flag if no convergence */
+    if (conv_err > LARGE_CONV_ERROR) {
+      /* we can't converge */
+      countIterations(-2, warmed);
+      return -2;
+    }
+
     /* enter loop to determine if a strut needs another iteration */
     iterate = 0;			/*assume iteration is done */
     for (i = 0; i < NUM_STRUTS; i++) {
@@ -473,6 +567,28 @@ int kinematicsForward(const double * joints,
 	iterate = 1;
       }
     }
+    if (!iterate) {
+      break;
+    }
+
+    /* solve Jinv * delta = StrutLengthDiff */
+    if (0 != LUFactor(InvJ, piv)) {
+      countIterations(-1, warmed);
+      return -1;
+    }
+    LU = InvJ;
+    for (i = 0; i < NUM_STRUTS; i++) {
+      delta[i] = StrutLengthDiff[i];
+    }
+    LUSolve(LU, piv, delta);
+
+    /* subtract delta from last iterations pos values */
+    q_trans.x -= delta[0];
+    q_trans.y -= delta[1];
+    q_trans.z -= delta[2];
+    q_RPY.r   -= delta[3];
+    q_RPY.p   -= delta[4];
+    q_RPY.y   -= delta[5];
   } /* exit Newton-Raphson Iterative loop */
 
   /* assign r,p,w to a,b,c */
@@ -485,6 +601,25 @@ int kinematicsForward(const double * joints,
   pos->tran.y = q_trans.y;
   pos->tran.z = q_trans.z;
 
+  /* remember the solution, and the last factored Jacobian unless the
+     estimate was good enough without one, then the old one is kept */
+  if (LU || warmed) {
+    if (LU) {
+      for (i = 0; i < NUM_STRUTS; i++) {
+	for (j = 0; j < NUM_STRUTS; j++) {
+	  warm[slot].LU[i][j] = LU[i][j];
+	}
+	warm[slot].piv[i] = piv[i];
+      }
+    }
+    warm[slot].pos = *pos;
+    for (i = 0; i < NUM_STRUTS; i++) {
+      warm[slot].joints[i] = joints[i];
+    }
+    warm[slot].valid = 1;
+  }
+
+  countIterations(retval, warmed);
   return retval;
 }
 
@@ -554,6 +689,8 @@ KINEMATICS_TYPE kinematicsType()
 #ifdef MAIN
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 /* FIXME-- this works for Unix only */
 #include <sys/time.h>		/* struct timeval */
 #include <unistd.h>		/* gettimeofday() */
@@ -568,6 +705,103 @@ static double timestamp()
   return ((double) tp.tv_sec) + ((double) tp.tv_usec) / 1000000.0;
 }
 
+static void printStats(void)
+{
+  int t;
+
+  printf("iterations:");
+  for (t = 0; t < ITER_HIST_BINS; t++) {
+    printf(" %d:%u", t + 1, stats.hist[t]);
+  }
+  printf(" more:%u  max %d, %u warm starts, %u failures\n",
+	 stats.hist[ITER_HIST_BINS], stats.max,
+	 stats.warm_starts, stats.failures);
+  memset(&stats, 0, sizeof(stats));
+}
+
+/* Benchmark: follow a path the way motion would, one servo cycle at a
+   time, feeding each forward solution back in as the next estimate.
+   The path is a circle with some tilt and twist around HOME, at a
+   speed of a few units/sec with a 1 ms servo period, and it is run
+   with and without the warm start. */
+#define BENCH_HOME_Z 20.0
+#define BENCH_RADIUS 5.0
+#define BENCH_TILT 5.0			/* degrees */
+#define BENCH_PERIOD 0.001
+#define BENCH_REV 10.0			/* seconds per circle */
+
+static void benchPose(long n, EmcPose *pos)
+{
+  double t = 2.0 * PM_PI * n * BENCH_PERIOD / BENCH_REV;
+
+  pos->tran.x = BENCH_RADIUS * cos(t);
+  pos->tran.y = BENCH_RADIUS * sin(t);
+  pos->tran.z = BENCH_HOME_Z + 0.2 * BENCH_RADIUS * sin(3.0 * t);
+  pos->a = BENCH_TILT * sin(t);
+  pos->b = BENCH_TILT * cos(t);
+  pos->c = 2.0 * BENCH_TILT * sin(2.0 * t);
+}
+
+static int bench(long cycles)
+{
+  KINEMATICS_INVERSE_FLAGS iflags = 0;
+  KINEMATICS_FORWARD_FLAGS fflags = 0;
+  EmcPose pos, want;
+  double (*joints)[NUM_STRUTS];
+  double start, end, err, maxerr;
+  long n;
+  int pass, retval;
+
+  joints = malloc(cycles * sizeof(*joints));
+  if (!joints) {
+    return 1;
+  }
+  for (n = 0; n < cycles; n++) {
+    benchPose(n, &want);
+    kinematicsInverse(&want, joints[n], &iflags, &fflags);
+  }
+
+  for (pass = 0; pass < 2; pass++) {
+    warm_start = !pass;
+    memset(warm, 0, sizeof(warm));
+    benchPose(0, &pos);
+
+    memset(&stats, 0, sizeof(stats));
+    start = timestamp();
+    for (n = 0; n < cycles; n++) {
+      retval = kinematicsForward(joints[n], &pos, &fflags, &iflags);
+      if (0 != retval) {
+	printf("fwd kins error %d at cycle %ld\n", retval, n);
+	free(joints);
+	return 1;
+      }
+    }
+    end = timestamp();
+    printf("%s start: %ld calls, %.0f ns/call\n",
+	   warm_start ? "warm" : "cold", cycles,
+	   (end - start) * 1e9 / cycles);
+    printStats();
+
+    /* check the solutions against the path, outside the timing */
+    maxerr = 0.0;
+    benchPose(0, &pos);
+    for (n = 0; n < cycles; n++) {
+      kinematicsForward(joints[n], &pos, &fflags, &iflags);
+      benchPose(n, &want);
+      err = fabs(pos.tran.x - want.tran.x) + fabs(pos.tran.y - want.tran.y) +
+	fabs(pos.tran.z - want.tran.z) + fabs(pos.a - want.a) +
+	fabs(pos.b - want.b) + fabs(pos.c - want.c);
+      if (err > maxerr) {
+	maxerr = err;
+      }
+    }
+    printf("max error %g\n", maxerr);
+  }
+
+  free(joints);
+  return 0;
+}
+
 int main(int argc, char *argv[])
 {
 #define BUFFERLEN 256
@@ -585,7 +819,16 @@ int main(int argc, char *argv[])
 #define ITERATIONS 100000
   double start, end;
 
-  /* syntax is a.out {i|f # # # # # #} */
+  /* syntax is a.out {i|f # # # # # #} or a.out b [cycles] */
+  if (argc >= 2 && argc <= 3 && argv[1][0] == 'b') {
+    long cycles = 100000;
+
+    if (argc == 3 && (1 != sscanf(argv[2], "%ld", &cycles) || cycles < 1)) {
+      fprintf(stderr, "bad value: %s\n", argv[2]);
+      return 1;
+    }
+    return bench(cycles);
+  }
   if (argc == 8) {
     if (argv[1][0] == 'f') {
       /* joints passed, so do interations on forward kins for timing */
@@ -626,7 +869,7 @@ int main(int argc, char *argv[])
       inverse = 1;
     }
     else {
-      fprintf(stderr, "syntax: %s {i|f # # # # # #}\n", argv[0]);
+      fprintf(stderr, "syntax: %s {i|f # # # # # #} | b [cycles]\n", argv[0]);
       return 1;
     }
 
@@ -668,6 +911,9 @@ int main(int argc, char *argv[])
 
     printf("calculation time: %f secs\n",
 	   (end - start) / ((double) ITERATIONS));
+    if (!inverse) {
+      printStats();
+    }
     return 0;
   } /* end of if args for timestamping */
 
@@ -898,15 +1144,78 @@ MODULE_LICENSE("GPL");
 
 
 
+static struct haldata {
+  hal_s32_t *last_iterations;
+  hal_s32_t *max_iterations;
+  hal_u32_t *hist[ITER_HIST_BINS + 1];
+  hal_u32_t *calls;
+  hal_u32_t *failures;
+  hal_u32_t *warm_starts;
+  hal_bit_t *reset_stats;
+} *haldata = 0;
+
+static void exportStats(void)
+{
+  int i;
+
+  if (!haldata) {
+    return;
+  }
+  if (*haldata->reset_stats) {
+    stats.calls = stats.failures = stats.warm_starts = 0;
+    for (i = 0; i <= ITER_HIST_BINS; i++) {
+      stats.hist[i] = 0;
+    }
+    stats.max = 0;
+  }
+  *haldata->last_iterations = stats.last;
+  *haldata->max_iterations = stats.max;
+  for (i = 0; i <= ITER_HIST_BINS; i++) {
+    *haldata->hist[i] = stats.hist[i];
+  }
+  *haldata->calls = stats.calls;
+  *haldata->failures = stats.failures;
+  *haldata->warm_starts = stats.warm_starts;
+}
+
 int comp_id;
 int rtapi_app_main(void) {
+    struct haldata *h;
+    int res = 0, i;
+
     comp_id = hal_init("genhexkins");
-    if(comp_id > 0) {
-	hal_ready(comp_id);
-	return 0;
+    if(comp_id < 0) return comp_id;
+
+    h = hal_malloc(sizeof(struct haldata));
+    if (!h) goto error;
+
+    if((res = hal_pin_s32_newf(HAL_OUT, &(h->last_iterations), comp_id,
+	    "genhexkins.last-iterations")) < 0) goto error;
+    if((res = hal_pin_s32_newf(HAL_OUT, &(h->max_iterations), comp_id,
+	    "genhexkins.max-iterations")) < 0) goto error;
+    for (i = 0; i < ITER_HIST_BINS; i++) {
+	if((res = hal_pin_u32_newf(HAL_OUT, &(h->hist[i]), comp_id,
+		"genhexkins.iterations-%d", i + 1)) < 0) goto error;
     }
-    return comp_id;
+    if((res = hal_pin_u32_newf(HAL_OUT, &(h->hist[ITER_HIST_BINS]), comp_id,
+	    "genhexkins.iterations-more")) < 0) goto error;
+    if((res = hal_pin_u32_newf(HAL_OUT, &(h->calls), comp_id,
+	    "genhexkins.calls")) < 0) goto error;
+    if((res = hal_pin_u32_newf(HAL_OUT, &(h->failures), comp_id,
+	    "genhexkins.failures")) < 0) goto error;
+    if((res = hal_pin_u32_newf(HAL_OUT, &(h->warm_starts), comp_id,
+	    "genhexkins.warm-starts")) < 0) goto error;
+    if((res = hal_pin_bit_newf(HAL_IN, &(h->reset_stats), comp_id,
+	    "genhexkins.reset-stats")) < 0) goto error;
+
+    haldata = h;
+    hal_ready(comp_id);
+    return 0;
+
+error:
+    hal_exit(comp_id);
+    return res ? res : -ENOMEM;
 }
 
-void rtapi_app_exit(void) { hal_exit(comp_id); }
+void rtapi_app_exit(void) { haldata = 0; hal_exit(comp_id); }
 #endif
@@ -0,0 +1,648 @@
+/********************************************************************
+* Description: userkins.c
+*   Run realtime kinematics modules in user space, on arrays of poses
+*
+* License: GPL Version 2
+* System: Linux
+*
+*******************************************************************
+
+  See userkins.h.  The module is dlopen()ed as rtapi_app would, and
+  the HAL functions it calls while loading are the stand-ins below,
+  which keep its pins and parameters in plain memory owned by the
+  userkins_t.  Kinematics modules only create pins and parameters, so
+  that is all that is provided.
+*/
+
+#define _GNU_SOURCE		/* dladdr(), dlmopen() */
+#include <dlfcn.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#include "config.h"
+#include "rtapi.h"
+#include "hal.h"
+#include "userkins.h"
+
+#ifndef EMC2_RTLIB_DIR
+#define EMC2_RTLIB_DIR "/usr/lib/linuxcnc"
+#endif
+
+/* the flavors whose modules are shared objects */
+static const char *userland_flavors[] = {
+    "posix", "rt-preempt", "xenomai", NULL
+};
+
+typedef int (*forward_t)(const double *, EmcPose *,
+			 const KINEMATICS_FORWARD_FLAGS *,
+			 KINEMATICS_INVERSE_FLAGS *);
+typedef int (*inverse_t)(const EmcPose *, double *,
+			 const KINEMATICS_INVERSE_FLAGS *,
+			 KINEMATICS_FORWARD_FLAGS *);
+typedef KINEMATICS_TYPE (*type_t)(void);
+
+/* this library's own entry points, in a copy of it loaded elsewhere */
+struct userkins_ops {
+    userkins_t *(*load)(const char *, char *, int);
+    void (*unload)(userkins_t *);
+    KINEMATICS_TYPE (*type)(userkins_t *);
+    int (*num_params)(userkins_t *);
+    const char *(*param_name)(userkins_t *, int);
+    int (*get)(userkins_t *, const char *, double *);
+    int (*set)(userkins_t *, const char *, double);
+    long (*forward)(userkins_t *, const double *, int, EmcPose *, long,
+		    int *);
+    long (*inverse)(userkins_t *, const EmcPose *, double *, int, long,
+		    int *);
+};
+
+struct userkins_param {
+    char name[HAL_NAME_LEN + 1];
+    hal_type_t type;
+    volatile void *data;
+};
+
+struct userkins_block {
+    struct userkins_block *next;
+    double data[];		/* aligned for any HAL type */
+};
+
+struct userkins {
+    char name[HAL_NAME_LEN + 1];
+    void *dl;
+    forward_t forward;
+    inverse_t inverse;
+    type_t type;
+    KINEMATICS_FORWARD_FLAGS fflags;
+    KINEMATICS_INVERSE_FLAGS iflags;
+    pthread_mutex_t lock;	/* kinematics modules aren't reentrant */
+
+    struct userkins_param *params;
+    int nparams;
+    struct userkins_block *blocks;	/* from hal_malloc(), and pins */
+
+    /* set if the module was loaded in a private namespace, see
+       load_isolated(); every call is passed on to remote */
+    void *ns;
+    userkins_t *remote;
+    struct userkins_ops ops;
+};
+
+/* the module being loaded, for the HAL stand-ins; loads are serialized */
+static pthread_mutex_t load_lock = PTHREAD_MUTEX_INITIALIZER;
+static userkins_t *loading;
+static int next_comp_id = 1;
+
+/***********************************************************************
+*                          HAL stand-ins                               *
+************************************************************************/
+
+int hal_init_mode(const char *name, int mode)
+{
+    if (!loading)
+	return -EINVAL;
+    return next_comp_id++;
+}
+
+int hal_ready(int comp_id)
+{
+    return 0;
+}
+
+int hal_exit(int comp_id)
+{
+    return 0;
+}
+
+void *hal_malloc(long int size)
+{
+    struct userkins_block *b;
+
+    if (!loading || size < 0)
+	return NULL;
+    b = calloc(1, sizeof(*b) + size);
+    if (!b)
+	return NULL;
+    b->next = loading->blocks;
+    loading->blocks = b;
+    return b->data;
+}
+
+static int add_param(hal_type_t type, volatile void *data, const char *fmt,
+		     va_list ap)
+{
+    struct userkins_param *p;
+
+    if (!loading || !data)
+	return -EINVAL;
+    p = realloc(loading->params, (loading->nparams + 1) * sizeof(*p));
+    if (!p)
+	return -ENOMEM;
+    loading->params = p;
+    p += loading->nparams;
+    if (vsnprintf(p->name, sizeof(p->name), fmt, ap) >= (int) sizeof(p->name))
+	return -EINVAL;
+    p->type = type;
+    p->data = data;
+    loading->nparams++;
+    return 0;
+}
+
+static int add_pin(hal_type_t type, void **ptr, const char *fmt, va_list ap)
+{
+    void *data = hal_malloc(sizeof(double));
+    int retval;
+
+    if (!data)
+	return -ENOMEM;
+    retval = add_param(type, data, fmt, ap);
+    if (retval == 0)
+	*ptr = data;
+    return retval;
+}
+
+static int new_pin(hal_type_t type, void **ptr, const char *fmt, ...)
+{
+    va_list ap;
+    int retval;
+
+    va_start(ap, fmt);
+    retval = add_pin(type, ptr, fmt, ap);
+    va_end(ap);
+    return retval;
+}
+
+static int new_param(hal_type_t type, volatile void *data,
+		     const char *fmt, ...)
+{
+    va_list ap;
+    int retval;
+
+    va_start(ap, fmt);
+    retval = add_param(type, data, fmt, ap);
+    va_end(ap);
+    return retval;
+}
+
+int hal_pin_new(const char *name, hal_type_t type, hal_pin_dir_t dir,
+		void **data_ptr_addr, int comp_id)
+{
+    return new_pin(type, data_ptr_addr, "%s", name);
+}
+
+#define PIN_NEW(type, TYPE)						\
+int hal_pin_##type##_new(const char *name, hal_pin_dir_t dir,		\
+			 hal_##type##_t **data_ptr_addr, int comp_id)	\
+{									\
+    return new_pin(TYPE, (void **) data_ptr_addr, "%s", name);		\
+}									\
+int hal_pin_##type##_newf(hal_pin_dir_t dir,				\
+			  hal_##type##_t **data_ptr_addr, int comp_id,	\
+			  const char *fmt, ...)				\
+{									\
+    va_list ap;								\
+    int retval;								\
+    va_start(ap, fmt);							\
+    retval = add_pin(TYPE, (void **) data_ptr_addr, fmt, ap);		\
+    va_end(ap);								\
+    return retval;							\
+}
+
+#define PARAM_NEW(type, TYPE)						\
+int hal_param_##type##_new(const char *name, hal_param_dir_t dir,	\
+			   hal_##type##_t *data_addr, int comp_id)	\
+{									\
+    return new_param(TYPE, data_addr, "%s", name);			\
+}									\
+int hal_param_##type##_newf(hal_param_dir_t dir,			\
+			    hal_##type##_t *data_addr, int comp_id,	\
+			    const char *fmt, ...)			\
+{									\
+    va_list ap;								\
+    int retval;								\
+    va_start(ap, fmt);							\
+    retval = add_param(TYPE, data_addr, fmt, ap);			\
+    va_end(ap);								\
+    return retval;							\
+}
+
+PIN_NEW(bit, HAL_BIT)
+PIN_NEW(float, HAL_FLOAT)
+PIN_NEW(s32, HAL_S32)
+PIN_NEW(u32, HAL_U32)
+PARAM_NEW(bit, HAL_BIT)
+PARAM_NEW(float, HAL_FLOAT)
+PARAM_NEW(s32, HAL_S32)
+PARAM_NEW(u32, HAL_U32)
+
+void rtapi_print(const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+}
+
+void rtapi_print_msg(int level, const char *fmt, ...)
+{
+    va_list ap;
+
+    if (level > RTAPI_MSG_ERR)
+	return;
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+}
+
+/***********************************************************************
+*                            loading                                   *
+************************************************************************/
+
+static void free_kins(userkins_t *kins)
+{
+    struct userkins_block *b;
+
+    while ((b = kins->blocks)) {
+	kins->blocks = b->next;
+	free(b);
+    }
+    free(kins->params);
+    pthread_mutex_destroy(&kins->lock);
+    free(kins);
+}
+
+static int find_module(const char *name, char *path, int len)
+{
+    const char *dir = getenv("HAL_RTMOD_DIR");
+    const char *flavor = getenv("FLAVOR");
+    struct stat st;
+    int i;
+
+    if (strchr(name, '/')) {
+	snprintf(path, len, "%s", name);
+	return stat(path, &st);
+    }
+    if (!dir || !*dir)
+	dir = EMC2_RTLIB_DIR;
+    if (flavor) {
+	snprintf(path, len, "%s/%s/%s.so", dir, flavor, name);
+	if (stat(path, &st) == 0)
+	    return 0;
+    }
+    for (i = 0; userland_flavors[i]; i++) {
+	snprintf(path, len, "%s/%s/%s.so", dir, userland_flavors[i], name);
+	if (stat(path, &st) == 0)
+	    return 0;
+    }
+    snprintf(path, len, "%s/<flavor>/%s.so", dir, name);
+    return -1;
+}
+
+/* The module resolves the HAL functions in the global scope, which a
+   library loaded by an interpreter isn't in, so make sure this one is,
+   and that it is this library's functions the module will get.  In a
+   namespace of its own, this library is the global scope already. */
+static int export_stand_ins(void)
+{
+    Dl_info info;
+    Lmid_t lmid;
+    void *self;
+
+    /* fails harmlessly if this is linked into the executable */
+    if (dladdr((void *) hal_init_mode, &info) && info.dli_fname) {
+	self = dlopen(info.dli_fname, RTLD_NOW | RTLD_NOLOAD);
+	if (self && dlinfo(self, RTLD_DI_LMID, &lmid) == 0 &&
+	    lmid != LM_ID_BASE) {
+	    dlclose(self);
+	    return 0;
+	}
+	if (self)
+	    dlclose(self);
+	dlopen(info.dli_fname, RTLD_NOW | RTLD_GLOBAL | RTLD_NOLOAD);
+    }
+    if (dlsym(RTLD_DEFAULT, "hal_init_mode") != (void *) hal_init_mode ||
+	dlsym(RTLD_DEFAULT, "hal_pin_float_newf") != (void *) hal_pin_float_newf)
+	return -1;
+    return 0;
+}
+
+#define RESOLVE(kins, f) \
+    (*(void **) &(kins)->ops.f = dlsym((kins)->ns, "userkins_" #f))
+
+/* With the HAL library in the global scope, as in any program that
+   runs the interpreter, the module would bind to the real HAL.  Load a
+   second copy of this library into a new link namespace instead, where
+   it is the global scope the module sees, and pass every call on to
+   it.  glibc allows 15 such namespaces per process. */
+static userkins_t *load_isolated(const char *name, char *err, int errlen)
+{
+    Dl_info info;
+    userkins_t *kins;
+
+    if (!dladdr((void *) userkins_load, &info) || !info.dli_fname) {
+	snprintf(err, errlen,
+		 "userkins: the HAL library is loaded in this process");
+	return NULL;
+    }
+    kins = calloc(1, sizeof(*kins));
+    if (!kins) {
+	snprintf(err, errlen, "%s", strerror(ENOMEM));
+	return NULL;
+    }
+    pthread_mutex_init(&kins->lock, NULL);
+    kins->ns = dlmopen(LM_ID_NEWLM, info.dli_fname, RTLD_NOW | RTLD_LOCAL);
+    if (!kins->ns) {
+	snprintf(err, errlen, "%s", dlerror());
+	free_kins(kins);
+	return NULL;
+    }
+    if (!RESOLVE(kins, load) || !RESOLVE(kins, unload) ||
+	!RESOLVE(kins, type) || !RESOLVE(kins, num_params) ||
+	!RESOLVE(kins, param_name) || !RESOLVE(kins, get) ||
+	!RESOLVE(kins, set) || !RESOLVE(kins, forward) ||
+	!RESOLVE(kins, inverse)) {
+	snprintf(err, errlen, "%s", dlerror());
+	goto fail;
+    }
+    kins->remote = kins->ops.load(name, err, errlen);
+    if (!kins->remote)
+	goto fail;
+    snprintf(kins->name, sizeof(kins->name), "%s", userkins_name(kins->remote));
+    return kins;
+
+fail:
+    dlclose(kins->ns);
+    free_kins(kins);
+    return NULL;
+}
+
+userkins_t *userkins_load(const char *name, char *err, int errlen)
+{
+    char path[PATH_MAX];
+    const char *base;
+    userkins_t *kins;
+    int (*start)(void);
+    int retval;
+
+    if (find_module(name, path, sizeof(path)) != 0) {
+	snprintf(err, errlen, "%s: no such module", path);
+	return NULL;
+    }
+    kins = calloc(1, sizeof(*kins));
+    if (!kins) {
+	snprintf(err, errlen, "%s", strerror(ENOMEM));
+	return NULL;
+    }
+    pthread_mutex_init(&kins->lock, NULL);
+    base = strrchr(path, '/');
+    snprintf(kins->name, sizeof(kins->name), "%s", base ? base + 1 : path);
+    if (strlen(kins->name) > 3 &&
+	!strcmp(kins->name + strlen(kins->name) - 3, ".so"))
+	kins->name[strlen(kins->name) - 3] = 0;
+
+    pthread_mutex_lock(&load_lock);
+    if (export_stand_ins() != 0) {
+	pthread_mutex_unlock(&load_lock);
+	free_kins(kins);
+	return load_isolated(name, err, errlen);
+    }
+
+    kins->dl = dlopen(path, RTLD_NOW | RTLD_LOCAL | RTLD_NOLOAD);
+    if (kins->dl) {
+	snprintf(err, errlen, "%s: already loaded", kins->name);
+	goto fail;
+    }
+    kins->dl = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!kins->dl) {
+	snprintf(err, errlen, "%s", dlerror());
+	goto fail;
+    }
+    start = (int (*)(void)) dlsym(kins->dl, "rtapi_app_main");
+    kins->type = (type_t) dlsym(kins->dl, "kinematicsType");
+    kins->forward = (forward_t) dlsym(kins->dl, "kinematicsForward");
+    kins->inverse = (inverse_t) dlsym(kins->dl, "kinematicsInverse");
+    if (!start || !kins->type || !kins->inverse) {
+	snprintf(err, errlen, "%s: not a kinematics module", kins->name);
+	goto fail;
+    }
+
+    loading = kins;
+    retval = start();
+    loading = NULL;
+    if (retval < 0) {
+	snprintf(err, errlen, "%s: rtapi_app_main: %s",
+		 kins->name, strerror(-retval));
+	goto fail;
+    }
+    pthread_mutex_unlock(&load_lock);
+    return kins;
+
+fail:
+    if (kins->dl)
+	dlclose(kins->dl);
+    pthread_mutex_unlock(&load_lock);
+    free_kins(kins);
+    return NULL;
+}
+
+void userkins_unload(userkins_t *kins)
+{
+    void (*stop)(void);
+
+    if (!kins)
+	return;
+    if (kins->remote) {
+	kins->ops.unload(kins->remote);
+	dlclose(kins->ns);
+	free_kins(kins);
+	return;
+    }
+    pthread_mutex_lock(&load_lock);
+    stop = (void (*)(void)) dlsym(kins->dl, "rtapi_app_exit");
+    if (stop)
+	stop();
+    dlclose(kins->dl);
+    pthread_mutex_unlock(&load_lock);
+    free_kins(kins);
+}
+
+const char *userkins_name(userkins_t *kins)
+{
+    return kins->name;
+}
+
+KINEMATICS_TYPE userkins_type(userkins_t *kins)
+{
+    if (kins->remote)
+	return kins->ops.type(kins->remote);
+    return kins->type();
+}
+
+/***********************************************************************
+*                      pins and parameters                             *
+************************************************************************/
+
+int userkins_num_params(userkins_t *kins)
+{
+    if (kins->remote)
+	return kins->ops.num_params(kins->remote);
+    return kins->nparams;
+}
+
+const char *userkins_param_name(userkins_t *kins, int n)
+{
+    if (kins->remote)
+	return kins->ops.param_name(kins->remote, n);
+    if (n < 0 || n >= kins->nparams)
+	return NULL;
+    return kins->params[n].name;
+}
+
+static struct userkins_param *find_param(userkins_t *kins, const char *name)
+{
+    int n;
+
+    for (n = 0; n < kins->nparams; n++)
+	if (!strcmp(kins->params[n].name, name))
+	    return &kins->params[n];
+    return NULL;
+}
+
+int userkins_get(userkins_t *kins, const char *name, double *value)
+{
+    struct userkins_param *p;
+
+    if (kins->remote)
+	return kins->ops.get(kins->remote, name, value);
+    p = find_param(kins, name);
+    if (!p)
+	return -ENOENT;
+    switch (p->type) {
+    case HAL_BIT:
+	*value = *(hal_bit_t *) p->data;
+	break;
+    case HAL_FLOAT:
+	*value = *(hal_float_t *) p->data;
+	break;
+    case HAL_S32:
+	*value = *(hal_s32_t *) p->data;
+	break;
+    case HAL_U32:
+	*value = *(hal_u32_t *) p->data;
+	break;
+    default:
+	return -EINVAL;
+    }
+    return 0;
+}
+
+int userkins_set(userkins_t *kins, const char *name, double value)
+{
+    struct userkins_param *p;
+
+    if (kins->remote)
+	return kins->ops.set(kins->remote, name, value);
+    p = find_param(kins, name);
+    if (!p)
+	return -ENOENT;
+    pthread_mutex_lock(&kins->lock);
+    switch (p->type) {
+    case HAL_BIT:
+	*(hal_bit_t *) p->data = value != 0;
+	break;
+    case HAL_FLOAT:
+	*(hal_float_t *) p->data = value;
+	break;
+    case HAL_S32:
+	*(hal_s32_t *) p->data = (__s32) value;
+	break;
+    case HAL_U32:
+	*(hal_u32_t *) p->data = (__u32) value;
+	break;
+    default:
+	break;
+    }
+    pthread_mutex_unlock(&kins->lock);
+    return 0;
+}
+
+/***********************************************************************
+*                          transforms                                  *
+************************************************************************/
+
+long userkins_forward(userkins_t *kins, const double *joints, int njoints,
+		      EmcPose *world, long n, int *status)
+{
+    double j[USERKINS_MAX_JOINTS] = { 0.0 };
+    EmcPose pos;
+    long i, failed = 0;
+    int retval;
+
+    if (kins->remote)
+	return kins->ops.forward(kins->remote, joints, njoints, world, n,
+				 status);
+    if (njoints < 1 || njoints > USERKINS_MAX_JOINTS)
+	return -EINVAL;
+    if (!kins->forward || kins->type() == KINEMATICS_INVERSE_ONLY)
+	return -ENOSYS;
+    if (n <= 0)
+	return 0;
+
+    pthread_mutex_lock(&kins->lock);
+    pos = world[0];
+    for (i = 0; i < n; i++) {
+	memcpy(j, joints + i * njoints, njoints * sizeof(double));
+	retval = kins->forward(j, &pos, &kins->fflags, &kins->iflags);
+	if (retval != 0) {
+	    failed++;
+	    /* go on from the last good pose */
+	    pos = i ? world[i - 1] : world[0];
+	}
+	world[i] = pos;
+	if (status)
+	    status[i] = retval;
+    }
+    pthread_mutex_unlock(&kins->lock);
+    return failed;
+}
+
+long userkins_inverse(userkins_t *kins, const EmcPose *world, double *joints,
+		      int njoints, long n, int *status)
+{
+    double j[USERKINS_MAX_JOINTS] = { 0.0 }, last[USERKINS_MAX_JOINTS];
+    long i, failed = 0;
+    int retval;
+
+    if (kins->remote)
+	return kins->ops.inverse(kins->remote, world, joints, njoints, n,
+				 status);
+    if (njoints < 1 || njoints > USERKINS_MAX_JOINTS)
+	return -EINVAL;
+    if (n <= 0)
+	return 0;
+
+    pthread_mutex_lock(&kins->lock);
+    memcpy(j, joints, njoints * sizeof(double));
+    memcpy(last, j, sizeof(j));
+    for (i = 0; i < n; i++) {
+	retval = kins->inverse(&world[i], j, &kins->iflags, &kins->fflags);
+	if (retval != 0) {
+	    failed++;
+	    memcpy(j, last, sizeof(j));
+	} else {
+	    memcpy(last, j, sizeof(j));
+	}
+	memcpy(joints + i * njoints, j, njoints * sizeof(double));
+	if (status)
+	    status[i] = retval;
+    }
+    pthread_mutex_unlock(&kins->lock);
+    return failed;
+}
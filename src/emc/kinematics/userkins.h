@@ -0,0 +1,82 @@
+/********************************************************************
+* Description: userkins.h
+*   Run realtime kinematics modules in user space, on arrays of poses
+*
+* License: GPL Version 2
+* System: Linux
+*
+*******************************************************************
+
+  The kinematics modules (trivkins, genserkins, pumakins and so on)
+  transform one pose per call, inside motion.  This library loads the
+  same modules, as built for a userland thread flavor, into an ordinary
+  process, with a small stand-in for the HAL calls they make from
+  rtapi_app_main(), and runs their kinematicsForward() and
+  kinematicsInverse() over whole arrays.  That is what the preview and
+  program checks need to map world coordinates to joints, without a
+  running realtime environment.
+
+  The geometry pins and parameters a module exports are kept by the
+  library and can be read and set by name, e.g. "genserkins.A-1".
+
+  Modules are found in $HAL_RTMOD_DIR/<flavor>, or in the directory
+  given at build time, for the flavor named by $FLAVOR, else the first
+  of the userland flavors that has the module.  A name containing a '/'
+  is taken as the path of the module.
+
+  The stand-in HAL functions are resolved by the module at load time.
+  In a process that has the HAL library (liblinuxcnchal) in its global
+  symbol scope, as anything linked with the interpreter does, the
+  module is loaded into a link namespace of its own, with a private
+  copy of this library.  A module can be loaded once per process, or
+  once per namespace.
+*/
+
+#ifndef USERKINS_H
+#define USERKINS_H
+
+#include "emcpos.h"		/* EmcPose */
+#include "kinematics.h"		/* KINEMATICS_TYPE */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the most joints a module may read or write, EMCMOT_MAX_JOINTS */
+#define USERKINS_MAX_JOINTS 9
+
+typedef struct userkins userkins_t;
+
+/* Loads a kinematics module and runs its rtapi_app_main().  Returns
+   NULL on failure, with the reason in err. */
+extern userkins_t *userkins_load(const char *name, char *err, int errlen);
+extern void userkins_unload(userkins_t *kins);
+
+extern const char *userkins_name(userkins_t *kins);
+extern KINEMATICS_TYPE userkins_type(userkins_t *kins);
+
+/* pins and parameters exported by the module, all read and written as
+   doubles.  get and set return 0, or -ENOENT for an unknown name. */
+extern int userkins_num_params(userkins_t *kins);
+extern const char *userkins_param_name(userkins_t *kins, int n);
+extern int userkins_get(userkins_t *kins, const char *name, double *value);
+extern int userkins_set(userkins_t *kins, const char *name, double value);
+
+/* Transform n poses.  joints holds n rows of njoints values, and world
+   n poses.  Iterative kinematics start each pose from the result for
+   the previous one, like motion does from cycle to cycle, and the
+   first from what the output array holds on entry.  Every pose is
+   tried; the return value is the number that failed, and if status is
+   not NULL, status[i] is the kinematics return value for pose i.
+   Returns -EINVAL for a bad njoints, and -ENOSYS from userkins_forward()
+   for a module with inverse kinematics only. */
+extern long userkins_forward(userkins_t *kins, const double *joints,
+			     int njoints, EmcPose *world, long n, int *status);
+extern long userkins_inverse(userkins_t *kins, const EmcPose *world,
+			     double *joints, int njoints, long n, int *status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* USERKINS_H */
@@ -0,0 +1,343 @@
+//    Python interface to userkins: kinematics modules in user space
+//
+//    This program is free software; you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation; either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program; if not, write to the Free Software
+//    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+#include <Python.h>
+#include <errno.h>
+#include <string.h>
+
+#include "userkins.h"
+
+#if PY_VERSION_HEX < 0x02050000 && !defined(PY_SSIZE_T_MIN)
+typedef int Py_ssize_t;
+#define PY_SSIZE_T_MAX INT_MAX
+#define PY_SSIZE_T_MIN INT_MIN
+#endif
+
+#define POSE_DOUBLES (sizeof(EmcPose) / sizeof(double))
+
+typedef struct {
+    PyObject_HEAD
+    userkins_t *kins;
+} kinsobject;
+
+static PyObject *userkins_error_type;
+
+static int pykins_init(PyObject *_self, PyObject *args, PyObject *kw) {
+    kinsobject *self = (kinsobject *)_self;
+    char *name;
+    char err[256];
+
+    if(!PyArg_ParseTuple(args, "s:userkins.kins", &name)) return -1;
+    if(self->kins) {
+        PyErr_SetString(PyExc_RuntimeError, "already loaded");
+        return -1;
+    }
+    self->kins = userkins_load(name, err, sizeof(err));
+    if(!self->kins) {
+        PyErr_SetString(userkins_error_type, err);
+        return -1;
+    }
+    return 0;
+}
+
+static void pykins_delete(PyObject *_self) {
+    kinsobject *self = (kinsobject *)_self;
+    if(self->kins) userkins_unload(self->kins);
+    PyObject_Del(self);
+}
+
+#define EXCEPTION_IF_NOT_LOADED(retval) do { \
+    if(!self->kins) { \
+        PyErr_SetString(PyExc_RuntimeError, "kinematics module not loaded"); \
+        return retval; \
+    } \
+} while(0)
+
+static PyObject *pykins_repr(PyObject *_self) {
+    kinsobject *self = (kinsobject *)_self;
+    if(!self->kins) return PyString_FromString("<userkins.kins, not loaded>");
+    return PyString_FromFormat("<userkins.kins %s>", userkins_name(self->kins));
+}
+
+static PyObject *pykins_params(PyObject *_self, PyObject *o) {
+    kinsobject *self = (kinsobject *)_self;
+    EXCEPTION_IF_NOT_LOADED(NULL);
+    int n = userkins_num_params(self->kins);
+    PyObject *result = PyList_New(n);
+    if(!result) return NULL;
+    for(int i = 0; i < n; i++) {
+        PyObject *s = PyString_FromString(userkins_param_name(self->kins, i));
+        if(!s) { Py_DECREF(result); return NULL; }
+        PyList_SET_ITEM(result, i, s);
+    }
+    return result;
+}
+
+static PyObject *pykins_type(PyObject *_self, PyObject *o) {
+    kinsobject *self = (kinsobject *)_self;
+    EXCEPTION_IF_NOT_LOADED(NULL);
+    return PyInt_FromLong(userkins_type(self->kins));
+}
+
+static PyObject *pykins_name(PyObject *_self, PyObject *o) {
+    kinsobject *self = (kinsobject *)_self;
+    EXCEPTION_IF_NOT_LOADED(NULL);
+    return PyString_FromString(userkins_name(self->kins));
+}
+
+static Py_ssize_t pykins_len(PyObject *_self) {
+    kinsobject *self = (kinsobject *)_self;
+    EXCEPTION_IF_NOT_LOADED(-1);
+    return userkins_num_params(self->kins);
+}
+
+static PyObject *pykins_getitem(PyObject *_self, PyObject *key) {
+    kinsobject *self = (kinsobject *)_self;
+    EXCEPTION_IF_NOT_LOADED(NULL);
+    char *name = PyString_AsString(key);
+    double value;
+    if(!name) return NULL;
+    if(userkins_get(self->kins, name, &value) != 0) {
+        PyErr_Format(PyExc_KeyError, "Pin or parameter '%s' does not exist", name);
+        return NULL;
+    }
+    return PyFloat_FromDouble(value);
+}
+
+static int pykins_setitem(PyObject *_self, PyObject *key, PyObject *v) {
+    kinsobject *self = (kinsobject *)_self;
+    EXCEPTION_IF_NOT_LOADED(-1);
+    char *name = PyString_AsString(key);
+    if(!name) return -1;
+    if(!v) {
+        PyErr_SetString(PyExc_TypeError, "Can't delete a pin or parameter");
+        return -1;
+    }
+    double value = PyFloat_AsDouble(v);
+    if(value == -1 && PyErr_Occurred()) return -1;
+    if(userkins_set(self->kins, name, value) != 0) {
+        PyErr_Format(PyExc_KeyError, "Pin or parameter '%s' does not exist", name);
+        return -1;
+    }
+    return 0;
+}
+
+// world is n poses, joints n rows of the same number of joints, and
+// status (if given) n ints
+static int get_buffers(PyObject *pyjoints, PyObject *pyworld,
+        PyObject *pystatus, bool joints_out, double **joints, int *njoints,
+        EmcPose **world, long *n, int **status) {
+    Py_ssize_t jlen, wlen, slen;
+    void *j, *w, *s;
+
+    if(joints_out) {
+        if(PyObject_AsWriteBuffer(pyjoints, &j, &jlen) < 0) return -1;
+        if(PyObject_AsReadBuffer(pyworld, (const void **)&w, &wlen) < 0) return -1;
+    } else {
+        if(PyObject_AsReadBuffer(pyjoints, (const void **)&j, &jlen) < 0) return -1;
+        if(PyObject_AsWriteBuffer(pyworld, &w, &wlen) < 0) return -1;
+    }
+    if(wlen % sizeof(EmcPose)) {
+        PyErr_Format(PyExc_ValueError,
+            "world must hold a multiple of %d doubles", (int)POSE_DOUBLES);
+        return -1;
+    }
+    *n = wlen / sizeof(EmcPose);
+    if(*n == 0) {
+        *njoints = 1;
+    } else if(jlen % (*n * sizeof(double))
+            || jlen / (*n * sizeof(double)) < 1
+            || jlen / (*n * sizeof(double)) > USERKINS_MAX_JOINTS) {
+        PyErr_Format(PyExc_ValueError,
+            "joints must hold 1 to %d doubles for each of the %ld poses",
+            USERKINS_MAX_JOINTS, *n);
+        return -1;
+    } else {
+        *njoints = jlen / (*n * sizeof(double));
+    }
+    *joints = (double *)j;
+    *world = (EmcPose *)w;
+    *status = NULL;
+    if(pystatus && pystatus != Py_None) {
+        if(PyObject_AsWriteBuffer(pystatus, &s, &slen) < 0) return -1;
+        if(slen != (Py_ssize_t)(*n * sizeof(int))) {
+            PyErr_Format(PyExc_ValueError,
+                "status must hold %ld ints", *n);
+            return -1;
+        }
+        *status = (int *)s;
+    }
+    return 0;
+}
+
+static PyObject *pykins_forward(PyObject *_self, PyObject *args) {
+    kinsobject *self = (kinsobject *)_self;
+    PyObject *pyjoints, *pyworld, *pystatus = NULL;
+    double *joints;
+    EmcPose *world;
+    int njoints, *status;
+    long n, result;
+
+    EXCEPTION_IF_NOT_LOADED(NULL);
+    if(!PyArg_ParseTuple(args, "OO|O:forward", &pyjoints, &pyworld, &pystatus))
+        return NULL;
+    if(get_buffers(pyjoints, pyworld, pystatus, false,
+            &joints, &njoints, &world, &n, &status) < 0)
+        return NULL;
+
+    Py_BEGIN_ALLOW_THREADS
+    result = userkins_forward(self->kins, joints, njoints, world, n, status);
+    Py_END_ALLOW_THREADS
+
+    if(result < 0) {
+        PyErr_SetString(userkins_error_type, strerror(-result));
+        return NULL;
+    }
+    return PyInt_FromLong(result);
+}
+
+static PyObject *pykins_inverse(PyObject *_self, PyObject *args) {
+    kinsobject *self = (kinsobject *)_self;
+    PyObject *pyjoints, *pyworld, *pystatus = NULL;
+    double *joints;
+    EmcPose *world;
+    int njoints, *status;
+    long n, result;
+
+    EXCEPTION_IF_NOT_LOADED(NULL);
+    if(!PyArg_ParseTuple(args, "OO|O:inverse", &pyworld, &pyjoints, &pystatus))
+        return NULL;
+    if(get_buffers(pyjoints, pyworld, pystatus, true,
+            &joints, &njoints, &world, &n, &status) < 0)
+        return NULL;
+
+    Py_BEGIN_ALLOW_THREADS
+    result = userkins_inverse(self->kins, world, joints, njoints, n, status);
+    Py_END_ALLOW_THREADS
+
+    if(result < 0) {
+        PyErr_SetString(userkins_error_type, strerror(-result));
+        return NULL;
+    }
+    return PyInt_FromLong(result);
+}
+
+static PyMethodDef kins_methods[] = {
+    {"params", pykins_params, METH_NOARGS,
+        "List the pins and parameters of the module"},
+    {"type", pykins_type, METH_NOARGS,
+        "Return the kinematics type, one of the KINEMATICS_ constants"},
+    {"name", pykins_name, METH_NOARGS,
+        "Return the module name"},
+    {"forward", pykins_forward, METH_VARARGS,
+        "forward(joints, world[, status]) -> number of failures\n"
+        "Run the forward kinematics on n poses.  world is a writable buffer\n"
+        "of n*9 doubles (x y z a b c u v w), joints a buffer of n rows of\n"
+        "up to 9 doubles, and status an optional writable buffer of n ints\n"
+        "for the result of each pose.  Each pose starts from the one\n"
+        "before, and the first from what world holds."},
+    {"inverse", pykins_inverse, METH_VARARGS,
+        "inverse(world, joints[, status]) -> number of failures\n"
+        "Run the inverse kinematics on n poses, like forward()."},
+    {NULL},
+};
+
+static PyMappingMethods kinsobject_map = {
+    pykins_len,
+    pykins_getitem,
+    pykins_setitem
+};
+
+static
+PyTypeObject kinsobject_type = {
+    PyObject_HEAD_INIT(NULL)
+    0,                         /*ob_size*/
+    "userkins.kins",           /*tp_name*/
+    sizeof(kinsobject),        /*tp_basicsize*/
+    0,                         /*tp_itemsize*/
+    pykins_delete,             /*tp_dealloc*/
+    0,                         /*tp_print*/
+    0,                         /*tp_getattr*/
+    0,                         /*tp_setattr*/
+    0,                         /*tp_compare*/
+    pykins_repr,               /*tp_repr*/
+    0,                         /*tp_as_number*/
+    0,                         /*tp_as_sequence*/
+    &kinsobject_map,           /*tp_as_mapping*/
+    0,                         /*tp_hash */
+    0,                         /*tp_call*/
+    0,                         /*tp_str*/
+    0,                         /*tp_getattro*/
+    0,                         /*tp_setattro*/
+    0,                         /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT,        /*tp_flags*/
+    "Kinematics module",       /*tp_doc*/
+    0,                         /*tp_traverse*/
+    0,                         /*tp_clear*/
+    0,                         /*tp_richcompare*/
+    0,                         /*tp_weaklistoffset*/
+    0,                         /*tp_iter*/
+    0,                         /*tp_iternext*/
+    kins_methods,              /*tp_methods*/
+    0,                         /*tp_members*/
+    0,                         /*tp_getset*/
+    0,                         /*tp_base*/
+    0,                         /*tp_dict*/
+    0,                         /*tp_descr_get*/
+    0,                         /*tp_descr_set*/
+    0,                         /*tp_dictoffset*/
+    pykins_init,               /*tp_init*/
+    0,                         /*tp_alloc*/
+    PyType_GenericNew,         /*tp_new*/
+    0,                         /*tp_free*/
+    0,                         /*tp_is_gc*/
+};
+
+static PyMethodDef module_methods[] = {
+    {NULL},
+};
+
+static const char *module_doc = "Kinematics modules in user space\n"
+"\n"
+"Loads a realtime kinematics module, as built for a userland thread\n"
+"flavor, and runs it on arrays of poses.\n"
+"\n"
+"Typical usage:\n"
+"\n"
+"import userkins, array\n"
+"k = userkins.kins(\"genserkins\")\n"
+"k[\"genserkins.A-1\"] = 300\n"
+"world = array.array('d', [0] * 9 * n)   # n poses, with a starting guess\n"
+"joints = array.array('d', ...)          # n rows of 6 joints\n"
+"failures = k.forward(joints, world)\n";
+
+extern "C"
+void inituserkins(void) {
+    PyObject *m = Py_InitModule3("userkins", module_methods,
+            module_doc);
+
+    userkins_error_type = PyErr_NewException((char*)"userkins.error", NULL, NULL);
+    PyModule_AddObject(m, "error", userkins_error_type);
+
+    PyType_Ready(&kinsobject_type);
+    PyModule_AddObject(m, "kins", (PyObject*)&kinsobject_type);
+
+    PyModule_AddIntConstant(m, "KINEMATICS_IDENTITY", KINEMATICS_IDENTITY);
+    PyModule_AddIntConstant(m, "KINEMATICS_FORWARD_ONLY", KINEMATICS_FORWARD_ONLY);
+    PyModule_AddIntConstant(m, "KINEMATICS_INVERSE_ONLY", KINEMATICS_INVERSE_ONLY);
+    PyModule_AddIntConstant(m, "KINEMATICS_BOTH", KINEMATICS_BOTH);
+    PyModule_AddIntConstant(m, "MAX_JOINTS", USERKINS_MAX_JOINTS);
+}
@@ -342,6 +342,56 @@ static int is_feed_type(int motion_type)
     }
 }
 
+/* helpers for cubic compensation: the entries of a table are
+   array[1] to array[entries], and segment i runs from array[i] to
+   array[i+1] */
+static double comp_trim(emcmot_comp_entry_t *e, int rev)
+{
+    return rev ? e->rev_trim : e->fwd_trim;
+}
+
+static double comp_secant(emcmot_comp_entry_t *a, int i, int rev)
+{
+    return (comp_trim(&a[i+1], rev) - comp_trim(&a[i], rev)) /
+	(a[i+1].nominal - a[i].nominal);
+}
+
+/* the slope of the curve at entry i: the mean of the segments on
+   either side, or the slope of the only one at the ends */
+static double comp_tangent(emcmot_comp_t *comp, int i, int rev)
+{
+    if (i <= 1) {
+	return comp_secant(comp->array, 1, rev);
+    }
+    if (i >= comp->entries) {
+	return comp_secant(comp->array, comp->entries - 1, rev);
+    }
+    return 0.5 * (comp_secant(comp->array, i - 1, rev) +
+	comp_secant(comp->array, i, rev));
+}
+
+/* fits the cubic of segment i, which passes through both of its
+   entries with the slopes comp_tangent() gives there */
+static void fit_comp_segment(emcmot_comp_t *comp, int i)
+{
+    emcmot_comp_entry_t *e = &comp->array[i];
+    double h, s, m0, m1;
+
+    h = comp->array[i+1].nominal - e->nominal;
+    s = comp_secant(comp->array, i, 0);
+    m0 = comp_tangent(comp, i, 0);
+    m1 = comp_tangent(comp, i + 1, 0);
+    e->fwd_slope = m0;
+    e->fwd_c2 = (3.0 * s - 2.0 * m0 - m1) / h;
+    e->fwd_c3 = (m0 + m1 - 2.0 * s) / (h * h);
+    s = comp_secant(comp->array, i, 1);
+    m0 = comp_tangent(comp, i, 1);
+    m1 = comp_tangent(comp, i + 1, 1);
+    e->rev_slope = m0;
+    e->rev_c2 = (3.0 * s - 2.0 * m0 - m1) / h;
+    e->rev_c3 = (m0 + m1 - 2.0 * s) / (h * h);
+}
+
 /*
   emcmotCommandHandler() is called each main cycle to read the
   shared memory buffer
@@ -1587,7 +1637,7 @@ check_stuff ( "before command_handler()" );
 	    if (joint == 0) {
 		break;
 	    }
-	    if (joint->comp.entries >= EMCMOT_COMP_SIZE) {
+	    if (joint->comp.entries >= joint->comp.size) {
 		reportError(_("joint %d: too many compensation entries"), joint_num);
 		break;
 	    }
@@ -1615,6 +1665,14 @@ check_stuff ( "before command_handler()" );
 		comp_entry[0].rev_trim = comp_entry[1].rev_trim;
 	    }
 	    joint->comp.entries++;
+	    if (joint->comp.cubic) {
+		/* the new entry changes the slope at the one before it,
+		   so the last two segments are fitted again */
+		n = joint->comp.entries;
+		for (n = (n > 2 ? n - 2 : 1); n < joint->comp.entries; n++) {
+		    fit_comp_segment(&joint->comp, n);
+		}
+	    }
 	    break;
 
         case EMCMOT_SET_OFFSET:
@@ -20,6 +20,7 @@
 #include "motion.h"
 #include "mot_priv.h"
 #include "rtapi_math.h"
+#include "rtapi_mbarrier.h"
 #include "tp.h"
 #include "tc.h"
 #include "motion_debug.h"
@@ -189,6 +190,18 @@ static void get_pos_cmds(long period);
 */
 static void compute_screw_comp(void);
 
+/* 'compute_vcomp()' computes the volumetric compensation, the offsets
+   of the active vcomp grid at the commanded XYZ position, interpolated
+   between the eight nodes around it, and puts them in the vcomp of the
+   joints the grid names.  Like the screw comp, it is added to
+   joint_pos_cmd to create motor_pos_cmd and subtracted from
+   motor_pos_fb.  It costs the same each period, wherever the position
+   is in the grid and however large the grid is.  The offsets follow
+   the grid at up to half the joint's velocity limit, so a new grid,
+   or none, is ramped in.
+*/
+static void compute_vcomp(void);
+
 /* 'output_to_hal()' writes the handles the final stages of the
    control function.  It applies screw comp and writes the
    final motor position to the HAL (which routes it to the PID
@@ -327,6 +340,8 @@ check_stuff ( "after do_homing()" );
 check_stuff ( "after get_pos_cmds()" );
     compute_screw_comp();
 check_stuff ( "after compute_screw_comp()" );
+    compute_vcomp();
+check_stuff ( "after compute_vcomp()" );
     output_to_hal();
 check_stuff ( "after output_to_hal()" );
     update_status();
@@ -517,9 +532,10 @@ static void process_inputs(void)
 	       to match the commanded value instead. */
 	    joint->pos_fb = joint->pos_cmd;
 	} else {
-	    /* normal case: subtract backlash comp and motor offset */
+	    /* normal case: subtract backlash comp, volumetric comp
+	       and motor offset */
 	    joint->pos_fb = joint->motor_pos_fb -
-		(joint->backlash_filt + joint->motor_offset);
+		(joint->backlash_filt + joint->vcomp + joint->motor_offset);
 	}
 	/* calculate following error */
 	joint->ferror = joint->pos_cmd - joint->pos_fb;
@@ -1558,11 +1574,30 @@ Their exact contents and meaning are as follows:
 
 */
 
+/* finds the segment of a comp table pos is in: the entry before the
+   last one whose nominal is not above pos */
+static emcmot_comp_entry_t *find_comp_entry(emcmot_comp_t *comp, double pos)
+{
+    int lo = 0, hi = comp->entries + 1, mid;
+
+    /* array[lo] <= pos < array[hi], the ends being -/+DBL_MAX */
+    while (hi - lo > 1) {
+	mid = (lo + hi) / 2;
+	if (pos < comp->array[mid].nominal) {
+	    hi = mid;
+	} else {
+	    lo = mid;
+	}
+    }
+    return &comp->array[lo];
+}
+
 static void compute_screw_comp(void)
 {
     int joint_num;
     emcmot_joint_t *joint;
     emcmot_comp_t *comp;
+    emcmot_comp_entry_t *entry;
     double dpos;
     double a_max, v_max, v, s_to_go, ds_stop, ds_vel, ds_acc, dv_acc;
 
@@ -1579,23 +1614,34 @@ static void compute_screw_comp(void)
 	comp = &(joint->comp);
 	if ( comp->entries > 0 ) {
 	    /* there is data in the comp table, use it */
-	    /* first make sure we're in the right spot in the table */
-	    while ( joint->pos_cmd < comp->entry->nominal ) {
-		comp->entry--;
-	    }
-	    while ( joint->pos_cmd >= (comp->entry+1)->nominal ) {
-		comp->entry++;
+	    /* first make sure we're in the right spot in the table;
+	       the joint is mostly still in the segment it was in last
+	       period, or the next one, else it is searched for */
+	    entry = comp->entry;
+	    if ( joint->pos_cmd < entry->nominal ) {
+		if ( joint->pos_cmd >= (entry-1)->nominal ) {
+		    entry--;
+		} else {
+		    entry = find_comp_entry(comp, joint->pos_cmd);
+		}
+	    } else if ( joint->pos_cmd >= (entry+1)->nominal ) {
+		if ( joint->pos_cmd < (entry+2)->nominal ) {
+		    entry++;
+		} else {
+		    entry = find_comp_entry(comp, joint->pos_cmd);
+		}
 	    }
-	    /* now interpolate */
-	    dpos = joint->pos_cmd - comp->entry->nominal;
+	    comp->entry = entry;
+	    /* now interpolate; c2 and c3 are 0 in tables that aren't cubic */
+	    dpos = joint->pos_cmd - entry->nominal;
 	    if (joint->vel_cmd > 0.0) {
 	        /* moving "up". apply forward screw comp */
-		joint->backlash_corr = comp->entry->fwd_trim + 
-					comp->entry->fwd_slope * dpos;
+		joint->backlash_corr = entry->fwd_trim + dpos * (entry->fwd_slope
+		    + dpos * (entry->fwd_c2 + dpos * entry->fwd_c3));
 	    } else if (joint->vel_cmd < 0.0) {
 	        /* moving "down". apply reverse screw comp */
-		joint->backlash_corr = comp->entry->rev_trim +
-					comp->entry->rev_slope * dpos;
+		joint->backlash_corr = entry->rev_trim + dpos * (entry->rev_slope
+		    + dpos * (entry->rev_c2 + dpos * entry->rev_c3));
 	    } else {
 		/* not moving, use whatever was there before */
 	    }
@@ -1749,6 +1795,119 @@ static void compute_screw_comp(void)
    halscope and halmeter for debugging.
 */
 
+/* the cell of a grid axis pos is in, and how far into it, 0 to 1;
+   outside the grid, the cell at its edge */
+static int vcomp_cell(double pos, double p0, double d, int nodes, double *frac)
+{
+    double t = (pos - p0) / d;
+    int i;
+
+    if (!(t > 0.0)) {
+	*frac = 0.0;
+	return 0;
+    }
+    if (t >= nodes - 1) {
+	*frac = 1.0;
+	return nodes - 2;
+    }
+    i = (int) t;
+    *frac = t - i;
+    return i;
+}
+
+static void compute_vcomp(void)
+{
+    int joint_num, bank, n, i, j, k, sy, sz;
+    emcmot_joint_t *joint;
+    vcomp_grid_t *grid;
+    float *node;
+    double u, v, w, c0, c1, c00, c10, c01, c11;
+    double v_max, a_max, max_dv, err, vel_req;
+    double corr[VCOMP_AXES];
+    double target[EMCMOT_MAX_JOINTS];
+
+    if (vcomp_shm == 0) {
+	return;
+    }
+    /* tell vcomp-load which bank is read this period; it only writes
+       the other one */
+    bank = vcomp_shm->active;
+    vcomp_shm->in_use = bank;
+    rtapi_smp_mb();
+    for (joint_num = 0; joint_num < num_joints; joint_num++) {
+	target[joint_num] = 0.0;
+    }
+    if (bank == 0 || bank == 1) {
+	if (!emcmotStatus->carte_pos_cmd_ok) {
+	    /* don't know where we are, use whatever was there before */
+	    return;
+	}
+	grid = &vcomp_shm->grid[bank];
+	if (grid->nx < 2 || grid->ny < 2 || grid->nz < 2 ||
+	    grid->nx * grid->ny * grid->nz > vcomp_shm->points) {
+	    return;
+	}
+	/* the node at the low corner of the cell, and the strides to the
+	   next node along Y and Z; X neighbours are adjacent */
+	i = vcomp_cell(emcmotStatus->carte_pos_cmd.tran.x,
+	    grid->x0, grid->dx, grid->nx, &u);
+	j = vcomp_cell(emcmotStatus->carte_pos_cmd.tran.y,
+	    grid->y0, grid->dy, grid->ny, &v);
+	k = vcomp_cell(emcmotStatus->carte_pos_cmd.tran.z,
+	    grid->z0, grid->dz, grid->nz, &w);
+	sy = grid->nx * VCOMP_AXES;
+	sz = grid->ny * sy;
+	node = VCOMP_BANK(vcomp_shm, bank) + k * sz + j * sy + i * VCOMP_AXES;
+	/* trilinear interpolation, X first */
+	for (n = 0; n < VCOMP_AXES; n++) {
+	    c00 = node[n] + u * (node[n + VCOMP_AXES] - node[n]);
+	    c10 = node[n + sy] + u * (node[n + sy + VCOMP_AXES] - node[n + sy]);
+	    c01 = node[n + sz] + u * (node[n + sz + VCOMP_AXES] - node[n + sz]);
+	    c11 = node[n + sz + sy] +
+		u * (node[n + sz + sy + VCOMP_AXES] - node[n + sz + sy]);
+	    c0 = c00 + v * (c10 - c00);
+	    c1 = c01 + v * (c11 - c01);
+	    corr[n] = c0 + w * (c1 - c0);
+	}
+	for (n = 0; n < VCOMP_AXES; n++) {
+	    joint_num = grid->joint[n];
+	    if (joint_num >= 0 && joint_num < num_joints) {
+		target[joint_num] += corr[n];
+	    }
+	}
+    }
+    /* move towards the new offsets the way the backlash comp does, with
+       half the joint's velocity and acceleration limits, so that loading
+       another grid or removing it doesn't step motor_pos_cmd */
+    for (joint_num = 0; joint_num < num_joints; joint_num++) {
+	joint = &joints[joint_num];
+	v_max = 0.5 * joint->vel_limit;
+	a_max = 0.5 * joint->acc_limit;
+	max_dv = a_max * servo_period;
+	/* the fastest it may go and still stop at the target, as the
+	   free mode planner computes it */
+	err = target[joint_num] - joint->vcomp;
+	if (err >= 0.0) {
+	    vel_req = -max_dv + sqrt(2.0 * a_max * err + max_dv * max_dv);
+	} else {
+	    vel_req = max_dv - sqrt(-2.0 * a_max * err + max_dv * max_dv);
+	}
+	if (vel_req > v_max) {
+	    vel_req = v_max;
+	} else if (vel_req < -v_max) {
+	    vel_req = -v_max;
+	}
+	if (vel_req > joint->vcomp_vel + max_dv) {
+	    joint->vcomp_vel += max_dv;
+	} else if (vel_req < joint->vcomp_vel - max_dv) {
+	    joint->vcomp_vel -= max_dv;
+	} else {
+	    joint->vcomp_vel = vel_req;
+	}
+	joint->vcomp += joint->vcomp_vel * servo_period;
+    }
+}
+
 static void output_to_hal(void)
 {
     int joint_num;
@@ -1855,9 +2014,9 @@ static void output_to_hal(void)
     for (joint_num = 0; joint_num < num_joints; joint_num++) {
 	/* point to joint struct */
 	joint = &joints[joint_num];
-	/* apply backlash and motor offset to output */
-	joint->motor_pos_cmd =
-	    joint->pos_cmd + joint->backlash_filt + joint->motor_offset;
+	/* apply backlash, volumetric comp and motor offset to output */
+	joint->motor_pos_cmd = joint->pos_cmd + joint->backlash_filt +
+	    joint->vcomp + joint->motor_offset;
 	/* point to HAL data */
 	joint_data = &(emcmot_hal_data->joint[joint_num]);
 	/* write to HAL pins */
@@ -1874,6 +2033,7 @@ static void output_to_hal(void)
 	*(joint_data->backlash_corr) = joint->backlash_corr;
 	*(joint_data->backlash_filt) = joint->backlash_filt;
 	*(joint_data->backlash_vel) = joint->backlash_vel;
+	*(joint_data->vcomp) = joint->vcomp;
 	*(joint_data->f_error) = joint->ferror;
 	*(joint_data->f_error_lim) = joint->ferror_limit;
 
@@ -14,6 +14,8 @@
 #ifndef MOT_PRIV_H
 #define MOT_PRIV_H
 
+#include "vcomp.h"
+
 /***********************************************************************
 *                       TYPEDEFS, ENUMS, ETC.                          *
 ************************************************************************/
@@ -37,6 +39,7 @@ typedef struct {
     hal_float_t *backlash_corr;	/* RPI: correction for backlash */
     hal_float_t *backlash_filt;	/* RPI: filtered backlash correction */
     hal_float_t *backlash_vel;	/* RPI: backlash speed variable */
+    hal_float_t *vcomp;		/* RPI: volumetric correction */
     hal_float_t *motor_offset;	/* RPI: motor offset, for checking homing stability */
     hal_float_t *motor_pos_cmd;	/* WPI: commanded position, with comp */
     hal_float_t *motor_pos_fb;	/* RPI: position feedback, with comp */
@@ -208,6 +211,10 @@ extern emcmot_hal_data_t *emcmot_hal_data;
 */
 extern emcmot_joint_t *joints;
 
+/* the volumetric compensation grids, or 0 if motmod was loaded
+   without vcomp_points */
+extern vcomp_shm_t *vcomp_shm;
+
 /* flag used to indicate that this is the very first pass thru the
    code.  Various places in the code use this to set initial conditions
    and avoid startup glitches.
@@ -13,6 +13,7 @@
 #include "rtapi.h"		/* RTAPI realtime OS API */
 #include "rtapi_app.h"		/* RTAPI realtime module decls */
 #include "rtapi_string.h"       /* memset */
+#include "rtapi_mbarrier.h"	/* rtapi_smp_wmb() */
 #include "hal.h"		/* decls for HAL implementation */
 #include "emcmotglb.h"
 #include "motion.h"
@@ -62,6 +63,12 @@ int num_dio = 4;			/* default number of motion synched DIO */
 RTAPI_MP_INT(num_dio, "number of digital inputs/outputs");
 int num_aio = 4;			/* default number of motion synched AIO */
 RTAPI_MP_INT(num_aio, "number of analog inputs/outputs");
+static int comp_size = EMCMOT_COMP_SIZE;	/* entries per comp table */
+RTAPI_MP_INT(comp_size, "entries in each joint's compensation table");
+static int comp_cubic = 0;		/* joints with cubic comp, a bit each */
+RTAPI_MP_INT(comp_cubic, "mask of joints whose compensation is cubic");
+static int vcomp_points = 0;		/* nodes in a volumetric comp grid */
+RTAPI_MP_INT(vcomp_points, "nodes a volumetric compensation grid may have");
 
 /***********************************************************************
 *                  GLOBAL VARIABLE DEFINITIONS                         *
@@ -79,6 +86,7 @@ emcmot_joint_t joint_array[EMCMOT_MAX_JOINTS];
 #endif
 
 int mot_comp_id;	/* component ID for motion module */
+vcomp_shm_t *vcomp_shm = 0;	/* volumetric comp grids, if any */
 int first_pass = 1;	/* used to set initial conditions */
 int kinType = 0;
 
@@ -110,6 +118,10 @@ struct emcmot_error_t *emcmotError = 0;	/* unused for RT_FIFO */
 
 /* RTAPI shmem ID - for comms with higher level user space stuff */
 static int emc_shmem_id;	/* the shared memory ID */
+/* and for the compensation tables, which only motion uses */
+static int comp_shmem_id;
+/* and for the volumetric compensation grids, which vcomp-load fills */
+static int vcomp_shmem_id = -1;
 
 /***********************************************************************
 *                   LOCAL FUNCTION PROTOTYPES                          *
@@ -211,6 +223,19 @@ int rtapi_app_main(void)
 	return -1;
     }
 
+    if (vcomp_points < 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    _("MOTION: vcomp_points is %d, must not be negative\n"),
+	    vcomp_points);
+	return -1;
+    }
+
+    if (comp_size < 1) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    _("MOTION: comp_size is %d, must be at least 1\n"), comp_size);
+	return -1;
+    }
+
     /* initialize/export HAL pins and parameters */
     retval = init_hal_io();
     if (retval != 0) {
@@ -264,6 +289,18 @@ void rtapi_app_exit(void)
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    _("MOTION: rtapi_shmem_delete() failed, returned %d\n"), retval);
     }
+    retval = rtapi_shmem_delete(comp_shmem_id, mot_comp_id);
+    if (retval < 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    _("MOTION: rtapi_shmem_delete() failed, returned %d\n"), retval);
+    }
+    if (vcomp_shmem_id >= 0) {
+	retval = rtapi_shmem_delete(vcomp_shmem_id, mot_comp_id);
+	if (retval < 0) {
+	    rtapi_print_msg(RTAPI_MSG_ERR,
+		_("MOTION: rtapi_shmem_delete() failed, returned %d\n"), retval);
+	}
+    }
     /* disconnect from HAL and RTAPI */
     retval = hal_exit(mot_comp_id);
     if (retval < 0) {
@@ -724,6 +761,11 @@ static int export_joint(int num, joint_hal_t * addr)
     if (retval != 0) {
 	return retval;
     }
+    retval =
+	hal_pin_float_newf(HAL_OUT, &(addr->vcomp), mot_comp_id, "axis.%d.vcomp", num);
+    if (retval != 0) {
+	return retval;
+    }
     retval =
 	hal_pin_float_newf(HAL_OUT, &(addr->backlash_filt), mot_comp_id, "axis.%d.backlash-filt", num);
     if (retval != 0) {
@@ -825,6 +867,7 @@ static int init_comm_buffers(void)
 {
     int joint_num, n;
     emcmot_joint_t *joint;
+    emcmot_comp_entry_t *comp_array;
     int retval;
 
     rtapi_print_msg(RTAPI_MSG_INFO,
@@ -928,6 +971,49 @@ static int init_comm_buffers(void)
     joints = &(joint_array[0]);
 #endif
 
+    /* the compensation tables, comp_size entries for each joint, sized
+       here since they may hold thousands of measured points */
+    comp_shmem_id = rtapi_shmem_new(MOTION_COMP_SHMEM_KEY, mot_comp_id,
+	num_joints * (comp_size + 2) * sizeof(emcmot_comp_entry_t));
+    if (comp_shmem_id < 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "MOTION: rtapi_shmem_new failed, returned %d\n", comp_shmem_id);
+	return -1;
+    }
+    retval = rtapi_shmem_getptr(comp_shmem_id, (void **) &comp_array);
+    if (retval < 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "MOTION: rtapi_shmem_getptr failed, returned %d\n", retval);
+	return -1;
+    }
+    memset(comp_array, 0,
+	num_joints * (comp_size + 2) * sizeof(emcmot_comp_entry_t));
+
+    /* the volumetric compensation grids, if asked for; there is none
+       until vcomp-load makes one active */
+    if (vcomp_points > 0) {
+	vcomp_shmem_id = rtapi_shmem_new(MOTION_VCOMP_SHMEM_KEY, mot_comp_id,
+	    VCOMP_SHM_SIZE(vcomp_points));
+	if (vcomp_shmem_id < 0) {
+	    rtapi_print_msg(RTAPI_MSG_ERR,
+		"MOTION: rtapi_shmem_new failed, returned %d\n", vcomp_shmem_id);
+	    return -1;
+	}
+	retval = rtapi_shmem_getptr(vcomp_shmem_id, (void **) &vcomp_shm);
+	if (retval < 0) {
+	    rtapi_print_msg(RTAPI_MSG_ERR,
+		"MOTION: rtapi_shmem_getptr failed, returned %d\n", retval);
+	    return -1;
+	}
+	memset(vcomp_shm, 0, VCOMP_SHM_SIZE(vcomp_points));
+	vcomp_shm->points = vcomp_points;
+	vcomp_shm->active = -1;
+	vcomp_shm->in_use = -1;
+	rtapi_smp_wmb();
+	/* last, so that vcomp-load sees a segment that is set up */
+	vcomp_shm->shm_size = VCOMP_SHM_SIZE(vcomp_points);
+    }
+
     /* init per-joint stuff */
     for (joint_num = 0; joint_num < num_joints; joint_num++) {
 	/* point to structure for this joint */
@@ -952,6 +1038,9 @@ static int init_comm_buffers(void)
 	joint->backlash = 0.0;
 
 	joint->comp.entries = 0;
+	joint->comp.size = comp_size;
+	joint->comp.cubic = (comp_cubic >> joint_num) & 1;
+	joint->comp.array = comp_array + joint_num * (comp_size + 2);
 	joint->comp.entry = &(joint->comp.array[0]);
 	/* the compensation code has -DBL_MAX at one end of the table
 	   and +DBL_MAX at the other so _all_ commanded positions are
@@ -961,7 +1050,7 @@ static int init_comm_buffers(void)
 	joint->comp.array[0].rev_trim = 0.0;
 	joint->comp.array[0].fwd_slope = 0.0;
 	joint->comp.array[0].rev_slope = 0.0;
-	for ( n = 1 ; n < EMCMOT_COMP_SIZE+2 ; n++ ) {
+	for ( n = 1 ; n < comp_size+2 ; n++ ) {
 	    joint->comp.array[n].nominal = DBL_MAX;
 	    joint->comp.array[n].fwd_trim = 0.0;
 	    joint->comp.array[n].rev_trim = 0.0;
@@ -977,6 +1066,8 @@ static int init_comm_buffers(void)
 	joint->backlash_corr = 0.0;
 	joint->backlash_filt = 0.0;
 	joint->backlash_vel = 0.0;
+	joint->vcomp = 0.0;
+	joint->vcomp_vel = 0.0;
 	joint->motor_pos_cmd = 0.0;
 	joint->motor_pos_fb = 0.0;
 	joint->pos_fb = 0.0;
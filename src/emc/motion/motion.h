@@ -378,14 +378,19 @@ Suggestion: Split this in to an Error and a Status flag register..
 	float rev_trim;		/* correction for reverse movement */
 	float fwd_slope;	/* slopes between here and next pt */
 	float rev_slope;
+	float fwd_c2, fwd_c3;	/* for cubic interpolation, the 2nd and */
+	float rev_c2, rev_c3;	/* 3rd order coefficients, else 0 */
     } emcmot_comp_entry_t; 
 
 
+/* default size of a comp table, set with motmod's comp_size */
 #define EMCMOT_COMP_SIZE 256
     typedef struct {
 	int entries;		/* number of entries in the array */
+	int size;		/* entries there is room for */
+	int cubic;		/* non-zero to interpolate with cubics */
 	emcmot_comp_entry_t *entry;  /* current entry in array */
-	emcmot_comp_entry_t array[EMCMOT_COMP_SIZE+2];
+	emcmot_comp_entry_t *array;  /* size+2 entries, in their own shmem */
 	/* +2 because array has -HUGE_VAL and +HUGE_VAL entries at the ends */
     } emcmot_comp_t;
 
@@ -500,6 +505,8 @@ Suggestion: Split this in to an Error and a Status flag register..
 	double backlash_corr;	/* correction for backlash */
 	double backlash_filt;	/* filtered backlash correction */
 	double backlash_vel;	/* backlash velocity variable */
+	double vcomp;		/* volumetric correction */
+	double vcomp_vel;	/* volumetric correction velocity */
 	double motor_pos_cmd;	/* commanded position, with comp */
 	double motor_pos_fb;	/* position feedback, with comp */
 	double pos_fb;		/* position feedback, comp removed */
@@ -45,6 +45,11 @@ static int SET_ERRNO(int value) {
 #endif
 }
 
+// the conversion of the format at *fmt_io, or -1 if it has one stashf
+// can't take from the arguments: a '*' width or precision, which takes
+// an argument of its own, a size other than h, hh or l (ll, z, j, t, L,
+// q), a wide char or string, or 'n'.  *fmt_io is moved past the
+// conversion.
 static int get_code(const char **fmt_io, int *modifier_l) {
     const char *fmt = *fmt_io;
     *modifier_l = 0;
@@ -52,20 +57,33 @@ static int get_code(const char **fmt_io, int *modifier_l) {
     for(; *fmt; fmt++) {
         switch(*fmt) {
             case 'l':
+                // 'll' is a long long
+                if(*modifier_l) return -1;
                 *modifier_l = 1;
                 break;
+            // flags, field width and precision; a short is passed as an int
+            case '-': case '+': case ' ': case '#': case '\'': case '.':
+            case '0': case '1': case '2': case '3': case '4':
+            case '5': case '6': case '7': case '8': case '9':
+            case 'h':
+                break;
+            // char; string: not wide
+            case 'c': case 's':
+                if(*modifier_l) return -1;
+                goto format_end;
             // integers
-            case 'd': case 'i': case 'x': case 'u': case 'X':
+            case 'd': case 'i': case 'o': case 'x': case 'u': case 'X':
             // doubles
             case 'e': case 'E': case 'f': case 'F': case 'g': case 'G':
-            // char; string
-            case 'c': case 's':
             // pointer
             case 'p':
             // literal percent
             case '%': goto format_end;
+            default:
+                return -1;
         }
     }
+    return -1;
 format_end:
     *fmt_io = fmt+1;
     return *fmt;
@@ -73,8 +91,11 @@ format_end:
 
 int vstashf(struct dbuf_iter *o, const char *fmt, va_list ap) {
     int modifier_l;
+    int result;
+    const char *s;
 
-    dbuf_put_string(o, fmt);
+    result = dbuf_put_string(o, fmt);
+    if(result < 0) return SET_ERRNO(result);
 
     while((fmt = strchr(fmt, '%'))) {
         int code = get_code(&fmt, &modifier_l);
@@ -82,24 +103,27 @@ int vstashf(struct dbuf_iter *o, const char *fmt, va_list ap) {
         switch(code) {
         case '%':
             break;
-        case 'c': case 'd': case 'i': case 'x': case 'u': case 'X':
+        case 'c': case 'd': case 'i': case 'o': case 'x': case 'u': case 'X':
             if(modifier_l) {
         case 'p':
-                dbuf_put_long(o, va_arg(ap, long));
+                result = dbuf_put_long(o, va_arg(ap, long));
             } else {
-                dbuf_put_int(o, va_arg(ap, int));
+                result = dbuf_put_int(o, va_arg(ap, int));
             }
             break;
         case 'e': case 'E': case 'f': case 'F': case 'g': case 'G':
-            dbuf_put_double(o, va_arg(ap, double));
+            result = dbuf_put_double(o, va_arg(ap, double));
             break;
         case 's':
-            dbuf_put_string(o, va_arg(ap, const char *));
+            s = va_arg(ap, const char *);
+            result = dbuf_put_string(o, s ? s : "(null)");
             break;
         default:
             return SET_ERRNO(-EINVAL);
             break;
         }
+        // out of room: the caller can't use what was stashed
+        if(result < 0) return SET_ERRNO(result);
     }
     return 0;
 }
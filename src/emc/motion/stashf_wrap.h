@@ -30,16 +30,22 @@ const char *fmt, *efmt;
     while((efmt = strchr(fmt, '%'))) {
         int modifier_l;
         int code = get_code(&efmt, &modifier_l);
-        int fmt_len = efmt - fmt;
-        char *block = alloca(fmt_len + 1);
+        int fmt_len;
+        char *block;
+        // vstashf() doesn't stash such a format
+        if(code < 0) return SET_ERRNO(-EINVAL);
+        fmt_len = efmt - fmt;
+        block = alloca(fmt_len + 1);
         memcpy(block, fmt, fmt_len);
         block[fmt_len] = 0;
 
         switch(code) {
             case '%':
+                // the block ends in "%%", which prints as one '%'
+                block[fmt_len - 1] = 0;
                 result = PRINT("%s", block);
                 break;
-            case 'c': case 'd': case 'i': case 'x': case 'u': case 'X':
+            case 'c': case 'd': case 'i': case 'o': case 'x': case 'u': case 'X':
                 if(modifier_l)
             case 'p':
                 {
@@ -0,0 +1,51 @@
+/********************************************************************
+* Description: vcomp.h
+*   Shared memory layout of motion's volumetric compensation grid
+*
+*   A grid of X, Y and Z offsets over the work volume, which motion
+*   interpolates at the commanded position and adds to the joints the
+*   grid names, after kinematics.  motmod creates the segment when it
+*   is loaded with vcomp_points > 0; vcomp-load fills it.
+*
+*   The segment holds two banks.  motion reads the bank named by
+*   'active' and reports the one it read in 'in_use'; a loader fills
+*   the other bank, and only once 'in_use' equals 'active', then makes
+*   it active.  So a grid is never written while motion reads it, and
+*   motion switches from one grid to the next between two periods; the
+*   offsets it applies are ramped to the new grid's.
+*
+* License: GPL Version 2
+* System: Linux
+********************************************************************/
+#ifndef VCOMP_H
+#define VCOMP_H
+
+/* offsets at each node: X, Y and Z */
+#define VCOMP_AXES 3
+
+typedef struct {
+    int nx, ny, nz;		/* nodes along X, Y and Z, 2 or more */
+    double x0, y0, z0;		/* position of the first node */
+    double dx, dy, dz;		/* distance between nodes */
+    int joint[VCOMP_AXES];	/* joints the offsets go to, -1 for none */
+} vcomp_grid_t;
+
+typedef struct {
+    unsigned long shm_size;	/* size of the segment, 0 until set up */
+    int points;			/* nodes there is room for in each bank */
+    volatile int active;	/* bank motion is to read, -1 for none */
+    volatile int in_use;	/* bank motion read last period */
+    volatile unsigned int swaps;	/* times a grid has been made active */
+    vcomp_grid_t grid[2];
+    /* followed by two banks of points * VCOMP_AXES floats: the offsets
+       of each node in turn, X varying fastest, then Y, then Z */
+} vcomp_shm_t;
+
+/* the offsets of bank b */
+#define VCOMP_BANK(shm, b) \
+    ((float *) ((shm) + 1) + (b) * (shm)->points * VCOMP_AXES)
+
+#define VCOMP_SHM_SIZE(points) \
+    (sizeof(vcomp_shm_t) + 2 * (points) * VCOMP_AXES * sizeof(float))
+
+#endif /* VCOMP_H */
@@ -0,0 +1,295 @@
+/********************************************************************
+* Description: vcompload.c
+*   Loads a volumetric compensation grid into motion.
+*
+*   vcomp-load reads a grid from a text file, writes it to the bank of
+*   the vcomp segment that motion is not reading, and makes it active.
+*   motion switches to it between two servo periods; see vcomp.h.
+*
+*   A grid file has the size, position and spacing of the grid, the
+*   joints its X, Y and Z offsets go to, and then the offsets of each
+*   node, X varying fastest, then Y, then Z:
+*
+*	# comments and blank lines are ignored
+*	nodes 11 6 3
+*	origin 0 0 -200
+*	spacing 100 100 100
+*	joints 0 1 2
+*	0.0012 -0.0003 0.0000
+*	...
+*
+* License: GPL Version 2
+* System: Linux
+*
+********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>		/* getopt(), usleep() */
+
+#include "rtapi.h"		/* RTAPI realtime OS API */
+#include "rtapi_mbarrier.h"
+#include "rtapi_shmkeys.h"
+#include "vcomp.h"
+
+/* how long to wait for motion to take up the last grid, in msec */
+#define SWAP_TIMEOUT 1000
+
+static int module_id = -1;
+static int shm_id = -1;
+static vcomp_shm_t *shm;
+
+static void usage(void)
+{
+    fprintf(stderr,
+	"Usage:\n"
+	"  vcomp-load [-q] file   load the grid in file and make it active\n"
+	"  vcomp-load -d          stop volumetric compensation\n"
+	"  vcomp-load -s          show the active grid\n");
+}
+
+static int attach(void)
+{
+    module_id = rtapi_init("vcomp-load");
+    if (module_id < 0) {
+	fprintf(stderr, "vcomp-load: ERROR: rtapi_init() failed\n");
+	return -1;
+    }
+    /* attach to the segment motmod set up, whatever its size */
+    shm_id = rtapi_shmem_new(MOTION_VCOMP_SHMEM_KEY, module_id, 0);
+    if (shm_id < 0) {
+	fprintf(stderr, "vcomp-load: ERROR: no vcomp grid "
+	    "(is motmod loaded with vcomp_points?)\n");
+	return -1;
+    }
+    if (rtapi_shmem_getptr(shm_id, (void **) &shm) < 0) {
+	fprintf(stderr, "vcomp-load: ERROR: failed to map shared memory\n");
+	return -1;
+    }
+    if (shm->shm_size == 0) {
+	fprintf(stderr, "vcomp-load: ERROR: motmod has not set up the grid\n");
+	return -1;
+    }
+    return 0;
+}
+
+static void detach(void)
+{
+    if (shm_id >= 0) {
+	rtapi_shmem_delete(shm_id, module_id);
+    }
+    if (module_id >= 0) {
+	rtapi_exit(module_id);
+    }
+}
+
+/* waits until motion reads the active bank, so that the other is free */
+static int wait_for_motion(void)
+{
+    int n;
+
+    for (n = 0; n < SWAP_TIMEOUT; n++) {
+	if (shm->in_use == shm->active) {
+	    rtapi_smp_mb();
+	    return 0;
+	}
+	usleep(1000);
+    }
+    fprintf(stderr, "vcomp-load: ERROR: motion has not taken up the last "
+	"grid (is the servo thread running?)\n");
+    return -1;
+}
+
+/* the next line that isn't blank or a comment, or 0 at the end */
+static char *next_line(FILE *f, char *buf, int size, int *lineno)
+{
+    char *p;
+
+    while (fgets(buf, size, f)) {
+	(*lineno)++;
+	if ((p = strchr(buf, '#'))) {
+	    *p = '\0';
+	}
+	for (p = buf; *p == ' ' || *p == '\t'; p++);
+	if (*p != '\0' && *p != '\n' && *p != '\r') {
+	    return p;
+	}
+    }
+    return 0;
+}
+
+static int read_grid(const char *filename, vcomp_grid_t *grid, float *nodes)
+{
+    FILE *f;
+    char buf[256], *p;
+    int lineno = 0, got = 0, n, count = 0, points = 0;
+    float e[VCOMP_AXES];
+
+    f = fopen(filename, "r");
+    if (!f) {
+	perror(filename);
+	return -1;
+    }
+    /* the four keywords, in any order, then the nodes */
+    while (got != 15 && (p = next_line(f, buf, sizeof(buf), &lineno))) {
+	if (sscanf(p, "nodes %d %d %d", &grid->nx, &grid->ny, &grid->nz) == 3) {
+	    got |= 1;
+	} else if (sscanf(p, "origin %lf %lf %lf",
+		&grid->x0, &grid->y0, &grid->z0) == 3) {
+	    got |= 2;
+	} else if (sscanf(p, "spacing %lf %lf %lf",
+		&grid->dx, &grid->dy, &grid->dz) == 3) {
+	    got |= 4;
+	} else if (sscanf(p, "joints %d %d %d",
+		&grid->joint[0], &grid->joint[1], &grid->joint[2]) == 3) {
+	    got |= 8;
+	} else {
+	    fprintf(stderr, "%s:%d: expected nodes, origin, spacing or "
+		"joints\n", filename, lineno);
+	    fclose(f);
+	    return -1;
+	}
+    }
+    if (got != 15) {
+	fprintf(stderr, "%s: nodes, origin, spacing and joints must all "
+	    "be given\n", filename);
+	fclose(f);
+	return -1;
+    }
+    if (grid->nx < 2 || grid->ny < 2 || grid->nz < 2) {
+	fprintf(stderr, "%s: a grid needs 2 or more nodes along each axis\n",
+	    filename);
+	fclose(f);
+	return -1;
+    }
+    if (!(grid->dx > 0.0 && grid->dy > 0.0 && grid->dz > 0.0)) {
+	fprintf(stderr, "%s: spacing must be positive\n", filename);
+	fclose(f);
+	return -1;
+    }
+    points = grid->nx * grid->ny * grid->nz;
+    if (points > shm->points) {
+	fprintf(stderr, "%s: %d nodes, but motmod's vcomp_points is %d\n",
+	    filename, points, shm->points);
+	fclose(f);
+	return -1;
+    }
+    while (count < points && (p = next_line(f, buf, sizeof(buf), &lineno))) {
+	if (sscanf(p, "%f %f %f", &e[0], &e[1], &e[2]) != VCOMP_AXES) {
+	    fprintf(stderr, "%s:%d: expected X, Y and Z offsets\n",
+		filename, lineno);
+	    fclose(f);
+	    return -1;
+	}
+	for (n = 0; n < VCOMP_AXES; n++) {
+	    nodes[count * VCOMP_AXES + n] = e[n];
+	}
+	count++;
+    }
+    if (count < points) {
+	fprintf(stderr, "%s: only %d of the %d nodes given\n", filename,
+	    count, points);
+	fclose(f);
+	return -1;
+    }
+    if (next_line(f, buf, sizeof(buf), &lineno)) {
+	fprintf(stderr, "%s:%d: more than the %d nodes of the grid\n",
+	    filename, lineno, points);
+	fclose(f);
+	return -1;
+    }
+    fclose(f);
+    return 0;
+}
+
+static int load(const char *filename, int quiet)
+{
+    vcomp_grid_t grid;
+    float *nodes;
+    int bank;
+
+    nodes = malloc(shm->points * VCOMP_AXES * sizeof(float));
+    if (!nodes) {
+	fprintf(stderr, "vcomp-load: ERROR: out of memory\n");
+	return -1;
+    }
+    memset(&grid, 0, sizeof(grid));
+    if (read_grid(filename, &grid, nodes) < 0 || wait_for_motion() < 0) {
+	free(nodes);
+	return -1;
+    }
+    /* fill the bank motion isn't reading, then switch to it */
+    bank = shm->active == 0 ? 1 : 0;
+    shm->grid[bank] = grid;
+    memcpy(VCOMP_BANK(shm, bank), nodes,
+	grid.nx * grid.ny * grid.nz * VCOMP_AXES * sizeof(float));
+    rtapi_smp_wmb();
+    shm->active = bank;
+    shm->swaps++;
+    free(nodes);
+    if (!quiet) {
+	printf("vcomp-load: %s: %d x %d x %d nodes, active\n", filename,
+	    grid.nx, grid.ny, grid.nz);
+    }
+    return 0;
+}
+
+static int show(void)
+{
+    vcomp_grid_t *g;
+
+    if (shm->active != 0 && shm->active != 1) {
+	printf("no grid active, room for %d nodes\n", shm->points);
+	return 0;
+    }
+    g = &shm->grid[shm->active];
+    printf("nodes %d %d %d\norigin %g %g %g\nspacing %g %g %g\n"
+	"joints %d %d %d\n", g->nx, g->ny, g->nz, g->x0, g->y0, g->z0,
+	g->dx, g->dy, g->dz, g->joint[0], g->joint[1], g->joint[2]);
+    printf("# bank %d, %s by motion, %u grids loaded, room for %d nodes\n",
+	shm->active, shm->in_use == shm->active ? "in use" : "not yet used",
+	shm->swaps, shm->points);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int opt, disable = 0, status = 0, quiet = 0, retval;
+
+    while ((opt = getopt(argc, argv, "dsqh")) != -1) {
+	switch (opt) {
+	case 'd':
+	    disable = 1;
+	    break;
+	case 's':
+	    status = 1;
+	    break;
+	case 'q':
+	    quiet = 1;
+	    break;
+	case 'h':
+	default:
+	    usage();
+	    return 1;
+	}
+    }
+    if (disable + status + (optind < argc) != 1 || optind < argc - 1) {
+	usage();
+	return 1;
+    }
+    if (attach() < 0) {
+	detach();
+	return 1;
+    }
+    if (status) {
+	retval = show();
+    } else if (disable) {
+	shm->active = -1;
+	retval = 0;
+    } else {
+	retval = load(argv[optind], quiet);
+    }
+    detach();
+    return retval < 0 ? 1 : 0;
+}
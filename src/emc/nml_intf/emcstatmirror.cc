@@ -0,0 +1,187 @@
+/********************************************************************
+* Description: emcstatmirror.cc
+*   Shared memory copy of EMC_STAT, see emcstatmirror.hh
+*
+* License: GPL Version 2
+* System: Linux
+********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>		/* kill() */
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "config.h"		/* LINELEN */
+#include "rcs_print.hh"
+#include "rtapi_shmkeys.h"
+#include "emcstatmirror.hh"
+
+/* how often emcStatMirrorRead() tries before it gives up */
+#define EMC_STAT_MIRROR_TRIES 100
+
+/* named like the RTAPI segments, so that 'realtime stop' removes a
+   segment left over by a task that crashed */
+static void mirror_name(char *name, size_t len)
+{
+    const char *instance = getenv("INSTANCE");
+
+    snprintf(name, len, SHM_FMT, instance ? atoi(instance) : 0,
+	     EMC_STAT_MIRROR_KEY);
+}
+
+static size_t mirror_size(void)
+{
+    return sizeof(emc_stat_mirror_t) + sizeof(EMC_STAT);
+}
+
+/* a task that crashed left its last image behind, with the magic set;
+   clients that still have it mapped would read it on and on, so clear
+   the magic before the new segment replaces it */
+static void retire_mirror(const char *name)
+{
+    emc_stat_mirror_t *m;
+    struct stat st;
+    int fd;
+
+    fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0)
+	return;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t) sizeof(*m)) {
+	m = (emc_stat_mirror_t *) mmap(NULL, sizeof(*m),
+				       PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (m != MAP_FAILED) {
+	    m->magic = 0;
+	    __sync_synchronize();
+	    munmap(m, sizeof(*m));
+	}
+    }
+    close(fd);
+}
+
+emc_stat_mirror_t *emcStatMirrorCreate(void)
+{
+    char name[LINELEN];
+    emc_stat_mirror_t *m;
+    int fd;
+
+    mirror_name(name, sizeof(name));
+    retire_mirror(name);
+    shm_unlink(name);
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+	rcs_print_error("can't create status mirror %s: %s\n",
+			name, strerror(errno));
+	return NULL;
+    }
+    if (ftruncate(fd, mirror_size()) < 0) {
+	rcs_print_error("can't size status mirror %s: %s\n",
+			name, strerror(errno));
+	close(fd);
+	shm_unlink(name);
+	return NULL;
+    }
+    m = (emc_stat_mirror_t *) mmap(NULL, mirror_size(),
+				   PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) {
+	rcs_print_error("can't map status mirror %s: %s\n",
+			name, strerror(errno));
+	shm_unlink(name);
+	return NULL;
+    }
+    m->size = sizeof(EMC_STAT);
+    m->seq = 0;
+    m->pid = getpid();
+    /* nothing to read until the first image is written */
+    m->magic = 0;
+    return m;
+}
+
+void emcStatMirrorPublish(emc_stat_mirror_t *m, const EMC_STAT *stat)
+{
+    m->seq++;
+    __sync_synchronize();
+    memcpy(m->image, stat, sizeof(EMC_STAT));
+    __sync_synchronize();
+    m->seq++;
+    m->magic = EMC_STAT_MIRROR_MAGIC;
+}
+
+void emcStatMirrorDestroy(emc_stat_mirror_t *m)
+{
+    char name[LINELEN];
+
+    if (m == NULL)
+	return;
+    m->magic = 0;
+    __sync_synchronize();
+    munmap(m, mirror_size());
+    mirror_name(name, sizeof(name));
+    shm_unlink(name);
+}
+
+int emcStatMirrorAlive(const emc_stat_mirror_t *m)
+{
+    if (m->magic != EMC_STAT_MIRROR_MAGIC)
+	return 0;
+    /* a task that crashed never cleared the magic; EPERM means the
+       process is there, only not ours */
+    return kill(m->pid, 0) == 0 || errno != ESRCH;
+}
+
+emc_stat_mirror_t *emcStatMirrorAttach(void)
+{
+    char name[LINELEN];
+    emc_stat_mirror_t *m;
+    struct stat st;
+    int fd;
+
+    mirror_name(name, sizeof(name));
+    fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+	return NULL;
+    /* a segment of another build may be smaller than ours */
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t) mirror_size()) {
+	close(fd);
+	return NULL;
+    }
+    m = (emc_stat_mirror_t *) mmap(NULL, mirror_size(), PROT_READ,
+				   MAP_SHARED, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED)
+	return NULL;
+    if (!emcStatMirrorAlive(m) || m->size != sizeof(EMC_STAT)) {
+	munmap(m, mirror_size());
+	return NULL;
+    }
+    return m;
+}
+
+void emcStatMirrorDetach(emc_stat_mirror_t *m)
+{
+    if (m != NULL)
+	munmap(m, mirror_size());
+}
+
+int emcStatMirrorRead(const emc_stat_mirror_t *m, EMC_STAT *stat)
+{
+    unsigned int seq;
+    int tries;
+
+    if (!emcStatMirrorAlive(m))
+	return -1;
+    for (tries = 0; tries < EMC_STAT_MIRROR_TRIES; tries++) {
+	if (m->magic != EMC_STAT_MIRROR_MAGIC)
+	    return -1;
+	seq = emcStatMirrorBegin(m);
+	memcpy((void *) stat, m->image, sizeof(EMC_STAT));
+	if (!emcStatMirrorRetry(m, seq))
+	    return 0;
+    }
+    return -1;
+}
@@ -0,0 +1,85 @@
+/********************************************************************
+* Description: emcstatmirror.hh
+*   A read-only copy of EMC_STAT in shared memory, written by task
+*   once per cycle, for GUIs running on the same machine.
+*
+* License: GPL Version 2
+* System: Linux
+********************************************************************/
+#ifndef EMCSTATMIRROR_HH
+#define EMCSTATMIRROR_HH
+
+#include "emc_nml.hh"
+
+/*
+  Local clients of the emcStatus NML channel peek() it, which copies
+  the whole EMC_STAT out of the buffer, several times a second each.
+  The mirror is the same EMC_STAT image, written by task right after
+  it writes the channel, to a POSIX shared memory segment that clients
+  map read-only.  A C or C++ client can read the fields it needs in
+  place:
+
+      unsigned seq;
+      do {
+	  seq = emcStatMirrorBegin(m);
+	  mode = emcStatMirrorStatus(m)->task.mode;
+      } while (emcStatMirrorRetry(m, seq));
+
+  The image is an EMC_STAT of the build that task was built from, as in
+  the NML buffer; 'size' is checked on attach so that a client of
+  another build doesn't misread it.  Only its data members may be used.
+
+  'seq' is odd while task writes the image.  When task exits it clears
+  'magic', so that clients which still have the segment mapped notice,
+  detach, and fall back to NML.  A task that crashed can't; then the
+  next task clears it before it replaces the segment, and until then
+  emcStatMirrorAlive() finds that 'pid' is gone.  Attach and Read check
+  it; clients that read in place should too, now and then.
+*/
+
+#define EMC_STAT_MIRROR_MAGIC 0x45535441	/* "ESTA" */
+
+struct emc_stat_mirror_t {
+    int magic;
+    unsigned int size;		/* sizeof(EMC_STAT) of the writer */
+    volatile unsigned int seq;	/* odd while the image is written */
+    int pid;			/* of task */
+    double image[];		/* the EMC_STAT, aligned for its doubles */
+};
+
+/* task side: create, write once per cycle, remove */
+extern emc_stat_mirror_t *emcStatMirrorCreate(void);
+extern void emcStatMirrorPublish(emc_stat_mirror_t *m, const EMC_STAT *stat);
+extern void emcStatMirrorDestroy(emc_stat_mirror_t *m);
+
+/* client side: attach returns NULL if task doesn't publish one */
+extern emc_stat_mirror_t *emcStatMirrorAttach(void);
+extern void emcStatMirrorDetach(emc_stat_mirror_t *m);
+/* whether the task that writes the image is still there */
+extern int emcStatMirrorAlive(const emc_stat_mirror_t *m);
+/* copies a consistent image to stat; -1 if task has exited, or
+   kept writing while we tried */
+extern int emcStatMirrorRead(const emc_stat_mirror_t *m, EMC_STAT *stat);
+
+static inline const EMC_STAT *emcStatMirrorStatus(const emc_stat_mirror_t *m)
+{
+    return (const EMC_STAT *) m->image;
+}
+
+static inline unsigned int emcStatMirrorBegin(const emc_stat_mirror_t *m)
+{
+    /* if the image is being written, the retry fails */
+    unsigned int seq = m->seq & ~1U;
+
+    __sync_synchronize();
+    return seq;
+}
+
+static inline int emcStatMirrorRetry(const emc_stat_mirror_t *m,
+				     unsigned int seq)
+{
+    __sync_synchronize();
+    return m->seq != seq;
+}
+
+#endif
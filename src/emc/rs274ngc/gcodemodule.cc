@@ -18,6 +18,12 @@
 
 #include <Python.h>
 #include <structmember.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <new>
+#include <vector>
 
 #include "rs274ngc.hh"
 #include "rs274ngc_interp.hh"
@@ -137,7 +143,839 @@ static PyTypeObject LineCodeType = {
     0,                      /*tp_is_gc*/
 };
 
+static void unrotate(double &x, double &y, double c, double s) {
+    double tx = x * c + y * s;
+    y = -x * s + y * c;
+    x = tx;
+}
+
+static void rotate(double &x, double &y, double c, double s) {
+    double tx = x * c - y * s;
+    y = x * s + y * c;
+    x = tx;
+}
+
+// Break an arc into straight segments.  'lo' is the start point, in
+// translated coordinates; the arc's end point and center are as passed
+// to ARC_FEED.  The end points of the segments are left in 'points',
+// nine translated coordinates each, and their number is returned.
+static int arc_to_points(const double lo[9],
+        double x1, double y1, double cx, double cy, int rot, double z1,
+        double a, double b, double c, double u, double v, double w,
+        int plane, double rotation_cos, double rotation_sin,
+        const double g5xoffset[9], const double g92offset[9],
+        int max_segments, std::vector<double> &points) {
+    double o[9], n[9];
+    int X, Y, Z;
+
+    if(plane == 1) {
+        X=0; Y=1; Z=2;
+    } else if(plane == 3) {
+        X=2; Y=0; Z=1;
+    } else {
+        X=1; Y=2; Z=0;
+    }
+    n[X] = x1;
+    n[Y] = y1;
+    n[Z] = z1;
+    n[3] = a;
+    n[4] = b;
+    n[5] = c;
+    n[6] = u;
+    n[7] = v;
+    n[8] = w;
+    for(int ax=0; ax<9; ax++) o[ax] = lo[ax] - g5xoffset[ax];
+    unrotate(o[0], o[1], rotation_cos, rotation_sin);
+    for(int ax=0; ax<9; ax++) o[ax] -= g92offset[ax];
+
+    double theta1 = atan2(o[Y]-cy, o[X]-cx);
+    double theta2 = atan2(n[Y]-cy, n[X]-cx);
+
+    if(rot < 0) {
+        while(theta2 - theta1 > -CIRCLE_FUZZ) theta2 -= 2*M_PI;
+    } else {
+        while(theta2 - theta1 < CIRCLE_FUZZ) theta2 += 2*M_PI;
+    }
+
+    // if multi-turn, add the right number of full circles
+    if(rot < -1) theta2 += 2*M_PI*(rot+1);
+    if(rot > 1) theta2 += 2*M_PI*(rot-1);
+
+    int steps = std::max(3, int(max_segments * fabs(theta1 - theta2) / M_PI));
+    double rsteps = 1. / steps;
+    points.resize(steps * 9);
+
+    double dtheta = theta2 - theta1;
+    double d[9] = {0, 0, 0, n[3]-o[3], n[4]-o[4], n[5]-o[5], n[6]-o[6], n[7]-o[7], n[8]-o[8]};
+    d[Z] = n[Z] - o[Z];
+
+    double tx = o[X] - cx, ty = o[Y] - cy, dc = cos(dtheta*rsteps), ds = sin(dtheta*rsteps);
+    for(int i=0; i<steps-1; i++) {
+        double f = (i+1) * rsteps;
+        double *p = &points[i * 9];
+        rotate(tx, ty, dc, ds);
+        p[X] = tx + cx;
+        p[Y] = ty + cy;
+        p[Z] = o[Z] + d[Z] * f;
+        p[3] = o[3] + d[3] * f;
+        p[4] = o[4] + d[4] * f;
+        p[5] = o[5] + d[5] * f;
+        p[6] = o[6] + d[6] * f;
+        p[7] = o[7] + d[7] * f;
+        p[8] = o[8] + d[8] * f;
+        for(int ax=0; ax<9; ax++) p[ax] += g92offset[ax];
+        rotate(p[0], p[1], rotation_cos, rotation_sin);
+        for(int ax=0; ax<9; ax++) p[ax] += g5xoffset[ax];
+    }
+    for(int ax=0; ax<9; ax++) n[ax] += g92offset[ax];
+    rotate(n[0], n[1], rotation_cos, rotation_sin);
+    for(int ax=0; ax<9; ax++) n[ax] += g5xoffset[ax];
+    std::copy(n, n + 9, &points[(steps - 1) * 9]);
+    return steps;
+}
+
+// Native preview geometry.
+//
+// A gcode.preview collects the moves of a program the way
+// rs274.glcanon.GLCanon used to, but into packed arrays instead of
+// lists of tuples: for each kind of move (traverse, feed, arcfeed) a
+// gcode.segments holding float start and end points, int line numbers
+// and float feed rates.  When the canon passed to parse() has a
+// 'preview' attribute of this type, moves are added to it here and
+// never reach Python.  Everything else still calls the canon's Python
+// methods, and those pass offsets, feed rate, plane and tool offsets on
+// to the preview.
+//
+// The segments export their points through the buffer protocol, as
+// float[n][2][9], and their line numbers and feed rates as memoryviews
+// of int[n] and float[n].  linuxcnc.draw_lines() draws them directly.
+
+struct SegmentStore {
+    std::vector<float> points;  // start and end of each segment
+    std::vector<int> lines;
+    std::vector<float> feedrates;
+    double last_end[3];         // extents include the last end point
+    double last_to[3];
+};
+
+typedef struct {
+    PyObject_HEAD
+    SegmentStore *store;
+    int has_feedrate;
+    int exports;                // buffers handed out; no appends while > 0
+    Py_ssize_t shape[3];
+    Py_ssize_t strides[3];
+} Segments;
+
+static Py_ssize_t Segments_len(Segments *self) {
+    return self->store->lines.size();
+}
+
+static PyObject *point_tuple(const float *p) {
+    return Py_BuildValue("(ddddddddd)", p[0], p[1], p[2], p[3], p[4],
+            p[5], p[6], p[7], p[8]);
+}
+
+// seg[i] is (line number, start, end) for traverses, and
+// (line number, start, end, feed rate) for feeds
+static PyObject *Segments_item(Segments *self, Py_ssize_t i) {
+    SegmentStore *st = self->store;
+    if(i < 0 || i >= (Py_ssize_t)st->lines.size()) {
+        PyErr_SetString(PyExc_IndexError, "segment index out of range");
+        return NULL;
+    }
+    const float *p = &st->points[i * 18];
+    if(self->has_feedrate)
+        return Py_BuildValue("iNNd", st->lines[i], point_tuple(p),
+                point_tuple(p + 9), (double)st->feedrates[i]);
+    return Py_BuildValue("iNN", st->lines[i], point_tuple(p),
+            point_tuple(p + 9));
+}
+
+static PyObject *Segments_select(Segments *self, PyObject *args) {
+    SegmentStore *st = self->store;
+    int lineno;
+    if(!PyArg_ParseTuple(args, "i:select", &lineno)) return NULL;
+    PyObject *result = PyList_New(0);
+    if(!result) return NULL;
+    for(size_t i = 0; i < st->lines.size(); i++) {
+        if(st->lines[i] != lineno) continue;
+        const float *p = &st->points[i * 18];
+        PyObject *item = Py_BuildValue("NN", point_tuple(p), point_tuple(p + 9));
+        if(!item || PyList_Append(result, item) < 0) {
+            Py_XDECREF(item);
+            Py_DECREF(result);
+            return NULL;
+        }
+        Py_DECREF(item);
+    }
+    return result;
+}
+
+static PyObject *Segments_totals(Segments *self, PyObject *args) {
+    SegmentStore *st = self->store;
+    double maxrate, distance = 0, time = 0;
+    if(!PyArg_ParseTuple(args, "d:totals", &maxrate)) return NULL;
+    for(size_t i = 0; i < st->lines.size(); i++) {
+        const float *p = &st->points[i * 18];
+        double dx = p[9] - p[0], dy = p[10] - p[1], dz = p[11] - p[2];
+        double d = sqrt(dx * dx + dy * dy + dz * dz);
+        double rate = maxrate;
+        if(self->has_feedrate) rate = std::min(rate, (double)st->feedrates[i]);
+        distance += d;
+        time += d / rate;
+    }
+    return Py_BuildValue("dd", distance, time);
+}
+
+// hand out a one dimensional view of part of the store; it holds a
+// reference to the segments, and counts as an export until released
+static PyObject *Segments_view(Segments *self, void *buf, Py_ssize_t n,
+        const char *format, Py_ssize_t itemsize) {
+    static float empty;
+    Py_buffer view;
+    Py_ssize_t shape = n;
+
+    memset(&view, 0, sizeof(view));
+    view.obj = (PyObject *)self;
+    view.buf = n ? buf : &empty;
+    view.len = n * itemsize;
+    view.readonly = 1;
+    view.itemsize = itemsize;
+    view.format = (char *)format;
+    view.ndim = 1;
+    view.shape = &shape;
+    view.strides = &view.itemsize;
+    PyObject *result = PyMemoryView_FromBuffer(&view);
+    if(result) {
+        Py_INCREF(self);
+        self->exports++;
+    }
+    return result;
+}
+
+static PyObject *Segments_lines(Segments *self) {
+    SegmentStore *st = self->store;
+    return Segments_view(self, st->lines.empty() ? 0 : &st->lines[0],
+            st->lines.size(), "i", sizeof(int));
+}
+
+static PyObject *Segments_feedrates(Segments *self) {
+    SegmentStore *st = self->store;
+    return Segments_view(self, st->feedrates.empty() ? 0 : &st->feedrates[0],
+            st->feedrates.size(), "f", sizeof(float));
+}
+
+static int Segments_getbuffer(Segments *self, Py_buffer *view, int flags) {
+    static float empty;
+    SegmentStore *st = self->store;
+
+    if(flags & PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "segments are read-only");
+        view->obj = NULL;
+        return -1;
+    }
+    self->shape[0] = st->lines.size();
+    self->shape[1] = 2;
+    self->shape[2] = 9;
+    self->strides[0] = 18 * sizeof(float);
+    self->strides[1] = 9 * sizeof(float);
+    self->strides[2] = sizeof(float);
+
+    view->obj = (PyObject *)self;
+    Py_INCREF(self);
+    view->buf = st->points.empty() ? &empty : &st->points[0];
+    view->len = st->points.size() * sizeof(float);
+    view->readonly = 1;
+    view->itemsize = sizeof(float);
+    view->format = (flags & PyBUF_FORMAT) ? (char *)"f" : NULL;
+    view->ndim = (flags & PyBUF_ND) ? 3 : 1;
+    view->shape = (flags & PyBUF_ND) ? self->shape : NULL;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    self->exports++;
+    return 0;
+}
+
+static void Segments_releasebuffer(Segments *self, Py_buffer *view) {
+    self->exports--;
+}
+
+static void Segments_dealloc(Segments *self) {
+    delete self->store;
+    self->ob_type->tp_free((PyObject *)self);
+}
+
+static PySequenceMethods SegmentsSequence = {
+    (lenfunc)Segments_len,          /*sq_length*/
+    0,                              /*sq_concat*/
+    0,                              /*sq_repeat*/
+    (ssizeargfunc)Segments_item,    /*sq_item*/
+};
+
+static PyBufferProcs SegmentsBuffer = {
+    0,                              /*bf_getreadbuffer*/
+    0,                              /*bf_getwritebuffer*/
+    0,                              /*bf_getsegcount*/
+    0,                              /*bf_getcharbuffer*/
+    (getbufferproc)Segments_getbuffer,
+    (releasebufferproc)Segments_releasebuffer,
+};
+
+static PyMethodDef SegmentsMethods[] = {
+    {"select", (PyCFunction)Segments_select, METH_VARARGS,
+        "List the (start, end) points of the segments of one line"},
+    {"totals", (PyCFunction)Segments_totals, METH_VARARGS,
+        "totals(maxrate) -> (distance, time) over X, Y and Z"},
+    {NULL}
+};
+
+static PyGetSetDef SegmentsGetSet[] = {
+    {(char*)"lines", (getter)Segments_lines},
+    {(char*)"feedrates", (getter)Segments_feedrates},
+    {NULL, NULL},
+};
+
+static PyTypeObject SegmentsType = {
+    PyObject_HEAD_INIT(NULL)
+    0,                      /*ob_size*/
+    "gcode.segments",       /*tp_name*/
+    sizeof(Segments),       /*tp_basicsize*/
+    0,                      /*tp_itemsize*/
+    /* methods */
+    (destructor)Segments_dealloc, /*tp_dealloc*/
+    0,                      /*tp_print*/
+    0,                      /*tp_getattr*/
+    0,                      /*tp_setattr*/
+    0,                      /*tp_compare*/
+    0,                      /*tp_repr*/
+    0,                      /*tp_as_number*/
+    &SegmentsSequence,      /*tp_as_sequence*/
+    0,                      /*tp_as_mapping*/
+    0,                      /*tp_hash*/
+    0,                      /*tp_call*/
+    0,                      /*tp_str*/
+    0,                      /*tp_getattro*/
+    0,                      /*tp_setattro*/
+    &SegmentsBuffer,        /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER, /*tp_flags*/
+    0,                      /*tp_doc*/
+    0,                      /*tp_traverse*/
+    0,                      /*tp_clear*/
+    0,                      /*tp_richcompare*/
+    0,                      /*tp_weaklistoffset*/
+    0,                      /*tp_iter*/
+    0,                      /*tp_iternext*/
+    SegmentsMethods,        /*tp_methods*/
+    0,                      /*tp_members*/
+    SegmentsGetSet,         /*tp_getset*/
+};
+
+static Segments *Segments_new(int has_feedrate) {
+    Segments *self = PyObject_New(Segments, &SegmentsType);
+    if(!self) return NULL;
+    self->store = new(std::nothrow) SegmentStore;
+    if(!self->store) {
+        PyObject_Del(self);
+        PyErr_NoMemory();
+        return NULL;
+    }
+    self->has_feedrate = has_feedrate;
+    self->exports = 0;
+    return self;
+}
+
+typedef struct {
+    PyObject_HEAD
+    Segments *traverse, *feed, *arcfeed;
+    double lo[9];               // last position, translated
+    int first_move;
+    int suppress;
+    double feedrate;
+    int plane;
+    int arcdivision;
+    double to[9];               // tool offset
+    double g5x[9], g92[9];
+    double rotation_xy, rotation_cos, rotation_sin;
+    double min_extents[3], max_extents[3];
+    double min_extents_t[3], max_extents_t[3];
+    std::vector<double> *arc;   // scratch for arc_to_points
+} Preview;
+
+static void preview_translate(Preview *p, double pt[9]) {
+    for(int i=0; i<9; i++) pt[i] += p->g92[i];
+    if(p->rotation_xy) rotate(pt[0], pt[1], p->rotation_cos, p->rotation_sin);
+    for(int i=0; i<9; i++) pt[i] += p->g5x[i];
+}
+
+static void extents_add(Preview *p, const double pt[3], const double to[3]) {
+    for(int i=0; i<3; i++) {
+        p->min_extents[i] = std::min(p->min_extents[i], pt[i]);
+        p->max_extents[i] = std::max(p->max_extents[i], pt[i]);
+        p->min_extents_t[i] = std::min(p->min_extents_t[i], pt[i] + to[i]);
+        p->max_extents_t[i] = std::max(p->max_extents_t[i], pt[i] + to[i]);
+    }
+}
+
+static bool preview_add(Preview *p, Segments *s, int line,
+        const double start[9], const double end[9]) {
+    SegmentStore *st = s->store;
+    if(s->exports) {
+        PyErr_SetString(PyExc_BufferError,
+                "can't add to segments while their buffer is in use");
+        return false;
+    }
+    try {
+        st->points.insert(st->points.end(), start, start + 9);
+        st->points.insert(st->points.end(), end, end + 9);
+        st->lines.push_back(line);
+        if(s->has_feedrate) st->feedrates.push_back(p->feedrate);
+    } catch(std::bad_alloc &) {
+        st->points.resize(st->lines.size() * 18);
+        st->feedrates.resize(s->has_feedrate ? st->lines.size() : 0);
+        PyErr_NoMemory();
+        return false;
+    }
+    // the same extents gcode.calc_extents finds: every start point, and
+    // the end of the last segment of each kind
+    extents_add(p, start, p->to);
+    std::copy(end, end + 3, st->last_end);
+    std::copy(p->to, p->to + 3, st->last_to);
+    return true;
+}
+
+static bool preview_straight_traverse(Preview *p, int line, double pt[9]) {
+    if(p->suppress > 0) return true;
+    preview_translate(p, pt);
+    if(!p->first_move && !preview_add(p, p->traverse, line, p->lo, pt))
+        return false;
+    std::copy(pt, pt + 9, p->lo);
+    return true;
+}
+
+static bool preview_straight_feed(Preview *p, int line, double pt[9]) {
+    if(p->suppress > 0) return true;
+    p->first_move = 0;
+    preview_translate(p, pt);
+    if(!preview_add(p, p->feed, line, p->lo, pt)) return false;
+    std::copy(pt, pt + 9, p->lo);
+    return true;
+}
+
+static bool preview_rigid_tap(Preview *p, int line, double x, double y, double z) {
+    if(p->suppress > 0) return true;
+    p->first_move = 0;
+    double pt[9] = {x, y, z, 0, 0, 0, 0, 0, 0};
+    preview_translate(p, pt);
+    std::copy(p->lo + 3, p->lo + 9, pt + 3);
+    return preview_add(p, p->feed, line, p->lo, pt)
+        && preview_add(p, p->feed, line, pt, p->lo);
+}
+
+static bool preview_arc_feed(Preview *p, int line,
+        double x1, double y1, double cx, double cy, int rot, double z1,
+        double a, double b, double c, double u, double v, double w) {
+    if(p->suppress > 0) return true;
+    p->first_move = 0;
+    std::vector<double> &points = *p->arc;
+    int steps = arc_to_points(p->lo, x1, y1, cx, cy, rot, z1, a, b, c, u, v, w,
+            p->plane, p->rotation_cos, p->rotation_sin, p->g5x, p->g92,
+            p->arcdivision, points);
+    for(int i=0; i<steps; i++) {
+        if(!preview_add(p, p->arcfeed, line, p->lo, &points[i*9]))
+            return false;
+        std::copy(&points[i*9], &points[i*9] + 9, p->lo);
+    }
+    return true;
+}
+
+static PyObject *Preview_straight_traverse(Preview *self, PyObject *args) {
+    int line;
+    double pt[9];
+    if(!PyArg_ParseTuple(args, "iddddddddd:straight_traverse", &line,
+                &pt[0], &pt[1], &pt[2], &pt[3], &pt[4], &pt[5],
+                &pt[6], &pt[7], &pt[8]))
+        return NULL;
+    if(!preview_straight_traverse(self, line, pt)) return NULL;
+    Py_RETURN_NONE;
+}
+
+static PyObject *Preview_straight_feed(Preview *self, PyObject *args) {
+    int line;
+    double pt[9];
+    if(!PyArg_ParseTuple(args, "iddddddddd:straight_feed", &line,
+                &pt[0], &pt[1], &pt[2], &pt[3], &pt[4], &pt[5],
+                &pt[6], &pt[7], &pt[8]))
+        return NULL;
+    if(!preview_straight_feed(self, line, pt)) return NULL;
+    Py_RETURN_NONE;
+}
+
+static PyObject *Preview_rigid_tap(Preview *self, PyObject *args) {
+    int line;
+    double x, y, z;
+    if(!PyArg_ParseTuple(args, "iddd:rigid_tap", &line, &x, &y, &z))
+        return NULL;
+    if(!preview_rigid_tap(self, line, x, y, z)) return NULL;
+    Py_RETURN_NONE;
+}
+
+static PyObject *Preview_arc_feed(Preview *self, PyObject *args) {
+    int line, rot;
+    double x1, y1, cx, cy, z1, a, b, c, u, v, w;
+    if(!PyArg_ParseTuple(args, "iddddiddddddd:arc_feed", &line,
+                &x1, &y1, &cx, &cy, &rot, &z1, &a, &b, &c, &u, &v, &w))
+        return NULL;
+    if(!preview_arc_feed(self, line, x1, y1, cx, cy, rot, z1, a, b, c, u, v, w))
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+static bool parse_pose(PyObject *args, const char *fmt, double pt[9]) {
+    return PyArg_ParseTuple(args, fmt, &pt[0], &pt[1], &pt[2], &pt[3],
+            &pt[4], &pt[5], &pt[6], &pt[7], &pt[8]);
+}
+
+static PyObject *Preview_tool_offset(Preview *self, PyObject *args) {
+    double to[9];
+    if(!parse_pose(args, "ddddddddd:tool_offset", to)) return NULL;
+    self->first_move = 1;
+    for(int i=0; i<9; i++) self->lo[i] += self->to[i] - to[i];
+    std::copy(to, to + 9, self->to);
+    Py_RETURN_NONE;
+}
+
+static PyObject *Preview_set_g5x_offset(Preview *self, PyObject *args) {
+    if(!parse_pose(args, "ddddddddd:set_g5x_offset", self->g5x)) return NULL;
+    Py_RETURN_NONE;
+}
+
+static PyObject *Preview_set_g92_offset(Preview *self, PyObject *args) {
+    if(!parse_pose(args, "ddddddddd:set_g92_offset", self->g92)) return NULL;
+    Py_RETURN_NONE;
+}
+
+static PyObject *Preview_set_xy_rotation(Preview *self, PyObject *args) {
+    double theta;
+    if(!PyArg_ParseTuple(args, "d:set_xy_rotation", &theta)) return NULL;
+    self->rotation_xy = theta;
+    self->rotation_cos = cos(theta * M_PI / 180);
+    self->rotation_sin = sin(theta * M_PI / 180);
+    Py_RETURN_NONE;
+}
+
+static PyObject *Preview_calc_extents(Preview *self) {
+    double mn[3], mx[3], mnt[3], mxt[3];
+    std::copy(self->min_extents, self->min_extents + 3, mn);
+    std::copy(self->max_extents, self->max_extents + 3, mx);
+    std::copy(self->min_extents_t, self->min_extents_t + 3, mnt);
+    std::copy(self->max_extents_t, self->max_extents_t + 3, mxt);
+    Segments *kinds[3] = {self->arcfeed, self->feed, self->traverse};
+    for(int k=0; k<3; k++) {
+        SegmentStore *st = kinds[k]->store;
+        if(st->lines.empty()) continue;
+        for(int i=0; i<3; i++) {
+            mn[i] = std::min(mn[i], st->last_end[i]);
+            mx[i] = std::max(mx[i], st->last_end[i]);
+            mnt[i] = std::min(mnt[i], st->last_end[i] + st->last_to[i]);
+            mxt[i] = std::max(mxt[i], st->last_end[i] + st->last_to[i]);
+        }
+    }
+    return Py_BuildValue("[ddd][ddd][ddd][ddd]",
+        mn[0], mn[1], mn[2],  mx[0], mx[1], mx[2],
+        mnt[0], mnt[1], mnt[2],  mxt[0], mxt[1], mxt[2]);
+}
+
+static PyObject *Preview_get_lo(Preview *self) {
+    return Py_BuildValue("(ddddddddd)", self->lo[0], self->lo[1], self->lo[2],
+            self->lo[3], self->lo[4], self->lo[5],
+            self->lo[6], self->lo[7], self->lo[8]);
+}
+
+static int Preview_set_lo(Preview *self, PyObject *value) {
+    double lo[9];
+    if(!value) {
+        PyErr_SetString(PyExc_TypeError, "can't delete lo");
+        return -1;
+    }
+    if(!PyArg_ParseTuple(value, "ddddddddd:lo", &lo[0], &lo[1], &lo[2],
+                &lo[3], &lo[4], &lo[5], &lo[6], &lo[7], &lo[8]))
+        return -1;
+    std::copy(lo, lo + 9, self->lo);
+    return 0;
+}
+
+// Preview files, for rs274.previewcache: a header, then the points,
+// line numbers and feed rates of the traverses, feeds and arc feeds as
+// they are in memory, then a string of the caller's.  They are read
+// back by the same build on the same machine, so nothing is converted;
+// a file from anywhere else is refused by its header.
+
+#define PREVIEW_MAGIC "GCPREVW1"
+#define PREVIEW_ORDER 0x01020304u
+
+struct PreviewHeader {
+    char magic[8];
+    uint32_t order;
+    uint32_t float_size;
+    uint64_t count[3];          // traverse, feed, arcfeed
+    uint64_t extra;             // length of the caller's string
+    double extents[4][3];
+    double last_end[3][3], last_to[3][3];
+};
+
+static uint64_t preview_file_size(const PreviewHeader &h) {
+    uint64_t size = sizeof(h) + h.extra;
+    for(int k=0; k<3; k++)
+        size += h.count[k] * (18 * sizeof(float) + sizeof(int)
+                + (k ? sizeof(float) : 0));
+    return size;
+}
+
+static bool write_all(FILE *f, const void *buf, size_t len) {
+    return !len || fwrite(buf, len, 1, f) == 1;
+}
+
+static bool read_all(FILE *f, void *buf, size_t len) {
+    return !len || fread(buf, len, 1, f) == 1;
+}
+
+static PyObject *Preview_save(Preview *self, PyObject *args) {
+    char *filename, *extra = 0;
+    Py_ssize_t extra_len = 0;
+    if(!PyArg_ParseTuple(args, "s|s#:save", &filename, &extra, &extra_len))
+        return NULL;
+
+    Segments *kinds[3] = {self->traverse, self->feed, self->arcfeed};
+    PreviewHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, PREVIEW_MAGIC, sizeof(h.magic));
+    h.order = PREVIEW_ORDER;
+    h.float_size = sizeof(float);
+    h.extra = extra_len;
+    std::copy(self->min_extents, self->min_extents + 3, h.extents[0]);
+    std::copy(self->max_extents, self->max_extents + 3, h.extents[1]);
+    std::copy(self->min_extents_t, self->min_extents_t + 3, h.extents[2]);
+    std::copy(self->max_extents_t, self->max_extents_t + 3, h.extents[3]);
+    for(int k=0; k<3; k++) {
+        SegmentStore *st = kinds[k]->store;
+        h.count[k] = st->lines.size();
+        std::copy(st->last_end, st->last_end + 3, h.last_end[k]);
+        std::copy(st->last_to, st->last_to + 3, h.last_to[k]);
+    }
+
+    FILE *f = fopen(filename, "wb");
+    if(!f) return PyErr_SetFromErrnoWithFilename(PyExc_IOError, filename);
+    bool ok = write_all(f, &h, sizeof(h));
+    for(int k=0; ok && k<3; k++) {
+        SegmentStore *st = kinds[k]->store;
+        size_t n = st->lines.size();
+        ok = write_all(f, n ? &st->points[0] : 0, n * 18 * sizeof(float))
+            && write_all(f, n ? &st->lines[0] : 0, n * sizeof(int))
+            && (!kinds[k]->has_feedrate
+                || write_all(f, n ? &st->feedrates[0] : 0, n * sizeof(float)));
+    }
+    ok = ok && write_all(f, extra, extra_len);
+    if(fclose(f) != 0) ok = false;
+    if(!ok) return PyErr_SetFromErrnoWithFilename(PyExc_IOError, filename);
+    Py_RETURN_NONE;
+}
+
+// replaces the segments with those in the file, and returns the string
+// saved with them
+static PyObject *Preview_load(Preview *self, PyObject *args) {
+    char *filename;
+    if(!PyArg_ParseTuple(args, "s:load", &filename)) return NULL;
+
+    Segments *kinds[3] = {self->traverse, self->feed, self->arcfeed};
+    for(int k=0; k<3; k++) {
+        if(kinds[k]->exports) {
+            PyErr_SetString(PyExc_BufferError,
+                    "can't load segments while their buffer is in use");
+            return NULL;
+        }
+    }
+
+    FILE *f = fopen(filename, "rb");
+    if(!f) return PyErr_SetFromErrnoWithFilename(PyExc_IOError, filename);
+    PreviewHeader h;
+    struct stat st;
+    if(!read_all(f, &h, sizeof(h)) || fstat(fileno(f), &st) != 0
+            || memcmp(h.magic, PREVIEW_MAGIC, sizeof(h.magic))
+            || h.order != PREVIEW_ORDER || h.float_size != sizeof(float)
+            || preview_file_size(h) != (uint64_t)st.st_size) {
+        fclose(f);
+        PyErr_Format(PyExc_ValueError, "%s: not a preview file", filename);
+        return NULL;
+    }
+
+    SegmentStore *stores[3] = {0, 0, 0};
+    PyObject *extra = 0;
+    bool ok = true;
+    try {
+        for(int k=0; ok && k<3; k++) {
+            SegmentStore *s = stores[k] = new SegmentStore;
+            size_t n = h.count[k];
+            s->points.resize(n * 18);
+            s->lines.resize(n);
+            s->feedrates.resize(kinds[k]->has_feedrate ? n : 0);
+            std::copy(h.last_end[k], h.last_end[k] + 3, s->last_end);
+            std::copy(h.last_to[k], h.last_to[k] + 3, s->last_to);
+            ok = read_all(f, n ? &s->points[0] : 0, n * 18 * sizeof(float))
+                && read_all(f, n ? &s->lines[0] : 0, n * sizeof(int))
+                && read_all(f, s->feedrates.empty() ? 0 : &s->feedrates[0],
+                        s->feedrates.size() * sizeof(float));
+        }
+    } catch(std::bad_alloc &) {
+        ok = false;
+        PyErr_NoMemory();
+    }
+    if(ok) {
+        extra = PyString_FromStringAndSize(NULL, h.extra);
+        ok = extra && read_all(f, PyString_AS_STRING(extra), h.extra);
+    }
+    fclose(f);
+    if(!ok) {
+        for(int k=0; k<3; k++) delete stores[k];
+        Py_XDECREF(extra);
+        if(!PyErr_Occurred())
+            PyErr_SetFromErrnoWithFilename(PyExc_IOError, filename);
+        return NULL;
+    }
+
+    for(int k=0; k<3; k++) {
+        std::swap(kinds[k]->store, stores[k]);
+        delete stores[k];
+    }
+    std::copy(h.extents[0], h.extents[0] + 3, self->min_extents);
+    std::copy(h.extents[1], h.extents[1] + 3, self->max_extents);
+    std::copy(h.extents[2], h.extents[2] + 3, self->min_extents_t);
+    std::copy(h.extents[3], h.extents[3] + 3, self->max_extents_t);
+    return extra;
+}
+
+static PyObject *Preview_new(PyTypeObject *type, PyObject *args, PyObject *kw) {
+    Preview *self = (Preview *)type->tp_alloc(type, 0);
+    if(!self) return NULL;
+    self->arc = new(std::nothrow) std::vector<double>;
+    self->traverse = Segments_new(0);
+    self->feed = Segments_new(1);
+    self->arcfeed = Segments_new(1);
+    if(!self->arc || !self->traverse || !self->feed || !self->arcfeed) {
+        Py_DECREF(self);
+        return PyErr_Occurred() ? NULL : PyErr_NoMemory();
+    }
+    self->first_move = 1;
+    self->feedrate = 1;
+    self->plane = 1;
+    self->arcdivision = 64;
+    self->rotation_cos = 1;
+    for(int i=0; i<3; i++) {
+        self->min_extents[i] = self->min_extents_t[i] = 9e99;
+        self->max_extents[i] = self->max_extents_t[i] = -9e99;
+    }
+    return (PyObject *)self;
+}
+
+static void Preview_dealloc(Preview *self) {
+    Py_XDECREF(self->traverse);
+    Py_XDECREF(self->feed);
+    Py_XDECREF(self->arcfeed);
+    delete self->arc;
+    self->ob_type->tp_free((PyObject *)self);
+}
+
+static PyMethodDef PreviewMethods[] = {
+    {"straight_traverse", (PyCFunction)Preview_straight_traverse, METH_VARARGS,
+        "straight_traverse(lineno, x, y, z, a, b, c, u, v, w)"},
+    {"straight_feed", (PyCFunction)Preview_straight_feed, METH_VARARGS,
+        "straight_feed(lineno, x, y, z, a, b, c, u, v, w)"},
+    {"straight_probe", (PyCFunction)Preview_straight_feed, METH_VARARGS,
+        "straight_probe(lineno, x, y, z, a, b, c, u, v, w)"},
+    {"rigid_tap", (PyCFunction)Preview_rigid_tap, METH_VARARGS,
+        "rigid_tap(lineno, x, y, z)"},
+    {"arc_feed", (PyCFunction)Preview_arc_feed, METH_VARARGS,
+        "arc_feed(lineno, x1, y1, cx, cy, rot, z1, a, b, c, u, v, w)"},
+    {"tool_offset", (PyCFunction)Preview_tool_offset, METH_VARARGS,
+        "tool_offset(x, y, z, a, b, c, u, v, w)"},
+    {"set_g5x_offset", (PyCFunction)Preview_set_g5x_offset, METH_VARARGS,
+        "set_g5x_offset(x, y, z, a, b, c, u, v, w)"},
+    {"set_g92_offset", (PyCFunction)Preview_set_g92_offset, METH_VARARGS,
+        "set_g92_offset(x, y, z, a, b, c, u, v, w)"},
+    {"set_xy_rotation", (PyCFunction)Preview_set_xy_rotation, METH_VARARGS,
+        "set_xy_rotation(degrees)"},
+    {"calc_extents", (PyCFunction)Preview_calc_extents, METH_NOARGS,
+        "Return min, max, min with tool offset and max with tool offset"},
+    {"save", (PyCFunction)Preview_save, METH_VARARGS,
+        "save(filename[, extra]) writes the segments and extents to a file"},
+    {"load", (PyCFunction)Preview_load, METH_VARARGS,
+        "load(filename) -> extra: replace the segments and extents with a file's"},
+    {NULL}
+};
+
+static PyMemberDef PreviewMembers[] = {
+    {(char*)"traverse", T_OBJECT, offsetof(Preview, traverse), READONLY},
+    {(char*)"feed", T_OBJECT, offsetof(Preview, feed), READONLY},
+    {(char*)"arcfeed", T_OBJECT, offsetof(Preview, arcfeed), READONLY},
+    {(char*)"first_move", T_INT, offsetof(Preview, first_move), 0},
+    {(char*)"suppress", T_INT, offsetof(Preview, suppress), 0},
+    {(char*)"feedrate", T_DOUBLE, offsetof(Preview, feedrate), 0},
+    {(char*)"plane", T_INT, offsetof(Preview, plane), 0},
+    {(char*)"arcdivision", T_INT, offsetof(Preview, arcdivision), 0},
+    {NULL}
+};
+
+static PyGetSetDef PreviewGetSet[] = {
+    {(char*)"lo", (getter)Preview_get_lo, (setter)Preview_set_lo},
+    {NULL, NULL},
+};
+
+static PyTypeObject PreviewType = {
+    PyObject_HEAD_INIT(NULL)
+    0,                      /*ob_size*/
+    "gcode.preview",        /*tp_name*/
+    sizeof(Preview),        /*tp_basicsize*/
+    0,                      /*tp_itemsize*/
+    /* methods */
+    (destructor)Preview_dealloc, /*tp_dealloc*/
+    0,                      /*tp_print*/
+    0,                      /*tp_getattr*/
+    0,                      /*tp_setattr*/
+    0,                      /*tp_compare*/
+    0,                      /*tp_repr*/
+    0,                      /*tp_as_number*/
+    0,                      /*tp_as_sequence*/
+    0,                      /*tp_as_mapping*/
+    0,                      /*tp_hash*/
+    0,                      /*tp_call*/
+    0,                      /*tp_str*/
+    0,                      /*tp_getattro*/
+    0,                      /*tp_setattro*/
+    0,                      /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT,     /*tp_flags*/
+    "Preview geometry collected from G-code moves", /*tp_doc*/
+    0,                      /*tp_traverse*/
+    0,                      /*tp_clear*/
+    0,                      /*tp_richcompare*/
+    0,                      /*tp_weaklistoffset*/
+    0,                      /*tp_iter*/
+    0,                      /*tp_iternext*/
+    PreviewMethods,         /*tp_methods*/
+    PreviewMembers,         /*tp_members*/
+    PreviewGetSet,          /*tp_getset*/
+    0,                      /*tp_base*/
+    0,                      /*tp_dict*/
+    0,                      /*tp_descr_get*/
+    0,                      /*tp_descr_set*/
+    0,                      /*tp_dictoffset*/
+    0,                      /*tp_init*/
+    0,                      /*tp_alloc*/
+    Preview_new,            /*tp_new*/
+};
+
 static PyObject *callback;
+static Preview *preview;        // the callback's, if it has one
 static int interp_error;
 static int last_sequence_number;
 static bool metric;
@@ -203,6 +1041,15 @@ void ARC_FEED(int line_number,
         v_position /= 25.4;
         w_position /= 25.4;
     }
+    if(preview) {
+        if(interp_error) return;
+        if(!preview_arc_feed(preview, line_number, first_end, second_end,
+                    first_axis, second_axis, rotation, axis_end_point,
+                    a_position, b_position, c_position,
+                    u_position, v_position, w_position))
+            interp_error ++;
+        return;
+    }
     maybe_new_line(line_number);
     if(interp_error) return;
     PyObject *result =
@@ -223,6 +1070,12 @@ void STRAIGHT_FEED(int line_number,
     _pos_a=a; _pos_b=b; _pos_c=c;
     _pos_u=u; _pos_v=v; _pos_w=w;
     if(metric) { x /= 25.4; y /= 25.4; z /= 25.4; u /= 25.4; v /= 25.4; w /= 25.4; }
+    if(preview) {
+        if(interp_error) return;
+        double pt[9] = {x, y, z, a, b, c, u, v, w};
+        if(!preview_straight_feed(preview, line_number, pt)) interp_error ++;
+        return;
+    }
     maybe_new_line(line_number);
     if(interp_error) return;
     PyObject *result =
@@ -240,6 +1093,12 @@ void STRAIGHT_TRAVERSE(int line_number,
     _pos_a=a; _pos_b=b; _pos_c=c;
     _pos_u=u; _pos_v=v; _pos_w=w;
     if(metric) { x /= 25.4; y /= 25.4; z /= 25.4; u /= 25.4; v /= 25.4; w /= 25.4; }
+    if(preview) {
+        if(interp_error) return;
+        double pt[9] = {x, y, z, a, b, c, u, v, w};
+        if(!preview_straight_traverse(preview, line_number, pt)) interp_error ++;
+        return;
+    }
     maybe_new_line(line_number);
     if(interp_error) return;
     PyObject *result =
@@ -475,6 +1334,12 @@ void STRAIGHT_PROBE(int line_number,
     _pos_a=a; _pos_b=b; _pos_c=c;
     _pos_u=u; _pos_v=v; _pos_w=w;
     if(metric) { x /= 25.4; y /= 25.4; z /= 25.4; u /= 25.4; v /= 25.4; w /= 25.4; }
+    if(preview) {
+        if(interp_error) return;
+        double pt[9] = {x, y, z, a, b, c, u, v, w};
+        if(!preview_straight_feed(preview, line_number, pt)) interp_error ++;
+        return;
+    }
     maybe_new_line(line_number);
     if(interp_error) return;
     PyObject *result =
@@ -487,6 +1352,11 @@ void STRAIGHT_PROBE(int line_number,
 void RIGID_TAP(int line_number,
                double x, double y, double z) {
     if(metric) { x /= 25.4; y /= 25.4; z /= 25.4; }
+    if(preview) {
+        if(interp_error) return;
+        if(!preview_rigid_tap(preview, line_number, x, y, z)) interp_error ++;
+        return;
+    }
     maybe_new_line(line_number);
     if(interp_error) return;
     PyObject *result =
@@ -685,11 +1555,21 @@ static PyObject *parse_file(PyObject *self, PyObject *args) {
     char *f;
     char *unitcode=0, *initcode=0, *interpname=0;
     int error_line_offset = 0;
-    struct timeval t0, t1;
+    struct timeval t0, t1, tl;
     int wait = 1;
     if(!PyArg_ParseTuple(args, "sO|sss", &f, &callback, &unitcode, &initcode, &interpname))
         return NULL;
 
+    // moves go straight to the canon's preview, if it has one
+    Py_CLEAR(preview);
+    PyObject *p = PyObject_GetAttrString(callback, "preview");
+    if(p && PyObject_TypeCheck(p, &PreviewType)) {
+        preview = (Preview *)p;
+    } else {
+        Py_XDECREF(p);
+        PyErr_Clear();
+    }
+
     if(pinterp) {
         delete pinterp;
         pinterp = 0;
@@ -703,6 +1583,7 @@ static PyObject *parse_file(PyObject *self, PyObject *args) {
         USER_DEFINED_FUNCTION[i] = user_defined_function;
 
     gettimeofday(&t0, NULL);
+    tl = t0;
 
     metric=false;
     interp_error = 0;
@@ -732,12 +1613,20 @@ static PyObject *parse_file(PyObject *self, PyObject *args) {
         result = interp_new.read();
         gettimeofday(&t1, NULL);
         if(t1.tv_sec > t0.tv_sec + wait) {
-            if(check_abort()) return NULL;
+            if(check_abort()) { Py_CLEAR(preview); return NULL; }
             t0 = t1;
         }
         if(!RESULT_OK) break;
         error_line_offset = 0;
         result = interp_new.execute();
+        // moves that go to the preview don't call next_line, so the
+        // canon only hears of the lines that matter to it; still tell
+        // it where we are now and then, for its progress display
+        if(preview && (t1.tv_sec - tl.tv_sec) * 1000000
+                + (t1.tv_usec - tl.tv_usec) > 100000) {
+            maybe_new_line();
+            tl = t1;
+        }
     }
 out_error:
     if(pinterp) pinterp->close();
@@ -746,11 +1635,13 @@ out_error:
             PyErr_Format(PyExc_RuntimeError,
                     "interp_error > 0 but no Python exception set");
         }
+        Py_CLEAR(preview);
         return NULL;
     }
     PyErr_Clear();
     maybe_new_line();
     if(PyErr_Occurred()) { interp_error = 1; goto out_error; }
+    Py_CLEAR(preview);
     PyObject *retval = PyTuple_New(2);
     PyTuple_SetItem(retval, 0, PyInt_FromLong(result));
     PyTuple_SetItem(retval, 1, PyInt_FromLong(last_sequence_number + error_line_offset));
@@ -871,24 +1762,12 @@ static bool get_attr(PyObject *o, const char *attr_name, const char *fmt, ...) {
     return result;
 }
 
-static void unrotate(double &x, double &y, double c, double s) {
-    double tx = x * c + y * s;
-    y = -x * s + y * c;
-    x = tx;
-}
-
-static void rotate(double &x, double &y, double c, double s) {
-    double tx = x * c - y * s;
-    y = x * s + y * c;
-    x = tx;
-}
-
 static PyObject *rs274_arc_to_segments(PyObject *self, PyObject *args) {
     PyObject *canon;
     double x1, y1, cx, cy, z1, a, b, c, u, v, w;
-    double o[9], n[9], g5xoffset[9], g92offset[9];
+    double o[9], g5xoffset[9], g92offset[9];
     int rot, plane;
-    int X, Y, Z;
+    std::vector<double> points;
     double rotation_cos, rotation_sin;
     int max_segments = 128;
 
@@ -919,72 +1798,15 @@ static PyObject *rs274_arc_to_segments(PyObject *self, PyObject *args) {
     if(!get_attr(canon, "g92_offset_v", &g92offset[7])) return NULL;
     if(!get_attr(canon, "g92_offset_w", &g92offset[8])) return NULL;
 
-    if(plane == 1) {
-        X=0; Y=1; Z=2;
-    } else if(plane == 3) {
-        X=2; Y=0; Z=1;
-    } else {
-        X=1; Y=2; Z=0;
-    }
-    n[X] = x1;
-    n[Y] = y1;
-    n[Z] = z1;
-    n[3] = a;
-    n[4] = b;
-    n[5] = c;
-    n[6] = u;
-    n[7] = v;
-    n[8] = w;
-    for(int ax=0; ax<9; ax++) o[ax] -= g5xoffset[ax];
-    unrotate(o[0], o[1], rotation_cos, rotation_sin);
-    for(int ax=0; ax<9; ax++) o[ax] -= g92offset[ax];
-
-    double theta1 = atan2(o[Y]-cy, o[X]-cx);
-    double theta2 = atan2(n[Y]-cy, n[X]-cx);
-
-    if(rot < 0) {
-        while(theta2 - theta1 > -CIRCLE_FUZZ) theta2 -= 2*M_PI;
-    } else {
-        while(theta2 - theta1 < CIRCLE_FUZZ) theta2 += 2*M_PI;
-    }
-
-    // if multi-turn, add the right number of full circles
-    if(rot < -1) theta2 += 2*M_PI*(rot+1);
-    if(rot > 1) theta2 += 2*M_PI*(rot-1);
-
-    int steps = std::max(3, int(max_segments * fabs(theta1 - theta2) / M_PI));
-    double rsteps = 1. / steps;
+    int steps = arc_to_points(o, x1, y1, cx, cy, rot, z1, a, b, c, u, v, w,
+            plane, rotation_cos, rotation_sin, g5xoffset, g92offset,
+            max_segments, points);
     PyObject *segs = PyList_New(steps);
-
-    double dtheta = theta2 - theta1;
-    double d[9] = {0, 0, 0, n[3]-o[3], n[4]-o[4], n[5]-o[5], n[6]-o[6], n[7]-o[7], n[8]-o[8]};
-    d[Z] = n[Z] - o[Z];
-
-    double tx = o[X] - cx, ty = o[Y] - cy, dc = cos(dtheta*rsteps), ds = sin(dtheta*rsteps);
-    for(int i=0; i<steps-1; i++) {
-        double f = (i+1) * rsteps;
-        double p[9];
-        rotate(tx, ty, dc, ds);
-        p[X] = tx + cx;
-        p[Y] = ty + cy;
-        p[Z] = o[Z] + d[Z] * f;
-        p[3] = o[3] + d[3] * f;
-        p[4] = o[4] + d[4] * f;
-        p[5] = o[5] + d[5] * f;
-        p[6] = o[6] + d[6] * f;
-        p[7] = o[7] + d[7] * f;
-        p[8] = o[8] + d[8] * f;
-        for(int ax=0; ax<9; ax++) p[ax] += g92offset[ax];
-        rotate(p[0], p[1], rotation_cos, rotation_sin);
-        for(int ax=0; ax<9; ax++) p[ax] += g5xoffset[ax];
+    for(int i=0; i<steps; i++) {
+        double *p = &points[i*9];
         PyList_SET_ITEM(segs, i,
             Py_BuildValue("ddddddddd", p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7], p[8]));
     }
-    for(int ax=0; ax<9; ax++) n[ax] += g92offset[ax];
-    rotate(n[0], n[1], rotation_cos, rotation_sin);
-    for(int ax=0; ax<9; ax++) n[ax] += g5xoffset[ax];
-    PyList_SET_ITEM(segs, steps-1,
-        Py_BuildValue("ddddddddd", n[0], n[1], n[2], n[3], n[4], n[5], n[6], n[7], n[8]));
     return segs;
 }
 
@@ -1005,6 +1827,12 @@ initgcode(void) {
                 "Interface to EMC rs274ngc interpreter");
     PyType_Ready(&LineCodeType);
     PyModule_AddObject(m, "linecode", (PyObject*)&LineCodeType);
+    PyType_Ready(&SegmentsType);
+    Py_INCREF(&SegmentsType);
+    PyModule_AddObject(m, "segments", (PyObject*)&SegmentsType);
+    PyType_Ready(&PreviewType);
+    Py_INCREF(&PreviewType);
+    PyModule_AddObject(m, "preview", (PyObject*)&PreviewType);
     PyObject_SetAttrString(m, "MAX_ERROR", PyInt_FromLong(maxerror));
     PyObject_SetAttrString(m, "MIN_ERROR",
             PyInt_FromLong(INTERP_MIN_ERROR));
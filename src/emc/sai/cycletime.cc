@@ -0,0 +1,381 @@
+/********************************************************************
+* Description: cycletime.cc
+*   Works out how long a G-code program runs, with motion's own
+*   trajectory planner run off line
+*
+*   See cycletime.hh.  tp.c and tc.c are built here as they are for
+*   motmod; the parts of motion they use, the status and debug structs
+*   and a few functions for synched I/O and indexing rotaries, are
+*   defined here for them, standing still and never waiting.
+*
+* License: GPL Version 2
+* System: Linux
+*
+********************************************************************/
+
+#include <math.h>
+#include <string.h>
+#include "posemath.h"
+#include "rtapi.h"
+#include "hal.h"
+#include "motion_types.h"	/* EMC_MOTION_TYPE_* */
+extern "C" {
+#include "tp.h"
+#include "motion.h"
+#include "motion_debug.h"
+#include "mot_priv.h"
+}
+#include "cycletime.hh"
+
+/* moves shorter than this go nowhere, as in emccanon.cc */
+#define TINY 1e-7
+
+/***********************************************************************
+*                      the motion tp.c runs in                         *
+************************************************************************/
+
+static emcmot_status_t status;
+static emcmot_debug_t debug;
+
+extern "C" {
+emcmot_status_t *emcmotStatus = &status;
+emcmot_debug_t *emcmotDebug = &debug;
+int num_dio = EMCMOT_MAX_DIO;
+int num_aio = EMCMOT_MAX_AIO;
+
+void emcmotDioWrite(int index, char value)
+{
+}
+
+void emcmotAioWrite(int index, double value)
+{
+}
+
+void emcmotSetRotaryUnlock(int axis, int unlock)
+{
+}
+
+int emcmotGetRotaryIsUnlocked(int axis)
+{
+    return 1;
+}
+}
+
+#define tp (&debug.queue)
+
+/***********************************************************************/
+
+static inline double axis(const EmcPose &p, int n)
+{
+    switch (n) {
+    case 0: return p.tran.x;
+    case 1: return p.tran.y;
+    case 2: return p.tran.z;
+    case 3: return p.a;
+    case 4: return p.b;
+    case 5: return p.c;
+    case 6: return p.u;
+    case 7: return p.v;
+    default: return p.w;
+    }
+}
+
+CycleTimeReport::CycleTimeReport()
+{
+    time = dwell_time = 0;
+    moves = cycles = 0;
+    feed_length = traverse_length = 0;
+    peak_speed = 0;
+}
+
+CycleTime::CycleTime(const PreflightConfig &config, double period_) :
+    cfg(config), period(period_), pos(config.start),
+    trace_file(NULL), trace_interval(0), trace_next(0), trace_scale(1)
+{
+    memset(&status, 0, sizeof(status));
+    memset(&debug, 0, sizeof(debug));
+    status.net_feed_scale = 1.0;
+    status.spindle_is_atspeed = 1;
+
+    /* as motion.c and initraj.cc set it up */
+    tpCreate(tp, DEFAULT_TC_QUEUE_SIZE, debug.queueTcSpace);
+    tpSetCycleTime(tp, period);
+    tpSetPos(tp, pos);
+    tpSetVlimit(tp, cfg.traj_max_velocity > 0 ? cfg.traj_max_velocity : 1e99);
+}
+
+CycleTime::~CycleTime()
+{
+}
+
+/***********************************************************************
+*                        moves from the canon                          *
+************************************************************************/
+
+void CycleTime::traverse(int line, const EmcPose &end)
+{
+    straight(line, end, EMC_MOTION_TYPE_TRAVERSE, 0, 0);
+}
+
+void CycleTime::feed(int line, const EmcPose &end,
+		     double linear, double angular)
+{
+    straight(line, end, EMC_MOTION_TYPE_FEED, linear, angular);
+}
+
+/* the velocity and acceleration of a straight move, as
+   getStraightVelocity() and getStraightAcceleration() work them out,
+   and for a traverse the velocity is the limit */
+void CycleTime::straight(int line, const EmcPose &end, int type,
+			 double linear, double angular)
+{
+    double d[PREFLIGHT_MAX_JOINTS], tv = 0, ta = 0, t, length;
+    double vel, ini_maxvel, acc;
+    bool cartesian, angular_move;
+    int n;
+
+    for (n = 0; n < PREFLIGHT_MAX_JOINTS; n++) {
+	d[n] = fabs(axis(end, n) - axis(pos, n));
+	if (!(cfg.axis_mask & (1 << n)) || d[n] < TINY)
+	    d[n] = 0;
+    }
+    cartesian = d[0] || d[1] || d[2] || d[6] || d[7] || d[8];
+    angular_move = d[3] || d[4] || d[5];
+    if (!cartesian && !angular_move) {
+	pos = end;
+	return;
+    }
+    if (d[0] || d[1] || d[2])
+	length = sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    else if (cartesian)
+	length = sqrt(d[6] * d[6] + d[7] * d[7] + d[8] * d[8]);
+    else
+	length = sqrt(d[3] * d[3] + d[4] * d[4] + d[5] * d[5]);
+
+    for (n = 0; n < PREFLIGHT_MAX_JOINTS; n++) {
+	if (!d[n])
+	    continue;
+	t = d[n] / cfg.max_velocity[n];
+	if (t > tv)
+	    tv = t;
+	t = d[n] / cfg.max_acceleration[n];
+	if (t > ta)
+	    ta = t;
+    }
+    vel = ini_maxvel = length / tv;
+    acc = length / ta;
+    if (type != EMC_MOTION_TYPE_TRAVERSE) {
+	double req = cartesian ? linear : angular;
+	if (vel > req)
+	    vel = req;
+    }
+
+    pos = end;
+    if (vel <= 0 || acc <= 0)
+	return;
+    while (tcqFull(&tp->queue))
+	cycle();
+    tpSetId(tp, line);
+    tpAddLine(tp, end, type, vel, ini_maxvel, acc, 0, 0, -1);
+    queued(line, type);
+}
+
+/* the velocity and acceleration of an arc, as ARC_FEED() in emccanon.cc
+   works them out: the axes of the plane at the slower one's limits, and
+   no faster than their acceleration allows around the circle */
+void CycleTime::arc(int line, const EmcPose &end,
+		    const PM_CARTESIAN &center, const PM_CARTESIAN &normal,
+		    int turn, double linear, double angular)
+{
+    PmCircle circle;
+    PmPose start_xyz, end_xyz;
+    PmCartesian c, nv;
+    PmQuaternion identity = { 1.0, 0.0, 0.0, 0.0 };
+    double v1, v2, a1, a2, circ_maxvel, circ_acc, axial_maxvel = 0;
+    double ini_maxvel, vel, acc, angle, axis_len, helical_length;
+    double tmax, t;
+    int first, second, axial, n, turns;
+
+    c.x = center.x;
+    c.y = center.y;
+    c.z = center.z;
+    nv.x = normal.x;
+    nv.y = normal.y;
+    nv.z = normal.z;
+    start_xyz.tran = pos.tran;
+    start_xyz.rot = identity;
+    end_xyz.tran = end.tran;
+    end_xyz.rot = identity;
+    if (pmCircleInit(&circle, start_xyz, end_xyz, c, nv, turn) != 0) {
+	pos = end;
+	return;
+    }
+
+    if (fabs(normal.z) > 0.5) {
+	first = 0; second = 1; axial = 2;	/* G17 */
+    } else if (fabs(normal.x) >= fabs(normal.y)) {
+	first = 1; second = 2; axial = 0;	/* G19 */
+    } else {
+	first = 0; second = 2; axial = 1;	/* G18 */
+    }
+    pmCartMag(circle.rHelix, &axis_len);
+    /* emccanon.cc takes the angle within one turn */
+    turns = turn < 0 ? -1 - turn : turn;
+    angle = circle.angle - turns * 2.0 * M_PI;
+    helical_length = sqrt(pow(angle * circle.radius, 2) + axis_len * axis_len);
+
+    v1 = cfg.max_velocity[first];
+    v2 = cfg.max_velocity[second];
+    a1 = cfg.max_acceleration[first];
+    a2 = cfg.max_acceleration[second];
+    circ_maxvel = ini_maxvel = v1 < v2 ? v1 : v2;
+    circ_acc = acc = a1 < a2 ? a1 : a2;
+    if ((cfg.axis_mask & (1 << axial)) && axis_len > 0.001) {
+	axial_maxvel = cfg.max_velocity[axial];
+	if (axial_maxvel < ini_maxvel)
+	    ini_maxvel = axial_maxvel;
+	if (cfg.max_acceleration[axial] < acc)
+	    acc = cfg.max_acceleration[axial];
+    }
+
+    v1 = sqrt(circ_acc * circle.radius);
+    if (v1 < circ_maxvel)
+	circ_maxvel = v1;
+    tmax = fabs(angle * circle.radius / circ_maxvel);
+    if (axial_maxvel && axis_len / axial_maxvel > tmax)
+	tmax = axis_len / axial_maxvel;
+    for (n = 3; n < PREFLIGHT_MAX_JOINTS; n++) {
+	double d = fabs(axis(end, n) - axis(pos, n));
+	if ((cfg.axis_mask & (1 << n)) && d &&
+	    (t = d / cfg.max_velocity[n]) > tmax)
+	    tmax = t;
+    }
+    vel = linear;
+    if (tmax > 0) {
+	ini_maxvel = helical_length / tmax;
+	if (ini_maxvel < vel)
+	    vel = ini_maxvel;
+    }
+
+    tmax = helical_length / acc;
+    for (n = 3; n < PREFLIGHT_MAX_JOINTS; n++) {
+	double d = fabs(axis(end, n) - axis(pos, n));
+	if ((cfg.axis_mask & (1 << n)) && d &&
+	    (t = d / cfg.max_acceleration[n]) > tmax)
+	    tmax = t;
+    }
+    if (tmax > 0)
+	acc = helical_length / tmax;
+
+    pos = end;
+    if (vel <= 0 || acc <= 0)
+	return;
+    while (tcqFull(&tp->queue))
+	cycle();
+    tpSetId(tp, line);
+    tpAddCircle(tp, end, c, nv, turn, EMC_MOTION_TYPE_ARC,
+		vel, ini_maxvel, acc, 0, 0);
+    queued(line, EMC_MOTION_TYPE_ARC);
+}
+
+/* counts the move tp.c just queued */
+void CycleTime::queued(int line, int type)
+{
+    TC_STRUCT *tc = tcqItem(&tp->queue, tcqLen(&tp->queue) - 1, 0);
+
+    if (!tc)
+	return;
+    rep.moves++;
+    if (type == EMC_MOTION_TYPE_TRAVERSE)
+	rep.traverse_length += tc->target;
+    else
+	rep.feed_length += tc->target;
+}
+
+void CycleTime::dwell(int line, double seconds)
+{
+    double end;
+
+    drain();
+    if (seconds <= 0)
+	return;
+    end = rep.time + seconds;
+    while (trace_file && trace_next <= end) {
+	rep.time = trace_next;
+	sample(0, line);
+    }
+    rep.time = end;
+    rep.dwell_time += seconds;
+    if (line >= 0) {
+	if ((size_t) line >= rep.line_time.size())
+	    rep.line_time.resize(line + 1);
+	rep.line_time[line] += seconds;
+    }
+}
+
+void CycleTime::motion_mode(bool exact_stop, double tolerance)
+{
+    tpSetTermCond(tp, exact_stop ? TC_TERM_COND_STOP : TC_TERM_COND_BLEND,
+		  tolerance);
+}
+
+void CycleTime::wait(int line)
+{
+    drain();
+}
+
+void CycleTime::finish()
+{
+    drain();
+}
+
+void CycleTime::trace(FILE *f, double interval, double scale)
+{
+    trace_file = f;
+    trace_scale = scale;
+    trace_interval = interval > period ? interval : period;
+    trace_next = rep.time;
+}
+
+/***********************************************************************
+*                             planning                                 *
+************************************************************************/
+
+/* one trajectory period, as control.c runs it */
+void CycleTime::cycle()
+{
+    double speed;
+    int line;
+
+    tpRunCycle(tp, (long) (period * 1e9 + 0.5));
+    if (tpIsDone(tp))
+	return;
+    rep.cycles++;
+    rep.time += period;
+    speed = status.current_vel;
+    if (speed > rep.peak_speed)
+	rep.peak_speed = speed;
+    line = tpGetExecId(tp);
+    if (line >= 0) {
+	if ((size_t) line >= rep.line_time.size())
+	    rep.line_time.resize(line + 1);
+	rep.line_time[line] += period;
+    }
+    if (trace_file && rep.time >= trace_next)
+	sample(speed, line);
+}
+
+/* runs the queue until motion is done with it, as the program does
+   before it goes on from a wait */
+void CycleTime::drain()
+{
+    while (!tpIsDone(tp))
+	cycle();
+}
+
+void CycleTime::sample(double speed, int line)
+{
+    fprintf(trace_file, "%.4f %.4f %d\n", rep.time, speed * trace_scale,
+	    line);
+    trace_next += trace_interval;
+}
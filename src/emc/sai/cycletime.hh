@@ -0,0 +1,83 @@
+/********************************************************************
+* Description: cycletime.hh
+*   Works out how long a G-code program runs, with motion's own
+*   trajectory planner run off line
+*
+* License: GPL Version 2
+* System: Linux
+*
+********************************************************************/
+
+#ifndef CYCLETIME_HH
+#define CYCLETIME_HH
+
+#include <stdio.h>
+#include <vector>
+#include "saicanon.hh"
+#include "preflight.hh"		/* PreflightConfig */
+
+struct CycleTimeReport {
+    double time;		/* run time, s */
+    double dwell_time;
+    long moves;
+    long cycles;		/* trajectory periods planned */
+    double feed_length, traverse_length;	/* mm */
+    double peak_speed;		/* tool speed, mm/s */
+    std::vector<double> line_time;	/* s, by line number */
+
+    CycleTimeReport();
+};
+
+/* Gets the moves from the canon, through _sai_motion, works out their
+   velocity and acceleration limits the way emccanon.cc does, and queues
+   them in tp.c, which is run a trajectory period at a time, as motion
+   runs it, with nothing paused, overridden or waiting for the spindle.
+   The time of a period goes to the line of the move motion reports as
+   executing.
+
+   tp.c keeps some of its state in globals, and so does this, for the
+   motion status tp.c works with: only one CycleTime can be in use at a
+   time in a process. */
+class CycleTime : public SaiMotion {
+public:
+    /* period is motion's trajectory period, in s */
+    CycleTime(const PreflightConfig &config, double period);
+    virtual ~CycleTime();
+
+    virtual void traverse(int line, const EmcPose &end);
+    virtual void feed(int line, const EmcPose &end,
+		      double linear, double angular);
+    virtual void arc(int line, const EmcPose &end,
+		     const PM_CARTESIAN &center, const PM_CARTESIAN &normal,
+		     int turn, double linear, double angular);
+    virtual void dwell(int line, double seconds);
+    virtual void motion_mode(bool exact_stop, double tolerance);
+    virtual void wait(int line);
+
+    /* runs whatever is still queued */
+    void finish();
+
+    /* writes a line to f every interval, from then on: the time, the
+       tool speed times scale and the line executing */
+    void trace(FILE *f, double interval, double scale = 1.0);
+
+    const CycleTimeReport &report() const { return rep; }
+
+private:
+    void straight(int line, const EmcPose &end, int type,
+		  double linear, double angular);
+    void queued(int line, int type);
+    void cycle();
+    void drain();
+    void sample(double speed, int line);
+
+    PreflightConfig cfg;
+    double period;
+    CycleTimeReport rep;
+    EmcPose pos;
+
+    FILE *trace_file;
+    double trace_interval, trace_next, trace_scale;
+};
+
+#endif
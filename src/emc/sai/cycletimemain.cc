@@ -0,0 +1,143 @@
+/********************************************************************
+* Description: cycletimemain.cc
+*   Runs G-code programs through the interpreter and motion's
+*   trajectory planner, off line, and reports how long each would run:
+*   rs274-cycletime
+*
+*   The programs are run in parallel, as many at a time as there are
+*   processors, and the reports come out in the order the programs were
+*   given.
+*
+* License: GPL Version 2
+* System: Linux
+*
+********************************************************************/
+
+#include "canon.hh"		// _parameter_file_name
+#include "saibatch.hh"
+#include "cycletime.hh"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libgen.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+struct Options {
+    SaiMachine machine;
+    double period;
+    bool lines;
+    const char *trace_dir;
+    double trace_interval;
+};
+
+/* Runs one program, in a child process, and writes the report to out.
+   Returns 0 if it ran to the end, 1 on an interpreter error, 2 if it
+   couldn't be run. */
+static int time_program(const char *file, FILE *out, void *arg)
+{
+    Options &o = *(Options *) arg;
+    SaiMachine &m = o.machine;
+    CycleTime cycletime(m.cfg, o.period);
+    const CycleTimeReport &rep = cycletime.report();
+    FILE *trace = NULL;
+    std::string error;
+    int status, line = 0, minutes;
+    size_t n;
+
+    if (o.trace_dir) {
+	std::string name(file);
+	name = std::string(o.trace_dir) + "/" +
+	    basename(&name[0]) + ".trace";
+	trace = fopen(name.c_str(), "w");
+	if (!trace) {
+	    fprintf(out, "%s: can't write %s\n", file, name.c_str());
+	    return 2;
+	}
+	cycletime.trace(trace, o.trace_interval, m.units[0]);
+    }
+
+    _sai_motion = &cycletime;
+    status = sai_run_program(file, line, error);
+    if (status < 0) {
+	fprintf(out, "%s: can't open\n", file);
+	return 2;
+    }
+    cycletime.finish();
+    _sai_motion = NULL;
+    if (trace)
+	fclose(trace);
+
+    minutes = (int) (rep.time / 60);
+    fprintf(out, "%s: %d:%05.2f (%.3f s, %.3f s dwell), %ld moves\n",
+	    file, minutes, rep.time - minutes * 60, rep.time, rep.dwell_time,
+	    rep.moves);
+    if (status > 0)
+	fprintf(out, "  error on line %d: %s\n", line, error.c_str());
+    fprintf(out, "  feed %.4f, traverse %.4f, peak speed %.4f/s\n",
+	    rep.feed_length * m.units[0], rep.traverse_length * m.units[0],
+	    rep.peak_speed * m.units[0]);
+    if (o.lines) {
+	for (n = 0; n < rep.line_time.size(); n++)
+	    if (rep.line_time[n] > 0)
+		fprintf(out, "  line %lu: %.3f s\n", (unsigned long) n,
+			rep.line_time[n]);
+    }
+    return status > 0 ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    Options o;
+    const char *inifile = NULL, *tooltable = NULL;
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int parallel = ncpu > 0 ? ncpu : 1;
+    int c, result;
+
+    o.period = 0;
+    o.lines = false;
+    o.trace_dir = NULL;
+    o.trace_interval = 0.01;
+    _parameter_file_name[0] = 0;
+    while ((c = getopt(argc, argv, "i:t:v:j:d:lT:r:")) != -1) {
+	switch (c) {
+	case 'i': inifile = optarg; break;
+	case 't': tooltable = optarg; break;
+	case 'v': snprintf(_parameter_file_name, PARAMETER_FILE_NAME_LENGTH,
+			   "%s", optarg); break;
+	case 'j': parallel = atoi(optarg); break;
+	case 'd': o.period = atof(optarg); break;
+	case 'l': o.lines = true; break;
+	case 'T': o.trace_dir = optarg; break;
+	case 'r': o.trace_interval = atof(optarg); break;
+	default: goto usage;
+	}
+    }
+    if (!inifile || optind >= argc || parallel < 1 || o.period < 0 ||
+	o.trace_interval <= 0) {
+usage:
+	fprintf(stderr,
+		"Usage: %s -i file.ini [-t tool.tbl] [-v file.var] [-j jobs]\n"
+		"          [-d period] [-l] [-T dir [-r interval]] file.ngc...\n",
+		argv[0]);
+	exit(2);
+    }
+
+    if (sai_read_ini(inifile, o.machine) != 0 ||
+	sai_load_kins(inifile, NULL, std::vector<std::string>(),
+		      o.machine) != 0)
+	exit(2);
+    sai_find_start(o.machine);
+    if (!o.period)
+	o.period = o.machine.traj_period > 0 ? o.machine.traj_period : 0.001;
+    if (sai_init_interp(inifile, tooltable) != 0)
+	exit(2);
+
+    result = sai_run_jobs(argv + optind, argc - optind, parallel,
+			  time_program, &o);
+    if (o.machine.kins)
+	userkins_unload(o.machine.kins);
+    exit(result);
+}
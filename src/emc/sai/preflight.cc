@@ -0,0 +1,547 @@
+/********************************************************************
+* Description: preflight.cc
+*   Checks the motion of a G-code program against the machine's limits,
+*   and estimates how long it runs, without the machine
+*
+*   See preflight.hh.  Velocity and acceleration limits for a move are
+*   worked out as in emccanon.cc, and the queue is planned like
+*   motion's: the end of the queue is taken to be a stop, so moves are
+*   only run once the queue is long enough that nothing added later
+*   could let them go faster.
+*
+* License: GPL Version 2
+* System: Linux
+*
+********************************************************************/
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "preflight.hh"
+
+/* motion's DEFAULT_TC_QUEUE_SIZE */
+#define QUEUE_SIZE 2000
+
+/* moves shorter than this go nowhere, as in emccanon.cc */
+#define TINY 1e-7
+
+static inline double &axis(EmcPose &p, int n)
+{
+    switch (n) {
+    case 0: return p.tran.x;
+    case 1: return p.tran.y;
+    case 2: return p.tran.z;
+    case 3: return p.a;
+    case 4: return p.b;
+    case 5: return p.c;
+    case 6: return p.u;
+    case 7: return p.v;
+    default: return p.w;
+    }
+}
+
+static inline double axis(const EmcPose &p, int n)
+{
+    return axis(const_cast<EmcPose &>(p), n);
+}
+
+PreflightConfig::PreflightConfig()
+{
+    int n;
+
+    joints = 3;
+    axis_mask = 0x7;
+    for (n = 0; n < PREFLIGHT_MAX_JOINTS; n++) {
+	min_limit[n] = -1e99;
+	max_limit[n] = 1e99;
+	max_velocity[n] = 1.0;
+	max_acceleration[n] = 1.0;
+	home[n] = 0;
+    }
+    traj_max_velocity = 0;
+    cycle_time = 0.001;
+    memset(&start, 0, sizeof(start));
+}
+
+PreflightReport::PreflightReport()
+{
+    violations = 0;
+    first_line = 0;
+    time = dwell_time = 0;
+    moves = 0;
+    feed_length = traverse_length = 0;
+    peak_speed = 0;
+    memset(peak_velocity, 0, sizeof(peak_velocity));
+    memset(peak_acceleration, 0, sizeof(peak_acceleration));
+}
+
+Preflight::Preflight(const PreflightConfig &config, userkins_t *kins_) :
+    cfg(config), kins(kins_), pos(config.start), exact_stop(false),
+    tolerance(0), clock(0), have_last(false)
+{
+    memset(last_joints, 0, sizeof(last_joints));
+    queue.reserve(QUEUE_SIZE + 1);
+}
+
+Preflight::~Preflight()
+{
+}
+
+/***********************************************************************
+*                        moves from the canon                          *
+************************************************************************/
+
+void Preflight::traverse(int line, const EmcPose &end)
+{
+    Move m;
+
+    m.line = line;
+    m.traverse = true;
+    m.circular = false;
+    m.start = pos;
+    m.end = end;
+    add(m, 0, 0);
+}
+
+void Preflight::feed(int line, const EmcPose &end,
+		     double linear, double angular)
+{
+    Move m;
+
+    m.line = line;
+    m.traverse = false;
+    m.circular = false;
+    m.start = pos;
+    m.end = end;
+    add(m, linear, angular);
+}
+
+void Preflight::arc(int line, const EmcPose &end,
+		    const PM_CARTESIAN &center, const PM_CARTESIAN &normal,
+		    int turn, double linear, double angular)
+{
+    Move m;
+    PmPose start_xyz, end_xyz;
+    PmCartesian c, n;
+    PmQuaternion identity = { 1.0, 0.0, 0.0, 0.0 };
+
+    m.line = line;
+    m.traverse = false;
+    m.circular = true;
+    m.start = pos;
+    m.end = end;
+    start_xyz.tran = pos.tran;
+    start_xyz.rot = identity;
+    end_xyz.tran = end.tran;
+    end_xyz.rot = identity;
+    c.x = center.x;
+    c.y = center.y;
+    c.z = center.z;
+    n.x = normal.x;
+    n.y = normal.y;
+    n.z = normal.z;
+    pmCircleInit(&m.circle, start_xyz, end_xyz, c, n, turn);
+    add(m, linear, angular);
+}
+
+void Preflight::dwell(int line, double seconds)
+{
+    plan(true);
+    if (seconds > 0) {
+	rep.time += seconds;
+	rep.dwell_time += seconds;
+	clock += seconds;
+    }
+}
+
+void Preflight::motion_mode(bool exact, double tol)
+{
+    exact_stop = exact;
+    tolerance = tol;
+}
+
+void Preflight::wait(int line)
+{
+    plan(true);
+}
+
+void Preflight::finish()
+{
+    plan(true);
+}
+
+void Preflight::error(int line, const std::string &text)
+{
+    plan(true);
+    violation(line, "%s", text.c_str());
+}
+
+void Preflight::violation(int line, const char *fmt, ...)
+{
+    char text[256];
+    va_list ap;
+
+    if (rep.violations++)
+	return;
+    va_start(ap, fmt);
+    vsnprintf(text, sizeof(text), fmt, ap);
+    va_end(ap);
+    rep.first_line = line;
+    rep.first = text;
+}
+
+/***********************************************************************
+*                             planning                                 *
+************************************************************************/
+
+/* the speed and acceleration the move's axes allow, as
+   getStraightVelocity() and friends in emccanon.cc work them out */
+void Preflight::limits(Move &m, double linear, double angular)
+{
+    double d[PREFLIGHT_MAX_JOINTS], tv = 0, ta = 0, t;
+    double xyz, uvw, abc;
+    bool cartesian, angular_only;
+    int n;
+
+    for (n = 0; n < PREFLIGHT_MAX_JOINTS; n++) {
+	d[n] = fabs(axis(m.end, n) - axis(m.start, n));
+	if (!(cfg.axis_mask & (1 << n)) || d[n] < TINY)
+	    d[n] = 0;
+    }
+    xyz = sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    uvw = sqrt(d[6] * d[6] + d[7] * d[7] + d[8] * d[8]);
+    abc = sqrt(d[3] * d[3] + d[4] * d[4] + d[5] * d[5]);
+
+    if (m.circular) {
+	/* the axes of the plane move as fast as the tool, along the
+	   axis of the helix and the others only in proportion */
+	double h;
+
+	pmCartMag(m.circle.rHelix, &h);
+	m.length = sqrt(pow(m.circle.angle * m.circle.radius, 2) + h * h);
+	for (n = 0; n < 3; n++) {
+	    double normal = n == 0 ? m.circle.normal.x :
+		n == 1 ? m.circle.normal.y : m.circle.normal.z;
+	    if (fabs(normal) < 0.999 || (h > 0.001 && d[n] > 0))
+		d[n] = m.length;
+	}
+    } else if (xyz > 0) {
+	m.length = xyz;
+    } else if (uvw > 0) {
+	m.length = uvw;
+    } else {
+	m.length = abc;
+    }
+    cartesian = xyz > 0 || uvw > 0 || m.circular;
+    angular_only = !cartesian && abc > 0;
+
+    for (n = 0; n < PREFLIGHT_MAX_JOINTS; n++) {
+	if (!d[n])
+	    continue;
+	t = d[n] / cfg.max_velocity[n];
+	if (t > tv)
+	    tv = t;
+	t = d[n] / cfg.max_acceleration[n];
+	if (t > ta)
+	    ta = t;
+    }
+    m.maxvel = tv > 0 ? m.length / tv : 0;
+    m.maxaccel = ta > 0 ? m.length / ta : 0;
+    if (!m.traverse) {
+	double req = angular_only ? angular : linear;
+	if (req < m.maxvel)
+	    m.maxvel = req;
+    }
+    if (cartesian && cfg.traj_max_velocity > 0 &&
+	cfg.traj_max_velocity < m.maxvel)
+	m.maxvel = cfg.traj_max_velocity;
+}
+
+void Preflight::add(Move &m, double linear, double angular)
+{
+    limits(m, linear, angular);
+    pos = m.end;
+    if (m.length < TINY)
+	return;
+    if (m.maxvel <= 0 || m.maxaccel <= 0) {
+	plan(true);
+	violation(m.line, "%s move on line %d has no velocity or "
+		  "acceleration", m.traverse ? "Rapid" : "Feed", m.line);
+	return;
+    }
+
+    /* the most the move can start at, from the corner with the last:
+       the blend turns the tool through the corner at about
+       v cos(theta/2), and with a tolerance, no faster than the arc of
+       that deviation allows at the move's acceleration */
+    m.blend = 0;
+    if (!exact_stop && !queue.empty()) {
+	const Move &last = queue.back();
+	PmCartesian u1, u2;
+	double c, half, v;
+
+	direction(last, true, u1);
+	direction(m, false, u2);
+	pmCartCartDot(u1, u2, &c);
+	if (c > 1)
+	    c = 1;
+	half = sqrt((1 + c) / 2);
+	v = last.maxvel < m.maxvel ? last.maxvel : m.maxvel;
+	m.blend = v * half;
+	if (tolerance > 0 && half < 1) {
+	    double r = tolerance * half / (1 - half);
+	    double a = last.maxaccel < m.maxaccel ? last.maxaccel : m.maxaccel;
+	    if (sqrt(a * r) < m.blend)
+		m.blend = sqrt(a * r);
+	}
+    }
+    queue.push_back(m);
+    if (queue.size() >= QUEUE_SIZE)
+	plan(false);
+}
+
+/* Plans the queue as if it ended in a stop, then runs all of it if it
+   really does, or else the first half, whose speeds can't be raised by
+   anything added later. */
+void Preflight::plan(bool stop)
+{
+    long n = queue.size(), k, run_to;
+    double v;
+
+    if (!n)
+	return;
+
+    /* backward: fast enough to stop in time for the next move */
+    queue[n - 1].vend = 0;
+    for (k = n - 1; k >= 0; k--) {
+	Move &m = queue[k];
+	v = sqrt(m.vend * m.vend + 2 * m.maxaccel * m.length);
+	if (v > m.maxvel)
+	    v = m.maxvel;
+	if (k > 0 && v > m.blend)
+	    v = m.blend;
+	m.vstart = v;
+	if (k > 0) {
+	    queue[k - 1].vend = v < queue[k - 1].maxvel ? v : queue[k - 1].maxvel;
+	}
+    }
+
+    /* forward: no faster than it can get up to from the start, which
+       is wherever the last run left the first move */
+    if (queue[0].vstart > queue[0].blend)
+	queue[0].vstart = queue[0].blend;
+    v = queue[0].vstart;
+    for (k = 0; k < n; k++) {
+	Move &m = queue[k];
+	if (m.vstart > v)
+	    m.vstart = v;
+	v = sqrt(m.vstart * m.vstart + 2 * m.maxaccel * m.length);
+	if (m.vend > v)
+	    m.vend = v;
+	v = m.vend;
+    }
+
+    run_to = stop ? n : n / 2;
+    for (k = 0; k < run_to; k++)
+	run(queue[k]);
+    queue.erase(queue.begin(), queue.begin() + run_to);
+
+    /* what is left starts at the speed the last run move ended at */
+    if (!queue.empty())
+	queue[0].blend = queue[0].vstart;
+}
+
+/***********************************************************************
+*                        running and sampling                          *
+************************************************************************/
+
+void Preflight::point(const Move &m, double s, EmcPose &p) const
+{
+    double f = m.length > 0 ? s / m.length : 1;
+    int n;
+
+    for (n = 0; n < PREFLIGHT_MAX_JOINTS; n++)
+	axis(p, n) = axis(m.start, n) + f * (axis(m.end, n) - axis(m.start, n));
+    if (m.circular) {
+	PmPose xyz;
+	pmCirclePoint(const_cast<PmCircle *>(&m.circle),
+		      f * m.circle.angle, &xyz);
+	p.tran = xyz.tran;
+    }
+}
+
+/* the way the move heads at its start or end, in all nine axes,
+   with the rotary ones counted in degrees as if they were mm */
+void Preflight::direction(const Move &m, bool end, PmCartesian &dir) const
+{
+    EmcPose a, b;
+    double e = m.length * 1e-6, mag = 0, d[PREFLIGHT_MAX_JOINTS];
+    int n;
+
+    point(m, end ? m.length - e : 0, a);
+    point(m, end ? m.length : e, b);
+    for (n = 0; n < PREFLIGHT_MAX_JOINTS; n++) {
+	d[n] = axis(b, n) - axis(a, n);
+	mag += d[n] * d[n];
+    }
+    mag = sqrt(mag);
+    if (mag <= 0)
+	mag = 1;
+    /* fold the nine into three for the dot product: the xyz part
+       carries the corner, the others only add to it */
+    dir.x = (d[0] + d[6]) / mag;
+    dir.y = (d[1] + d[7]) / mag;
+    dir.z = (d[2] + d[8]) / mag;
+    if (!d[0] && !d[1] && !d[2] && !d[6] && !d[7] && !d[8]) {
+	dir.x = d[3] / mag;
+	dir.y = d[4] / mag;
+	dir.z = d[5] / mag;
+    }
+}
+
+/* Runs the move along its trapezoid, at the planned start and end
+   speeds, and samples it every cycle_time. */
+void Preflight::run(const Move &m)
+{
+    double v0 = m.vstart, v1 = m.vend, a = m.maxaccel, L = m.length;
+    double vc, d1, d3, t1, t2, t3, T, t, s;
+    long k, n;
+
+    vc = sqrt((2 * a * L + v0 * v0 + v1 * v1) / 2);
+    if (vc > m.maxvel)
+	vc = m.maxvel;
+    if (vc < v0)
+	vc = v0;
+    if (vc < v1)
+	vc = v1;
+    d1 = (vc * vc - v0 * v0) / (2 * a);
+    d3 = (vc * vc - v1 * v1) / (2 * a);
+    if (d1 + d3 > L) {
+	/* rounding; there is no cruise */
+	d1 = L * d1 / (d1 + d3);
+	d3 = L - d1;
+    }
+    t1 = (vc - v0) / a;
+    t3 = (vc - v1) / a;
+    t2 = vc > 0 ? (L - d1 - d3) / vc : 0;
+    T = t1 + t2 + t3;
+
+    rep.moves++;
+    rep.time += T;
+    if (m.traverse)
+	rep.traverse_length += L;
+    else
+	rep.feed_length += L;
+    if (vc > rep.peak_speed)
+	rep.peak_speed = vc;
+
+    n = (long) ceil(T / cfg.cycle_time);
+    if (n < 1)
+	n = 1;
+    if ((long) world.size() < n + 1) {
+	world.resize(n + 1);
+	times.resize(n + 1);
+	joints.resize((n + 1) * PREFLIGHT_MAX_JOINTS);
+	status.resize(n + 1);
+    }
+    for (k = 0; k <= n; k++) {
+	t = T * k / n;
+	if (t < t1)
+	    s = v0 * t + a * t * t / 2;
+	else if (t < t1 + t2)
+	    s = d1 + vc * (t - t1);
+	else {
+	    double tt = t - t1 - t2;
+	    s = L - d3 + vc * tt - a * tt * tt / 2;
+	}
+	if (s > L || k == n)
+	    s = L;
+	point(m, s, world[k]);
+	times[k] = clock + t;
+    }
+    clock += T;
+    sample(m, &times[0], n + 1);
+}
+
+void Preflight::sample(const Move &m, const double *t, long n)
+{
+    int nj = cfg.joints, j;
+    double *q = &joints[0], v, acc;
+    double vel[PREFLIGHT_MAX_JOINTS], lastvel[PREFLIGHT_MAX_JOINTS];
+    bool have_vel = false, unreachable = false;
+    bool over_pos[PREFLIGHT_MAX_JOINTS], over_vel[PREFLIGHT_MAX_JOINTS];
+    const char *type = m.traverse ? "Rapid" : m.circular ? "Circular" :
+	"Linear";
+    long k;
+
+    memset(over_pos, 0, sizeof(over_pos));
+    memset(over_vel, 0, sizeof(over_vel));
+    if (kins) {
+	memcpy(q, last_joints, nj * sizeof(double));
+	userkins_inverse(kins, &world[0], q, nj, n, &status[0]);
+    } else {
+	for (k = 0; k < n; k++) {
+	    for (j = 0; j < nj; j++)
+		q[k * nj + j] = axis(world[k], j);
+	    status[k] = 0;
+	}
+    }
+
+    /* the first point is where the last move ended, checked already */
+    for (k = have_last ? 1 : 0; k < n; k++) {
+	double *qk = q + k * nj;
+
+	if (status[k] != 0) {
+	    if (!unreachable)
+		violation(m.line, "%s move on line %d can't be reached "
+			  "by the kinematics", type, m.line);
+	    unreachable = true;
+	    have_vel = false;
+	    continue;
+	}
+	for (j = 0; j < nj; j++) {
+	    if (over_pos[j])
+		continue;
+	    if (qk[j] > cfg.max_limit[j] + TINY) {
+		violation(m.line, "%s move on line %d would exceed joint "
+			  "%d's positive limit (%.4f > %.4f)", type, m.line,
+			  j, qk[j], cfg.max_limit[j]);
+		over_pos[j] = true;
+	    } else if (qk[j] < cfg.min_limit[j] - TINY) {
+		violation(m.line, "%s move on line %d would exceed joint "
+			  "%d's negative limit (%.4f < %.4f)", type, m.line,
+			  j, qk[j], cfg.min_limit[j]);
+		over_pos[j] = true;
+	    }
+	}
+	if (k == 0 || status[k - 1] != 0)
+	    continue;
+
+	/* velocity from one sample to the next, and acceleration from
+	   one velocity to the next within the move: where the plan
+	   carries speed through a corner the velocity jumps, which
+	   motion's blend smooths over */
+	for (j = 0; j < nj; j++) {
+	    v = (qk[j] - qk[j - nj]) / (t[k] - t[k - 1]);
+	    vel[j] = v;
+	    if (fabs(v) > rep.peak_velocity[j])
+		rep.peak_velocity[j] = fabs(v);
+	    if (fabs(v) > cfg.max_velocity[j] * 1.001 + TINY && !over_vel[j]) {
+		violation(m.line, "%s move on line %d would exceed joint "
+			  "%d's velocity limit (%.4f > %.4f)", type, m.line,
+			  j, fabs(v), cfg.max_velocity[j]);
+		over_vel[j] = true;
+	    }
+	    if (have_vel) {
+		acc = (v - lastvel[j]) / ((t[k] - t[k - 2]) / 2);
+		if (fabs(acc) > rep.peak_acceleration[j])
+		    rep.peak_acceleration[j] = fabs(acc);
+	    }
+	}
+	memcpy(lastvel, vel, sizeof(vel));
+	have_vel = true;
+    }
+    memcpy(last_joints, q + (n - 1) * nj, nj * sizeof(double));
+    have_last = true;
+}
@@ -0,0 +1,128 @@
+/********************************************************************
+* Description: preflight.hh
+*   Checks the motion of a G-code program against the machine's limits,
+*   and estimates how long it runs, without the machine
+*
+* License: GPL Version 2
+* System: Linux
+*
+********************************************************************/
+
+#ifndef PREFLIGHT_HH
+#define PREFLIGHT_HH
+
+#include <string>
+#include <vector>
+#include "saicanon.hh"
+#include "userkins.h"
+
+#define PREFLIGHT_MAX_JOINTS USERKINS_MAX_JOINTS
+
+/* The machine, from the ini file, in mm and degrees.  Joint n takes its
+   limits from [AXIS_n], and so does axis n (X, Y, Z, A, B, C, U, V, W)
+   when moves are planned, as in motion and emccanon.cc. */
+struct PreflightConfig {
+    int joints;
+    int axis_mask;		/* the axes in [TRAJ]COORDINATES */
+    double min_limit[PREFLIGHT_MAX_JOINTS];
+    double max_limit[PREFLIGHT_MAX_JOINTS];
+    double max_velocity[PREFLIGHT_MAX_JOINTS];
+    double max_acceleration[PREFLIGHT_MAX_JOINTS];
+    double traj_max_velocity;	/* 0 for no limit */
+    double home[PREFLIGHT_MAX_JOINTS];
+    double cycle_time;		/* how finely motion is sampled, s */
+    EmcPose start;		/* where the program starts */
+
+    PreflightConfig();
+};
+
+/* What a run found.  Only the first violation is kept in full, since a
+   program usually goes on violating the same limit once it does. */
+struct PreflightReport {
+    int violations;
+    int first_line;
+    std::string first;
+
+    double time;		/* estimated run time, s */
+    double dwell_time;
+    long moves;
+    double feed_length, traverse_length;	/* mm */
+    double peak_speed;		/* tool speed, mm/s */
+    double peak_velocity[PREFLIGHT_MAX_JOINTS];
+    double peak_acceleration[PREFLIGHT_MAX_JOINTS];
+
+    PreflightReport();
+};
+
+/* Gets the moves from the canon, through _sai_motion, and plans them the
+   way the realtime planner does in outline: each move accelerates and
+   decelerates at the limit of its axes, and in G64 the move's end speed
+   is carried into the next, down to what the corner between them and
+   the blend tolerance allow, with lookahead over a queue as long as
+   motion's.  The path is sampled every cycle_time, mapped to joints with
+   the kinematics module, if any, and the joints are checked against
+   their position and velocity limits. */
+class Preflight : public SaiMotion {
+public:
+    /* kins may be NULL for trivkins, joint n being axis n */
+    Preflight(const PreflightConfig &config, userkins_t *kins);
+    virtual ~Preflight();
+
+    virtual void traverse(int line, const EmcPose &end);
+    virtual void feed(int line, const EmcPose &end,
+		      double linear, double angular);
+    virtual void arc(int line, const EmcPose &end,
+		     const PM_CARTESIAN &center, const PM_CARTESIAN &normal,
+		     int turn, double linear, double angular);
+    virtual void dwell(int line, double seconds);
+    virtual void motion_mode(bool exact_stop, double tolerance);
+    virtual void wait(int line);
+
+    /* plans and checks whatever is still queued */
+    void finish();
+
+    /* an interpreter error ends the run, and counts as a violation */
+    void error(int line, const std::string &text);
+
+    const PreflightReport &report() const { return rep; }
+
+private:
+    struct Move {
+	int line;
+	bool traverse, circular;
+	EmcPose start, end;
+	PmCircle circle;
+	double length;
+	double maxvel, maxaccel;
+	double blend;		/* most speed at the start, from the corner */
+	double vstart, vend;	/* planned */
+    };
+
+    void add(Move &m, double linear, double angular);
+    void limits(Move &m, double linear, double angular);
+    void plan(bool stop);
+    void run(const Move &m);
+    void point(const Move &m, double s, EmcPose &pos) const;
+    void direction(const Move &m, bool end, PmCartesian &dir) const;
+    void sample(const Move &m, const double *t, long n);
+    void violation(int line, const char *fmt, ...);
+
+    PreflightConfig cfg;
+    userkins_t *kins;
+    PreflightReport rep;
+
+    EmcPose pos;
+    bool exact_stop;
+    double tolerance;
+    std::vector<Move> queue;
+
+    /* sampling state, carried from move to move */
+    std::vector<EmcPose> world;
+    std::vector<double> joints, times;
+    std::vector<int> status;
+    double last_joints[PREFLIGHT_MAX_JOINTS];
+    double clock;
+    bool have_last;
+};
+
+#endif
@@ -0,0 +1,119 @@
+/********************************************************************
+* Description: preflightmain.cc
+*   Runs G-code programs through the interpreter, off line, and checks
+*   their motion against the machine's limits: rs274-preflight
+*
+*   The programs are checked in parallel, as many at a time as there
+*   are processors, and the reports come out in the order the programs
+*   were given.
+*
+* License: GPL Version 2
+* System: Linux
+*
+********************************************************************/
+
+#include "canon.hh"		// _parameter_file_name
+#include "saibatch.hh"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+/* Runs one program, in a child process, and writes the report to out.
+   Returns 0 if it checked out, 1 if not, 2 if it couldn't be run. */
+static int check_program(const char *file, FILE *out, void *arg)
+{
+    SaiMachine &m = *(SaiMachine *) arg;
+    Preflight preflight(m.cfg, m.kins);
+    const PreflightReport &rep = preflight.report();
+    std::string error;
+    int status, line = 0, n, minutes;
+
+    _sai_motion = &preflight;
+    status = sai_run_program(file, line, error);
+    if (status < 0) {
+	fprintf(out, "%s: can't open\n", file);
+	return 2;
+    }
+    if (status > 0)
+	preflight.error(line, error);
+    preflight.finish();
+    _sai_motion = NULL;
+
+    if (rep.violations)
+	fprintf(out, "%s: line %d: %s", file, rep.first_line,
+		rep.first.c_str());
+    else
+	fprintf(out, "%s: ok", file);
+    if (rep.violations > 1)
+	fprintf(out, " (and %d more)", rep.violations - 1);
+    minutes = (int) (rep.time / 60);
+    fprintf(out, "\n  time %d:%05.2f (%.3f s, %.3f s dwell), %ld moves\n",
+	    minutes, rep.time - minutes * 60, rep.time, rep.dwell_time,
+	    rep.moves);
+    fprintf(out, "  feed %.4f, traverse %.4f, peak speed %.4f/s\n",
+	    rep.feed_length * m.units[0], rep.traverse_length * m.units[0],
+	    rep.peak_speed * m.units[0]);
+    for (n = 0; n < m.cfg.joints; n++)
+	fprintf(out, "  joint %d: peak velocity %.4f (%.4f), "
+		"acceleration %.4f (%.4f)\n", n,
+		rep.peak_velocity[n] * m.units[n],
+		m.cfg.max_velocity[n] * m.units[n],
+		rep.peak_acceleration[n] * m.units[n],
+		m.cfg.max_acceleration[n] * m.units[n]);
+    return rep.violations ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    SaiMachine machine;
+    std::vector<std::string> sets;
+    const char *inifile = NULL, *kinsname = NULL, *tooltable = NULL;
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int parallel = ncpu > 0 ? ncpu : 1;
+    int c, result;
+
+    _parameter_file_name[0] = 0;
+    while ((c = getopt(argc, argv, "i:t:v:j:k:s:d:")) != -1) {
+	switch (c) {
+	case 'i': inifile = optarg; break;
+	case 't': tooltable = optarg; break;
+	case 'v': snprintf(_parameter_file_name, PARAMETER_FILE_NAME_LENGTH,
+			   "%s", optarg); break;
+	case 'j': parallel = atoi(optarg); break;
+	case 'k': kinsname = optarg; break;
+	case 's':
+	    if (!strchr(optarg, '='))
+		goto usage;
+	    sets.push_back(optarg);
+	    break;
+	case 'd': machine.cfg.cycle_time = atof(optarg); break;
+	default: goto usage;
+	}
+    }
+    if (!inifile || optind >= argc || parallel < 1 ||
+	machine.cfg.cycle_time <= 0) {
+usage:
+	fprintf(stderr,
+		"Usage: %s -i file.ini [-t tool.tbl] [-v file.var] [-j jobs]\n"
+		"          [-k kinematics] [-s pin=value]... [-d period]"
+		" file.ngc...\n", argv[0]);
+	exit(2);
+    }
+
+    if (sai_read_ini(inifile, machine) != 0 ||
+	sai_load_kins(inifile, kinsname, sets, machine) != 0)
+	exit(2);
+    sai_find_start(machine);
+    if (sai_init_interp(inifile, tooltable) != 0)
+	exit(2);
+
+    result = sai_run_jobs(argv + optind, argc - optind, parallel,
+			  check_program, &machine);
+    if (machine.kins)
+	userkins_unload(machine.kins);
+    exit(result);
+}
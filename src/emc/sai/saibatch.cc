@@ -0,0 +1,317 @@
+/********************************************************************
+* Description: saibatch.cc
+*   What the off-line drivers of the stand-alone interpreter have in
+*   common, see saibatch.hh
+*
+*   Each program is run in a process of its own, since the interpreter
+*   and the canon keep their state in globals.  The interpreter is set
+*   up once, before the processes are forked.
+*
+* License: GPL Version 2
+* System: Linux
+*
+********************************************************************/
+
+#include "rs274ngc.hh"
+#include "rs274ngc_interp.hh"
+#include "rs274ngc_return.hh"
+#include "emcIniFile.hh"	// EmcIniFile
+#include "canon.hh"		// _tools
+#include "config.h"		// LINELEN
+#include "tool_parse.h"
+#include "saibatch.hh"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+InterpBase *pinterp;
+#define interp_new (*pinterp)
+
+int _task = 0; // control preview behaviour when remapping
+
+static const char axis_letters[] = "XYZABCUVW";
+
+int sai_read_ini(const char *inifile, SaiMachine &m)
+{
+    EmcIniFile ini;
+    EmcLinearUnits linear = 1;
+    EmcAngularUnits angular = 1;
+    EmcAxisType type;
+    const char *s;
+    char section[16];
+    double d;
+    int n;
+
+    if (!ini.Open(inifile)) {
+	fprintf(stderr, "can't open %s\n", inifile);
+	return -1;
+    }
+    ini.FindLinearUnits(&linear, "LINEAR_UNITS", "TRAJ");
+    ini.FindAngularUnits(&angular, "ANGULAR_UNITS", "TRAJ");
+    if (linear <= 0)
+	linear = 1;
+    if (angular <= 0)
+	angular = 1;
+
+    m.cfg.axis_mask = 0;
+    if ((s = ini.Find("COORDINATES", "TRAJ"))) {
+	for (; *s; s++) {
+	    const char *p = strchr(axis_letters, toupper(*s));
+	    if (p && *p)
+		m.cfg.axis_mask |= 1 << (p - axis_letters);
+	}
+    }
+    if (!m.cfg.axis_mask)
+	m.cfg.axis_mask = 0x7;
+    m.cfg.joints = 3;
+    if (ini.Find(&n, "JOINTS", "KINS") != IniFile::ERR_NONE &&
+	ini.Find(&n, "AXES", "TRAJ") != IniFile::ERR_NONE)
+	n = 3;
+    if (n < 1 || n > PREFLIGHT_MAX_JOINTS) {
+	fprintf(stderr, "%s: can't check %d joints\n", inifile, n);
+	return -1;
+    }
+    m.cfg.joints = n;
+    if (ini.Find(&d, "MAX_VELOCITY", "TRAJ") == IniFile::ERR_NONE)
+	m.cfg.traj_max_velocity = d / linear;
+
+    /* motmod's traj_period_nsec, which is servo_period_nsec if not set */
+    m.traj_period = 0;
+    if (ini.Find(&d, "TRAJ_PERIOD", "EMCMOT") == IniFile::ERR_NONE ||
+	ini.Find(&d, "SERVO_PERIOD", "EMCMOT") == IniFile::ERR_NONE)
+	m.traj_period = d * 1e-9;
+
+    for (n = 0; n < PREFLIGHT_MAX_JOINTS; n++) {
+	double u;
+
+	snprintf(section, sizeof(section), "AXIS_%d", n);
+	type = n >= 3 && n <= 5 ? EMC_AXIS_ANGULAR : EMC_AXIS_LINEAR;
+	ini.Find(&type, "TYPE", section);
+	u = m.units[n] = type == EMC_AXIS_ANGULAR ? angular : linear;
+	if (ini.Find(&d, "MIN_LIMIT", section) == IniFile::ERR_NONE)
+	    m.cfg.min_limit[n] = d / u;
+	if (ini.Find(&d, "MAX_LIMIT", section) == IniFile::ERR_NONE)
+	    m.cfg.max_limit[n] = d / u;
+	if (ini.Find(&d, "MAX_VELOCITY", section) == IniFile::ERR_NONE)
+	    m.cfg.max_velocity[n] = d / u;
+	if (ini.Find(&d, "MAX_ACCELERATION", section) == IniFile::ERR_NONE)
+	    m.cfg.max_acceleration[n] = d / u;
+	if (ini.Find(&d, "HOME", section) == IniFile::ERR_NONE)
+	    m.cfg.home[n] = d / u;
+    }
+    return 0;
+}
+
+int sai_load_kins(const char *inifile, const char *name,
+		  const std::vector<std::string> &sets, SaiMachine &m)
+{
+    IniFile ini;
+    char module[LINELEN], err[LINELEN];
+    const char *s = name;
+    size_t k;
+
+    m.kins = NULL;
+    if (!s && ini.Open(inifile))
+	s = ini.Find("KINEMATICS", "KINS");
+    if (!s || sscanf(s, "%s", module) != 1 || !strcmp(module, "trivkins"))
+	return 0;
+    m.kins = userkins_load(module, err, sizeof(err));
+    if (!m.kins) {
+	fprintf(stderr, "%s\n", err);
+	return -1;
+    }
+    for (k = 0; k < sets.size(); k++) {
+	std::string pin = sets[k].substr(0, sets[k].find('='));
+	double value = atof(sets[k].c_str() + pin.size() + 1);
+	if (userkins_set(m.kins, pin.c_str(), value) != 0) {
+	    fprintf(stderr, "%s: no pin or parameter %s\n", module,
+		    pin.c_str());
+	    return -1;
+	}
+    }
+    return 0;
+}
+
+void sai_find_start(SaiMachine &m)
+{
+    double joints[PREFLIGHT_MAX_JOINTS];
+    EmcPose &start = m.cfg.start;
+    int n;
+
+    memset(&start, 0, sizeof(start));
+    if (m.kins) {
+	memcpy(joints, m.cfg.home, sizeof(joints));
+	if (userkins_forward(m.kins, joints, m.cfg.joints, &start, 1, NULL))
+	    memset(&start, 0, sizeof(start));
+	return;
+    }
+    for (n = 0; n < m.cfg.joints; n++) {
+	switch (n) {
+	case 0: start.tran.x = m.cfg.home[n]; break;
+	case 1: start.tran.y = m.cfg.home[n]; break;
+	case 2: start.tran.z = m.cfg.home[n]; break;
+	case 3: start.a = m.cfg.home[n]; break;
+	case 4: start.b = m.cfg.home[n]; break;
+	case 5: start.c = m.cfg.home[n]; break;
+	case 6: start.u = m.cfg.home[n]; break;
+	case 7: start.v = m.cfg.home[n]; break;
+	case 8: start.w = m.cfg.home[n]; break;
+	}
+    }
+}
+
+int sai_init_interp(const char *inifile, const char *tooltable)
+{
+    char buffer[LINELEN];
+    int status;
+
+    setenv("INI_FILE_NAME", inifile, 1);
+    _outfile = fopen("/dev/null", "w");
+    if (!tooltable) {
+	IniFile ini;
+	if (ini.Open(inifile))
+	    tooltable = ini.Find("TOOL_TABLE", "EMCIO");
+	if (tooltable)
+	    tooltable = strdup(tooltable);
+    }
+    if (tooltable && loadToolTable(tooltable, _tools, 0, 0, 0) != 0) {
+	fprintf(stderr, "can't read tool table %s\n", tooltable);
+	return -1;
+    }
+    pinterp = new Interp;
+    status = interp_new.init();
+    if (status != INTERP_OK) {
+	interp_new.error_text(status, buffer, sizeof(buffer));
+	fprintf(stderr, "%s\n", buffer);
+	return -1;
+    }
+    return 0;
+}
+
+static int interp_error(int status, int &line, std::string &error)
+{
+    char text[LINELEN];
+
+    interp_new.error_text(status, text, sizeof(text));
+    line = interp_new.sequence_number();
+    error = text[0] ? text : "Unknown error, bad error code";
+    return 1;
+}
+
+int sai_run_program(const char *file, int &line, std::string &error)
+{
+    int status, result = 0;
+
+    status = interp_new.open(file);
+    if (status != INTERP_OK)
+	return -1;
+    for (;;) {
+	status = interp_new.read();
+	if (status == INTERP_ENDFILE)
+	    break;
+	if (status != INTERP_OK && status != INTERP_EXECUTE_FINISH) {
+	    result = interp_error(status, line, error);
+	    break;
+	}
+	status = interp_new.execute();
+	if (status == INTERP_EXIT)
+	    break;
+	if (status != INTERP_OK && status != INTERP_EXECUTE_FINISH) {
+	    result = interp_error(status, line, error);
+	    break;
+	}
+    }
+    interp_new.close();
+    return result;
+}
+
+struct Job {
+    const char *file;
+    pid_t pid;
+    FILE *out;
+    int status;
+    bool done;
+};
+
+int sai_run_jobs(char **files, int count, int parallel,
+		 sai_job_t run, void *arg)
+{
+    std::vector<Job> jobs(count);
+    int status, result = 0;
+    size_t next = 0, printed = 0, running = 0, k;
+    char buffer[LINELEN];
+
+    for (k = 0; k < jobs.size(); k++) {
+	jobs[k].file = files[k];
+	jobs[k].pid = -1;
+	jobs[k].out = NULL;
+	jobs[k].status = 2;
+	jobs[k].done = false;
+    }
+    fflush(stdout);
+    fflush(stderr);
+    while (printed < jobs.size()) {
+	while (running < (size_t) parallel && next < jobs.size()) {
+	    Job &job = jobs[next++];
+	    job.out = tmpfile();
+	    job.pid = job.out ? fork() : -1;
+	    if (job.pid == 0) {
+		status = run(job.file, job.out, arg);
+		fflush(job.out);
+		_exit(status);
+	    }
+	    if (job.pid < 0) {
+		fprintf(stderr, "%s: %s\n", job.file, strerror(errno));
+		job.done = true;
+		continue;
+	    }
+	    running++;
+	}
+	if (running) {
+	    pid_t pid = wait(&status);
+	    for (k = 0; k < jobs.size(); k++) {
+		if (jobs[k].pid == pid && !jobs[k].done) {
+		    jobs[k].done = true;
+		    jobs[k].status = WIFEXITED(status) ? WEXITSTATUS(status) : 2;
+		    if (!WIFEXITED(status))
+			fprintf(stderr, "%s: died with signal %d\n",
+				jobs[k].file, WTERMSIG(status));
+		    running--;
+		}
+	    }
+	}
+	for (; printed < jobs.size() && jobs[printed].done; printed++) {
+	    Job &job = jobs[printed];
+	    if (job.out) {
+		size_t len;
+		rewind(job.out);
+		while ((len = fread(buffer, 1, sizeof(buffer), job.out)) > 0)
+		    fwrite(buffer, 1, len, stdout);
+		fclose(job.out);
+	    }
+	    if (job.status > result)
+		result = job.status;
+	}
+	fflush(stdout);
+    }
+    return result;
+}
+
+/***********************************************************************/
+
+int emcOperatorError(int id, const char *fmt, ...)
+{
+    va_list ap;
+
+    if (id)
+	fprintf(stderr, "[%d] ", id);
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    return 0;
+}
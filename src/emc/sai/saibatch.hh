@@ -0,0 +1,61 @@
+/********************************************************************
+* Description: saibatch.hh
+*   What the off-line drivers of the stand-alone interpreter have in
+*   common: reading the machine from its ini file, setting up the
+*   interpreter, and running a batch of programs, each in a process of
+*   its own
+*
+* License: GPL Version 2
+* System: Linux
+*
+********************************************************************/
+
+#ifndef SAIBATCH_HH
+#define SAIBATCH_HH
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "preflight.hh"		/* PreflightConfig */
+
+struct SaiMachine {
+    PreflightConfig cfg;
+    userkins_t *kins;
+    double units[PREFLIGHT_MAX_JOINTS];	/* machine units per mm or degree */
+    double traj_period;		/* motion's, from [EMCMOT], s, or 0 */
+
+    SaiMachine() : kins(NULL), traj_period(0) {}
+};
+
+/* Reads the limits of the joints and axes from the ini file, as
+   iniaxis.cc and initraj.cc do, and converts them to mm and degrees.
+   Prints what's wrong and returns -1 if it can't. */
+extern int sai_read_ini(const char *inifile, SaiMachine &m);
+
+/* Loads the module named, or in [KINS]KINEMATICS, unless it is trivkins,
+   and sets the pins given as pin=value. */
+extern int sai_load_kins(const char *inifile, const char *name,
+			 const std::vector<std::string> &sets, SaiMachine &m);
+
+/* sets m.cfg.start to the home position */
+extern void sai_find_start(SaiMachine &m);
+
+/* Sets up the interpreter the way rs274 -i does, but quiet, with the
+   tool table given or the one in [EMCIO]TOOL_TABLE.  Done once, before
+   the programs are run, so that each gets a copy of it. */
+extern int sai_init_interp(const char *inifile, const char *tooltable);
+
+/* Runs a program through the interpreter, with the moves going to
+   _sai_motion.  Returns 0 if it ran to the end, -1 if it couldn't be
+   opened, and 1 on an interpreter error, with its line and text. */
+extern int sai_run_program(const char *file, int &line, std::string &error);
+
+/* Runs job(file, out, arg) for every file, in a child process, at most
+   parallel at a time, and copies what each writes to out to stdout, in
+   the order of the files.  job returns the process's exit status, 2 if
+   it dies; the highest is returned. */
+typedef int (*sai_job_t)(const char *file, FILE *out, void *arg);
+extern int sai_run_jobs(char **files, int count, int parallel,
+			sai_job_t job, void *arg);
+
+#endif
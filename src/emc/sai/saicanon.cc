@@ -34,6 +34,7 @@
 #include "canon.hh"
 #include "rs274ngc.hh"
 #include "rs274ngc_interp.hh"
+#include "saicanon.hh"
 #include <math.h>
 #include <stdio.h>
 #include <string.h>
@@ -44,6 +45,7 @@
 /* where to print */
 //extern FILE * _outfile;
 FILE * _outfile=NULL;      /* where to print, set in main */
+SaiMotion * _sai_motion=NULL; /* gets the moves too, set in main */
 
 /* Dummy world model */
 
@@ -68,6 +70,9 @@ static double _g5x_x, _g5x_y, _g5x_z;
 static double _g5x_a, _g5x_b, _g5x_c;
 static double _g92_x, _g92_y, _g92_z;
 static double _g92_a, _g92_b, _g92_c;
+static double _g5x_u, _g5x_v, _g5x_w;
+static double _g92_u, _g92_v, _g92_w;
+static double _xy_rotation;
 static double            _program_position_a = 0; /*AA*/
 static double            _program_position_b = 0; /*BB*/
 static double            _program_position_c = 0; /*CC*/
@@ -206,13 +211,56 @@ void print_nc_line_number()
                    arg1,arg2,arg3,arg4,arg5,arg6,arg7,arg8,arg9,arg10,arg11,arg12,arg13,arg14); \
           } else
 
+/* Machine coordinates for _sai_motion, in mm and degrees: what
+from_prog() and rotate_and_offset_pos() in emccanon.cc make of a
+position in program coordinates. */
+
+static EmcPose to_machine(double x, double y, double z,
+                          double a, double b, double c,
+                          double u, double v, double w)
+{
+  EmcPose pos;
+  double t = _xy_rotation * M_PI / 180.0;
+  double xx, yy;
+
+  x += _g92_x;
+  y += _g92_y;
+  xx = x * cos(t) - y * sin(t);
+  yy = x * sin(t) + y * cos(t);
+  pos.tran.x = (xx + _g5x_x + _tool_offset.tran.x) * _length_unit_factor;
+  pos.tran.y = (yy + _g5x_y + _tool_offset.tran.y) * _length_unit_factor;
+  pos.tran.z = (z + _g92_z + _g5x_z + _tool_offset.tran.z) * _length_unit_factor;
+  pos.a = a + _g92_a + _g5x_a + _tool_offset.a;
+  pos.b = b + _g92_b + _g5x_b + _tool_offset.b;
+  pos.c = c + _g92_c + _g5x_c + _tool_offset.c;
+  pos.u = (u + _g92_u + _g5x_u + _tool_offset.u) * _length_unit_factor;
+  pos.v = (v + _g92_v + _g5x_v + _tool_offset.v) * _length_unit_factor;
+  pos.w = (w + _g92_w + _g5x_w + _tool_offset.w) * _length_unit_factor;
+  return pos;
+}
+
+/* feed rates per second; G95 feeds are per spindle revolution */
+static double linear_feed()
+{
+  double rate = _feed_rate * _length_unit_factor / 60.0;
+
+  return _feed_mode ? rate * _spindle_speed : rate;
+}
+
+static double angular_feed()
+{
+  double rate = _feed_rate / 60.0;
+
+  return _feed_mode ? rate * _spindle_speed : rate;
+}
+
 /* Representation */
 
 void SET_XY_ROTATION(double t) {
   fprintf(_outfile, "%5d ", _line_number++);
   print_nc_line_number();
   fprintf(_outfile, "SET_XY_ROTATION(%.4f)\n", t);
-  // CJR XXX 
+  _xy_rotation = t;
 }
     
 
@@ -237,6 +285,9 @@ void SET_G5X_OFFSET(int index,
   _g5x_a = a;  /*AA*/
   _g5x_b = b;  /*BB*/
   _g5x_c = c;  /*CC*/
+  _g5x_u = u;
+  _g5x_v = v;
+  _g5x_w = w;
 }
 
 void SET_G92_OFFSET(double x, double y, double z,
@@ -259,6 +310,9 @@ void SET_G92_OFFSET(double x, double y, double z,
   _g92_a = a;  /*AA*/
   _g92_b = b;  /*BB*/
   _g92_c = c;  /*CC*/
+  _g92_u = u;
+  _g92_v = v;
+  _g92_w = w;
 }
 
 void USE_LENGTH_UNITS(CANON_UNITS in_unit)
@@ -282,6 +336,14 @@ void USE_LENGTH_UNITS(CANON_UNITS in_unit)
           _g92_x /= 25.4;
           _g92_y /= 25.4;
           _g92_z /= 25.4;
+
+          _g5x_u /= 25.4;
+          _g5x_v /= 25.4;
+          _g5x_w /= 25.4;
+
+          _g92_u /= 25.4;
+          _g92_v /= 25.4;
+          _g92_w /= 25.4;
         }
     }
   else if (in_unit == CANON_UNITS_MM)
@@ -303,6 +365,14 @@ void USE_LENGTH_UNITS(CANON_UNITS in_unit)
           _g92_x *= 25.4;
           _g92_y *= 25.4;
           _g92_z *= 25.4;
+
+          _g5x_u *= 25.4;
+          _g5x_v *= 25.4;
+          _g5x_w *= 25.4;
+
+          _g92_u *= 25.4;
+          _g92_v *= 25.4;
+          _g92_w *= 25.4;
         }
     }
   else
@@ -341,6 +411,8 @@ void STRAIGHT_TRAVERSE( int line_number,
   _program_position_a = a; /*AA*/
   _program_position_b = b; /*BB*/
   _program_position_c = c; /*CC*/
+  if (_sai_motion)
+    _sai_motion->traverse(line_number, to_machine(x, y, z, a, b, c, u, v, w));
 }
 
 /* Machining Attributes */
@@ -382,6 +454,9 @@ extern void SET_MOTION_CONTROL_MODE(CANON_MOTION_MODE mode, double tolerance)
     }
   else
     PRINT0("SET_MOTION_CONTROL_MODE(UNKNOWN)\n");
+  if (_sai_motion)
+    _sai_motion->motion_mode(_motion_mode != CANON_CONTINUOUS,
+                             motion_tolerance * _length_unit_factor);
 }
 
 extern void SET_NAIVECAM_TOLERANCE(double tolerance)
@@ -472,6 +547,37 @@ void ARC_FEED(int line_number,
   _program_position_a = a; /*AA*/
   _program_position_b = b; /*BB*/
   _program_position_c = c; /*CC*/
+  if (_sai_motion)
+    {
+      EmcPose end, center;
+      PM_CARTESIAN normal;
+      double t = _xy_rotation * M_PI / 180.0;
+
+      end = to_machine(_program_position_x, _program_position_y,
+                       _program_position_z, a, b, c, u, v, w);
+      if (_active_plane == CANON_PLANE_XY)
+        {
+          center = to_machine(first_axis, second_axis, axis_end_point,
+                              0, 0, 0, 0, 0, 0);
+          normal = PM_CARTESIAN(0, 0, 1);
+        }
+      else if (_active_plane == CANON_PLANE_YZ)
+        {
+          center = to_machine(axis_end_point, first_axis, second_axis,
+                              0, 0, 0, 0, 0, 0);
+          normal = PM_CARTESIAN(cos(t), sin(t), 0);
+        }
+      else
+        {
+          center = to_machine(second_axis, axis_end_point, first_axis,
+                              0, 0, 0, 0, 0, 0);
+          normal = PM_CARTESIAN(-sin(t), cos(t), 0);
+        }
+      _sai_motion->arc(line_number, end,
+                       PM_CARTESIAN(center.tran.x, center.tran.y, center.tran.z),
+                       normal, rotation > 0 ? rotation - 1 : rotation,
+                       linear_feed(), angular_feed());
+    }
 }
 
 void STRAIGHT_FEED(int line_number,
@@ -499,6 +605,9 @@ void STRAIGHT_FEED(int line_number,
   _program_position_a = a; /*AA*/
   _program_position_b = b; /*BB*/
   _program_position_c = c; /*CC*/
+  if (_sai_motion)
+    _sai_motion->feed(line_number, to_machine(x, y, z, a, b, c, u, v, w),
+                      linear_feed(), angular_feed());
 }
 
 
@@ -540,6 +649,12 @@ void STRAIGHT_PROBE(int line_number,
   _probe_position_a = a; /*AA*/
   _probe_position_b = b; /*BB*/
   _probe_position_c = c; /*CC*/
+  if (_sai_motion)
+    {
+      _sai_motion->feed(line_number, to_machine(x, y, z, a, b, c, u, v, w),
+                        linear_feed(), angular_feed());
+      _sai_motion->wait(line_number);
+    }
   if (distance != 0)
     {
       backoff = ((_length_unit_type == CANON_UNITS_MM) ? 0.254 : 0.01);
@@ -560,12 +675,30 @@ void RIGID_TAP(int line_number, double x, double y, double z)
     fprintf(_outfile, "%5d ", _line_number++);
     print_nc_line_number();
     fprintf(_outfile, "RIGID_TAP(%.4f, %.4f, %.4f)\n", x, y, z);
+    if (_sai_motion)
+      {
+        /* in to the bottom and back out, at the programmed pitch */
+        EmcPose start = to_machine(_program_position_x, _program_position_y,
+                                   _program_position_z, _program_position_a,
+                                   _program_position_b, _program_position_c,
+                                   0, 0, 0);
+        EmcPose bottom = start;
+
+        bottom.tran = to_machine(x, y, z, 0, 0, 0, 0, 0, 0).tran;
+        _sai_motion->feed(line_number, bottom, linear_feed(), angular_feed());
+        _sai_motion->feed(line_number, start, linear_feed(), angular_feed());
+        _sai_motion->wait(line_number);
+      }
 
 }
 
 
 void DWELL(double seconds)
-{PRINT1("DWELL(%.4f)\n", seconds);}
+{
+  PRINT1("DWELL(%.4f)\n", seconds);
+  if (_sai_motion)
+    _sai_motion->dwell(interp_new.sequence_number(), seconds);
+}
 
 /* Spindle Functions */
 void SPINDLE_RETRACT_TRAVERSE()
@@ -641,6 +774,8 @@ void USE_TOOL_LENGTH_OFFSET(EmcPose offset)
 void CHANGE_TOOL(int slot)
 {
   PRINT1("CHANGE_TOOL(%d)\n", slot);
+  if (_sai_motion)
+    _sai_motion->wait(interp_new.sequence_number());
   _active_slot = slot;
   _tools[0] = _tools[slot];
 }
@@ -754,7 +889,11 @@ void UNCLAMP_AXIS(CANON_AXIS axis)
 /* Program Functions */
 
 void PROGRAM_STOP()
-{PRINT0("PROGRAM_STOP()\n");}
+{
+  PRINT0("PROGRAM_STOP()\n");
+  if (_sai_motion)
+    _sai_motion->wait(interp_new.sequence_number());
+}
 
 void SET_BLOCK_DELETE(bool state)
 {block_delete = state;} //state == ON, means we don't interpret lines starting with "/"
@@ -769,10 +908,18 @@ bool GET_OPTIONAL_PROGRAM_STOP()
 {return optional_program_stop;} //state == ON, means we stop
 
 void OPTIONAL_PROGRAM_STOP()
-{PRINT0("OPTIONAL_PROGRAM_STOP()\n");}
+{
+  PRINT0("OPTIONAL_PROGRAM_STOP()\n");
+  if (_sai_motion)
+    _sai_motion->wait(interp_new.sequence_number());
+}
 
 void PROGRAM_END()
-{PRINT0("PROGRAM_END()\n");}
+{
+  PRINT0("PROGRAM_END()\n");
+  if (_sai_motion)
+    _sai_motion->wait(interp_new.sequence_number());
+}
 
 
 /*************************************************************************/
@@ -0,0 +1,52 @@
+/********************************************************************
+* Description: saicanon.hh
+*   Motion from the stand-alone interpreter's canon, for drivers that
+*   do more with it than print the calls
+*
+* License: GPL Version 2
+* System: Linux
+*
+********************************************************************/
+
+#ifndef SAICANON_HH
+#define SAICANON_HH
+
+#include <stdio.h>
+#include "emcpos.h"		/* EmcPose */
+#include "posemath.h"		/* PM_CARTESIAN */
+
+/* Positions are in machine coordinates, in mm and degrees, with the
+   work offsets, XY rotation and tool offset applied the way emccanon.cc
+   applies them before a move goes to motion.  Feed rates are in units
+   per second: linear is for moves of the linear axes, in mm/s, angular
+   for moves of the rotary axes alone, in degrees/s. */
+class SaiMotion {
+public:
+    virtual ~SaiMotion() {}
+
+    /* a move starts where the last one ended, or at the origin */
+    virtual void traverse(int line, const EmcPose &end) = 0;
+    virtual void feed(int line, const EmcPose &end,
+		      double linear, double angular) = 0;
+    /* center, normal and turn as in EMC_TRAJ_CIRCULAR_MOVE */
+    virtual void arc(int line, const EmcPose &end,
+		     const PM_CARTESIAN &center, const PM_CARTESIAN &normal,
+		     int turn, double linear, double angular) = 0;
+    virtual void dwell(int line, double seconds) = 0;
+
+    /* G61/G61.1 stop at the end of every move, G64 blends within
+       tolerance (0 for no limit) */
+    virtual void motion_mode(bool exact_stop, double tolerance) = 0;
+
+    /* the program waits for motion to finish before it goes on: tool
+       changes, probing, program stops and the end of the program */
+    virtual void wait(int line) = 0;
+};
+
+/* where the calls are printed, stdout if NULL */
+extern FILE *_outfile;
+
+/* gets the motion as well as the printout, if not NULL */
+extern SaiMotion *_sai_motion;
+
+#endif
@@ -80,6 +80,7 @@ fpu_control_t __fpu_control = _FPU_IEEE & ~(_FPU_MASK_IM | _FPU_MASK_ZM | _FPU_M
 #include "task.hh"		// emcTaskCommand etc
 #include "taskclass.hh"
 #include "motion.h"             // EMCMOT_ORIENT_*
+#include "emcstatmirror.hh"	// emcStatMirrorPublish()
 
 /* time after which the user interface is declared dead
  * because it would'nt read any more messages
@@ -96,6 +97,9 @@ static RCS_CMD_CHANNEL *emcCommandBuffer = 0;
 static RCS_STAT_CHANNEL *emcStatusBuffer = 0;
 static NML *emcErrorBuffer = 0;
 
+// shared memory copy of emcStatus for local GUIs, may be 0
+static emc_stat_mirror_t *emcStatMirror = 0;
+
 // NML command channel data pointer
 static RCS_CMD_MSG *emcCommand = 0;
 
@@ -2859,6 +2863,8 @@ static int emctask_startup()
 	rcs_print_error("can't get emcStatus buffer\n");
 	return -1;
     }
+    // not fatal, clients use the NML channel without it
+    emcStatMirror = emcStatMirrorCreate();
 
     if (!(emc_debug & EMC_DEBUG_NML)) {
 	set_rcs_print_destination(RCS_PRINT_TO_NULL);	// inhibit diag
@@ -3025,6 +3031,11 @@ static int emctask_shutdown(void)
 	emcErrorBuffer = 0;
     }
 
+    if (0 != emcStatMirror) {
+	emcStatMirrorDestroy(emcStatMirror);
+	emcStatMirror = 0;
+    }
+
     if (0 != emcStatusBuffer) {
 	delete emcStatusBuffer;
 	emcStatusBuffer = 0;
@@ -3435,6 +3446,9 @@ int main(int argc, char *argv[])
 	// will be updated in the _update() functions above. There's
 	// no need to call the individual functions on all WM items.
 	emcStatusBuffer->write(emcStatus);
+	if (emcStatMirror) {
+	    emcStatMirrorPublish(emcStatMirror, emcStatus);
+	}
 
 	// wait on timer cycle, if specified, or calculate actual
 	// interval if ini file says to run full out via
@@ -24,6 +24,7 @@
 #include "rcs.hh"
 #include "emc.hh"
 #include "emc_nml.hh"
+#include "emcstatmirror.hh"
 #include "kinematics.h"
 #include "config.h"
 #include "inifile.hh"
@@ -79,10 +80,23 @@ struct pyIniFile {
     IniFile *i;
 };
 
+// groups of stat fields, for changed_fields(); see stat_regions below
+enum { STAT_STAT, STAT_TASK, STAT_TRAJ, STAT_AXIS, STAT_SPINDLE, STAT_DIO,
+       STAT_IO, STAT_TOOL, STAT_GROUPS };
+
+// upper bound on the getters whose result is cached, see Stat_fields
+#define STAT_FIELDS 32
+
 struct pyStatChannel {
     PyObject_HEAD
     RCS_STAT_CHANNEL *c;
+    emc_stat_mirror_t *mirror;
     EMC_STAT status;
+    EMC_STAT *next;                     // poll() reads into this first
+    unsigned changed;                   // groups changed by the last poll()
+    unsigned gen[STAT_GROUPS];          // bumped when the group changes
+    PyObject *cache[STAT_FIELDS];       // built from the group at cache_gen
+    unsigned cache_gen[STAT_FIELDS];
 };
 
 struct pyCommandChannel {
@@ -260,11 +274,18 @@ static int Stat_init(pyStatChannel *self, PyObject *a, PyObject *k) {
     }
 
     self->c = c;
+    self->mirror = emcStatMirrorAttach();
+    if(!self->next) self->next = new EMC_STAT();
     return 0;
 }
 
 static void Stat_dealloc(PyObject *self) {
-    delete ((pyStatChannel*)self)->c;
+    pyStatChannel *s = (pyStatChannel*)self;
+    delete s->c;
+    emcStatMirrorDetach(s->mirror);
+    delete s->next;
+    for(int i = 0; i < STAT_FIELDS; i++)
+        Py_XDECREF(s->cache[i]);
     PyObject_Del(self);
 }
 
@@ -276,18 +297,152 @@ static bool check_stat(RCS_STAT_CHANNEL *emcStatusBuffer) {
     return true;
 }
 
+// EMC_STAT cut into consecutive regions, each ending where the next
+// one starts; every byte is in one, so that copying the regions that
+// differ brings all of s->status up to date
+struct stat_region {
+    int group;
+    size_t start;
+};
+
+// fields that task, motion and io bump every cycle or every command
+// even when nothing else changes; they are copied before the regions
+// are compared, so that they don't mark their group as changed
+struct stat_counter {
+    size_t start, size;
+};
+
+#define STAT_REGIONS 10
+#define STAT_COUNTERS 11
+static stat_region stat_regions[STAT_REGIONS];
+static stat_counter stat_counters[STAT_COUNTERS];
+
+// fills in the tables above from a real EMC_STAT, once; EMC_STAT isn't
+// standard layout, so offsetof() isn't defined for it
+static void stat_layout(const EMC_STAT *st) {
+    static bool done;
+    if(done) return;
+    const char *base = (const char*)st;
+
+#define R(g, x) { g, (size_t)((const char*)&st->x - base) }
+    const stat_region regions[STAT_REGIONS] = {
+        { STAT_STAT, 0 },
+        R(STAT_TASK, task),
+        R(STAT_TRAJ, motion),
+        R(STAT_AXIS, motion.axis),
+        R(STAT_SPINDLE, motion.spindle),
+        R(STAT_DIO, motion.synch_di),
+        R(STAT_IO, io),
+        R(STAT_TOOL, io.tool),
+        R(STAT_IO, io.coolant),
+        R(STAT_STAT, debug),
+    };
+#undef R
+
+#define C(x) { (size_t)((const char*)&st->x - base), sizeof(st->x) }
+    const stat_counter counters[STAT_COUNTERS] = {
+        C(command_type), C(echo_serial_number),
+        C(task.command_type), C(task.echo_serial_number), C(task.heartbeat),
+        C(motion.command_type), C(motion.echo_serial_number),
+        C(motion.heartbeat),
+        C(io.command_type), C(io.echo_serial_number), C(io.heartbeat),
+    };
+#undef C
+
+    memcpy(stat_regions, regions, sizeof(regions));
+    memcpy(stat_counters, counters, sizeof(counters));
+    done = true;
+}
+
+static const char *stat_group_names[STAT_GROUPS] = {
+    "stat", "task", "traj", "axis", "spindle", "dio", "io", "tool",
+};
+
+static void Stat_update(pyStatChannel *s) {
+    const int n = STAT_REGIONS;
+    const int nc = STAT_COUNTERS;
+    char *cur = (char*)&s->status, *next = (char*)s->next;
+
+    stat_layout(&s->status);
+
+    for(int i = 0; i < nc; i++)
+        memcpy(cur + stat_counters[i].start, next + stat_counters[i].start,
+               stat_counters[i].size);
+    s->changed = 0;
+    for(int i = 0; i < n; i++) {
+        size_t start = stat_regions[i].start;
+        size_t end = i + 1 < n ? stat_regions[i+1].start : sizeof(EMC_STAT);
+        if(memcmp(cur + start, next + start, end - start)) {
+            memcpy(cur + start, next + start, end - start);
+            s->changed |= 1 << stat_regions[i].group;
+        }
+    }
+    for(int g = 0; g < STAT_GROUPS; g++)
+        if(s->changed & (1 << g)) s->gen[g]++;
+}
+
 static PyObject *poll(pyStatChannel *s, PyObject *o) {
+    // task's shared memory copy, if there is one, saves decoding
+    // the NML buffer; a restarted task publishes a new one
+    if(!s->mirror) s->mirror = emcStatMirrorAttach();
+    if(s->mirror) {
+        if(emcStatMirrorRead(s->mirror, s->next) == 0) {
+            Stat_update(s);
+            Py_INCREF(Py_None);
+            return Py_None;
+        }
+        emcStatMirrorDetach(s->mirror);
+        s->mirror = 0;
+    }
     if(!check_stat(s->c)) return NULL;
     if(s->c->peek() == EMC_STAT_TYPE) {
         EMC_STAT *emcStatus = static_cast<EMC_STAT*>(s->c->get_address());
-        memcpy(&s->status, emcStatus, sizeof(EMC_STAT));
+        memcpy((void*)s->next, emcStatus, sizeof(EMC_STAT));
+        Stat_update(s);
     }
     Py_INCREF(Py_None);
     return Py_None;
 }
 
+static PyObject *Stat_changed_fields(pyStatChannel *s, PyObject *o) {
+    PyObject *res = PyList_New(0);
+    if(!res) return NULL;
+    for(int g = 0; g < STAT_GROUPS; g++) {
+        if(!(s->changed & (1 << g))) continue;
+        PyObject *name = PyString_FromString(stat_group_names[g]);
+        if(!name || PyList_Append(res, name) < 0) {
+            Py_XDECREF(name);
+            Py_DECREF(res);
+            return NULL;
+        }
+        Py_DECREF(name);
+    }
+    return res;
+}
+
+static PyObject *Stat_generations(pyStatChannel *s, PyObject *o) {
+    PyObject *res = PyDict_New();
+    if(!res) return NULL;
+    for(int g = 0; g < STAT_GROUPS; g++) {
+        PyObject *gen = PyLong_FromUnsignedLong(s->gen[g]);
+        if(!gen || PyDict_SetItemString(res, stat_group_names[g], gen) < 0) {
+            Py_XDECREF(gen);
+            Py_DECREF(res);
+            return NULL;
+        }
+        Py_DECREF(gen);
+    }
+    return res;
+}
+
 static PyMethodDef Stat_methods[] = {
     {"poll", (PyCFunction)poll, METH_NOARGS, "Update current machine state"},
+    {"changed_fields", (PyCFunction)Stat_changed_fields, METH_NOARGS,
+        "List the groups of fields that the last poll() changed: stat, task, "
+        "traj, axis, spindle, dio, io and tool"},
+    {"generations", (PyCFunction)Stat_generations, METH_NOARGS,
+        "Get a dict of group name to a number that each poll() which "
+        "changes the group increments"},
     {NULL}
 };
 
@@ -615,31 +770,62 @@ static PyObject *Stat_tool_table(pyStatChannel *s) {
 // XXX io.tool.toolTable
 // XXX EMC_AXIS_STAT motion.axis[]
 
-static PyGetSetDef Stat_getsetlist[] = {
-    {(char*)"actual_position", (getter)Stat_actual},
-    {(char*)"ain", (getter)Stat_ain},
-    {(char*)"aout", (getter)Stat_aout},
-    {(char*)"axis", (getter)Stat_axis},
-    {(char*)"din", (getter)Stat_din},
-    {(char*)"dout", (getter)Stat_dout},
-    {(char*)"gcodes", (getter)Stat_activegcodes},
-    {(char*)"homed", (getter)Stat_homed},
-    {(char*)"limit", (getter)Stat_limit},
-    {(char*)"mcodes", (getter)Stat_activemcodes},
-    {(char*)"g5x_offset", (getter)Stat_g5x_offset},
-    {(char*)"g5x_index", (getter)Stat_g5x_index},
-    {(char*)"g92_offset", (getter)Stat_g92_offset},
-    {(char*)"position", (getter)Stat_position},
-    {(char*)"dtg", (getter)Stat_dtg},
-    {(char*)"joint_position", (getter)Stat_joint_position},
-    {(char*)"joint_actual_position", (getter)Stat_joint_actual},
-    {(char*)"probed_position", (getter)Stat_probed},
-    {(char*)"settings", (getter)Stat_activesettings},
-    {(char*)"tool_offset", (getter)Stat_tool_offset},
-    {(char*)"tool_table", (getter)Stat_tool_table},
+// getters whose result is kept, and handed out again until poll()
+// changes its group; 'axis' is a tuple of dicts, which the caller
+// may modify, so it is built each time
+struct stat_field {
+    const char *name;
+    PyObject *(*build)(pyStatChannel *s);
+    int group;
+    bool cache;
+};
+
+static stat_field Stat_fields[STAT_FIELDS] = {
+    {"actual_position", Stat_actual, STAT_TRAJ, true},
+    {"ain", Stat_ain, STAT_DIO, true},
+    {"aout", Stat_aout, STAT_DIO, true},
+    {"axis", Stat_axis, STAT_AXIS, false},
+    {"din", Stat_din, STAT_DIO, true},
+    {"dout", Stat_dout, STAT_DIO, true},
+    {"gcodes", Stat_activegcodes, STAT_TASK, true},
+    {"homed", Stat_homed, STAT_AXIS, true},
+    {"limit", Stat_limit, STAT_AXIS, true},
+    {"mcodes", Stat_activemcodes, STAT_TASK, true},
+    {"g5x_offset", Stat_g5x_offset, STAT_TASK, true},
+    {"g5x_index", Stat_g5x_index, STAT_TASK, true},
+    {"g92_offset", Stat_g92_offset, STAT_TASK, true},
+    {"position", Stat_position, STAT_TRAJ, true},
+    {"dtg", Stat_dtg, STAT_TRAJ, true},
+    {"joint_position", Stat_joint_position, STAT_AXIS, true},
+    {"joint_actual_position", Stat_joint_actual, STAT_AXIS, true},
+    {"probed_position", Stat_probed, STAT_TRAJ, true},
+    {"settings", Stat_activesettings, STAT_TASK, true},
+    {"tool_offset", Stat_tool_offset, STAT_TASK, true},
+    {"tool_table", Stat_tool_table, STAT_TOOL, true},
     {NULL}
 };
 
+static PyObject *Stat_field(pyStatChannel *s, void *closure) {
+    stat_field *f = (stat_field*)closure;
+    int i = f - Stat_fields;
+
+    if(!f->cache) return f->build(s);
+    if(s->cache[i] && s->cache_gen[i] == s->gen[f->group]) {
+        Py_INCREF(s->cache[i]);
+        return s->cache[i];
+    }
+    PyObject *res = f->build(s);
+    if(!res) return NULL;
+    Py_XDECREF(s->cache[i]);
+    Py_INCREF(res);
+    s->cache[i] = res;
+    s->cache_gen[i] = s->gen[f->group];
+    return res;
+}
+
+// filled in from Stat_fields by initlinuxcnc()
+static PyGetSetDef Stat_getsetlist[STAT_FIELDS + 1];
+
 static PyTypeObject Stat_Type = {
     PyObject_HEAD_INIT(NULL)
     0,                      /*ob_size*/
@@ -1667,8 +1853,70 @@ static PyObject *pyvertex9(PyObject *s, PyObject *o) {
     return Py_BuildValue("(ddd)", &pt[0], &pt[1], &pt[2]);
 }
 
+// Draw from packed segments, like a gcode.preview's: an object exporting
+// float[n][2][9] start and end points through the buffer protocol, with
+// a 'lines' attribute exporting their int[n] line numbers.
+static PyObject *draw_segments(const char *geometry, PyObject *segs,
+        int for_selection) {
+    Py_buffer points, lines;
+    PyObject *lo;
+    int first = 1;
+    int nl = -1;
+    double p1[9], p2[9], pl[9];
+    Py_ssize_t i, count;
+
+    if(PyObject_GetBuffer(segs, &points, PyBUF_ND | PyBUF_FORMAT) < 0)
+        return NULL;
+    lo = PyObject_GetAttrString(segs, "lines");
+    if(!lo || PyObject_GetBuffer(lo, &lines, PyBUF_ND | PyBUF_FORMAT) < 0) {
+        Py_XDECREF(lo);
+        PyBuffer_Release(&points);
+        return NULL;
+    }
+    count = lines.len / sizeof(int);
+    if(strcmp(points.format, "f") != 0 || strcmp(lines.format, "i") != 0
+            || points.len != count * 18 * (Py_ssize_t)sizeof(float)) {
+        PyErr_SetString(PyExc_TypeError,
+            "draw_lines: expected float[n][2][9] points and int[n] lines");
+        PyBuffer_Release(&lines);
+        PyBuffer_Release(&points);
+        Py_DECREF(lo);
+        return NULL;
+    }
+
+    const float *pt = (const float *)points.buf;
+    const int *ln = (const int *)lines.buf;
+    for(i=0; i<count; i++, pt += 18) {
+        int n = ln[i];
+        for(int j=0; j<9; j++) {
+            p1[j] = pt[j];
+            p2[j] = pt[j+9];
+        }
+        if(first || memcmp(p1, pl, sizeof(p1))
+                || (for_selection && n != nl)) {
+            if(!first) glEnd();
+            if(for_selection && n != nl) {
+                glLoadName(n);
+                nl = n;
+            }
+            glBegin(GL_LINE_STRIP);
+            glvertex9(p1, geometry);
+            first = 0;
+        }
+        line9(p1, p2, geometry);
+        memcpy(pl, p2, sizeof(p1));
+    }
+
+    if(!first) glEnd();
+
+    PyBuffer_Release(&lines);
+    PyBuffer_Release(&points);
+    Py_DECREF(lo);
+    Py_RETURN_NONE;
+}
+
 static PyObject *pydraw_lines(PyObject *s, PyObject *o) {
-    PyListObject *li;
+    PyObject *li;
     int for_selection = 0;
     int i;
     int first = 1;
@@ -1676,10 +1924,13 @@ static PyObject *pydraw_lines(PyObject *s, PyObject *o) {
     double p1[9], p2[9], pl[9];
     char *geometry;
 
-    if(!PyArg_ParseTuple(o, "sO!|i:draw_lines",
-			    &geometry, &PyList_Type, &li, &for_selection))
+    if(!PyArg_ParseTuple(o, "sO|i:draw_lines",
+			    &geometry, &li, &for_selection))
         return NULL;
 
+    if(!PyList_Check(li))
+        return draw_segments(geometry, li, for_selection);
+
     for(i=0; i<PyList_GET_SIZE(li); i++) {
         PyObject *it = PyList_GET_ITEM(li, i);
         PyObject *dummy1, *dummy2, *dummy3;
@@ -2175,6 +2426,11 @@ initlinuxcnc(void) {
 
     m = Py_InitModule3("linuxcnc", emc_methods, "Interface to LinuxCNC");
 
+    for(int i = 0; Stat_fields[i].name; i++) {
+        Stat_getsetlist[i].name = (char*)Stat_fields[i].name;
+        Stat_getsetlist[i].get = (getter)Stat_field;
+        Stat_getsetlist[i].closure = &Stat_fields[i];
+    }
     PyType_Ready(&Stat_Type);
     PyType_Ready(&Command_Type);
     PyType_Ready(&Error_Type);
@@ -1598,9 +1598,6 @@ property_names = [
     ('c', _("C bounds:"))
 ]
 
-def dist((x,y,z),(p,q,r)):
-    return ((x-p)**2 + (y-q)**2 + (z-r)**2) ** .5
-
 # returns units/sec
 def get_jog_speed(a):
     if vars.joint_mode.get() or a in (0,1,2,6,7,8):
@@ -1718,16 +1715,12 @@ class TclCommands(nf.TclCommands):
                 fmt = "%.4f"
 
             mf = vars.max_speed.get()
-            #print o.canon.traverse[0]
-
-            g0 = sum(dist(l[1][:3], l[2][:3]) for l in o.canon.traverse)
-            g1 = (sum(dist(l[1][:3], l[2][:3]) for l in o.canon.feed) +
-                sum(dist(l[1][:3], l[2][:3]) for l in o.canon.arcfeed))
-            gt = (sum(dist(l[1][:3], l[2][:3])/min(mf, l[3]) for l in o.canon.feed) +
-                sum(dist(l[1][:3], l[2][:3])/min(mf, l[3])  for l in o.canon.arcfeed) +
-                sum(dist(l[1][:3], l[2][:3])/mf  for l in o.canon.traverse) +
-                o.canon.dwell_time
-                )
+
+            g0, t0 = o.canon.traverse.totals(mf)
+            g1, t1 = o.canon.feed.totals(mf)
+            ga, ta = o.canon.arcfeed.totals(mf)
+            g1 += ga
+            gt = t0 + t1 + ta + o.canon.dwell_time
  
             props['g0'] = "%f %s".replace("%f", fmt) % (from_internal_linear_unit(g0, conv), units)
             props['g1'] = "%f %s".replace("%f", fmt) % (from_internal_linear_unit(g1, conv), units)
@@ -2990,6 +2983,7 @@ c.wait_complete()
 
 o = MyOpengl(widgets.preview_frame, width=400, height=300, double=1, depth=1)
 o.last_line = 1
+o.preview_cache = inifile.find("DISPLAY", "PREVIEW_CACHE")
 o.pack(fill="both", expand=1)
 
 def match_grid_size(v):
@@ -0,0 +1,248 @@
+#!/usr/bin/env python2
+#    Keeps the previews of a directory of G-code programs up to date
+#
+#    This program is free software; you can redistribute it and/or modify
+#    it under the terms of the GNU General Public License as published by
+#    the Free Software Foundation; either version 2 of the License, or
+#    (at your option) any later version.
+#
+#    This program is distributed in the hope that it will be useful,
+#    but WITHOUT ANY WARRANTY; without even the implied warranty of
+#    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#    GNU General Public License for more details.
+#
+#    You should have received a copy of the GNU General Public License
+#    along with this program; if not, write to the Free Software
+#    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+"""preview-cache: parses the programs in some directories, in parallel,
+whenever they change, and keeps their previews in [DISPLAY]PREVIEW_CACHE
+for AXIS and gremlin, which then open them without parsing them.
+
+Programs are parsed the way AXIS parses them, with the tool table, units
+and axes of the running LinuxCNC and the startup code and parameter file
+of its ini file.  A program with a [FILTER] is left to the GUI."""
+
+import sys, os, getopt, time, shutil, tempfile, multiprocessing
+import linuxcnc, gcode
+from rs274.glcanon import GLCanon
+from rs274.interpret import StatMixin
+from rs274 import previewcache
+
+EXTENSIONS = ('.ngc', '.nc', '.tap')
+
+def usage(exitcode=1):
+    print >>sys.stderr, """\
+Usage: preview-cache [-ini file.ini] [-d cachedir] [-j jobs] [-p seconds]
+                     [-1] [-v] [directory...]
+       preview-cache [-ini file.ini] [-d cachedir] -l [directory...]"""
+    sys.exit(exitcode)
+
+class Snapshot:
+    """What the canon asks linuxcnc.stat for, copied so that it can be
+    sent to the workers"""
+    def __init__(self, s):
+        self.tool_table = [tuple(t) for t in s.tool_table]
+        self.linear_units = s.linear_units
+        self.angular_units = s.angular_units
+        self.axis_mask = s.axis_mask
+        self.block_delete = s.block_delete
+
+class Settings:
+    """How AXIS parses a program on this machine"""
+    def __init__(self, inifile, s, cachedir):
+        self.cachedir = cachedir
+        self.parameter = inifile.find("RS274NGC", "PARAMETER_FILE")
+        self.initcode = inifile.find("EMC", "RS274NGC_STARTUP_CODE") or \
+            inifile.find("RS274NGC", "RS274NGC_STARTUP_CODE") or ""
+        self.interpname = inifile.find("TASK", "INTERPRETER") or ""
+        self.unitcode = ""
+        if not self.interpname:
+            self.unitcode = "G%d" % (20 + (s.linear_units == 1))
+        self.random = int(inifile.find("EMCIO", "RANDOM_TOOLCHANGER") or 0)
+        self.arcdivision = int(inifile.find("DISPLAY", "ARCDIVISION") or 64)
+
+class CacheCanon(GLCanon, StatMixin):
+    # the dwells keep the names of their colors, for the GUI's own
+    colors = {'dwell': 'dwell', 'm1xx': 'm1xx'}
+
+    def __init__(self, snapshot, settings, parameter_file):
+        GLCanon.__init__(self, self.colors, 'XYZ')
+        StatMixin.__init__(self, snapshot, settings.random)
+        self.arcdivision = settings.arcdivision
+        self.parameter_file = parameter_file
+
+    def change_tool(self, pocket):
+        GLCanon.change_tool(self, pocket)
+        StatMixin.change_tool(self, pocket)
+
+    def key(self, filename, settings):
+        return previewcache.key(filename, self, settings.unitcode,
+            settings.initcode, settings.interpname)
+
+tempdir = None
+
+def parse(task):
+    """Parses a program and saves its preview, in a worker process"""
+    filename, snapshot, settings = task
+    parameter = os.path.join(tempdir, "%d.var" % os.getpid())
+    try:
+        if settings.parameter and os.path.exists(settings.parameter):
+            shutil.copy(settings.parameter, parameter)
+        canon = CacheCanon(snapshot, settings, parameter)
+        canon.preview.arcdivision = canon.arcdivision
+        k = canon.key(filename, settings)
+        t0 = time.time()
+        try:
+            result, seq = gcode.parse(filename, canon, settings.unitcode,
+                settings.initcode, settings.interpname)
+        except KeyboardInterrupt:
+            result, seq = 0, 0
+        t1 = time.time()
+        previewcache.save(settings.cachedir, filename, canon, k, result, seq)
+    except Exception, detail:
+        return filename, None, "%s: %s" % (filename, detail)
+    if result > gcode.MIN_ERROR:
+        report = "%s: line %d: %s" % (filename, seq, gcode.strerror(result))
+    else:
+        report = "%s: %d segments in %.2f s" % (filename,
+            len(canon.traverse) + len(canon.feed) + len(canon.arcfeed),
+            t1 - t0)
+    return filename, k, report
+
+def programs(directories, inifile):
+    for d in directories:
+        try:
+            names = os.listdir(d)
+        except OSError:
+            continue
+        for name in names:
+            ext = os.path.splitext(name)[1]
+            if ext.lower() not in EXTENSIONS or inifile.find("FILTER", ext[1:]):
+                continue
+            filename = os.path.abspath(os.path.join(d, name))
+            if os.path.isfile(filename):
+                yield filename
+
+def cached_key(cachedir, filename):
+    try:
+        return previewcache.read(
+            previewcache.cache_file(cachedir, filename))[1].get('key')
+    except (IOError, OSError, ValueError, EOFError):
+        return None
+
+def list_cache(cachedir, directories, inifile):
+    for filename in sorted(programs(directories, inifile)):
+        try:
+            preview, meta = previewcache.read(
+                previewcache.cache_file(cachedir, filename))
+        except (IOError, OSError, ValueError, EOFError):
+            print "%s: not cached" % filename
+            continue
+        if meta['result'] > gcode.MIN_ERROR:
+            print "%s: line %d: %s" % (filename, meta['seq'], meta['error'])
+        else:
+            print "%s: %d segments" % (filename, len(preview.traverse)
+                + len(preview.feed) + len(preview.arcfeed))
+
+def main():
+    global tempdir
+    inipath = os.environ.get("INI_FILE_NAME")
+    cachedir = None
+    jobs = multiprocessing.cpu_count()
+    period = 2.0
+    once = verbose = listing = False
+
+    if len(sys.argv) > 2 and sys.argv[1] == '-ini':
+        inipath = sys.argv[2]
+        del sys.argv[1:3]
+    try:
+        opts, args = getopt.getopt(sys.argv[1:], "d:j:p:1vlh")
+    except getopt.GetoptError, detail:
+        print >>sys.stderr, detail
+        usage()
+    for o, a in opts:
+        if o == '-d': cachedir = a
+        elif o == '-j': jobs = int(a)
+        elif o == '-p': period = float(a)
+        elif o == '-1': once = True
+        elif o == '-v': verbose = True
+        elif o == '-l': listing = True
+        else: usage(0)
+    if not inipath: usage()
+    # the interpreter reads SUBROUTINE_PATH and the rest from here, and
+    # so does the key of a preview
+    os.environ["INI_FILE_NAME"] = inipath
+
+    inifile = linuxcnc.ini(inipath)
+    inidir = os.path.dirname(os.path.abspath(inipath))
+    cachedir = cachedir or inifile.find("DISPLAY", "PREVIEW_CACHE")
+    directories = args or [inifile.find("DISPLAY", "PROGRAM_PREFIX") or "."]
+    directories = [os.path.join(inidir, os.path.expanduser(d))
+        for d in directories]
+    if not cachedir:
+        print >>sys.stderr, "preview-cache: no -d and no [DISPLAY]PREVIEW_CACHE"
+        sys.exit(1)
+    cachedir = os.path.join(inidir, os.path.expanduser(cachedir))
+    if listing:
+        list_cache(cachedir, directories, inifile)
+        return
+    if not os.path.isdir(cachedir):
+        os.makedirs(cachedir)
+
+    nmlfile = inifile.find("EMC", "NML_FILE")
+    if nmlfile:
+        linuxcnc.nmlfile = os.path.join(inidir, nmlfile)
+    s = linuxcnc.stat()
+    try:
+        s.poll()
+    except linuxcnc.error, detail:
+        print >>sys.stderr, "preview-cache: LinuxCNC is not running: %s" % detail
+        sys.exit(1)
+    settings = Settings(inifile, s, cachedir)
+    if settings.parameter:
+        settings.parameter = os.path.join(inidir, settings.parameter)
+
+    # the interpreter keeps its state in globals, so each parse gets a
+    # process of its own, from a pool started once
+    tempdir = tempfile.mkdtemp()
+    pool = multiprocessing.Pool(max(jobs, 1))
+    known = {}          # program -> key of its cached preview
+    try:
+        while 1:
+            s.poll()
+            snapshot = Snapshot(s)
+            probe = CacheCanon(snapshot, settings, settings.parameter)
+            seen = set()
+            stale = []
+            for filename in programs(directories, inifile):
+                seen.add(filename)
+                try:
+                    k = probe.key(filename, settings)
+                except OSError:
+                    continue
+                if filename not in known:
+                    known[filename] = cached_key(cachedir, filename)
+                if known[filename] != k:
+                    stale.append((filename, snapshot, settings))
+            for filename in set(known) - seen:
+                del known[filename]
+                try:
+                    os.unlink(previewcache.cache_file(cachedir, filename))
+                except OSError:
+                    pass
+            for filename, k, report in pool.imap_unordered(parse, stale):
+                known[filename] = k
+                if verbose or k is None:
+                    print report
+                    sys.stdout.flush()
+            if once: break
+            time.sleep(period)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        pool.terminate()
+        shutil.rmtree(tempdir, ignore_errors=True)
+
+if __name__ == '__main__':
+    main()
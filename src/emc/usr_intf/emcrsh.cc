@@ -27,10 +27,16 @@
 #include <sys/socket.h>
 #include <sys/uio.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <fcntl.h>
 #include <pthread.h>
 #include <errno.h>
 #include <limits.h>
 
+#include <deque>
+#include <string>
+
 #include <getopt.h>
 
 #include "rcs.hh"
@@ -49,7 +55,7 @@
 
   emcrsh {-- --port <port number> --name <server name> --connectpw <password>
              --enablepw <password> --sessions <max sessions> --path <path>
-             -ini<inifile>}
+             --threads <workers> -ini<inifile>}
 
   With -- --port Waits for socket connections (Telnet) on specified socket, without port
             uses default port 5007.
@@ -60,6 +66,7 @@
             to max sessions. Default is no limit (-1).
   With -- --path Sets the base path to program (G-Code) files, default is "../../nc_files/".
             Make sure to include the final slash (/).
+  With -- --threads <workers> Sets the number of threads handling commands, default 4.
   With -- -ini <inifile>, uses inifile instead of emc.ini. 
 
   There are six commands supported, Where the commands set and get contain EMC
@@ -456,7 +463,17 @@ typedef struct {
   int commProt;
   char inBuf[256];
   char outBuf[4096];
-  char progName[PATH_MAX];} connectionRecType;
+  char progName[PATH_MAX];
+  char *tokSave;	// strtok_r() position in inBuf
+  // the fields below are shared between the event loop and the workers,
+  // and are protected by connMutex; except that while busy, the worker
+  // appends to out without it, the event loop leaves out alone then
+  std::string in;	// received, not yet handled
+  std::string out;	// replies not yet sent
+  bool busy;		// queued for, or being handled by, a worker
+  bool closing;		// the client went away or quit
+  bool polled;		// registered with epoll
+  } connectionRecType;
 
 int port = 5007;
 int server_sockfd;
@@ -472,6 +489,34 @@ char enablePWD[16] = "EMCTOO\0";
 char serverName[24] = "EMCNETSVR\0";
 int sessions = 0;
 int maxSessions = -1;
+int numWorkers = 4;
+
+// one thread waits for socket events and does all reads, accepts and
+// closes; a fixed pool of workers runs the commands.  A connection is
+// handled by at most one worker at a time, so its commands run in order.
+static int epollFd;
+static pthread_mutex_t connMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t workCond = PTHREAD_COND_INITIALIZER;
+static std::deque<connectionRecType *> workQueue;
+
+// the command parsers share the status buffer and the globals of shcom,
+// so only one worker runs commands at a time; a worker waiting for task
+// to get or finish a command lets go of it while it sleeps, see waitSleep()
+static pthread_mutex_t cmdMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// held from before a command that may write to task until task has got
+// it, as far as set_wait asks: the command channel holds one message,
+// and a write from another client must not replace it.  Taken before
+// cmdMutex.
+static pthread_mutex_t writeMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// get commands arriving within STATUS_SHARE_TIME of each other use the
+// same status message instead of each peeking the status channel
+#define STATUS_SHARE_TIME 0.01
+static double statusTime = 0;
+
+// most a client may have buffered without a line terminator
+#define MAX_PENDING 65536
 
 const char *setCommands[] = {
   "ECHO", "VERBOSE", "ENABLE", "CONFIG", "COMM_MODE", "COMM_PROT", "INIFILE", "PLAT", "INI", "DEBUG",
@@ -498,6 +543,7 @@ struct option longopts[] = {
   {"connectpw", 1, NULL, 'w'},
   {"enablepw", 1, NULL, 'e'},
   {"path", 1, NULL, 'd'},
+  {"threads", 1, NULL, 't'},
   {0,0,0,0}};
 
 /* static char *skipWhite(char *s)
@@ -513,7 +559,9 @@ static void thisQuit()
     EMC_NULL emc_null_msg;
 
     if (emcStatusBuffer != 0) {
-	// wait until current message has been received
+	// wait until current message has been received; this runs in the
+	// signal handler, which doesn't hold cmdMutex
+	emcCommandWaitSleep = esleep;
 	emcCommandWaitReceived(emcCommandSerialNumber);
     }
 
@@ -555,7 +603,7 @@ static int initSockets()
   server_address.sin_port = htons(port);
   server_len = sizeof(server_address);
   bind(server_sockfd, (struct sockaddr *)&server_address, server_len);
-  listen(server_sockfd, 5);
+  listen(server_sockfd, SOMAXCONN);
 
   // ignore SIGCHLD
   {
@@ -574,10 +622,30 @@ static void sigQuit(int sig)
     thisQuit();
 }
 
+// replies are collected and sent when the worker is done with the
+// connection, so a batch of pipelined commands goes out in one write
+static int sockSend(connectionRecType *context, const char *s)
+{
+   size_t len = strlen(s);
+
+   context->out.append(s, len);
+   return len;
+}
+
 static int sockWrite(connectionRecType *context)
 {
    strcat(context->outBuf, "\r\n");
-   return write(context->cliSock, context->outBuf, strlen(context->outBuf));
+   return sockSend(context, context->outBuf);
+}
+
+static void shareStatus()
+{
+   double now = etime();
+
+   if (now - statusTime >= STATUS_SHARE_TIME) {
+     updateStatus();
+     statusTime = now;
+     }
 }
 
 static setCommandType lookupSetCommand(char *s)
@@ -599,18 +667,18 @@ static int commandHello(connectionRecType *context)
 {
   char *pch;
 
-  pch = strtok(NULL, delims);
+  pch = strtok_r(NULL, delims, &context->tokSave);
   if (pch == NULL) return -1;
   if (strcmp(pch, pwd) != 0) return -1;
 
-  pch = strtok(NULL, delims);
+  pch = strtok_r(NULL, delims, &context->tokSave);
   if (pch == NULL) return -1;
   strncpy(context->hostName, pch, sizeof(context->hostName));
   if (context->hostName[sizeof(context->hostName)-1] != '\0') {
     return -1;
   }
 
-  pch = strtok(NULL, delims);
+  pch = strtok_r(NULL, delims, &context->tokSave);
   if (pch == NULL) return -1;
   strncpy(context->version, pch, sizeof(context->version));
   if (context->version[sizeof(context->version)-1] != '\0') {
@@ -800,7 +868,7 @@ static cmdResponseType setCommProt(char *s, connectionRecType *context)
 {
   char *pVersion;
   
-  pVersion = strtok(NULL, delims);
+  pVersion = strtok_r(NULL, delims, &context->tokSave);
   if (pVersion == NULL) return rtStandardError;
   strcpy(context->version, pVersion);
   return rtNoError;
@@ -811,7 +879,7 @@ static cmdResponseType setDebug(char *s, connectionRecType *context)
   char *pLevel;
   int level;
   
-  pLevel = strtok(NULL, delims);
+  pLevel = strtok_r(NULL, delims, &context->tokSave);
   if (pLevel == NULL) return rtStandardError;
   if (sscanf(pLevel, "%i", &level) == -1) return rtStandardError;
   else sendDebug(level);
@@ -963,13 +1031,13 @@ static cmdResponseType setToolOffset(char *s, connectionRecType *context)
   float length, diameter;
   char *pch;
   
-  pch = strtok(NULL, delims);
+  pch = strtok_r(NULL, delims, &context->tokSave);
   if (pch == NULL) return rtStandardError;
   if (sscanf(pch, "%d", &tool) <= 0) return rtStandardError;
-  pch = strtok(NULL, delims);
+  pch = strtok_r(NULL, delims, &context->tokSave);
   if (pch == NULL) return rtStandardError;
   if (sscanf(pch, "%f", &length) <= 0) return rtStandardError;
-  pch = strtok(NULL, delims);
+  pch = strtok_r(NULL, delims, &context->tokSave);
   if (pch == NULL) return rtStandardError;
   if (sscanf(pch, "%f", &diameter) <= 0) return rtStandardError;
   
@@ -991,7 +1059,7 @@ static cmdResponseType setMDI(char *s, connectionRecType *context)
 {
   char *pch;
   
-  pch = strtok(NULL, "\n\r\0");
+  pch = strtok_r(NULL, "\n\r\0", &context->tokSave);
   if (sendMdiCmd(pch) !=0) return rtStandardError;
   return rtNoError;
 }
@@ -1024,11 +1092,11 @@ static cmdResponseType setJog(char *s, connectionRecType *context)
   float speed;
   char *pch;
   
-  pch = strtok(NULL, delims);
+  pch = strtok_r(NULL, delims, &context->tokSave);
   if (pch == NULL) return rtStandardError;
   if (sscanf(pch, "%d", &axis) <= 0) return rtStandardError;
   if ((axis < 0) || (axis > 5)) return rtStandardError;
-  pch = strtok(NULL, delims);
+  pch = strtok_r(NULL, delims, &context->tokSave);
   if (pch == NULL) return rtStandardError;
   if (sscanf(pch, "%f", &speed) <= 0) return rtStandardError; 
   if (sendJogCont(axis, speed) != 0) return rtStandardError;
@@ -1051,14 +1119,14 @@ static cmdResponseType setJogIncr(char *s, connectionRecType *context)
   float speed, incr;
   char *pch;
   
-  pch = strtok(NULL, delims);
+  pch = strtok_r(NULL, delims, &context->tokSave);
   if (pch == NULL) return rtStandardError;
   if (sscanf(pch, "%d", &axis) <= 0) return rtStandardError;
   if ((axis < 0) || (axis > 5)) return rtStandardError;
-  pch = strtok(NULL, delims);
+  pch = strtok_r(NULL, delims, &context->tokSave);
   if (pch == NULL) return rtStandardError;
   if (sscanf(pch, "%f", &speed) <= 0) return rtStandardError; 
-  pch = strtok(NULL, delims);
+  pch = strtok_r(NULL, delims, &context->tokSave);
   if (pch == NULL) return rtStandardError;
   if (sscanf(pch, "%f", &incr) <= 0) return rtStandardError; 
   if (sendJogIncr(axis, speed, incr) != 0) return rtStandardError;
@@ -1075,7 +1143,7 @@ static cmdResponseType setOpen(char *s, connectionRecType *context)
 {
   char *pch;
 
-  pch = strtok(NULL, "\n\r\0");
+  pch = strtok_r(NULL, "\n\r\0", &context->tokSave);
   if (pch == NULL) return rtStandardError;
 
   strncpy(context->progName, pch, sizeof(context->progName));
@@ -1168,15 +1236,15 @@ static cmdResponseType setProbe(char *s, connectionRecType *context)
   float x, y, z;
   char *pch;
   
-  pch = strtok(NULL, delims);
+  pch = strtok_r(NULL, delims, &context->tokSave);
   if (pch == NULL) return rtStandardError;
   if (sscanf(pch, "%f", &x) <= 0) return rtStandardError;
 
-  pch = strtok(NULL, delims);
+  pch = strtok_r(NULL, delims, &context->tokSave);
   if (pch == NULL) return rtStandardError;
   if (sscanf(pch, "%f", &y) <= 0) return rtStandardError;
 
-  pch = strtok(NULL, delims);
+  pch = strtok_r(NULL, delims, &context->tokSave);
   if (pch == NULL) return rtStandardError;
   if (sscanf(pch, "%f", &z) <= 0) return rtStandardError;
   
@@ -1217,15 +1285,15 @@ int commandSet(connectionRecType *context)
   char *pch;
   cmdResponseType ret = rtNoError;
   
-  pch = strtok(NULL, delims);
+  pch = strtok_r(NULL, delims, &context->tokSave);
   if (pch == NULL) {
-    return write(context->cliSock, setNakStr, strlen(setNakStr));
+    return sockSend(context, setNakStr);
     }
   strupr(pch);
   cmd = lookupSetCommand(pch);
   if ((cmd >= scIniFile) && (context->cliSock != enabledConn)) {
     sprintf(context->outBuf, setCmdNakStr, pch);
-    return write(context->cliSock, context->outBuf, strlen(context->outBuf));
+    return sockSend(context, context->outBuf);
     }
   if ((cmd > scMachine) && (emcStatus->task.state != EMC_TASK_STATE_ON)) {
 //  Extra check in the event of an undetected change in Machine state resulting in
@@ -1233,44 +1301,44 @@ int commandSet(connectionRecType *context)
 //  and appropriate error messages are generated, however erratic behavior has been
 //  seen when doing certain set commands when the Machine state is other than 'On'.
     sprintf(context->outBuf, setCmdNakStr, pch);
-    return write(context->cliSock, context->outBuf, strlen(context->outBuf));
+    return sockSend(context, context->outBuf);
     }
   switch (cmd) {
-    case scEcho: ret = setEcho(strtok(NULL, delims), context); break;
-    case scVerbose: ret = setVerbose(strtok(NULL, delims), context); break;
-    case scEnable: ret = setEnable(strtok(NULL, delims), context); break;
-    case scConfig: ret = setConfig(strtok(NULL, delims), context); break;
-    case scCommMode: ret = setCommMode(strtok(NULL, delims), context); break;
-    case scCommProt: ret = setCommProt(strtok(NULL, delims), context); break;
+    case scEcho: ret = setEcho(strtok_r(NULL, delims, &context->tokSave), context); break;
+    case scVerbose: ret = setVerbose(strtok_r(NULL, delims, &context->tokSave), context); break;
+    case scEnable: ret = setEnable(strtok_r(NULL, delims, &context->tokSave), context); break;
+    case scConfig: ret = setConfig(strtok_r(NULL, delims, &context->tokSave), context); break;
+    case scCommMode: ret = setCommMode(strtok_r(NULL, delims, &context->tokSave), context); break;
+    case scCommProt: ret = setCommProt(strtok_r(NULL, delims, &context->tokSave), context); break;
     case scIniFile: break;
     case scPlat: break;
     case scIni: break;
-    case scDebug: ret = setDebug(strtok(NULL, delims), context); break;
-    case scSetWait: ret = setSetWait(strtok(NULL, delims), context); break;
-    case scWait: ret = setWait(strtok(NULL, delims), context); break;
-    case scSetTimeout: ret = setTimeout(strtok(NULL, delims), context); break;
-    case scUpdate: ret = setUpdate(strtok(NULL, delims), context); break;
+    case scDebug: ret = setDebug(strtok_r(NULL, delims, &context->tokSave), context); break;
+    case scSetWait: ret = setSetWait(strtok_r(NULL, delims, &context->tokSave), context); break;
+    case scWait: ret = setWait(strtok_r(NULL, delims, &context->tokSave), context); break;
+    case scSetTimeout: ret = setTimeout(strtok_r(NULL, delims, &context->tokSave), context); break;
+    case scUpdate: ret = setUpdate(strtok_r(NULL, delims, &context->tokSave), context); break;
     case scError: ret = rtStandardError; break;
     case scOperatorDisplay: ret = rtStandardError; break;
     case scOperatorText: ret = rtStandardError; break;
     case scTime: ret = rtStandardError; break;
-    case scEStop: ret = setEStop(strtok(NULL, delims), context); break;
-    case scMachine: ret = setMachine(strtok(NULL, delims), context); break;
-    case scMode: ret = setMode(strtok(NULL, delims), context); break;
-    case scMist: ret = setMist(strtok(NULL, delims), context); break;
-    case scFlood: ret = setFlood(strtok(NULL, delims), context); break;
-    case scLube: ret = setLube(strtok(NULL, delims), context); break;
+    case scEStop: ret = setEStop(strtok_r(NULL, delims, &context->tokSave), context); break;
+    case scMachine: ret = setMachine(strtok_r(NULL, delims, &context->tokSave), context); break;
+    case scMode: ret = setMode(strtok_r(NULL, delims, &context->tokSave), context); break;
+    case scMist: ret = setMist(strtok_r(NULL, delims, &context->tokSave), context); break;
+    case scFlood: ret = setFlood(strtok_r(NULL, delims, &context->tokSave), context); break;
+    case scLube: ret = setLube(strtok_r(NULL, delims, &context->tokSave), context); break;
     case scLubeLevel: ret = rtStandardError; break;
-    case scSpindle: ret = setSpindle(strtok(NULL, delims), context); break;
-    case scBrake: ret = setBrake(strtok(NULL, delims), context); break;
+    case scSpindle: ret = setSpindle(strtok_r(NULL, delims, &context->tokSave), context); break;
+    case scBrake: ret = setBrake(strtok_r(NULL, delims, &context->tokSave), context); break;
     case scTool: ret = rtStandardError; break;
     case scToolOffset: ret = setToolOffset(pch, context); break;
-    case scLoadToolTable: ret = setLoadToolTable(strtok(NULL, delims), context); break;
-    case scHome: ret = setHome(strtok(NULL, delims), context); break;
-    case scJogStop: ret = setJogStop(strtok(NULL, delims), context); break;
+    case scLoadToolTable: ret = setLoadToolTable(strtok_r(NULL, delims, &context->tokSave), context); break;
+    case scHome: ret = setHome(strtok_r(NULL, delims, &context->tokSave), context); break;
+    case scJogStop: ret = setJogStop(strtok_r(NULL, delims, &context->tokSave), context); break;
     case scJog: ret = setJog(pch, context); break;
     case scJogIncr: ret = setJogIncr(pch, context); break;
-    case scFeedOverride: ret = setFeedOverride(strtok(NULL, delims), context); break;
+    case scFeedOverride: ret = setFeedOverride(strtok_r(NULL, delims, &context->tokSave), context); break;
     case scAbsCmdPos: ret = rtStandardError; break;
     case scAbsActPos: ret = rtStandardError; break;
     case scRelCmdPos: ret = rtStandardError; break;
@@ -1283,7 +1351,7 @@ int commandSet(connectionRecType *context)
     case scMDI: ret = setMDI(pch, context); break;
     case scTskPlanInit: ret = setTaskPlanInit(pch, context); break;
     case scOpen: ret = setOpen(pch, context); break;
-    case scRun: ret = setRun(strtok(NULL, delims), context); break;
+    case scRun: ret = setRun(strtok_r(NULL, delims, &context->tokSave), context); break;
     case scPause: ret = setPause(pch, context); break;
     case scResume: ret = setResume(pch, context); break;
     case scAbort: ret = setAbort(pch, context); break;
@@ -1301,34 +1369,34 @@ int commandSet(connectionRecType *context)
     case scUserAngularUnits: ret = rtStandardError; break;
     case scDisplayLinearUnits: ret = rtStandardError; break;
     case scDisplayAngularUnits: ret = rtStandardError; break;
-    case scLinearUnitConversion: ret = setLinearUnitConversion(strtok(NULL, delims), context); break;
-    case scAngularUnitConversion: ret = setAngularUnitConversion(strtok(NULL, delims), context); break;
+    case scLinearUnitConversion: ret = setLinearUnitConversion(strtok_r(NULL, delims, &context->tokSave), context); break;
+    case scAngularUnitConversion: ret = setAngularUnitConversion(strtok_r(NULL, delims, &context->tokSave), context); break;
     case scProbeClear: ret = setProbeClear(pch, context); break;
     case scProbeTripped: ret = rtStandardError; break;
     case scProbeValue: ret = rtStandardError; break;
     case scProbe: ret = setProbe(pch, context); break;
-    case scTeleopEnable: ret = setTeleopEnable(strtok(NULL, delims), context); break;
+    case scTeleopEnable: ret = setTeleopEnable(strtok_r(NULL, delims, &context->tokSave), context); break;
     case scKinematicsType: ret = rtStandardError; break;
-    case scOverrideLimits: ret = setOverrideLimits(strtok(NULL, delims), context); break;
-    case scSpindleOverride: ret = setSpindleOverride(strtok(NULL, delims), context); break;
-    case scOptionalStop: ret = setOptionalStop(strtok(NULL, delims), context); break;
+    case scOverrideLimits: ret = setOverrideLimits(strtok_r(NULL, delims, &context->tokSave), context); break;
+    case scSpindleOverride: ret = setSpindleOverride(strtok_r(NULL, delims, &context->tokSave), context); break;
+    case scOptionalStop: ret = setOptionalStop(strtok_r(NULL, delims, &context->tokSave), context); break;
     case scUnknown: ret = rtStandardError;
     }
   switch (ret) {
     case rtNoError:  
       if (context->verbose) {
         sprintf(context->outBuf, ackStr, pch);
-        return write(context->cliSock, context->outBuf, strlen(context->outBuf));
+        return sockSend(context, context->outBuf);
         }
       break;
     case rtHandledNoError: // Custom ok response already handled, take no action
       break; 
     case rtStandardError:
       sprintf(context->outBuf, setCmdNakStr, pch);
-      return write(context->cliSock, context->outBuf, strlen(context->outBuf));
+      return sockSend(context, context->outBuf);
       break;
     case rtCustomError: // Custom error response entered in buffer
-      return write(context->cliSock, context->outBuf, strlen(context->outBuf));
+      return sockSend(context, context->outBuf);
       break;
     case rtCustomHandledError: ;// Custom error respose handled, take no action
     }
@@ -2277,15 +2345,15 @@ int commandGet(connectionRecType *context)
   char *pch;
   cmdResponseType ret = rtNoError;
   
-  pch = strtok(NULL, delims);
+  pch = strtok_r(NULL, delims, &context->tokSave);
   if (pch == NULL) {
-    return write(context->cliSock, setNakStr, strlen(setNakStr));
+    return sockSend(context, setNakStr);
     }
-  if (emcUpdateType == EMC_UPDATE_AUTO) updateStatus();
+  if (emcUpdateType == EMC_UPDATE_AUTO) shareStatus();
   strupr(pch);
   cmd = lookupSetCommand(pch);
   if (cmd > scIni)
-    if (emcUpdateType == EMC_UPDATE_AUTO) updateStatus();
+    if (emcUpdateType == EMC_UPDATE_AUTO) shareStatus();
   switch (cmd) {
     case scEcho: ret = getEcho(pch, context); break;
     case scVerbose: ret = getVerbose(pch, context); break;
@@ -2322,15 +2390,15 @@ int commandGet(connectionRecType *context)
     case scJog: ret = rtStandardError; break;
     case scJogIncr: ret = rtStandardError; break;
     case scFeedOverride: ret = getFeedOverride(pch, context); break;
-    case scAbsCmdPos: ret = getAbsCmdPos(strtok(NULL, delims), context); break;
-    case scAbsActPos: ret = getAbsActPos(strtok(NULL, delims), context); break;
-    case scRelCmdPos: ret = getRelCmdPos(strtok(NULL, delims), context); break;
-    case scRelActPos: ret = getRelActPos(strtok(NULL, delims), context); break;
-    case scJointPos: ret = getJointPos(strtok(NULL, delims), context); break;
-    case scPosOffset: ret = getPosOffset(strtok(NULL, delims), context); break;
-    case scJointLimit: ret = getJointLimit(strtok(NULL, delims), context); break;
-    case scJointFault: ret = getJointFault(strtok(NULL, delims), context); break;
-    case scJointHomed: ret = getJointHomed(strtok(NULL, delims), context); break;
+    case scAbsCmdPos: ret = getAbsCmdPos(strtok_r(NULL, delims, &context->tokSave), context); break;
+    case scAbsActPos: ret = getAbsActPos(strtok_r(NULL, delims, &context->tokSave), context); break;
+    case scRelCmdPos: ret = getRelCmdPos(strtok_r(NULL, delims, &context->tokSave), context); break;
+    case scRelActPos: ret = getRelActPos(strtok_r(NULL, delims, &context->tokSave), context); break;
+    case scJointPos: ret = getJointPos(strtok_r(NULL, delims, &context->tokSave), context); break;
+    case scPosOffset: ret = getPosOffset(strtok_r(NULL, delims, &context->tokSave), context); break;
+    case scJointLimit: ret = getJointLimit(strtok_r(NULL, delims, &context->tokSave), context); break;
+    case scJointFault: ret = getJointFault(strtok_r(NULL, delims, &context->tokSave), context); break;
+    case scJointHomed: ret = getJointHomed(strtok_r(NULL, delims, &context->tokSave), context); break;
     case scMDI: ret = rtStandardError; break;
     case scTskPlanInit: ret = rtStandardError; break;
     case scOpen: ret = rtStandardError; break;
@@ -2343,8 +2411,8 @@ int commandGet(connectionRecType *context)
     case scProgramLine: ret = getProgramLine(pch, context); break;
     case scProgramStatus: ret = getProgramStatus(pch, context); break;
     case scProgramCodes: ret = getProgramCodes(pch, context); break;
-    case scJointType: ret = getJointType(strtok(NULL, delims), context); break;
-    case scJointUnits: ret = getJointUnits(strtok(NULL, delims), context); break;
+    case scJointType: ret = getJointType(strtok_r(NULL, delims, &context->tokSave), context); break;
+    case scJointUnits: ret = getJointUnits(strtok_r(NULL, delims, &context->tokSave), context); break;
     case scProgramUnits: 
     case scProgramLinearUnits: ret = getProgramLinearUnits(pch, context); break;
     case scProgramAngularUnits: ret = getProgramAngularUnits(pch, context); break;
@@ -2582,7 +2650,7 @@ int commandHelp(connectionRecType *context)
 {
   char *pch;
   
-  pch = strtok(NULL, delims);
+  pch = strtok_r(NULL, delims, &context->tokSave);
   if (pch == NULL) return (helpGeneral(context));
   strupr(pch);
   if (strcmp(pch, "HELLO") == 0) return (helpHello(context));
@@ -2622,23 +2690,25 @@ int parseCommand(connectionRecType *context)
   static const char *helloAckStr = "HELLO ACK %s 1.1\r\n";
   static const char *setNakStr = "SET NAK\r\n";
     
-  pch = strtok(context->inBuf, delims);
+  pch = strtok_r(context->inBuf, delims, &context->tokSave);
   sprintf(s, helloAckStr, serverName);
   if (pch != NULL) {
     strupr(pch);
     switch (lookupToken(pch)) {
       case cmdHello: 
         if (commandHello(context) == -1)
-          ret = write(context->cliSock, helloNakStr, strlen(helloNakStr));
-        else ret = write(context->cliSock, s, strlen(s));
+          ret = sockSend(context, helloNakStr);
+        else ret = sockSend(context, s);
         break;
       case cmdGet: 
         ret = commandGet(context);
         break;
       case cmdSet:
         if (!context->linked)
-	  ret = write(context->cliSock, setNakStr, strlen(setNakStr));
+	  ret = sockSend(context, setNakStr);
         else ret = commandSet(context);
+        // the next get should see what this set did
+        statusTime = 0;
         break;
       case cmdQuit: 
         ret = commandQuit(context);
@@ -2646,7 +2716,7 @@ int parseCommand(connectionRecType *context)
       case cmdShutdown:
         ret = commandShutdown(context);
         if(ret ==0){
-          ret = write(context->cliSock, shutdownNakStr, strlen(shutdownNakStr));
+          ret = sockSend(context, shutdownNakStr);
         }
 	break;
       case cmdHelp:
@@ -2658,120 +2728,323 @@ int parseCommand(connectionRecType *context)
   return ret;
 }  
 
-void *readClient(void *arg)
-{
-  char buf[1600];
-  int context_index;
-  int i;
-  int len;
-  connectionRecType *context = (connectionRecType *)arg;
+// set the socket events the event loop waits for; called with connMutex held
+static void watchClient(connectionRecType *context)
+{
+  struct epoll_event ev;
+
+  ev.events = 0;
+  ev.data.ptr = context;
+  if (context->busy) {
+    // keep reading ahead while a worker runs the earlier commands
+    if (!context->closing && context->in.size() < MAX_PENDING)
+      ev.events = EPOLLIN;
+  } else if (context->closing) {
+    ev.events = context->out.empty() ? EPOLLIN : EPOLLOUT;
+  } else {
+    ev.events = EPOLLIN;
+    if (!context->out.empty())
+      ev.events |= EPOLLOUT;
+  }
 
-  context_index = 0;
+  // hangups are reported even with no events asked for, so take the
+  // socket out of the set until the worker is done with it
+  if (ev.events == 0) {
+    if (context->polled)
+      epoll_ctl(epollFd, EPOLL_CTL_DEL, context->cliSock, &ev);
+    context->polled = false;
+  } else {
+    epoll_ctl(epollFd, context->polled ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
+      context->cliSock, &ev);
+    context->polled = true;
+  }
+}
 
-  while (1) {
-    // We always start this loop with an empty buf, though there may be one
-    // partial line in context->inBuf[0..context_index].
-    len = read(context->cliSock, buf, sizeof(buf));
-    if (len < 0) {
-      fprintf(stderr, "linuxcncrsh: error reading from client: %s\n", strerror(errno));
-      goto finished;
-    }
-    if (len == 0) {
-      printf("linuxcncrsh: eof from client\n");
-      goto finished;
+// send what we can of the pending replies without blocking; called with
+// connMutex held
+static void flushClient(connectionRecType *context)
+{
+  while (!context->out.empty()) {
+    ssize_t len = write(context->cliSock, context->out.data(), context->out.size());
+    if (len > 0) {
+      context->out.erase(0, len);
+      continue;
     }
+    if (len < 0 && errno == EINTR) continue;
+    if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+    // the client is gone, nobody will read the rest
+    context->out.clear();
+    context->closing = true;
+  }
+}
+
+static void closeClient(connectionRecType *context)
+{
+  printf("linuxcncrsh: disconnecting client %s (%s)\n", context->hostName, context->version);
+  if (enabledConn == context->cliSock) enabledConn = -1;
+  close(context->cliSock);
+  delete context;
+  sessions--;
+}
 
+// emcCommandWaitReceived() and emcCommandWaitDone() sleep with this, so
+// that while one client waits for task, the others' gets still run
+static void waitSleep(double secs)
+{
+  pthread_mutex_unlock(&cmdMutex);
+  esleep(secs);
+  pthread_mutex_lock(&cmdMutex);
+}
+
+// gets only read the status, they don't need writeMutex
+static bool isGet(const char *line)
+{
+  line += strspn(line, delims);
+  return strncasecmp(line, "get", 3) == 0 &&
+    (line[3] == '\0' || strchr(delims, line[3]) != NULL);
+}
+
+// run the commands in lines, each of which ends in a line terminator;
+// returns true if one of them was quit
+static bool handleLines(connectionRecType *context, const std::string &lines)
+{
+  size_t start = 0, eol, len;
+  bool quit = false, get;
+
+  while (start < lines.size()) {
+    eol = lines.find_first_of("\r\n", start);
     if (context->echo && context->linked)
-      if(write(context->cliSock, buf, len) != (ssize_t)len) {
-        fprintf(stderr, "linuxcncrsh: write() failed: %s", strerror(errno));
-      }
+      context->out.append(lines, start, eol + 1 - start);
+    len = eol - start;
+    if (len > 0) {
+      if (len > sizeof(context->inBuf) - 1) len = sizeof(context->inBuf) - 1;
+      memcpy(context->inBuf, lines.data() + start, len);
+      context->inBuf[len] = '\0';
+
+      get = isGet(context->inBuf);
+      if (!get) pthread_mutex_lock(&writeMutex);
+      pthread_mutex_lock(&cmdMutex);
+      // Replies are buffered, so the only way parseCommand can
+      // return -1 is the quit command.  Other paths return small
+      // positive integers (cmdResponseType) or a reply length.
+      if (parseCommand(context) == -1) quit = true;
+      pthread_mutex_unlock(&cmdMutex);
+      if (!get) pthread_mutex_unlock(&writeMutex);
+      if (quit) break;
+    }
+    start = eol + 1;
+  }
+  return quit;
+}
 
-    for (i = 0; i < len; i ++) {
-        if ((buf[i] != '\n') && (buf[i] != '\r')) {
-            context->inBuf[context_index] = buf[i];
-            context_index ++;
-            continue;
-        }
+void *workerThread(void *arg)
+{
+  connectionRecType *context;
+  std::string lines;
+  size_t end;
 
-        // if we get here, i is the index of a line terminator in buf
+  while (1) {
+    pthread_mutex_lock(&connMutex);
+    while (workQueue.empty())
+      pthread_cond_wait(&workCond, &connMutex);
+    context = workQueue.front();
+    workQueue.pop_front();
+    // take every complete line, pipelined commands are run as one batch
+    end = context->in.find_last_of("\r\n");
+    lines.assign(context->in, 0, end + 1);
+    context->in.erase(0, end + 1);
+    pthread_mutex_unlock(&connMutex);
+
+    bool quit = handleLines(context, lines);
+
+    pthread_mutex_lock(&connMutex);
+    if (quit) {
+      // nothing the client sent after quit gets run
+      context->closing = true;
+      context->in.clear();
+    }
+    flushClient(context);
+    if (!quit && context->in.find_first_of("\r\n") != std::string::npos) {
+      // more arrived while we were busy, stay on it
+      workQueue.push_back(context);
+      pthread_cond_signal(&workCond);
+    } else {
+      context->busy = false;
+      // the event loop frees closing connections once their replies
+      // are out; shutting down the socket wakes it up
+      if (context->closing && context->out.empty())
+        shutdown(context->cliSock, SHUT_RDWR);
+    }
+    watchClient(context);
+    pthread_mutex_unlock(&connMutex);
+  }
+  return NULL;
+}
 
-        if (context_index > 0) {
-            // we have some bytes in the context buffer, parse them now
-            context->inBuf[context_index] = '\0';
+// read everything the client sent and hand complete lines to a worker;
+// returns false if the connection was closed
+static bool readClient(connectionRecType *context)
+{
+  char buf[1600];
+  ssize_t len;
+  bool eof = false;
 
-            // The return value from parseCommand was meant to indicate
-            // success or error, but it is unusable.  Some paths return
-            // the return value of write(2) and some paths return small
-            // positive integers (cmdResponseType) to indicate failure.
-            // We're best off just ignoring it.
-            (void)parseCommand(context);
+  pthread_mutex_lock(&connMutex);
+  while (!context->closing) {
+    len = read(context->cliSock, buf, sizeof(buf));
+    if (len > 0) {
+      context->in.append(buf, len);
+      if (context->in.size() >= MAX_PENDING) break;
+      continue;
+    }
+    if (len < 0 && errno == EINTR) continue;
+    if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+    if (len < 0)
+      fprintf(stderr, "linuxcncrsh: error reading from client: %s\n", strerror(errno));
+    else
+      printf("linuxcncrsh: eof from client\n");
+    context->closing = true;
+    eof = true;
+  }
 
-            context_index = 0;
-        }
+  if (!context->busy) {
+    if ((!context->closing || eof) &&
+        context->in.find_first_of("\r\n") != std::string::npos) {
+      // commands that came in with the eof still get run, but nothing
+      // is queued for a connection that quit or failed before
+      context->busy = true;
+      workQueue.push_back(context);
+      pthread_cond_signal(&workCond);
+    } else if (context->in.size() >= MAX_PENDING) {
+      fprintf(stderr, "linuxcncrsh: line too long from client %s\n", context->hostName);
+      context->closing = true;
+      context->out.clear();
+    }
+    if (!context->busy && context->closing && context->out.empty()) {
+      pthread_mutex_unlock(&connMutex);
+      closeClient(context);
+      return false;
     }
   }
+  watchClient(context);
+  pthread_mutex_unlock(&connMutex);
+  return true;
+}
 
-finished:
-  printf("linuxcncrsh: disconnecting client %s (%s)\n", context->hostName, context->version);
-  close(context->cliSock);
-  free(context);
-  pthread_exit((void *)0);
-  sessions--;  // FIXME: not reached
+static void writeClient(connectionRecType *context)
+{
+  pthread_mutex_lock(&connMutex);
+  if (!context->busy) {
+    flushClient(context);
+    if (context->closing && context->out.empty()) {
+      pthread_mutex_unlock(&connMutex);
+      closeClient(context);
+      return;
+    }
+    watchClient(context);
+  }
+  pthread_mutex_unlock(&connMutex);
+}
+
+static void acceptClients()
+{
+  struct epoll_event ev;
+  int client_sockfd;
+  int optval = 1;
+
+  while (1) {
+    client_len = sizeof(client_address);
+    client_sockfd = accept(server_sockfd,
+      (struct sockaddr *)&client_address, &client_len);
+    if (client_sockfd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+      exit(0);
+    }
+    if ((maxSessions != -1) && (sessions >= maxSessions)) {
+      close(client_sockfd);
+      continue;
+    }
+    fcntl(client_sockfd, F_SETFL, fcntl(client_sockfd, F_GETFL) | O_NONBLOCK);
+    // replies are already batched, don't let Nagle hold them back
+    setsockopt(client_sockfd, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(optval));
+
+    connectionRecType *context = new connectionRecType;
+    context->cliSock = client_sockfd;
+    context->linked = false;
+    context->echo = true;
+    context->verbose = false;
+    strcpy(context->version, "1.0");
+    strcpy(context->hostName, "Default");
+    context->enabled = false;
+    context->commMode = 0;
+    context->commProt = 0;
+    context->inBuf[0] = 0;
+    context->busy = false;
+    context->closing = false;
+    context->polled = true;
+
+    ev.events = EPOLLIN;
+    ev.data.ptr = context;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, client_sockfd, &ev) < 0) {
+      fprintf(stderr, "linuxcncrsh: epoll_ctl: %s\n", strerror(errno));
+      close(client_sockfd);
+      delete context;
+      continue;
+    }
+    sessions++;
+  }
 }
 
 int sockMain()
 {
-    int res;
-    
+    struct epoll_event ev, events[64];
+    pthread_t thrd;
+    int n, i;
+
+    epollFd = epoll_create(64);
+    if (epollFd < 0) {
+      fprintf(stderr, "linuxcncrsh: epoll_create: %s\n", strerror(errno));
+      exit(1);
+    }
+    fcntl(server_sockfd, F_SETFL, fcntl(server_sockfd, F_GETFL) | O_NONBLOCK);
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, server_sockfd, &ev);
+
+    for (i = 0; i < numWorkers; i++) {
+      if (pthread_create(&thrd, NULL, workerThread, NULL) != 0) {
+        fprintf(stderr, "linuxcncrsh: can't start worker thread\n");
+        exit(1);
+      }
+      pthread_detach(thrd);
+    }
+
     while (1) {
-      int client_sockfd;
-
-      client_len = sizeof(client_address);
-      client_sockfd = accept(server_sockfd,
-        (struct sockaddr *)&client_address, &client_len);
-      if (client_sockfd < 0) exit(0);
-      sessions++;
-      if ((maxSessions == -1) || (sessions <= maxSessions)) {
-        pthread_t *thrd;
-        connectionRecType *context;
-
-        thrd = (pthread_t *)calloc(1, sizeof(pthread_t));
-        if (thrd == NULL) {
-          fprintf(stderr, "linuxcncrsh: out of memory\n");
-          exit(1);
-        }
+      n = epoll_wait(epollFd, events, 64, -1);
+      if (n < 0) {
+        if (errno == EINTR) continue;
+        exit(0);
+      }
+      for (i = 0; i < n; i++) {
+        connectionRecType *context = (connectionRecType *)events[i].data.ptr;
 
-        context = (connectionRecType *) malloc(sizeof(connectionRecType));
         if (context == NULL) {
-          fprintf(stderr, "linuxcncrsh: out of memory\n");
-          exit(1);
+          acceptClients();
+          continue;
         }
-
-        context->cliSock = client_sockfd;
-        context->linked = false;
-        context->echo = true;
-        context->verbose = false;
-        strcpy(context->version, "1.0");
-        strcpy(context->hostName, "Default");
-        context->enabled = false;
-        context->commMode = 0;
-        context->commProt = 0;
-        context->inBuf[0] = 0;
-
-        res = pthread_create(thrd, NULL, readClient, (void *)context);
-      } else {
-        res = -1;
+        if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+          if (!readClient(context)) continue;
+        if (events[i].events & EPOLLOUT)
+          writeClient(context);
       }
-      if (res != 0) {
-        close(client_sockfd);
-        sessions--;
-        }
-     }
+    }
     return 0;
 }
 
 static void initMain()
 {
+    emcCommandWaitSleep = waitSleep;
     emcWaitType = EMC_WAIT_RECEIVED;
     emcCommandSerialNumber = 0;
     saveEmcCommandSerialNumber = 0;
@@ -2801,9 +3074,10 @@ static void usage(char* pname) {
            "         --enablepw   <password>     (default=%s)\n"
            "         --sessions   <max sessions> (default=%d) (-1 ==> no limit) \n"
            "         --path       <path>         (default=%s)\n"
+           "         --threads    <workers>      (default=%d)\n"
            "emcOptions:\n"
            "          -ini        <inifile>      (default=%s)\n"
-          ,pname,port,serverName,pwd,enablePWD,maxSessions,defaultPath,emc_inifile
+          ,pname,port,serverName,pwd,enablePWD,maxSessions,defaultPath,numWorkers,emc_inifile
           );
 }
 
@@ -2813,7 +3087,7 @@ int main(int argc, char *argv[])
 
     initMain();
     // process local command line args
-    while((opt = getopt_long(argc, argv, "he:n:p:s:w:d:", longopts, NULL)) != - 1) {
+    while((opt = getopt_long(argc, argv, "he:n:p:s:w:d:t:", longopts, NULL)) != - 1) {
       switch(opt) {
         case 'h': usage(argv[0]); exit(1);
         case 'e': strncpy(enablePWD, optarg, strlen(optarg) + 1); break;
@@ -2821,7 +3095,10 @@ int main(int argc, char *argv[])
         case 'p': sscanf(optarg, "%d", &port); break;
         case 's': sscanf(optarg, "%d", &maxSessions); break;
         case 'w': strncpy(pwd, optarg, strlen(optarg) + 1); break;
-        case 'd': strncpy(defaultPath, optarg, strlen(optarg) + 1);
+        case 'd': strncpy(defaultPath, optarg, strlen(optarg) + 1); break;
+        case 't': sscanf(optarg, "%d", &numWorkers);
+                  if (numWorkers < 1) numWorkers = 1;
+                  break;
         }
       }
 
@@ -77,6 +77,7 @@ class Gremlin(gtk.gtkgl.widget.DrawingArea, glnav.GlNavBase,
             s = self.colors[s]
             return [int(x * 255) for x in s + (a,)]
         self.inifile = inifile
+        self.preview_cache = inifile.find("DISPLAY", "PREVIEW_CACHE")
         self.logger = linuxcnc.positionlogger(linuxcnc.stat(),
             C('backplotjog'),
             C('backplottraverse'),
@@ -21,8 +21,13 @@
 #include <stdlib.h>
 #include <signal.h>
 #include <math.h>
+#include <poll.h>
+#include <string>
+#include <vector>
 
 #include "hal.h"		/* access to HAL functions/definitions */
+#include "hal_priv.h"		/* pin list, for the names of the inputs */
+#include "hal_notify.h"		/* waiting for the inputs to change */
 #include "rtapi.h"		/* rtapi_print_msg */
 #include "rcs.hh"
 #include "posemath.h"		// PM_POSE, TO_RAD
@@ -376,12 +381,32 @@ typedef halui_str_base<VALUE> local_halui_str;
 static halui_str *halui_data;
 static local_halui_str old_halui_data;
 
+// the input pins, with their values as of the last look; the main
+// loop only runs check_hal_changes() when one of them differs
+struct halui_watch {
+    hal_type_t type;
+    void **pin;			// the pin's pointer, which follows linking
+    union {
+	bool b;
+	int s;
+	double f;
+    } old;
+};
+static std::vector<halui_watch> watched;
+
 static char *mdi_commands[MDI_MAX];
 static int num_mdi_commands=0;
 static int have_home_all = 0;
 
 static int comp_id, done;				/* component ID, main while loop */
 
+// the inputs are waited for through the notify component when it is
+// loaded; NML has no way to wait for a status message, so it is looked
+// for once per task cycle, which is when task writes one
+static hal_notify_t *notify = 0;
+static double status_period = 0.01;	// [TASK]CYCLE_TIME
+#define HALUI_WATCHDOG 0.1	// seconds between full passes
+
 static int num_axes = 3; //number of axes, taken from the ini [TRAJ] section
 
 static double maxFeedOverride=1;
@@ -408,6 +433,10 @@ static int emcCommandSerialNumber = 100000;
 static double receiveTimeout = 1.;
 static double doneTimeout = 60.;
 
+// set when a new status message comes in, cleared when the HAL pins
+// have been brought up to date with it
+static int status_pending = 0;
+
 static void quit(int sig)
 {
     done = 1;
@@ -536,7 +565,10 @@ static int updateStatus()
 	break;
 
     case 0:			// no new data
+	break;
+
     case EMC_STAT_TYPE:	// new data
+	status_pending = 1;
 	break;
 
     default:
@@ -548,7 +580,7 @@ static int updateStatus()
 }
 
 
-#define EMC_COMMAND_DELAY   0.1	// how long to sleep between checks
+#define EMC_COMMAND_DELAY   0.001	// how long to sleep between checks
 
 /*
   emcCommandWaitReceived() waits until the EMC reports that it got
@@ -559,9 +591,9 @@ static int updateStatus()
 
 static int emcCommandWaitReceived(int serial_number)
 {
-    double end = 0.0;
+    double end = etime() + receiveTimeout;
 
-    while (end < receiveTimeout) {
+    do {
 	updateStatus();
 
 	if (emcStatus->echo_serial_number == serial_number) {
@@ -569,22 +601,22 @@ static int emcCommandWaitReceived(int serial_number)
 	}
 
 	esleep(EMC_COMMAND_DELAY);
-	end += EMC_COMMAND_DELAY;
-    }
+    } while (etime() < end);
 
     return -1;
 }
 
 static int emcCommandWaitDone(int serial_number)
 {
-    double end = 0.0;
+    double end;
 
     // first get it there
     if (0 != emcCommandWaitReceived(serial_number)) {
 	return -1;
     }
     // now wait until it, or subsequent command (e.g., abort) is done
-    while (end < doneTimeout) {
+    end = etime() + doneTimeout;
+    do {
 	updateStatus();
 
 	if (emcStatus->status == RCS_DONE) {
@@ -596,13 +628,13 @@ static int emcCommandWaitDone(int serial_number)
 	}
 
 	esleep(EMC_COMMAND_DELAY);
-	end += EMC_COMMAND_DELAY;
-    }
+    } while (etime() < end);
     return -1;
 }
 
 static void thisQuit()
 {
+    if (notify) hal_notify_close(notify);
     //don't forget the big HAL sin ;)
     hal_exit(comp_id);
     
@@ -636,6 +668,114 @@ static enum {
 #define GRAD_PER_DEG (100.0/90.0)
 #define RAD_PER_DEG TO_RAD	// from posemath.h
 
+// reads the current value of a watched pin; halcmd may move the pin's
+// pointer to a signal at any time
+static void watch_value(halui_watch &w, bool *b, int *s, double *f)
+{
+    volatile void *data = *(void * volatile *)w.pin;
+
+    switch (w.type) {
+    case HAL_BIT: *b = *(hal_bit_t *)data; break;
+    case HAL_S32: *s = *(hal_s32_t *)data; break;
+    default: *f = *(hal_float_t *)data; break;
+    }
+}
+
+// pin is the address of the pin's pointer, as passed to hal_pin_*_new()
+static void watch_input(hal_type_t type, void *pin)
+{
+    halui_watch w;
+
+    w.type = type;
+    w.pin = (void **)pin;
+    watch_value(w, &w.old.b, &w.old.s, &w.old.f);
+    watched.push_back(w);
+}
+
+// compare the input pins against their last values, and remember the
+// new ones
+static bool inputs_changed()
+{
+    bool changed = false;
+
+    for (size_t n = 0; n < watched.size(); n++) {
+	halui_watch &w = watched[n];
+	bool b = false;
+	int s = 0;
+	double f = 0;
+
+	watch_value(w, &b, &s, &f);
+	switch (w.type) {
+	case HAL_BIT:
+	    if (b != w.old.b) { w.old.b = b; changed = true; }
+	    break;
+	case HAL_S32:
+	    if (s != w.old.s) { w.old.s = s; changed = true; }
+	    break;
+	default:
+	    if (f != w.old.f) { w.old.f = f; changed = true; }
+	    break;
+	}
+    }
+    return changed;
+}
+
+// asks the notify component to report changes of the input pins; if it
+// isn't loaded, the inputs are compared once per status period instead
+static void notify_inputs()
+{
+    std::vector<std::string> names;
+    hal_pin_t *pin;
+    int next;
+
+    if (hal_notify_open(comp_id, &notify) < 0) {
+	notify = 0;
+	return;
+    }
+    rtapi_mutex_get(&(hal_data->mutex));
+    for (next = hal_data->pin_list_ptr; next != 0; next = pin->next_ptr) {
+	pin = (hal_pin_t *) SHMPTR(next);
+	for (size_t n = 0; n < watched.size(); n++) {
+	    if (SHMPTR(pin->data_ptr_addr) == (void *)watched[n].pin) {
+		names.push_back(pin->name);
+		break;
+	    }
+	}
+    }
+    rtapi_mutex_give(&(hal_data->mutex));
+    for (size_t n = 0; n < names.size(); n++) {
+	if (hal_notify_add(notify, names[n].c_str()) < 0) {
+	    rtapi_print_msg(RTAPI_MSG_ERR,
+		"HALUI: can't watch %s, polling the inputs\n", names[n].c_str());
+	    hal_notify_close(notify);
+	    notify = 0;
+	    return;
+	}
+    }
+}
+
+// sleeps until an input changes, or for at most 'timeout' seconds
+static void wait_for_changes(double timeout)
+{
+    struct pollfd pfd;
+    hal_notify_event_t event;
+
+    if (timeout < 0)
+	timeout = 0;
+    if (!notify) {
+	esleep(timeout);
+	return;
+    }
+    pfd.fd = hal_notify_fd(notify);
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, (int)(timeout * 1000 + 0.5)) > 0) {
+	// the values are compared by inputs_changed(), the events only
+	// say that there is something to compare
+	while (hal_notify_read(notify, &event) > 0)
+	    ;
+    }
+}
+
 int halui_export_pin_IN_bit(hal_bit_t **pin, const char *name)
 {
     int retval;
@@ -645,6 +785,7 @@ int halui_export_pin_IN_bit(hal_bit_t **pin, const char *name)
 	hal_exit(comp_id);
 	return -1;
     }
+    watch_input(HAL_BIT, pin);
     return 0;
 }
 
@@ -657,6 +798,7 @@ int halui_export_pin_IN_s32(hal_s32_t **pin, const char *name)
 	hal_exit(comp_id);
 	return -1;
     }
+    watch_input(HAL_S32, pin);
     return 0;
 }
 
@@ -669,6 +811,7 @@ int halui_export_pin_IN_float(hal_float_t **pin, const char *name)
 	hal_exit(comp_id);
 	return -1;
     }
+    watch_input(HAL_FLOAT, pin);
     return 0;
 }
 
@@ -953,38 +1096,54 @@ int halui_hal_init(void)
     for (joint=0; joint < num_axes ; joint++) {
 	retval =  hal_pin_bit_newf(HAL_IN, &(halui_data->joint_home[joint]), comp_id, "halui.joint.%d.home", joint); 
 	if (retval < 0) return retval;
+	watch_input(HAL_BIT, &halui_data->joint_home[joint]);
 	retval =  hal_pin_bit_newf(HAL_IN, &(halui_data->joint_unhome[joint]), comp_id, "halui.joint.%d.unhome", joint);
 	if (retval < 0) return retval;
+	watch_input(HAL_BIT, &halui_data->joint_unhome[joint]);
 	retval =  hal_pin_bit_newf(HAL_IN, &(halui_data->joint_nr_select[joint]), comp_id, "halui.joint.%d.select", joint); 
 	if (retval < 0) return retval;
+	watch_input(HAL_BIT, &halui_data->joint_nr_select[joint]);
 	retval =  hal_pin_bit_newf(HAL_IN, &(halui_data->jog_plus[joint]), comp_id, "halui.jog.%d.plus", joint); 
 	if (retval < 0) return retval;
+	watch_input(HAL_BIT, &halui_data->jog_plus[joint]);
 	retval =  hal_pin_bit_newf(HAL_IN, &(halui_data->jog_minus[joint]), comp_id, "halui.jog.%d.minus", joint); 
 	if (retval < 0) return retval;
+	watch_input(HAL_BIT, &halui_data->jog_minus[joint]);
 	retval =  hal_pin_float_newf(HAL_IN, &(halui_data->jog_analog[joint]), comp_id, "halui.jog.%d.analog", joint); 
 	if (retval < 0) return retval;
+	watch_input(HAL_FLOAT, &halui_data->jog_analog[joint]);
 	retval =  hal_pin_float_newf(HAL_IN, &(halui_data->jog_increment[joint]), comp_id, "halui.jog.%d.increment", joint);
 	if (retval < 0) return retval;
+	watch_input(HAL_FLOAT, &halui_data->jog_increment[joint]);
 	retval =  hal_pin_bit_newf(HAL_IN, &(halui_data->jog_increment_plus[joint]), comp_id, "halui.jog.%d.increment-plus", joint);
 	if (retval < 0) return retval;
+	watch_input(HAL_BIT, &halui_data->jog_increment_plus[joint]);
 	retval =  hal_pin_bit_newf(HAL_IN, &(halui_data->jog_increment_minus[joint]), comp_id, "halui.jog.%d.increment-minus", joint);
 	if (retval < 0) return retval;
+	watch_input(HAL_BIT, &halui_data->jog_increment_minus[joint]);
     }
 
     retval =  hal_pin_bit_newf(HAL_IN, &(halui_data->joint_home[num_axes]), comp_id, "halui.joint.selected.home"); 
     if (retval < 0) return retval;
+    watch_input(HAL_BIT, &halui_data->joint_home[num_axes]);
     retval =  hal_pin_bit_newf(HAL_IN, &(halui_data->joint_unhome[num_axes]), comp_id, "halui.joint.selected.unhome");
     if (retval < 0) return retval;
+    watch_input(HAL_BIT, &halui_data->joint_unhome[num_axes]);
     retval =  hal_pin_bit_newf(HAL_IN, &(halui_data->jog_plus[num_axes]), comp_id, "halui.jog.selected.plus"); 
     if (retval < 0) return retval;
+    watch_input(HAL_BIT, &halui_data->jog_plus[num_axes]);
     retval =  hal_pin_bit_newf(HAL_IN, &(halui_data->jog_minus[num_axes]), comp_id, "halui.jog.selected.minus"); 
     if (retval < 0) return retval;
+    watch_input(HAL_BIT, &halui_data->jog_minus[num_axes]);
     retval =  hal_pin_float_newf(HAL_IN, &(halui_data->jog_increment[num_axes]), comp_id, "halui.jog.selected.increment");
     if (retval < 0) return retval;
+    watch_input(HAL_FLOAT, &halui_data->jog_increment[num_axes]);
     retval =  hal_pin_bit_newf(HAL_IN, &(halui_data->jog_increment_plus[num_axes]), comp_id, "halui.jog.selected.increment-plus");
     if (retval < 0) return retval;
+    watch_input(HAL_BIT, &halui_data->jog_increment_plus[num_axes]);
     retval =  hal_pin_bit_newf(HAL_IN, &(halui_data->jog_increment_minus[num_axes]), comp_id, "halui.jog.selected.increment-minus");
     if (retval < 0) return retval;
+    watch_input(HAL_BIT, &halui_data->jog_increment_minus[num_axes]);
     retval = halui_export_pin_IN_float(&(halui_data->jog_speed), "halui.jog-speed");
     if (retval < 0) return retval;
     retval = halui_export_pin_IN_float(&(halui_data->jog_deadband), "halui.jog-deadband");
@@ -994,6 +1153,7 @@ int halui_hal_init(void)
     for (int n=0; n<num_mdi_commands; n++) {
         retval = hal_pin_bit_newf(HAL_IN, &(halui_data->mdi_commands[n]), comp_id, "halui.mdi-command-%02d", n);
         if (retval < 0) return retval;
+        watch_input(HAL_BIT, &halui_data->mdi_commands[n]);
     }
 
     hal_ready(comp_id);
@@ -1535,6 +1695,12 @@ static int iniLoad(const char *filename)
 	// not found, use default
     }
 
+    if (NULL != (inistring = inifile.Find("CYCLE_TIME", "TASK"))) {
+	if (1 == sscanf(inistring, "%lf", &d) && d > 0.0) {
+	    status_period = d;
+	}
+    }
+
     if (NULL != (inistring = inifile.Find("MAX_FEED_OVERRIDE", "DISPLAY"))) {
 	if (1 == sscanf(inistring, "%lf", &d) && d > 0.0) {
 	    maxFeedOverride =  d;
@@ -1916,8 +2082,10 @@ static void check_hal_changes()
 	    if (bit != 0) {
 		*halui_data->joint_selected = joint;
 		select_changed = joint; // flag that we changed the selected joint
-	    } 
-	    old_halui_data.joint_home[joint] = bit;
+	    }
+	    // its own slot: stored in joint_home, a held select pin used
+	    // to swallow the rising edge of halui.joint.N.home
+	    old_halui_data.joint_nr_select[joint] = bit;
 	}
     }
     
@@ -2159,15 +2327,32 @@ int main(int argc, char *argv[])
     /* catch SIGTERM too - the run script uses it to shut things down */
     signal(SIGTERM, quit);
 
+    notify_inputs();
+
+    // wake up when an input changes, and once per status period to look
+    // for a new status message, and only do the work for the side that
+    // changed; every HALUI_WATCHDOG seconds do a full pass whether or
+    // not anything did
+    double next_full = 0, next_status = 0;
     while (!done) {
+	double now = etime();
+	bool full = now >= next_full;
 
-	check_hal_changes(); //if anything changed send NML messages
+	if (inputs_changed() || full)
+	    check_hal_changes(); //if anything changed send NML messages
 
-	modify_hal_pins(); //if status changed modify HAL too
-	
-	esleep(0.02); //sleep for a while
-	
-	updateStatus();
+	if (now >= next_status || full) {
+	    updateStatus();
+	    next_status = now + status_period;
+	}
+	if (status_pending || full) {
+	    modify_hal_pins(); //if status changed modify HAL too
+	    status_pending = 0;
+	}
+
+	if (full)
+	    next_full = now + HALUI_WATCHDOG;
+	wait_for_changes(next_status - etime());
     }
     thisQuit();
     return 0;
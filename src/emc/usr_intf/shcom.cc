@@ -277,6 +277,10 @@ int updateError()
 
 #define EMC_COMMAND_DELAY   0.1	// how long to sleep between checks
 
+// a server that runs commands for several clients can hook this, to let
+// the others run while one waits
+void (*emcCommandWaitSleep)(double secs) = esleep;
+
 /*
   emcCommandWaitReceived() waits until the EMC reports that it got
   the command with the indicated serial_number.
@@ -295,7 +299,7 @@ int emcCommandWaitReceived(int serial_number)
 	    return 0;
 	}
 
-	esleep(EMC_COMMAND_DELAY);
+	emcCommandWaitSleep(EMC_COMMAND_DELAY);
 	end += EMC_COMMAND_DELAY;
     }
 
@@ -322,7 +326,7 @@ int emcCommandWaitDone(int serial_number)
 	    return -1;
 	}
 
-	esleep(EMC_COMMAND_DELAY);
+	emcCommandWaitSleep(EMC_COMMAND_DELAY);
 	end += EMC_COMMAND_DELAY;
     }
 
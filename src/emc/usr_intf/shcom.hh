@@ -91,6 +91,8 @@ extern int updateStatus();
 extern int updateError();
 extern int emcCommandWaitReceived(int serial_number);
 extern int emcCommandWaitDone(int serial_number);
+// what the two above sleep with between checks, esleep() by default
+extern void (*emcCommandWaitSleep)(double secs);
 extern double convertLinearUnits(double u);
 extern double convertAngularUnits(double u);
 extern int sendDebug(int level);
@@ -28,6 +28,16 @@
     called in a high speed thread, at least twice the maximum desired
     count rate.  "encoder.capture-position" can be called at a much
     slower rate, and updates the output variables.
+
+    With 'packed=1', the phase A, B, Z and latch inputs of all
+    counters are read from one u32 pin, "encoder.packed-input",
+    four bits per counter: counter N uses bit 4N for phase A,
+    4N+1 for phase B, 4N+2 for phase Z and 4N+3 for latch.  The
+    word is compared with the previous one, and only counters
+    whose inputs changed are decoded, so the cost of
+    "encoder.update-counters" hardly depends on the number of
+    counters.  hal_parport's "pins-in" pin has this layout for
+    two counters on the data pins of an input port.
 */
 
 /** Copyright (C) 2003 John Kasunich
@@ -78,6 +88,9 @@ RTAPI_MP_INT(num_chan, "number of encoder channels");
 char *names[MAX_CHAN] = {0,};
 RTAPI_MP_ARRAY_STRING(names, MAX_CHAN, "names of encoder");
 
+static int packed;
+RTAPI_MP_INT(packed, "read all inputs from encoder.packed-input");
+
 /***********************************************************************
 *                STRUCTURES AND GLOBAL VARIABLES                       *
 ************************************************************************/
@@ -109,12 +122,12 @@ typedef struct {
     atomic buf[2];		/* u:w c:r double buffer for atomic data */
     volatile atomic *bp;	/* u:r c:w ptr to in-use buffer */
     hal_s32_t *raw_counts;	/* u:rw raw count value, in update() only */
-    hal_bit_t *phaseA;		/* u:r quadrature input */
-    hal_bit_t *phaseB;		/* u:r quadrature input */
-    hal_bit_t *phaseZ;		/* u:r index pulse input */
+    hal_bit_t *phaseA;		/* u:r quadrature input (not if packed) */
+    hal_bit_t *phaseB;		/* u:r quadrature input (not if packed) */
+    hal_bit_t *phaseZ;		/* u:r index pulse input (not if packed) */
     hal_bit_t *index_ena;	/* c:rw index enable input */
     hal_bit_t *reset;		/* c:r counter reset input */
-    hal_bit_t *latch_in;        /* c:r counter latch input */
+    hal_bit_t *latch_in;        /* u:r counter latch input (not if packed) */
     hal_bit_t *latch_rising;    /* u:r latch on rising edge? */
     hal_bit_t *latch_falling;   /* u:r latch on falling edge? */
     __s32 raw_count;		/* c:rw captured raw_count */
@@ -135,11 +148,22 @@ typedef struct {
     int counts_since_timeout;	/* c:rw used for velocity calcs */
 } counter_t;
 
+/* inputs of all counters in one word, for packed mode */
+
+typedef struct {
+    hal_u32_t *in;		/* u:r A, B, Z and latch bits, 4 per counter */
+    __u32 old_in;		/* u:rw value of in on previous cycle */
+    __u32 mask;			/* bits used by the counters */
+} packed_t;
+
 static __u32 timebase;		/* master timestamp for all counters */
 
 /* pointer to array of counter_t structs in shmem, 1 per counter */
 static counter_t *counter_array;
 
+/* pointer to packed input data in shmem, NULL if not packed */
+static packed_t *packed_data;
+
 /* bitmasks for quadrature decode state machine */
 #define SM_PHASE_A_MASK 0x01
 #define SM_PHASE_B_MASK 0x02
@@ -147,6 +171,15 @@ static counter_t *counter_array;
 #define SM_CNT_UP_MASK  0x40
 #define SM_CNT_DN_MASK  0x80
 
+/* input bits of one counter, as passed to update_counter(), and as
+   they are laid out for each counter in the packed input word */
+#define IN_PHASE_A_MASK 0x01
+#define IN_PHASE_B_MASK 0x02
+#define IN_PHASE_Z_MASK 0x04
+#define IN_LATCH_MASK   0x08
+#define IN_ALL_MASK     0x0F
+#define IN_BITS         4
+
 /* Lookup table for quadrature decode state machine.  This machine
    will reject glitches on either input (will count up 1 on glitch,
    down 1 after glitch), and on both inputs simultaneously (no count
@@ -183,6 +216,7 @@ static int comp_id;		/* component ID */
 
 static int export_encoder(counter_t * addr,char * prefix);
 static void update(void *arg, long period);
+static void update_packed(void *arg, long period);
 static void capture(void *arg, long period);
 
 /***********************************************************************
@@ -233,6 +267,27 @@ int rtapi_app_main(void)
 	hal_exit(comp_id);
 	return -1;
     }
+    /* allocate and export the packed input word */
+    if (packed) {
+	packed_data = hal_malloc(sizeof(packed_t));
+	if (packed_data == 0) {
+	    rtapi_print_msg(RTAPI_MSG_ERR,
+		"ENCODER: ERROR: hal_malloc() failed\n");
+	    hal_exit(comp_id);
+	    return -1;
+	}
+	retval = hal_pin_u32_newf(HAL_IN, &(packed_data->in), comp_id,
+	    "encoder.packed-input");
+	if (retval != 0) {
+	    rtapi_print_msg(RTAPI_MSG_ERR,
+		"ENCODER: ERROR: packed input export failed\n");
+	    hal_exit(comp_id);
+	    return -1;
+	}
+	*(packed_data->in) = 0;
+	packed_data->old_in = 0;
+	packed_data->mask = 0xFFFFFFFF >> (32 - howmany * IN_BITS);
+    }
     /* init master timestamp counter */
     timebase = 0;
     /* export all the variables for each counter */
@@ -283,8 +338,8 @@ int rtapi_app_main(void)
 	cntr->counts_since_timeout = 0;
     }
     /* export functions */
-    retval = hal_export_funct("encoder.update-counters", update,
-	counter_array, 0, 0, comp_id);
+    retval = hal_export_funct("encoder.update-counters",
+	packed ? update_packed : update, counter_array, 0, 0, comp_id);
     if (retval != 0) {
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "ENCODER: ERROR: count funct export failed\n");
@@ -314,74 +369,88 @@ void rtapi_app_exit(void)
 *            REALTIME ENCODER COUNTING AND UPDATE FUNCTIONS            *
 ************************************************************************/
 
-static void update(void *arg, long period)
+/* runs the state machines of one counter, for one set of input bits */
+static inline void update_counter(counter_t *cntr, unsigned char in)
 {
-    counter_t *cntr;
     atomic *buf;
-    int n;
     unsigned char state;
     int latch, old_latch, rising, falling;
 
+    buf = (atomic *) cntr->bp;
+    /* get state machine current state, add input bits to state code */
+    state = cntr->state | (in & (SM_PHASE_A_MASK | SM_PHASE_B_MASK));
+    /* look up new state */
+    if ( *(cntr->counter_mode) ) {
+	state = lut_ctr[state & (SM_LOOKUP_MASK & ~SM_PHASE_B_MASK)];
+    } else if ( *(cntr->x4_mode) ) {
+	state = lut_x4[state & SM_LOOKUP_MASK];
+    } else {
+	state = lut_x1[state & SM_LOOKUP_MASK];
+    }
+    /* should we count? */
+    if (state & SM_CNT_UP_MASK) {
+	(*cntr->raw_counts)++;
+	buf->raw_count = *(cntr->raw_counts);
+	buf->timestamp = timebase;
+	buf->count_detected = 1;
+    } else if (state & SM_CNT_DN_MASK) {
+	(*cntr->raw_counts)--;
+	buf->raw_count = *(cntr->raw_counts);
+	buf->timestamp = timebase;
+	buf->count_detected = 1;
+    }
+    /* save state machine state */
+    cntr->state = state;
+    /* get old phase Z state, make room for new bit value */
+    state = cntr->oldZ << 1;
+    /* add new value of phase Z */
+    if (in & IN_PHASE_Z_MASK) {
+	state |= 1;
+    }
+    cntr->oldZ = state & 3;
+    /* test for index enabled and rising edge on phase Z */
+    if ((state & cntr->Zmask) == 1) {
+	/* capture counts, reset Zmask */
+	buf->index_count = *(cntr->raw_counts);
+	buf->index_detected = 1;
+	cntr->Zmask = 0;
+    }
+    /* test for latch enabled and desired edge on latch-in */
+    latch = (in & IN_LATCH_MASK) != 0, old_latch = cntr->old_latch;
+    rising = latch && !old_latch;
+    falling = !latch && old_latch;
+
+    if((rising && *(cntr->latch_rising))
+	    || (falling && *(cntr->latch_falling))) {
+	buf->latch_detected = 1;
+	buf->latch_count = *(cntr->raw_counts);
+    }
+    cntr->old_latch = latch;
+}
+
+static void update(void *arg, long period)
+{
+    counter_t *cntr;
+    int n;
+    unsigned char in;
+
     cntr = arg;
     for (n = 0; n < howmany; n++) {
-	buf = (atomic *) cntr->bp;
-	/* get state machine current state */
-	state = cntr->state;
-	/* add input bits to state code */
+	/* gather the input bits */
+	in = 0;
 	if (*(cntr->phaseA)) {
-	    state |= SM_PHASE_A_MASK;
+	    in |= IN_PHASE_A_MASK;
 	}
 	if (*(cntr->phaseB)) {
-	    state |= SM_PHASE_B_MASK;
-	}
-	/* look up new state */
-	if ( *(cntr->counter_mode) ) {
-	    state = lut_ctr[state & (SM_LOOKUP_MASK & ~SM_PHASE_B_MASK)];
-	} else if ( *(cntr->x4_mode) ) {
-	    state = lut_x4[state & SM_LOOKUP_MASK];
-	} else {
-	    state = lut_x1[state & SM_LOOKUP_MASK];
+	    in |= IN_PHASE_B_MASK;
 	}
-	/* should we count? */
-	if (state & SM_CNT_UP_MASK) {
-	    (*cntr->raw_counts)++;
-	    buf->raw_count = *(cntr->raw_counts);
-	    buf->timestamp = timebase;
-	    buf->count_detected = 1;
-	} else if (state & SM_CNT_DN_MASK) {
-	    (*cntr->raw_counts)--;
-	    buf->raw_count = *(cntr->raw_counts);
-	    buf->timestamp = timebase;
-	    buf->count_detected = 1;
-	}
-	/* save state machine state */
-	cntr->state = state;
-	/* get old phase Z state, make room for new bit value */
-	state = cntr->oldZ << 1;
-	/* add new value of phase Z */
 	if (*(cntr->phaseZ)) {
-	    state |= 1;
+	    in |= IN_PHASE_Z_MASK;
 	}
-	cntr->oldZ = state & 3;
-	/* test for index enabled and rising edge on phase Z */
-	if ((state & cntr->Zmask) == 1) {
-	    /* capture counts, reset Zmask */
-	    buf->index_count = *(cntr->raw_counts);
-	    buf->index_detected = 1;
-	    cntr->Zmask = 0;
+	if (*(cntr->latch_in)) {
+	    in |= IN_LATCH_MASK;
 	}
-        /* test for latch enabled and desired edge on latch-in */
-        latch = *(cntr->latch_in), old_latch = cntr->old_latch;
-        rising = latch && !old_latch;
-        falling = !latch && old_latch;
-
-        if((rising && *(cntr->latch_rising))
-                || (falling && *(cntr->latch_falling))) {
-            buf->latch_detected = 1;
-            buf->latch_count = *(cntr->raw_counts);
-        }
-        cntr->old_latch = latch;
-
+	update_counter(cntr, in);
 	/* move on to next channel */
 	cntr++;
     }
@@ -390,6 +459,34 @@ static void update(void *arg, long period)
     /* done */
 }
 
+/* The state machines are stable: fed the same inputs twice, they
+   neither change state nor count.  So a counter whose four bits
+   are the same as last time has nothing to do, and is skipped.
+   In most base periods most counters see no edge at all.
+*/
+static void update_packed(void *arg, long period)
+{
+    counter_t *cntr;
+    __u32 in, changed;
+
+    cntr = arg;
+    in = *(packed_data->in);
+    /* which counters have new input bits? */
+    changed = (in ^ packed_data->old_in) & packed_data->mask;
+    packed_data->old_in = in;
+    while (changed != 0) {
+	if (changed & IN_ALL_MASK) {
+	    update_counter(cntr, in & IN_ALL_MASK);
+	}
+	/* move on to next channel */
+	changed >>= IN_BITS;
+	in >>= IN_BITS;
+	cntr++;
+    }
+    /* increment main timestamp counter */
+    timebase += period;
+}
+
 
 static void capture(void *arg, long period)
 {
@@ -529,22 +626,31 @@ static int export_encoder(counter_t * addr,char * prefix)
     msg = rtapi_get_msg_level();
     rtapi_set_msg_level(RTAPI_MSG_WARN);
 
-    /* export pins for the quadrature inputs */
-    retval = hal_pin_bit_newf(HAL_IN, &(addr->phaseA), comp_id,
-            "%s.phase-A", prefix);
-    if (retval != 0) {
-	return retval;
-    }
-    retval = hal_pin_bit_newf(HAL_IN, &(addr->phaseB), comp_id,
-            "%s.phase-B", prefix);
-    if (retval != 0) {
-	return retval;
-    }
-    /* export pin for the index input */
-    retval = hal_pin_bit_newf(HAL_IN, &(addr->phaseZ), comp_id,
-            "%s.phase-Z", prefix);
-    if (retval != 0) {
-	return retval;
+    /* in packed mode the inputs come from encoder.packed-input */
+    if (!packed) {
+	/* export pins for the quadrature inputs */
+	retval = hal_pin_bit_newf(HAL_IN, &(addr->phaseA), comp_id,
+		"%s.phase-A", prefix);
+	if (retval != 0) {
+	    return retval;
+	}
+	retval = hal_pin_bit_newf(HAL_IN, &(addr->phaseB), comp_id,
+		"%s.phase-B", prefix);
+	if (retval != 0) {
+	    return retval;
+	}
+	/* export pin for the index input */
+	retval = hal_pin_bit_newf(HAL_IN, &(addr->phaseZ), comp_id,
+		"%s.phase-Z", prefix);
+	if (retval != 0) {
+	    return retval;
+	}
+	/* export pin for position latching */
+	retval = hal_pin_bit_newf(HAL_IN, &(addr->latch_in), comp_id,
+		"%s.latch-input", prefix);
+	if (retval != 0) {
+	    return retval;
+	}
     }
     /* export pin for the index enable input */
     retval = hal_pin_bit_newf(HAL_IO, &(addr->index_ena), comp_id,
@@ -559,11 +665,6 @@ static int export_encoder(counter_t * addr,char * prefix)
 	return retval;
     }
     /* export pins for position latching */
-    retval = hal_pin_bit_newf(HAL_IN, &(addr->latch_in), comp_id,
-            "%s.latch-input", prefix);
-    if (retval != 0) {
-	return retval;
-    }
     retval = hal_pin_bit_newf(HAL_IN, &(addr->latch_rising), comp_id,
             "%s.latch-rising", prefix);
     if (retval != 0) {
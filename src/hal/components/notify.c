@@ -0,0 +1,282 @@
+/********************************************************************
+* Description:  notify.c
+*               A HAL component that tells user space clients when
+*               the pins and signals they watch change, so that they
+*               don't have to poll them.
+*
+* License: GPL Version 2
+*
+********************************************************************/
+/** This file, 'notify.c', is the realtime part of HAL change
+    notification; the client side is in hal/hal_notify.c, and the
+    shared memory layout in hal/hal_notify.h.
+
+    Loading:
+
+    loadrt notify clients=8 watches=256 ring=16384
+    addf notify servo-thread
+
+    'clients' is the number of user space clients that can watch at
+    the same time, 'watches' the number of pins and signals each of
+    them can watch, and 'ring' the size in bytes of each client's ring
+    of changes.  The 'notify' funct can only be added to one thread;
+    changes are seen at the rate of that thread.
+*/
+
+/** This program is free software; you can redistribute it and/or
+    modify it under the terms of version 2 of the GNU General
+    Public License as published by the Free Software Foundation.
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111 USA
+*/
+
+#include "rtapi.h"              /* RTAPI realtime OS API */
+#include "rtapi_app.h"          /* RTAPI realtime module decls */
+#include "rtapi_shmkeys.h"
+#include "rtapi_errno.h"
+#include "hal.h"                /* HAL public API decls */
+#include "hal_notify.h"		/* shared memory layout */
+
+/* kernel and Xenomai RT threads can't make Linux system calls, so
+   those clients poll */
+#if !defined(MODULE) && !defined(RTAPI_XENOMAI)
+#define NOTIFY_DOORBELL 1
+#include <unistd.h>		/* syscall() */
+#include <sys/syscall.h>	/* SYS_futex */
+#include <linux/futex.h>	/* FUTEX_WAKE */
+#endif
+
+/* module information */
+MODULE_DESCRIPTION("Change notification for user space HAL clients");
+MODULE_LICENSE("GPL");
+static int clients = 8;
+RTAPI_MP_INT(clients, "number of clients");
+static int watches = 256;
+RTAPI_MP_INT(watches, "pins and signals each client can watch");
+static int ring = 16384;
+RTAPI_MP_INT(ring, "size of each client's ring of changes, in bytes");
+
+/***********************************************************************
+*                STRUCTURES AND GLOBAL VARIABLES                       *
+************************************************************************/
+
+static int comp_id;		/* component ID */
+static int shmem_id = -1;
+static hal_notify_shm_t *shm;
+static ringbuffer_t *rings;	/* the writer's side of each ring */
+
+/***********************************************************************
+*                  LOCAL FUNCTION DECLARATIONS                         *
+************************************************************************/
+
+static void notify(void *arg, long period);
+
+/***********************************************************************
+*                       INIT AND EXIT CODE                             *
+************************************************************************/
+
+int rtapi_app_main(void)
+{
+    unsigned long size, head_size, watch_size, ring_size;
+    hal_notify_client_t *c;
+    void *shmem_ptr;
+    int n, retval;
+
+    if (clients <= 0 || watches <= 0 ||
+	ring < (int) (4 * sizeof(hal_notify_record_t))) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "NOTIFY: ERROR: clients and watches must be positive, "
+	    "ring at least %d\n", (int) (4 * sizeof(hal_notify_record_t)));
+	return -EINVAL;
+    }
+    comp_id = hal_init("notify");
+    if (comp_id < 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR, "NOTIFY: ERROR: hal_init() failed\n");
+	return -EINVAL;
+    }
+    rings = hal_malloc(clients * sizeof(ringbuffer_t));
+    if (rings == 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "NOTIFY: ERROR: couldn't allocate HAL shared memory\n");
+	hal_exit(comp_id);
+	return -ENOMEM;
+    }
+
+    /* the header and client slots, then the watch tables, then the rings */
+    watch_size = SIZE_ALIGN(watches * sizeof(hal_notify_watch_t));
+    ring_size = SIZE_ALIGN(ring_memsize(0, ring, 0));
+    head_size = sizeof(hal_notify_shm_t) +
+	clients * sizeof(hal_notify_client_t);
+    head_size = SIZE_ALIGN(head_size);
+    size = head_size + clients * (watch_size + ring_size);
+    shmem_id = rtapi_shmem_new(HAL_NOTIFY_SHMEM_KEY, comp_id, size);
+    if (shmem_id < 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "NOTIFY: ERROR: couldn't allocate user/RT shared memory\n");
+	hal_exit(comp_id);
+	return -ENOMEM;
+    }
+    retval = rtapi_shmem_getptr(shmem_id, &shmem_ptr);
+    if (retval < 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "NOTIFY: ERROR: couldn't map user/RT shared memory\n");
+	rtapi_shmem_delete(shmem_id, comp_id);
+	hal_exit(comp_id);
+	return -ENOMEM;
+    }
+    shm = shmem_ptr;
+    memset(shm, 0, size);
+    shm->shm_size = size;
+    shm->num_clients = clients;
+    shm->max_watches = watches;
+#ifdef NOTIFY_DOORBELL
+    shm->can_wake = 1;
+#endif
+    for (n = 0; n < clients; n++) {
+	c = &shm->client[n];
+	c->watches = head_size + n * watch_size;
+	c->ring = head_size + clients * watch_size + n * ring_size;
+	ringheader_init(HAL_NOTIFY_RING(shm, c), 0, ring, 0);
+	ringbuffer_init(HAL_NOTIFY_RING(shm, c), &rings[n]);
+    }
+
+    /* one writer per ring, so not reentrant */
+    retval = hal_export_funct("notify", notify, 0, 1, 0, comp_id);
+    if (retval != 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "NOTIFY: ERROR: function export failed\n");
+	rtapi_shmem_delete(shmem_id, comp_id);
+	hal_exit(comp_id);
+	return retval;
+    }
+    /* clients check this before they use the segment */
+    rtapi_smp_wmb();
+    shm->magic = HAL_NOTIFY_MAGIC;
+    rtapi_print_msg(RTAPI_MSG_INFO,
+	"NOTIFY: %d clients, %d watches each\n", clients, watches);
+    hal_ready(comp_id);
+    return 0;
+}
+
+void rtapi_app_exit(void)
+{
+    if (shmem_id > 0) {
+	shm->magic = 0;
+	rtapi_shmem_delete(shmem_id, comp_id);
+    }
+    hal_exit(comp_id);
+}
+
+/***********************************************************************
+*                       REALTIME FUNCTIONS                             *
+************************************************************************/
+
+/* copies the value watched by w into v, and the watch's gen and type,
+   and returns 1 if it differs from the one last reported; 0 if the
+   client is changing the watch */
+static int changed(hal_notify_watch_t *w, hal_data_u *v, int *gen,
+    hal_type_t *type)
+{
+    hal_comp_t *comp;
+    int offset, owner;
+    void *p;
+
+    *gen = w->gen;
+    if (*gen == 0 || (*gen & 1)) {
+	return 0;
+    }
+    rtapi_smp_rmb();
+    offset = w->offset;
+    owner = w->owner;
+    *type = w->type;
+    rtapi_smp_rmb();
+    if (w->gen != *gen) {
+	return 0;
+    }
+    if (owner) {
+	/* the pin points into its owner's mapping of the HAL segment */
+	comp = SHMPTR(owner);
+	p = SHMPTR((char *) *((void **) SHMPTR(offset)) -
+	    (char *) comp->shmem_base);
+    } else {
+	p = SHMPTR(offset);
+    }
+    switch (*type) {
+    case HAL_BIT:
+	v->b = *((hal_bit_t *) p) ? 1 : 0;
+	return w->reported != *gen || v->b != w->last.b;
+    case HAL_FLOAT:
+	v->f = *((hal_float_t *) p);
+	/* NaN isn't equal to itself, but hasn't changed either */
+	return w->reported != *gen || (v->f != w->last.f &&
+	    (v->f == v->f || w->last.f == w->last.f));
+    case HAL_S32:
+	v->s = *((hal_s32_t *) p);
+	return w->reported != *gen || v->s != w->last.s;
+    case HAL_U32:
+	v->u = *((hal_u32_t *) p);
+	return w->reported != *gen || v->u != w->last.u;
+    default:
+	return 0;
+    }
+}
+
+static void ring_doorbell(hal_notify_client_t *c)
+{
+#ifdef NOTIFY_DOORBELL
+    rtapi_smp_mb();
+    if (c->doorbell && __sync_bool_compare_and_swap(&c->doorbell, 1, 0))
+	syscall(SYS_futex, &c->doorbell, FUTEX_WAKE, 1, NULL, NULL, 0);
+#endif
+}
+
+static void notify(void *arg, long period)
+{
+    hal_notify_client_t *c;
+    hal_notify_watch_t *w;
+    hal_notify_record_t *rec;
+    hal_data_u v;
+    hal_type_t type;
+    int n, i, count, seq, gen, written;
+
+    for (n = 0; n < shm->num_clients; n++) {
+	c = &shm->client[n];
+	if (c->pid == 0) {
+	    continue;
+	}
+	seq = c->seq;
+	count = c->num_watches;
+	/* the watches up to count are filled in */
+	rtapi_smp_rmb();
+	w = HAL_NOTIFY_WATCHES(shm, c);
+	written = 0;
+	for (i = 0; i < count; i++, w++) {
+	    if (!changed(w, &v, &gen, &type)) {
+		continue;
+	    }
+	    if (record_write_begin(&rings[n], (void **) &rec,
+		    sizeof(*rec)) != 0) {
+		/* full: keep the old value, try again next period */
+		c->overruns++;
+		break;
+	    }
+	    rec->seq = seq;
+	    rec->event.watch = i;
+	    rec->event.type = type;
+	    rec->event.value = v;
+	    record_write_end(&rings[n], rec, sizeof(*rec));
+	    w->last = v;
+	    w->reported = gen;
+	    written++;
+	}
+	if (written) {
+	    ring_doorbell(c);
+	}
+    }
+}
@@ -200,6 +200,9 @@ typedef struct {
                                        otherwise screw up FF */
     hal_bit_t *error_previous_target; /* pin: measure error as new position vs previous command, to match motion's ideas */
     char prev_ie;
+    long period;		/* period the constants below are for */
+    double periodfp;		/* period in seconds */
+    double periodrecip;		/* 1 / periodfp */
 } hal_pid_t;
 
 /* pointer to array of pid_t structs in shared memory, 1 per loop */
@@ -299,22 +302,28 @@ static void calc_pid(void *arg, long period)
 {
     hal_pid_t *pid;
     double tmp1, tmp2, command, feedback;
-    int enable;
-    double periodfp, periodrecip;
+    double lim, error_i, error_d, cmd_d, cmd_dd;
+    int enable, index_enable, step;
 
     /* point to the data for this PID loop */
     pid = arg;
-    /* precalculate some timing constants */
-    periodfp = period * 0.000000001;
-    periodrecip = 1.0 / periodfp;
-    /* get the enable bit */
+    /* recalculate the timing constants only when the period changes */
+    if (period != pid->period) {
+	pid->period = period;
+	pid->periodfp = period * 0.000000001;
+	pid->periodrecip = 1.0 / pid->periodfp;
+    }
+    /* read the inputs only once, they are volatile */
     enable = *(pid->enable);
-    /* read the command and feedback only once */
     command = *(pid->command);
     feedback = *(pid->feedback);
+    index_enable = *(pid->index_enable);
+    /* not the falling edge of index_enable: the normal case.  On the
+       falling edge, index homing has caused a step in position, so
+       prev_cmd and prev_fb can't be trusted */
+    step = pid->prev_ie && !index_enable;
     /* calculate the error */
-    if((!(pid->prev_ie && !*(pid->index_enable))) && 
-       (*(pid->error_previous_target))) {
+    if (!step && *(pid->error_previous_target)) {
         // the user requests ferror against prev_cmd, and we can honor
         // that request because we haven't just had an index reset that
         // screwed it up.  Otherwise, if we did just have an index
@@ -328,108 +337,119 @@ static void calc_pid(void *arg, long period)
     /* store error to error pin */
     *(pid->error) = tmp1;
     /* apply error limits */
-    if (*(pid->maxerror) != 0.0) {
-	if (tmp1 > *(pid->maxerror)) {
-	    tmp1 = *(pid->maxerror);
-	} else if (tmp1 < -*(pid->maxerror)) {
-	    tmp1 = -*(pid->maxerror);
+    lim = *(pid->maxerror);
+    if (lim != 0.0) {
+	if (tmp1 > lim) {
+	    tmp1 = lim;
+	} else if (tmp1 < -lim) {
+	    tmp1 = -lim;
 	}
     }
     /* apply the deadband */
-    if (tmp1 > *(pid->deadband)) {
-	tmp1 -= *(pid->deadband);
-    } else if (tmp1 < -*(pid->deadband)) {
-	tmp1 += *(pid->deadband);
+    lim = *(pid->deadband);
+    if (tmp1 > lim) {
+	tmp1 -= lim;
+    } else if (tmp1 < -lim) {
+	tmp1 += lim;
     } else {
 	tmp1 = 0;
     }
     /* do integrator calcs only if enabled */
     if (enable != 0) {
+	error_i = *(pid->error_i);
 	/* if output is in limit, don't let integrator wind up */
 	if ( ( tmp1 * pid->limit_state ) <= 0.0 ) {
 	    /* compute integral term */
-	    *(pid->error_i) += tmp1 * periodfp;
+	    error_i += tmp1 * pid->periodfp;
 	}
 	/* apply integrator limits */
-	if (*(pid->maxerror_i) != 0.0) {
-	    if (*(pid->error_i) > *(pid->maxerror_i)) {
-		*(pid->error_i) = *(pid->maxerror_i);
-	    } else if (*(pid->error_i) < -*(pid->maxerror_i)) {
-		*(pid->error_i) = -*(pid->maxerror_i);
+	lim = *(pid->maxerror_i);
+	if (lim != 0.0) {
+	    if (error_i > lim) {
+		error_i = lim;
+	    } else if (error_i < -lim) {
+		error_i = -lim;
 	    }
 	}
     } else {
 	/* not enabled, reset integrator */
-	*(pid->error_i) = 0;
+	error_i = 0;
     }
+    *(pid->error_i) = error_i;
     /* compute command and feedback derivatives to dummysigs */
-    if(!(pid->prev_ie && !*(pid->index_enable))) {
-        *(pid->commandvds) = (command - pid->prev_cmd) * periodrecip;
-        *(pid->feedbackvds) = (feedback - pid->prev_fb) * periodrecip;
-    }
-    /* and calculate derivative term as difference of derivatives */
-    *(pid->error_d) = *(pid->commandv) - *(pid->feedbackv);
+    if (!step) {
+        *(pid->commandvds) = (command - pid->prev_cmd) * pid->periodrecip;
+        *(pid->feedbackvds) = (feedback - pid->prev_fb) * pid->periodrecip;
+    }
+    /* and calculate derivative term as difference of derivatives; the
+       dummysigs are what commandv and feedbackv read when unlinked, so
+       they are read after the writes above */
+    error_d = *(pid->commandv) - *(pid->feedbackv);
     pid->prev_error = tmp1;
     /* apply derivative limits */
-    if (*(pid->maxerror_d) != 0.0) {
-	if (*(pid->error_d) > *(pid->maxerror_d)) {
-	    *(pid->error_d) = *(pid->maxerror_d);
-	} else if (*(pid->error_d) < -*(pid->maxerror_d)) {
-	    *(pid->error_d) = -*(pid->maxerror_d);
+    lim = *(pid->maxerror_d);
+    if (lim != 0.0) {
+	if (error_d > lim) {
+	    error_d = lim;
+	} else if (error_d < -lim) {
+	    error_d = -lim;
 	}
     }
+    *(pid->error_d) = error_d;
     /* calculate derivative of command */
     /* save old value for 2nd derivative calc later */
-    tmp2 = *(pid->cmd_d);
-    if(!(pid->prev_ie && !*(pid->index_enable))) {
-        // not falling edge of index_enable: the normal case
-        *(pid->cmd_d) = (command - pid->prev_cmd) * periodrecip;
+    tmp2 = cmd_d = *(pid->cmd_d);
+    if (!step) {
+        cmd_d = (command - pid->prev_cmd) * pid->periodrecip;
     }
-    // else: leave cmd_d alone and use last period's.  prev_cmd
-    // shouldn't be trusted because index homing has caused us to have
-    // a step in position.  Using the previous period's derivative is
-    // probably a decent approximation since index search is usually a
-    // slow steady speed.
+    // else: leave cmd_d alone and use last period's.  Using the
+    // previous period's derivative is probably a decent approximation
+    // since index search is usually a slow steady speed.
 
     // save ie for next time
-    pid->prev_ie = *(pid->index_enable);
+    pid->prev_ie = index_enable;
 
     pid->prev_cmd = command;
     pid->prev_fb = feedback;
 
     /* apply derivative limits */
-    if (*(pid->maxcmd_d) != 0.0) {
-	if (*(pid->cmd_d) > *(pid->maxcmd_d)) {
-	    *(pid->cmd_d) = *(pid->maxcmd_d);
-	} else if (*(pid->cmd_d) < -*(pid->maxcmd_d)) {
-	    *(pid->cmd_d) = -*(pid->maxcmd_d);
+    lim = *(pid->maxcmd_d);
+    if (lim != 0.0) {
+	if (cmd_d > lim) {
+	    cmd_d = lim;
+	} else if (cmd_d < -lim) {
+	    cmd_d = -lim;
 	}
     }
+    *(pid->cmd_d) = cmd_d;
     /* calculate 2nd derivative of command */
-    *(pid->cmd_dd) = (*(pid->cmd_d) - tmp2) * periodrecip;
+    cmd_dd = (cmd_d - tmp2) * pid->periodrecip;
     /* apply 2nd derivative limits */
-    if (*(pid->maxcmd_dd) != 0.0) {
-	if (*(pid->cmd_dd) > *(pid->maxcmd_dd)) {
-	    *(pid->cmd_dd) = *(pid->maxcmd_dd);
-	} else if (*(pid->cmd_dd) < -*(pid->maxcmd_dd)) {
-	    *(pid->cmd_dd) = -*(pid->maxcmd_dd);
+    lim = *(pid->maxcmd_dd);
+    if (lim != 0.0) {
+	if (cmd_dd > lim) {
+	    cmd_dd = lim;
+	} else if (cmd_dd < -lim) {
+	    cmd_dd = -lim;
 	}
     }
+    *(pid->cmd_dd) = cmd_dd;
     /* do output calcs only if enabled */
     if (enable != 0) {
 	/* calculate the output value */
 	tmp1 =
-	    *(pid->bias) + *(pid->pgain) * tmp1 + *(pid->igain) * *(pid->error_i) +
-	    *(pid->dgain) * *(pid->error_d);
-	tmp1 += command * *(pid->ff0gain) + *(pid->cmd_d) * *(pid->ff1gain) +
-	    *(pid->cmd_dd) * *(pid->ff2gain);
+	    *(pid->bias) + *(pid->pgain) * tmp1 + *(pid->igain) * error_i +
+	    *(pid->dgain) * error_d;
+	tmp1 += command * *(pid->ff0gain) + cmd_d * *(pid->ff1gain) +
+	    cmd_dd * *(pid->ff2gain);
 	/* apply output limits */
-	if (*(pid->maxoutput) != 0.0) {
-	    if (tmp1 > *(pid->maxoutput)) {
-		tmp1 = *(pid->maxoutput);
+	lim = *(pid->maxoutput);
+	if (lim != 0.0) {
+	    if (tmp1 > lim) {
+		tmp1 = lim;
 		pid->limit_state = 1.0;
-	    } else if (tmp1 < -*(pid->maxoutput)) {
-		tmp1 = -*(pid->maxoutput);
+	    } else if (tmp1 < -lim) {
+		tmp1 = -lim;
 		pid->limit_state = -1.0;
 	    } else {
 		pid->limit_state = 0.0;
@@ -446,7 +466,7 @@ static void calc_pid(void *arg, long period)
     /* set 'saturated' outputs */
     if(pid->limit_state) { 
         *(pid->saturated) = 1;
-        *(pid->saturated_s) += period * 1e-9;
+        *(pid->saturated_s) += pid->periodfp;
         if(*(pid->saturated_count) != 2147483647)
             (*pid->saturated_count) ++;
     } else {
@@ -658,6 +678,7 @@ static int export_pid(hal_pid_t * addr, char * prefix)
     addr->prev_error = 0.0;
     addr->prev_cmd = 0.0;
     addr->limit_state = 0.0;
+    addr->period = 0;
     *(addr->bias) = 0.0;
     *(addr->pgain) = 1.0;
     *(addr->igain) = 0.0;
@@ -324,36 +324,23 @@ RTAPI_MP_ARRAY_INT(user_step_type, MAX_CYCLE,
 *                STRUCTURES AND GLOBAL VARIABLES                       *
 ************************************************************************/
 
-/** This structure contains the runtime data for a single generator. */
-
-/* structure members are ordered to optimize caching for makepulses,
-   which runs in the fastest thread */
+/** This structure contains the runtime data for a single generator.
+    The state that make_pulses() reads and writes every base period is
+    not here, it is in the stepgen_core_t arrays below. */
 
 typedef struct {
-    /* stuff that is both read and written by makepulses */
-    unsigned int timer1;	/* times out when step pulse should end */
-    unsigned int timer2;	/* times out when safe to change dir */
-    unsigned int timer3;	/* times out when safe to step in new dir */
-    int hold_dds;		/* prevents accumulator from updating */
-    long addval;		/* actual frequency generator add value */
-    volatile long long accum;	/* frequency generator accumulator */
-    hal_s32_t rawcount;		/* param: position feedback in counts */
-    int curr_dir;		/* current direction */
-    int state;			/* current position in state table */
-    /* stuff that is read but not written by makepulses */
+    /* stuff that is read or written by makepulses */
     hal_bit_t *enable;		/* pin for enable stepgen */
-    long target_addval;		/* desired freq generator add value */
-    long deltalim;		/* max allowed change per period */
-    hal_u32_t step_len;		/* parameter: step pulse length */
-    hal_u32_t dir_hold_dly;	/* param: direction hold time or delay */
-    hal_u32_t dir_setup;	/* param: direction setup time */
-    int step_type;		/* stepping type - see list above */
-    int cycle_max;		/* cycle length for step types 2 and up */
-    int num_phases;		/* number of phases for types 2 and up */
+    hal_s32_t rawcount;		/* param: position feedback in counts */
+    int num_phases;		/* number of output pins */
     hal_bit_t *phase[5];	/* pins for output signals */
-    const unsigned char *lut;	/* pointer to state lookup table */
+    const unsigned char *lut;	/* state lookup table, types 2 and up */
     /* stuff that is not accessed by makepulses */
+    int step_type;		/* stepping type - see list above */
     int pos_mode;		/* 1 = position mode, 0 = velocity mode */
+    hal_u32_t step_len;		/* parameter: step pulse length */
+    hal_u32_t dir_hold_dly;	/* param: direction hold time or delay */
+    hal_u32_t dir_setup;	/* param: direction setup time */
     hal_u32_t step_space;	/* parameter: min step pulse spacing */
     double old_pos_cmd;		/* previous position command (counts) */
     hal_s32_t *count;		/* pin: captured feedback in counts */
@@ -376,6 +363,42 @@ typedef struct {
 /* ptr to array of stepgen_t structs in shared memory, 1 per channel */
 static stepgen_t *stepgen_array;
 
+/** The step generator core.  This is the part of every channel that
+    make_pulses() touches each base period, stored as one array per
+    field instead of one struct per channel.  The kernel that runs it
+    walks the arrays in step, with no pointers to chase and no branches,
+    so the compiler can vectorize it.  HAL pins are copied in before
+    the kernel and out after it.  Everything but the accumulator is 32
+    bits wide, so it fits four channels to a 128 bit vector; addval
+    never exceeds one step per period, 1 << PICKOFF.
+*/
+
+typedef struct {
+    /* stuff that is both read and written by makepulses */
+    long long accum[MAX_CHAN];	/* frequency generator accumulator */
+    int addval[MAX_CHAN];	/* actual frequency generator add value */
+    unsigned int timer1[MAX_CHAN];	/* times out when step pulse should end */
+    unsigned int timer2[MAX_CHAN];	/* times out when safe to change dir */
+    unsigned int timer3[MAX_CHAN];	/* times out when safe to step in new dir */
+    int hold_dds[MAX_CHAN];	/* prevents accumulator from updating */
+    int curr_dir[MAX_CHAN];	/* current direction */
+    int state[MAX_CHAN];	/* current position in state table */
+    int enable[MAX_CHAN];	/* copy of the enable pin */
+    /* stuff that is read but not written by makepulses */
+    int target_addval[MAX_CHAN];	/* desired freq generator add value */
+    int deltalim[MAX_CHAN];	/* max allowed change per period */
+    unsigned int step_len[MAX_CHAN];	/* step_len, rounded by update_freq */
+    unsigned int dir_hold_dly[MAX_CHAN];	/* dir_hold_dly, rounded */
+    unsigned int dir_setup[MAX_CHAN];	/* dir_setup, rounded */
+    int cycle_max[MAX_CHAN];	/* cycle length for step types 2 and up */
+} stepgen_core_t;
+
+/* ptr to the core, in shared memory */
+static stepgen_core_t *stepgen_core;
+
+/* deltalim that never limits; addval +/- this still fits in an int */
+#define NO_DELTALIM	(1 << 30)
+
 /* lookup tables for stepping types 2 and higher - phase A is the LSB */
 
 static unsigned char master_lut[][MAX_CYCLE] = {
@@ -430,7 +453,8 @@ typedef enum CONTROL { POSITION, VELOCITY, INVALID } CONTROL;
 *                  LOCAL FUNCTION DECLARATIONS                         *
 ************************************************************************/
 
-static int export_stepgen(int num, stepgen_t * addr, int step_type, int pos_mode);
+static int export_stepgen(int num, stepgen_t * addr,
+    stepgen_core_t * core, int step_type, int pos_mode);
 static void make_pulses(void *arg, long period);
 static void update_freq(void *arg, long period);
 static void update_pos(void *arg, long period);
@@ -498,10 +522,17 @@ int rtapi_app_main(void)
 	hal_exit(comp_id);
 	return -1;
     }
+    stepgen_core = hal_malloc(sizeof(stepgen_core_t));
+    if (stepgen_core == 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+			"STEPGEN: ERROR: hal_malloc() failed\n");
+	hal_exit(comp_id);
+	return -1;
+    }
     /* export all the variables for each pulse generator */
     for (n = 0; n < num_chan; n++) {
 	/* export all vars */
-	retval = export_stepgen(n, &(stepgen_array[n]),
+	retval = export_stepgen(n, &(stepgen_array[n]), stepgen_core,
 	    step_type[n], (parse_ctrl_type(ctrl_type[n]) == POSITION));
 	if (retval != 0) {
 	    rtapi_print_msg(RTAPI_MSG_ERR,
@@ -512,7 +543,7 @@ int rtapi_app_main(void)
     }
     /* export functions */
     retval = hal_export_funct("stepgen.make-pulses", make_pulses,
-	stepgen_array, 0, 0, comp_id);
+	stepgen_core, 0, 0, comp_id);
     if (retval != 0) {
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "STEPGEN: ERROR: makepulses funct export failed\n");
@@ -555,148 +586,188 @@ void rtapi_app_exit(void)
     toggles, a step is generated.
 */
 
+/* The kernel works with masks, ints that are either all ones (true)
+   or zero (false), and replaces each 'if' with a select:
+   'x = SELECT(m, a, b)' is 'x = m ? a : b'.  Written out like this
+   the compiler doesn't turn them into min/max or branches, which would
+   keep it from vectorizing the loop on plain SSE2. */
+#define MASK(cond)	(-(int)(cond))
+#define SELECT(m,a,b)	(((a) & (m)) | ((b) & ~(m)))
+
+static void make_pulses_core(stepgen_core_t *core, int nchan,
+    unsigned int per)
+{
+    int n;
+    unsigned int t1, t2, t3;
+    int old_addval, new_addval, hi, lo, dir, state;
+    int m, hold, run, step_now;
+    long long accum, new_accum;
+
+    for (n = 0; n < nchan; n++) {
+	/* decrement "timing constraint" timers, stop at zero */
+	t1 = core->timer1[n];
+	t2 = core->timer2[n];
+	t3 = core->timer3[n];
+	t1 = (t1 - per) & MASK(t1 > per);
+	t2 = (t2 - per) & MASK(t2 > per);
+	t3 = (t3 - per) & MASK(t3 > per);
+	/* hold is only ever set while timer 3 is running, so when it
+	   times out the hold is cancelled */
+	hold = core->hold_dds[n] & MASK(t3 != 0);
+	run = ~hold & core->enable[n];
+	/* update addval (ramping) */
+	old_addval = core->addval[n];
+	hi = old_addval + core->deltalim[n];
+	lo = old_addval - core->deltalim[n];
+	new_addval = core->target_addval[n];
+	new_addval = SELECT(MASK(new_addval > hi), hi, new_addval);
+	new_addval = SELECT(MASK(new_addval < lo), lo, new_addval);
+	new_addval = SELECT(run, new_addval, old_addval);
+	/* direction reversal, hold everything until delays time out */
+	hold |= run & MASK((new_addval ^ old_addval) < 0) & MASK(t3 != 0);
+	run = ~hold & core->enable[n];
+	/* update DDS, a step happens when the pickoff bit changes */
+	accum = core->accum[n];
+	new_accum = accum + (new_addval & run);
+	step_now = MASK(((accum ^ new_accum) >> PICKOFF) & 1);
+	/* update direction - do not change if addval = 0 */
+	dir = core->curr_dir[n];
+	m = MASK(t2 == 0) & MASK(new_addval != 0);
+	dir = SELECT(m, (new_addval >> 31) | 1, dir);
+	/* a step (re)starts the timers */
+	t1 = SELECT(step_now, core->step_len[n], t1);
+	t2 = SELECT(step_now, t1 + core->dir_hold_dly[n], t2);
+	t3 = SELECT(step_now, t2 + core->dir_setup[n], t3);
+	/* and moves the state for step types 2 and up (cycle_max is
+	   zero for the others, so it stays zero) */
+	state = core->state[n] + (dir & step_now);
+	state = SELECT(MASK(state < 0), core->cycle_max[n], state);
+	state &= ~MASK(state > core->cycle_max[n]);
+	/* save results */
+	core->timer1[n] = t1;
+	core->timer2[n] = t2;
+	core->timer3[n] = t3;
+	core->hold_dds[n] = hold;
+	core->addval[n] = new_addval;
+	core->accum[n] = new_accum;
+	core->curr_dir[n] = dir;
+	core->state[n] = state;
+    }
+}
+
+/* the same as one pass of make_pulses_core(), with branches: for up
+   to 3 channels this is faster than the kernel, which only pays off
+   when it runs on a whole vector */
+static void make_pulses_one(stepgen_core_t *core, int n, unsigned int per)
+{
+    int old_addval, new_addval;
+    long long accum;
+
+    /* decrement "timing constraint" timers */
+    if (core->timer1[n] > per) {
+	core->timer1[n] -= per;
+    } else {
+	core->timer1[n] = 0;
+    }
+    if (core->timer2[n] > per) {
+	core->timer2[n] -= per;
+    } else {
+	core->timer2[n] = 0;
+    }
+    if (core->timer3[n] > per) {
+	core->timer3[n] -= per;
+    } else {
+	core->timer3[n] = 0;
+	/* last timer timed out, cancel hold */
+	core->hold_dds[n] = 0;
+    }
+    if (!core->hold_dds[n] && core->enable[n]) {
+	/* update addval (ramping) */
+	old_addval = core->addval[n];
+	new_addval = core->target_addval[n];
+	if (new_addval > old_addval + core->deltalim[n]) {
+	    new_addval = old_addval + core->deltalim[n];
+	} else if (new_addval < old_addval - core->deltalim[n]) {
+	    new_addval = old_addval - core->deltalim[n];
+	}
+	core->addval[n] = new_addval;
+	/* direction reversal, hold everything until delays time out */
+	if ((new_addval ^ old_addval) < 0 && core->timer3[n] != 0) {
+	    core->hold_dds[n] = -1;
+	}
+    }
+    if (!core->hold_dds[n] && core->enable[n]) {
+	/* update DDS, a step happens when the pickoff bit changes */
+	accum = core->accum[n];
+	core->accum[n] += core->addval[n];
+	if (((accum ^ core->accum[n]) >> PICKOFF) & 1) {
+	    /* update direction first, the timers haven't restarted */
+	    if (core->timer2[n] == 0 && core->addval[n] != 0) {
+		core->curr_dir[n] = core->addval[n] < 0 ? -1 : 1;
+	    }
+	    /* (re)start the timers */
+	    core->timer1[n] = core->step_len[n];
+	    core->timer2[n] = core->timer1[n] + core->dir_hold_dly[n];
+	    core->timer3[n] = core->timer2[n] + core->dir_setup[n];
+	    /* and move the state for step types 2 and up */
+	    core->state[n] += core->curr_dir[n];
+	    if (core->state[n] < 0) {
+		core->state[n] = core->cycle_max[n];
+	    } else if (core->state[n] > core->cycle_max[n]) {
+		core->state[n] = 0;
+	    }
+	    return;
+	}
+    }
+    /* update direction - do not change if addval = 0 */
+    if (core->timer2[n] == 0 && core->addval[n] != 0) {
+	core->curr_dir[n] = core->addval[n] < 0 ? -1 : 1;
+    }
+}
+
 static void make_pulses(void *arg, long period)
 {
+    stepgen_core_t *core;
     stepgen_t *stepgen;
-    long old_addval, target_addval, new_addval, step_now;
-    int n, p;
+    int n, p, step, rev, nvec;
     unsigned char outbits;
 
     /* store period so scaling constants can be (re)calculated */
     periodns = period;
     /* point to stepgen data structures */
-    stepgen = arg;
-
+    core = arg;
+    stepgen = stepgen_array;
+    /* copy the enable pins into the core */
     for (n = 0; n < num_chan; n++) {
-	/* decrement "timing constraint" timers */
-	if ( stepgen->timer1 > 0 ) {
-	    if ( stepgen->timer1 > periodns ) {
-		stepgen->timer1 -= periodns;
-	    } else {
-		stepgen->timer1 = 0;
-	    }
-	}
-	if ( stepgen->timer2 > 0 ) {
-	    if ( stepgen->timer2 > periodns ) {
-		stepgen->timer2 -= periodns;
-	    } else {
-		stepgen->timer2 = 0;
-	    }
-	}
-	if ( stepgen->timer3 > 0 ) {
-	    if ( stepgen->timer3 > periodns ) {
-		stepgen->timer3 -= periodns;
-	    } else {
-		stepgen->timer3 = 0;
-		/* last timer timed out, cancel hold */
-		stepgen->hold_dds = 0;
-	    }
-	}
-	if ( !stepgen->hold_dds && *(stepgen->enable) ) {
-	    /* update addval (ramping) */
-	    old_addval = stepgen->addval;
-	    target_addval = stepgen->target_addval;
-	    if (stepgen->deltalim != 0) {
-		/* implement accel/decel limit */
-		if (target_addval > (old_addval + stepgen->deltalim)) {
-		    /* new value is too high, increase addval as far as possible */
-		    new_addval = old_addval + stepgen->deltalim;
-		} else if (target_addval < (old_addval - stepgen->deltalim)) {
-		    /* new value is too low, decrease addval as far as possible */
-		    new_addval = old_addval - stepgen->deltalim;
-		} else {
-		    /* new value can be reached in one step - do it */
-		    new_addval = target_addval;
-		}
-	    } else {
-		/* go to new freq without any ramping */
-		new_addval = target_addval;
-	    }
-	    /* save result */
-	    stepgen->addval = new_addval;
-	    /* check for direction reversal */
-	    if (((new_addval >= 0) && (old_addval < 0)) ||
-		((new_addval < 0) && (old_addval >= 0))) {
-		/* reversal required, can we do so now? */
-		if ( stepgen->timer3 != 0 ) {
-		    /* no - hold everything until delays time out */
-		    stepgen->hold_dds = 1;
-		}
-	    }
-	}
-	/* update DDS */
-	if ( !stepgen->hold_dds && *(stepgen->enable) ) {
-	    /* save current value of low half of accum */
-	    step_now = stepgen->accum;
-	    /* update the accumulator */
-	    stepgen->accum += stepgen->addval;
-	    /* test for changes in low half of accum */
-	    step_now ^= stepgen->accum;
-	    /* we only care about the pickoff bit */
-	    step_now &= (1L << PICKOFF);
-	    /* update rawcounts parameter */
-	    stepgen->rawcount = stepgen->accum >> PICKOFF;
-	} else {
-	    /* DDS is in hold, no steps */
-	    step_now = 0;
-	}
-	if ( stepgen->timer2 == 0 ) {
-	    /* update direction - do not change if addval = 0 */
-	    if ( stepgen->addval > 0 ) {
-		stepgen->curr_dir = 1;
-	    } else if ( stepgen->addval < 0 ) {
-		stepgen->curr_dir = -1;
-	    }
-	}
-	if ( step_now ) {
-	    /* (re)start various timers */
-	    /* timer 1 = time till end of step pulse */
-	    stepgen->timer1 = stepgen->step_len;
-	    /* timer 2 = time till allowed to change dir pin */
-	    stepgen->timer2 = stepgen->timer1 + stepgen->dir_hold_dly;
-	    /* timer 3 = time till allowed to step the other way */
-	    stepgen->timer3 = stepgen->timer2 + stepgen->dir_setup;
-	    if ( stepgen->step_type >= 2 ) {
-		/* update state */
-		stepgen->state += stepgen->curr_dir;
-		if ( stepgen->state < 0 ) {
-		    stepgen->state = stepgen->cycle_max;
-		} else if ( stepgen->state > stepgen->cycle_max ) {
-		    stepgen->state = 0;
-		}
-	    }
-	}
+	core->enable[n] = MASK(*(stepgen[n].enable) != 0);
+    }
+    /* run all the step generators: the kernel on whole vectors of 4,
+       the branchy version on the rest, as the kernel's scalar tail is
+       slower than that */
+    nvec = num_chan & ~3;
+    make_pulses_core(core, nvec, period);
+    for (n = nvec; n < num_chan; n++) {
+	make_pulses_one(core, n, period);
+    }
+    /* copy the results out to the HAL */
+    for (n = 0; n < num_chan; n++) {
+	/* update rawcounts parameter */
+	stepgen->rawcount = core->accum[n] >> PICKOFF;
 	/* generate output, based on stepping type */
+	step = core->timer1[n] != 0;
+	rev = core->curr_dir[n] < 0;
 	if (stepgen->step_type == 0) {
 	    /* step/dir output */
-	    if ( stepgen->timer1 != 0 ) {
-		 *(stepgen->phase[STEP_PIN]) = 1;
-	    } else {
-		 *(stepgen->phase[STEP_PIN]) = 0;
-	    }
-	    if ( stepgen->curr_dir < 0 ) {
-		 *(stepgen->phase[DIR_PIN]) = 1;
-	    } else {
-		 *(stepgen->phase[DIR_PIN]) = 0;
-	    }
+	    *(stepgen->phase[STEP_PIN]) = step;
+	    *(stepgen->phase[DIR_PIN]) = rev;
 	} else if (stepgen->step_type == 1) {
 	    /* up/down */
-	    if ( stepgen->timer1 != 0 ) {
-		if ( stepgen->curr_dir < 0 ) {
-		    *(stepgen->phase[UP_PIN]) = 0;
-		    *(stepgen->phase[DOWN_PIN]) = 1;
-		} else {
-		    *(stepgen->phase[UP_PIN]) = 1;
-		    *(stepgen->phase[DOWN_PIN]) = 0;
-		}
-	    } else {
-		*(stepgen->phase[UP_PIN]) = 0;
-		*(stepgen->phase[DOWN_PIN]) = 0;
-	    }
+	    *(stepgen->phase[UP_PIN]) = step & !rev;
+	    *(stepgen->phase[DOWN_PIN]) = step & rev;
 	} else {
 	    /* step type 2 or greater */
 	    /* look up correct output pattern */
-	    outbits = (stepgen->lut)[stepgen->state];
+	    outbits = (stepgen->lut)[core->state[n]];
 	    /* now output the phase bits */
 	    for (p = 0; p < stepgen->num_phases; p++) {
 		/* output one phase */
@@ -714,6 +785,7 @@ static void make_pulses(void *arg, long period)
 static void update_pos(void *arg, long period)
 {
     long long int accum_a, accum_b;
+    volatile long long int *accum;
     stepgen_t *stepgen;
     int n;
 
@@ -723,9 +795,10 @@ static void update_pos(void *arg, long period)
 	/* 'accum' is a long long, and its remotely possible that
 	   make_pulses could change it half-way through a read.
 	   So we have a crude atomic read routine */
+	accum = &(stepgen_core->accum[n]);
 	do {
-	    accum_a = stepgen->accum;
-	    accum_b = stepgen->accum;
+	    accum_a = *accum;
+	    accum_b = *accum;
 	} while ( accum_a != accum_b );
 	/* compute integer counts */
 	*(stepgen->count) = accum_a >> PICKOFF;
@@ -765,9 +838,11 @@ static unsigned long ulceil(unsigned long value, unsigned long increment)
 static void update_freq(void *arg, long period)
 {
     stepgen_t *stepgen;
+    stepgen_core_t *core;
     int n, newperiod;
     long min_step_period;
     long long int accum_a, accum_b;
+    volatile long long int *accum;
     double pos_cmd, vel_cmd, curr_pos, curr_vel, avg_v, max_freq, max_ac;
     double match_ac, match_time, est_out, est_cmd, est_err, dp, dv, new_vel;
     double desired_freq;
@@ -805,6 +880,7 @@ static void update_freq(void *arg, long period)
 
     /* point at stepgen data */
     stepgen = arg;
+    core = stepgen_core;
 
     /* loop thru generators */
     for (n = 0; n < num_chan; n++) {
@@ -859,6 +935,10 @@ static void update_freq(void *arg, long period)
 	    stepgen->old_dir_hold_dly = ulceil(stepgen->dir_hold_dly, periodns);
 	    stepgen->dir_hold_dly = stepgen->old_dir_hold_dly;
 	}
+	/* pass the validated timing parameters to make_pulses() */
+	core->step_len[n] = stepgen->step_len;
+	core->dir_hold_dly[n] = stepgen->dir_hold_dly;
+	core->dir_setup[n] = stepgen->dir_setup;
 	/* test for disabled stepgen */
 	if (*stepgen->enable == 0) {
 	    /* disabled: keep updating old_pos_cmd (if in pos ctrl mode) */
@@ -867,8 +947,8 @@ static void update_freq(void *arg, long period)
 	    }
 	    /* set velocity to zero */
 	    stepgen->freq = 0;
-	    stepgen->addval = 0;
-	    stepgen->target_addval = 0;
+	    core->addval[n] = 0;
+	    core->target_addval[n] = 0;
 	    /* and skip to next one */
 	    stepgen++;
 	    continue;
@@ -929,9 +1009,10 @@ static void update_freq(void *arg, long period)
 	    /* 'accum' is a long long, and its remotely possible that
 	       make_pulses could change it half-way through a read.
 	       So we have a crude atomic read routine */
+	    accum = &(core->accum[n]);
 	    do {
-		accum_a = stepgen->accum;
-		accum_b = stepgen->accum;
+		accum_a = *accum;
+		accum_b = *accum;
 	    } while ( accum_a != accum_b );
 	    /* convert from fixed point to double, after subtracting
 	       the one-half step offset */
@@ -1016,9 +1097,12 @@ static void update_freq(void *arg, long period)
 	}
 	stepgen->freq = new_vel;
 	/* calculate new addval */
-	stepgen->target_addval = stepgen->freq * freqscale;
-	/* calculate new deltalim */
-	stepgen->deltalim = max_ac * accelscale;
+	core->target_addval[n] = stepgen->freq * freqscale;
+	/* calculate new deltalim, zero means no limit */
+	core->deltalim[n] = max_ac * accelscale;
+	if (core->deltalim[n] == 0) {
+	    core->deltalim[n] = NO_DELTALIM;
+	}
 	/* move on to next channel */
 	stepgen++;
     }
@@ -1029,7 +1113,8 @@ static void update_freq(void *arg, long period)
 *                   LOCAL FUNCTION DEFINITIONS                         *
 ************************************************************************/
 
-static int export_stepgen(int num, stepgen_t * addr, int step_type, int pos_mode)
+static int export_stepgen(int num, stepgen_t * addr,
+    stepgen_core_t * core, int step_type, int pos_mode)
 {
     int n, retval, msg;
 
@@ -1108,6 +1193,7 @@ static int export_stepgen(int num, stepgen_t * addr, int step_type, int pos_mode
     /* export output pins */
     if ( step_type == 0 ) {
 	/* step and direction */
+	addr->num_phases = 2;
 	retval = hal_pin_bit_newf(HAL_OUT, &(addr->phase[STEP_PIN]),
 	    comp_id, "stepgen.%d.step", num);
 	if (retval != 0) { return retval; }
@@ -1118,6 +1204,7 @@ static int export_stepgen(int num, stepgen_t * addr, int step_type, int pos_mode
 	*(addr->phase[DIR_PIN]) = 0;
     } else if (step_type == 1) {
 	/* up and down */
+	addr->num_phases = 2;
 	retval = hal_pin_bit_newf(HAL_OUT, &(addr->phase[UP_PIN]),
 	    comp_id, "stepgen.%d.up", num);
 	if (retval != 0) { return retval; }
@@ -1164,26 +1251,34 @@ static int export_stepgen(int num, stepgen_t * addr, int step_type, int pos_mode
     addr->old_step_space = ~0;
     addr->old_dir_hold_dly = ~0;
     addr->old_dir_setup = ~0;
+    /* init output stuff */
     if ( step_type >= 2 ) {
-	/* init output stuff */
-	addr->cycle_max = cycle_len_lut[step_type - 2] - 1;
+	core->cycle_max[num] = cycle_len_lut[step_type - 2] - 1;
 	addr->lut = &(master_lut[step_type - 2][0]);
+    } else {
+	core->cycle_max[num] = 0;
+	addr->lut = 0;
     }
     /* init the step generator core to zero output */
-    addr->timer1 = 0;
-    addr->timer2 = 0;
-    addr->timer3 = 0;
-    addr->hold_dds = 0;
-    addr->addval = 0;
+    core->timer1[num] = 0;
+    core->timer2[num] = 0;
+    core->timer3[num] = 0;
+    core->hold_dds[num] = 0;
+    core->addval[num] = 0;
     /* accumulator gets a half step offset, so it will step half
        way between integer positions, not at the integer positions */
-    addr->accum = 1 << (PICKOFF-1);
+    core->accum[num] = 1 << (PICKOFF-1);
     addr->rawcount = 0;
-    addr->curr_dir = 0;
-    addr->state = 0;
+    core->curr_dir[num] = 0;
+    core->state[num] = 0;
+    core->enable[num] = 0;
     *(addr->enable) = 0;
-    addr->target_addval = 0;
-    addr->deltalim = 0;
+    core->target_addval[num] = 0;
+    core->deltalim[num] = NO_DELTALIM;
+    /* update_freq() rounds the timing params and copies them here */
+    core->step_len[num] = addr->step_len;
+    core->dir_hold_dly[num] = addr->dir_hold_dly;
+    core->dir_setup[num] = addr->dir_setup;
     /* other init */
     addr->printed_error = 0;
     addr->old_pos_cmd = 0.0;
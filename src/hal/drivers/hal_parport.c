@@ -43,6 +43,12 @@
     Each physical input has two corresponding HAL pins, named
     'parport.<portnum>.pin-<pinnum>-in' and
     'parport.<portnum>.pin-<pinnum>-in-not'.
+    All the inputs of a port are also collected in one u32 pin,
+    'parport.<portnum>.pins-in', for components like encoder that
+    can take many inputs in a single word: bits 0-7 are data pins
+    2-9, bits 8-12 are status pins 15, 13, 12, 10, 11, and bits 13-16
+    are control pins 1, 14, 16, 17.  Bits of ports used as outputs
+    are zero.
 
     <portnum> is the port number, starting from zero.  <pinnum> is
     the physical pin number on the DB-25 connector.
@@ -136,6 +142,7 @@ typedef struct {
     hal_bit_t *control_out[4];	/* ptrs for out pins 1, 14, 16, 17 */
     hal_bit_t control_inv[4];	/* pol. params for output pins 1, 14, 16, 17 */
     hal_bit_t control_reset[4];	/* reset flag for output pins 1, 14, 16, 17 */
+    hal_u32_t *pins_in;		/* all inputs, packed into one word */
     hal_u32_t reset_time;       /* min ns between write and reset */
     hal_u32_t debug1, debug2;
     long long write_time;
@@ -328,6 +335,7 @@ static void read_port(void *arg, long period)
     parport_t *port;
     int b;
     unsigned char indata, mask;
+    __u32 word;
 
     port = arg;
     /* read the status port */
@@ -345,6 +353,7 @@ static void read_port(void *arg, long period)
 	*(port->status_in[b + 1]) = !(indata & mask);
 	mask <<= 1;
     }
+    word = (__u32) (indata >> 3) << 8;
     /* are we using the data port for input? */
     if (port->data_dir != 0) {
 	/* yes, read the data port */
@@ -360,6 +369,7 @@ static void read_port(void *arg, long period)
 	    *(port->data_in[b + 1]) = !(indata & mask);
 	    mask <<= 1;
 	}
+	word |= indata;
     }
     /* are we using the control port for input? */
     if(port->use_control_in) {
@@ -375,7 +385,9 @@ static void read_port(void *arg, long period)
             *(port->control_in[b + 1]) = !(indata & mask);
 	    mask <<= 1;
         }
+	word |= (__u32) (indata & 0x0F) << 13;
     }
+    *(port->pins_in) = word;
 }
 
 static void reset_port(void *arg, long period) {
@@ -726,6 +738,9 @@ static int export_port(int portnum, parport_t * port)
         retval += export_input_pin(portnum, 16, port->control_in, 2);
         retval += export_input_pin(portnum, 17, port->control_in, 3);
     }
+    /* all inputs in one word */
+    retval += hal_pin_u32_newf(HAL_OUT, &port->pins_in, comp_id,
+	"parport.%d.pins-in", portnum);
 
     /* restore saved message level */
     rtapi_set_msg_level(msg);
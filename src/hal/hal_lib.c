@@ -1137,40 +1137,14 @@ int hal_pin_alias(const char *pin_name, const char *alias)
 *                      "SIGNAL" FUNCTIONS                              *
 ************************************************************************/
 
-int hal_signal_new(const char *name, hal_type_t type)
+/* allocates and initializes a signal, but doesn't put it in the list,
+   for hal_signal_new() and halpr_restore(); the caller holds the mutex.
+   Returns 0 on failure. */
+static hal_sig_t *new_signal(const char *name, hal_type_t type)
 {
-
-    int *prev, next, cmp;
-    hal_sig_t *new, *ptr;
+    hal_sig_t *new;
     void *data_addr;
 
-    if (hal_data == 0) {
-	rtapi_print_msg(RTAPI_MSG_ERR,
-	    "HAL: ERROR: signal_new called before init\n");
-	return -EINVAL;
-    }
-
-    if (strlen(name) > HAL_NAME_LEN) {
-	rtapi_print_msg(RTAPI_MSG_ERR,
-	    "HAL: ERROR: signal name '%s' is too long\n", name);
-	return -EINVAL;
-    }
-    if (hal_data->lock & HAL_LOCK_CONFIG) {
-	rtapi_print_msg(RTAPI_MSG_ERR,
-	    "HAL: ERROR: signal_new called while HAL is locked\n");
-	return -EPERM;
-    }
-
-    rtapi_print_msg(RTAPI_MSG_DBG, "HAL: creating signal '%s'\n", name);
-    /* get mutex before accessing shared data */
-    rtapi_mutex_get(&(hal_data->mutex));
-    /* check for an existing signal with the same name */
-    if (halpr_find_sig_by_name(name) != 0) {
-	rtapi_mutex_give(&(hal_data->mutex));
-	rtapi_print_msg(RTAPI_MSG_ERR,
-	    "HAL: ERROR: duplicate signal '%s'\n", name);
-	return -EINVAL;
-    }
     /* allocate memory for the signal value */
     switch (type) {
     case HAL_BIT:
@@ -1186,20 +1160,18 @@ int hal_signal_new(const char *name, hal_type_t type)
 	data_addr = shmalloc_up(sizeof(hal_float_t));
 	break;
     default:
-	rtapi_mutex_give(&(hal_data->mutex));
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: illegal signal type %d'\n", type);
-	return -EINVAL;
+	return 0;
 	break;
     }
     /* allocate a new signal structure */
     new = alloc_sig_struct();
     if ((new == 0) || (data_addr == 0)) {
 	/* alloc failed */
-	rtapi_mutex_give(&(hal_data->mutex));
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: insufficient memory for signal '%s'\n", name);
-	return -ENOMEM;
+	return 0;
     }
     /* initialize the signal value */
     switch (type) {
@@ -1225,6 +1197,47 @@ int hal_signal_new(const char *name, hal_type_t type)
     new->writers = 0;
     new->bidirs = 0;
     rtapi_snprintf(new->name, sizeof(new->name), "%s", name);
+    return new;
+}
+
+int hal_signal_new(const char *name, hal_type_t type)
+{
+
+    int *prev, next, cmp;
+    hal_sig_t *new, *ptr;
+
+    if (hal_data == 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: signal_new called before init\n");
+	return -EINVAL;
+    }
+
+    if (strlen(name) > HAL_NAME_LEN) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: signal name '%s' is too long\n", name);
+	return -EINVAL;
+    }
+    if (hal_data->lock & HAL_LOCK_CONFIG) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: signal_new called while HAL is locked\n");
+	return -EPERM;
+    }
+
+    rtapi_print_msg(RTAPI_MSG_DBG, "HAL: creating signal '%s'\n", name);
+    /* get mutex before accessing shared data */
+    rtapi_mutex_get(&(hal_data->mutex));
+    /* check for an existing signal with the same name */
+    if (halpr_find_sig_by_name(name) != 0) {
+	rtapi_mutex_give(&(hal_data->mutex));
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: duplicate signal '%s'\n", name);
+	return -EINVAL;
+    }
+    new = new_signal(name, type);
+    if (new == 0) {
+	rtapi_mutex_give(&(hal_data->mutex));
+	return (type < HAL_BIT || type > HAL_U32) ? -EINVAL : -ENOMEM;
+    }
     /* search list for 'name' and insert new structure */
     prev = &(hal_data->sig_list_ptr);
     next = *prev;
@@ -1296,93 +1309,44 @@ int hal_signal_delete(const char *name)
     return -EINVAL;
 }
 
-int hal_link(const char *pin_name, const char *sig_name)
+/* links a pin to a signal, for hal_link() and halpr_restore(); the
+   caller holds the mutex */
+static int link_pin(hal_pin_t *pin, hal_sig_t *sig)
 {
-    hal_pin_t *pin;
-    hal_sig_t *sig;
     hal_comp_t *comp;
     void **data_ptr_addr, *data_addr;
 
-    if (hal_data == 0) {
-	rtapi_print_msg(RTAPI_MSG_ERR,
-	    "HAL: ERROR: link called before init\n");
-	return -EINVAL;
-    }
-
-    if (hal_data->lock & HAL_LOCK_CONFIG)  {
-	rtapi_print_msg(RTAPI_MSG_ERR,
-	    "HAL: ERROR: link called while HAL locked\n");
-	return -EPERM;
-    }
-    /* make sure we were given a pin name */
-    if (pin_name == 0) {
-	rtapi_print_msg(RTAPI_MSG_ERR, "HAL: ERROR: pin name not given\n");
-	return -EINVAL;
-    }
-    /* make sure we were given a signal name */
-    if (sig_name == 0) {
-	rtapi_print_msg(RTAPI_MSG_ERR, "HAL: ERROR: signal name not given\n");
-	return -EINVAL;
-    }
-    rtapi_print_msg(RTAPI_MSG_DBG,
-	"HAL: linking pin '%s' to '%s'\n", pin_name, sig_name);
-    /* get mutex before accessing data structures */
-    rtapi_mutex_get(&(hal_data->mutex));
-    /* locate the pin */
-    pin = halpr_find_pin_by_name(pin_name);
-    if (pin == 0) {
-	/* not found */
-	rtapi_mutex_give(&(hal_data->mutex));
-	rtapi_print_msg(RTAPI_MSG_ERR,
-	    "HAL: ERROR: pin '%s' not found\n", pin_name);
-	return -EINVAL;
-    }
-    /* locate the signal */
-    sig = halpr_find_sig_by_name(sig_name);
-    if (sig == 0) {
-	/* not found */
-	rtapi_mutex_give(&(hal_data->mutex));
-	rtapi_print_msg(RTAPI_MSG_ERR,
-	    "HAL: ERROR: signal '%s' not found\n", sig_name);
-	return -EINVAL;
-    }
-    /* found both pin and signal, are they already connected? */
+    /* are they already connected? */
     if (SHMPTR(pin->signal) == sig) {
-	rtapi_mutex_give(&(hal_data->mutex));
 	rtapi_print_msg(RTAPI_MSG_WARN,
-	    "HAL: Warning: pin '%s' already linked to '%s'\n", pin_name, sig_name);
+	    "HAL: Warning: pin '%s' already linked to '%s'\n", pin->name, sig->name);
 	return 0;
     }
     /* is the pin connected to something else? */
     if(pin->signal) {
-	rtapi_mutex_give(&(hal_data->mutex));
-	sig = SHMPTR(pin->signal);
 	rtapi_print_msg(RTAPI_MSG_ERR,
 	    "HAL: ERROR: pin '%s' is linked to '%s', cannot link to '%s'\n",
-	    pin_name, sig->name, sig_name);
+	    pin->name, ((hal_sig_t *) SHMPTR(pin->signal))->name, sig->name);
 	return -EINVAL;
     }
     /* check types */
     if (pin->type != sig->type) {
-	rtapi_mutex_give(&(hal_data->mutex));
 	rtapi_print_msg(RTAPI_MSG_ERR,
-	    "HAL: ERROR: type mismatch '%s' <- '%s'\n", pin_name, sig_name);
+	    "HAL: ERROR: type mismatch '%s' <- '%s'\n", pin->name, sig->name);
 	return -EINVAL;
     }
     /* linking output pin to sig that already has output or I/O pins? */
     if ((pin->dir == HAL_OUT) && ((sig->writers > 0) || (sig->bidirs > 0 ))) {
 	/* yes, can't do that */
-	rtapi_mutex_give(&(hal_data->mutex));
 	rtapi_print_msg(RTAPI_MSG_ERR,
-	    "HAL: ERROR: signal '%s' already has output or I/O pin(s)\n", sig_name);
+	    "HAL: ERROR: signal '%s' already has output or I/O pin(s)\n", sig->name);
 	return -EINVAL;
     }
     /* linking bidir pin to sig that already has output pin? */
     if ((pin->dir == HAL_IO) && (sig->writers > 0)) {
 	/* yes, can't do that */
-	rtapi_mutex_give(&(hal_data->mutex));
 	rtapi_print_msg(RTAPI_MSG_ERR,
-	    "HAL: ERROR: signal '%s' already has output pin\n", sig_name);
+	    "HAL: ERROR: signal '%s' already has output pin\n", sig->name);
 	return -EINVAL;
     }
     /* everything is OK, make the new link */
@@ -1402,9 +1366,62 @@ int hal_link(const char *pin_name, const char *sig_name)
     }
     /* and update the pin */
     pin->signal = SHMOFF(sig);
+    return 0;
+}
+
+int hal_link(const char *pin_name, const char *sig_name)
+{
+    hal_pin_t *pin;
+    hal_sig_t *sig;
+    int retval;
+
+    if (hal_data == 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: link called before init\n");
+	return -EINVAL;
+    }
+
+    if (hal_data->lock & HAL_LOCK_CONFIG)  {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: link called while HAL locked\n");
+	return -EPERM;
+    }
+    /* make sure we were given a pin name */
+    if (pin_name == 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR, "HAL: ERROR: pin name not given\n");
+	return -EINVAL;
+    }
+    /* make sure we were given a signal name */
+    if (sig_name == 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR, "HAL: ERROR: signal name not given\n");
+	return -EINVAL;
+    }
+    rtapi_print_msg(RTAPI_MSG_DBG,
+	"HAL: linking pin '%s' to '%s'\n", pin_name, sig_name);
+    /* get mutex before accessing data structures */
+    rtapi_mutex_get(&(hal_data->mutex));
+    /* locate the pin */
+    pin = halpr_find_pin_by_name(pin_name);
+    if (pin == 0) {
+	/* not found */
+	rtapi_mutex_give(&(hal_data->mutex));
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: pin '%s' not found\n", pin_name);
+	return -EINVAL;
+    }
+    /* locate the signal */
+    sig = halpr_find_sig_by_name(sig_name);
+    if (sig == 0) {
+	/* not found */
+	rtapi_mutex_give(&(hal_data->mutex));
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: signal '%s' not found\n", sig_name);
+	return -EINVAL;
+    }
+    retval = link_pin(pin, sig);
     /* done, release the mutex and return */
     rtapi_mutex_give(&(hal_data->mutex));
-    return 0;
+    return retval;
 }
 
 int hal_unlink(const char *pin_name)
@@ -3839,6 +3856,208 @@ static void  __attribute__ ((destructor))  ulapi_hal_lib_cleanup(void)
 }
 #endif
 
+#ifdef ULAPI
+/***********************************************************************
+*                    BULK RESTORE OF A CONFIGURATION                   *
+************************************************************************/
+
+static int cmp_pin_name(const void *key, const void *elem)
+{
+    return strcmp((const char *) key, (*(hal_pin_t **) elem)->name);
+}
+
+static int cmp_param_name(const void *key, const void *elem)
+{
+    return strcmp((const char *) key, (*(hal_param_t **) elem)->name);
+}
+
+/* the objects of a list sorted by name, in an array for bsearch();
+   works for any list whose objects start with next_ptr */
+static void **list_array(int first, int *count)
+{
+    void **array;
+    int next, n = 0;
+
+    for (next = first; next != 0; next = *((int *) SHMPTR(next))) {
+	n++;
+    }
+    array = malloc((n ? n : 1) * sizeof(void *));
+    if (array == 0) {
+	return 0;
+    }
+    n = 0;
+    for (next = first; next != 0; next = *((int *) SHMPTR(next))) {
+	array[n++] = SHMPTR(next);
+    }
+    *count = n;
+    return array;
+}
+
+static void store_value(void *dst, hal_type_t type, const hal_data_u *value)
+{
+    switch (type) {
+    case HAL_BIT:
+	*((hal_bit_t *) dst) = value->b ? 1 : 0;
+	break;
+    case HAL_FLOAT:
+	*((hal_float_t *) dst) = value->f;
+	break;
+    case HAL_S32:
+	*((hal_s32_t *) dst) = value->s;
+	break;
+    case HAL_U32:
+	*((hal_u32_t *) dst) = *((hal_u32_t *) &value->u);
+	break;
+    default:
+	break;
+    }
+}
+
+/* merges the signals, sorted by name, into the signal list, and puts
+   them in sigs[] */
+static int restore_signals(const hal_restore_t *r, hal_sig_t **sigs)
+{
+    int *prev, next, n, cmp = 1;
+    hal_sig_t *sig;
+
+    prev = &(hal_data->sig_list_ptr);
+    next = *prev;
+    for (n = 0; n < r->num_sigs; n++) {
+	/* the list and r->sigs are both in name order */
+	while (next != 0) {
+	    sig = SHMPTR(next);
+	    cmp = strcmp(sig->name, r->sigs[n].name);
+	    if (cmp >= 0) {
+		break;
+	    }
+	    prev = &(sig->next_ptr);
+	    next = *prev;
+	}
+	if (next != 0 && cmp == 0) {
+	    sig = SHMPTR(next);
+	    if (sig->type != r->sigs[n].type) {
+		rtapi_print_msg(RTAPI_MSG_ERR,
+		    "HAL: ERROR: signal '%s' exists with another type\n",
+		    sig->name);
+		return -EINVAL;
+	    }
+	} else {
+	    sig = new_signal(r->sigs[n].name, r->sigs[n].type);
+	    if (sig == 0) {
+		return -ENOMEM;
+	    }
+	    sig->next_ptr = next;
+	    *prev = SHMOFF(sig);
+	    next = *prev;
+	}
+	sigs[n] = sig;
+    }
+    return 0;
+}
+
+int halpr_restore(const hal_restore_t *r)
+{
+    hal_sig_t **sigs;
+    hal_pin_t **pins = 0, **pin;
+    hal_param_t **params = 0, **param;
+    int num_pins = 0, num_params = 0, n, retval = 0;
+
+    if (hal_data == 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: restore called before init\n");
+	return -EINVAL;
+    }
+    if (hal_data->lock & HAL_LOCK_CONFIG) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: restore called while HAL is locked\n");
+	return -EPERM;
+    }
+    /* the merge needs the signals in order, and each only once */
+    for (n = 1; n < r->num_sigs; n++) {
+	if (strcmp(r->sigs[n-1].name, r->sigs[n].name) >= 0) {
+	    rtapi_print_msg(RTAPI_MSG_ERR,
+		"HAL: ERROR: restore: signals not in name order at '%s'\n",
+		r->sigs[n].name);
+	    return -EINVAL;
+	}
+    }
+    for (n = 0; n < r->num_links; n++) {
+	if (r->links[n].sig < 0 || r->links[n].sig >= r->num_sigs) {
+	    rtapi_print_msg(RTAPI_MSG_ERR,
+		"HAL: ERROR: restore: pin '%s' links to no signal\n",
+		r->links[n].pin);
+	    return -EINVAL;
+	}
+    }
+    sigs = malloc((r->num_sigs ? r->num_sigs : 1) * sizeof(hal_sig_t *));
+    if (sigs == 0) {
+	return -ENOMEM;
+    }
+    rtapi_mutex_get(&(hal_data->mutex));
+    pins = (hal_pin_t **) list_array(hal_data->pin_list_ptr, &num_pins);
+    params = (hal_param_t **) list_array(hal_data->param_list_ptr,
+	&num_params);
+    if (pins == 0 || params == 0) {
+	retval = -ENOMEM;
+	goto out;
+    }
+    if ((retval = restore_signals(r, sigs)) != 0) {
+	goto out;
+    }
+    for (n = 0; n < r->num_links; n++) {
+	pin = bsearch(r->links[n].pin, pins, num_pins, sizeof(*pins),
+	    cmp_pin_name);
+	if (pin == 0) {
+	    rtapi_print_msg(RTAPI_MSG_ERR,
+		"HAL: ERROR: pin '%s' not found\n", r->links[n].pin);
+	    retval = -EINVAL;
+	    goto out;
+	}
+	if ((retval = link_pin(*pin, sigs[r->links[n].sig])) != 0) {
+	    goto out;
+	}
+    }
+    /* values once everything is linked, as 'sets' after 'net' */
+    for (n = 0; n < r->num_sigs; n++) {
+	store_value(SHMPTR(sigs[n]->data_ptr), sigs[n]->type,
+	    &r->sigs[n].value);
+    }
+    for (n = 0; n < r->num_params; n++) {
+	param = bsearch(r->params[n].name, params, num_params,
+	    sizeof(*params), cmp_param_name);
+	if (param == 0 || (*param)->type != r->params[n].type
+	    || (*param)->dir == HAL_RO) {
+	    rtapi_print_msg(RTAPI_MSG_ERR,
+		"HAL: ERROR: no writable %s parameter '%s'\n",
+		param == 0 ? "" : "matching", r->params[n].name);
+	    retval = -EINVAL;
+	    goto out;
+	}
+	store_value(SHMPTR((*param)->data_ptr), (*param)->type,
+	    &r->params[n].value);
+    }
+    for (n = 0; n < r->num_pins; n++) {
+	pin = bsearch(r->pins[n].name, pins, num_pins, sizeof(*pins),
+	    cmp_pin_name);
+	if (pin == 0 || (*pin)->type != r->pins[n].type
+	    || (*pin)->dir == HAL_OUT || (*pin)->signal != 0) {
+	    rtapi_print_msg(RTAPI_MSG_ERR,
+		"HAL: ERROR: no unlinked input pin '%s'\n", r->pins[n].name);
+	    retval = -EINVAL;
+	    goto out;
+	}
+	/* an unlinked pin points at its dummy signal */
+	store_value(&((*pin)->dummysig), (*pin)->type, &r->pins[n].value);
+    }
+out:
+    rtapi_mutex_give(&(hal_data->mutex));
+    free(pins);
+    free(params);
+    free(sigs);
+    return retval;
+}
+#endif /* ULAPI */
+
 
 #ifdef RTAPI
 /* only export symbols when we're building a kernel module */
@@ -0,0 +1,284 @@
+/********************************************************************
+* Description:  hal_notify.c
+*               The client side of HAL change notification: watch
+*               pins and signals through the realtime 'notify'
+*               component, and wait for changes on a file descriptor.
+*
+* License: LGPL Version 2
+********************************************************************/
+
+/** This library is free software; you can redistribute it and/or
+    modify it under the terms of version 2.1 of the GNU Lesser General
+    Public License as published by the Free Software Foundation.
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111 USA
+*/
+
+/** How it works: a futex can't be waited on with select(), so each
+    client has a thread that waits on its doorbell, and makes an
+    eventfd readable once there are changes in the ring.  It then
+    waits until hal_notify_read() has emptied the ring, so that the
+    eventfd is written once per batch of changes, not per change.
+    See hal_notify.h for the realtime side.
+*/
+
+#include "config.h"
+#include "rtapi.h"		/* RTAPI realtime OS API */
+#include "rtapi_shmkeys.h"
+#include "hal.h"		/* HAL public API decls */
+#include "hal_priv.h"		/* HAL private decls */
+#include "hal_notify.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>		/* kill() */
+#include <unistd.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>	/* SYS_futex */
+#include <linux/futex.h>
+
+struct hal_notify {
+    int comp_id;
+    int shm_id;
+    hal_notify_shm_t *shm;
+    hal_notify_client_t *client;
+    int seq;			/* of our claim of the slot */
+    ringbuffer_t ring;		/* the reader's side */
+    int efd;
+    pthread_t thread;
+    volatile int stop;
+    volatile int pending;	/* futex: efd is readable */
+};
+
+static int futex(volatile int *addr, int op, int val, int msec)
+{
+    struct timespec ts = { msec / 1000, (msec % 1000) * 1000 * 1000 };
+
+    return syscall(SYS_futex, addr, op, val, msec ? &ts : NULL, NULL, 0);
+}
+
+static void *notify_thread(void *arg)
+{
+    hal_notify_t *n = arg;
+    hal_notify_client_t *c = n->client;
+    /* without a doorbell, poll */
+    int msec = n->shm->can_wake ? 1000 : 10;
+    uint64_t one = 1;
+
+    while (!n->stop) {
+	c->doorbell = 1;
+	rtapi_smp_mb();
+	/* changes written before the doorbell was set didn't ring it */
+	if (!n->stop && record_next_size(&n->ring) < 0)
+	    futex(&c->doorbell, FUTEX_WAIT, 1, msec);
+	c->doorbell = 0;
+	if (record_next_size(&n->ring) < 0)
+	    continue;
+	n->pending = 1;
+	if (write(n->efd, &one, sizeof(one)) < 0)
+	    break;
+	while (n->pending && !n->stop)
+	    futex(&n->pending, FUTEX_WAIT_PRIVATE, 1, 1000);
+    }
+    return NULL;
+}
+
+/* attaches to the whole segment of the notify component */
+static int attach(hal_notify_t *n)
+{
+    unsigned long size;
+    void *ptr;
+    int retval;
+
+    /* the header first, to learn the size */
+    n->shm_id = rtapi_shmem_new(HAL_NOTIFY_SHMEM_KEY, n->comp_id,
+	sizeof(hal_notify_shm_t));
+    if (n->shm_id < 0)
+	return n->shm_id;
+    if ((retval = rtapi_shmem_getptr(n->shm_id, &ptr)) < 0)
+	goto fail;
+    if (((hal_notify_shm_t *) ptr)->magic != HAL_NOTIFY_MAGIC) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: notify: the notify component is not loaded\n");
+	retval = -ENOENT;
+	goto fail;
+    }
+    size = ((hal_notify_shm_t *) ptr)->shm_size;
+    rtapi_shmem_delete(n->shm_id, n->comp_id);
+    n->shm_id = rtapi_shmem_new(HAL_NOTIFY_SHMEM_KEY, n->comp_id, size);
+    if (n->shm_id < 0)
+	return n->shm_id;
+    if ((retval = rtapi_shmem_getptr(n->shm_id, &ptr)) < 0)
+	goto fail;
+    n->shm = ptr;
+    return 0;
+fail:
+    rtapi_shmem_delete(n->shm_id, n->comp_id);
+    n->shm_id = -1;
+    return retval;
+}
+
+/* claims a free slot, or one whose client died */
+static hal_notify_client_t *claim(hal_notify_shm_t *shm)
+{
+    hal_notify_client_t *c;
+    int i, pid, mine = getpid();
+
+    for (i = 0; i < shm->num_clients; i++) {
+	c = &shm->client[i];
+	pid = c->pid;
+	if (pid != 0 && !(kill(pid, 0) < 0 && errno == ESRCH))
+	    continue;
+	if (__sync_bool_compare_and_swap(&c->pid, pid, mine))
+	    return c;
+    }
+    return 0;
+}
+
+int hal_notify_open(int comp_id, hal_notify_t **notify)
+{
+    hal_notify_t *n;
+    int retval;
+
+    n = calloc(1, sizeof(hal_notify_t));
+    if (n == 0)
+	return -ENOMEM;
+    n->comp_id = comp_id;
+    n->efd = -1;
+    if ((retval = attach(n)) < 0) {
+	free(n);
+	return retval;
+    }
+    n->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (n->efd < 0) {
+	retval = -errno;
+	goto fail;
+    }
+    n->client = claim(n->shm);
+    if (n->client == 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: notify: all %d clients in use\n",
+	    n->shm->num_clients);
+	retval = -EBUSY;
+	goto fail;
+    }
+    /* whatever the funct writes for the last owner is dropped by seq */
+    n->client->num_watches = 0;
+    n->seq = __sync_add_and_fetch(&n->client->seq, 1);
+    ringbuffer_init(HAL_NOTIFY_RING(n->shm, n->client), &n->ring);
+    record_flush(&n->ring);
+    if ((retval = -pthread_create(&n->thread, NULL, notify_thread, n)) != 0) {
+	n->client->pid = 0;
+	goto fail;
+    }
+    *notify = n;
+    return 0;
+fail:
+    if (n->efd >= 0)
+	close(n->efd);
+    rtapi_shmem_delete(n->shm_id, n->comp_id);
+    free(n);
+    return retval;
+}
+
+int hal_notify_add(hal_notify_t *n, const char *name)
+{
+    hal_notify_client_t *c = n->client;
+    hal_notify_watch_t *w;
+    hal_pin_t *pin;
+    hal_sig_t *sig = 0;
+    int offset = 0, owner = 0, gen, i = c->num_watches;
+    hal_type_t type = 0;
+
+    if (i >= n->shm->max_watches)
+	return -ENOSPC;
+    rtapi_mutex_get(&(hal_data->mutex));
+    if ((pin = halpr_find_pin_by_name(name)) != 0) {
+	/* through the pin's pointer, so relinking is followed */
+	offset = pin->data_ptr_addr;
+	owner = pin->owner_ptr;
+	type = pin->type;
+    } else if ((sig = halpr_find_sig_by_name(name)) != 0) {
+	offset = sig->data_ptr;
+	owner = 0;
+	type = sig->type;
+    }
+    rtapi_mutex_give(&(hal_data->mutex));
+    if (pin == 0 && sig == 0)
+	return -ENOENT;
+    /* a funct that still counts the watches of a dead client may be
+       reading this one: take it out of use before changing it */
+    w = HAL_NOTIFY_WATCHES(n->shm, c) + i;
+    gen = w->gen | 1;
+    w->gen = gen;
+    rtapi_smp_wmb();
+    w->offset = offset;
+    w->owner = owner;
+    w->type = type;
+    rtapi_smp_wmb();
+    /* a new gen, so that the current value is reported */
+    w->gen = gen + 1;
+    /* the funct reads the watch only once it is counted */
+    rtapi_smp_wmb();
+    c->num_watches = i + 1;
+    return i;
+}
+
+int hal_notify_fd(hal_notify_t *n)
+{
+    return n->efd;
+}
+
+int hal_notify_read(hal_notify_t *n, hal_notify_event_t *event)
+{
+    const hal_notify_record_t *rec;
+    const void *data;
+    size_t size;
+    uint64_t count;
+
+    while (record_read(&n->ring, &data, &size) == 0) {
+	rec = data;
+	if (size == sizeof(*rec) && rec->seq == n->seq) {
+	    *event = rec->event;
+	    record_shift(&n->ring);
+	    return 1;
+	}
+	record_shift(&n->ring);
+    }
+    /* none left: make efd unreadable, and let the thread wait again */
+    if (n->pending) {
+	if (read(n->efd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+	    return -errno;
+	n->pending = 0;
+	futex(&n->pending, FUTEX_WAKE_PRIVATE, 1, 0);
+    }
+    return 0;
+}
+
+void hal_notify_close(hal_notify_t *n)
+{
+    hal_notify_client_t *c = n->client;
+
+    n->stop = 1;
+    rtapi_smp_mb();
+    c->doorbell = 0;
+    n->pending = 0;
+    futex(&c->doorbell, FUTEX_WAKE, 1, 0);
+    futex(&n->pending, FUTEX_WAKE_PRIVATE, 1, 0);
+    pthread_join(n->thread, NULL);
+    c->num_watches = 0;
+    rtapi_smp_wmb();
+    __sync_bool_compare_and_swap(&c->pid, getpid(), 0);
+    close(n->efd);
+    rtapi_shmem_delete(n->shm_id, n->comp_id);
+    free(n);
+}
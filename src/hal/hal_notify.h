@@ -0,0 +1,134 @@
+/********************************************************************
+* Description:  hal_notify.h
+*               Change notification for user space HAL clients.
+*
+*               The realtime 'notify' component compares the pins and
+*               signals its clients watch once per thread period, and
+*               writes the changes to a ring per client.  A client
+*               waits on a file descriptor instead of polling values.
+*
+* License: LGPL Version 2
+********************************************************************/
+
+/** This library is free software; you can redistribute it and/or
+    modify it under the terms of version 2.1 of the GNU Lesser General
+    Public License as published by the Free Software Foundation.
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111 USA
+*/
+
+/** How it works: 'loadrt notify' creates a shared memory segment with
+    a slot for each client: a table of the values it watches, and a
+    ring of change records.  A client claims a free slot, and adds
+    pins and signals to its table.  The 'notify' funct walks the tables
+    of the claimed slots, writes a record for each value that differs
+    from the one it last reported, and then rings the slot's doorbell,
+    a futex, if the client waits on it.
+
+    Each side of a ring has a single user: the funct is the writer,
+    and cannot be added to more than one thread; the client is the
+    reader.  If a ring is full, the funct keeps the last reported value
+    as it is, so the change is reported in a later period; only values
+    in between are lost.
+
+    Kernel and Xenomai RT threads can't make Linux system calls, so
+    with those flavors the client polls the ring every few msec.
+*/
+
+#ifndef HAL_NOTIFY_H
+#define HAL_NOTIFY_H
+
+#include "hal.h"
+#include "hal_priv.h"		/* hal_data_u */
+#include "ring.h"
+
+#define HAL_NOTIFY_MAGIC 0x484e5446	/* "HNTF" */
+
+/* one watched value; the client fills it in while 'gen' is odd, the
+   funct uses offset, owner and type only if 'gen' is even and the same
+   before and after it reads them */
+typedef struct {
+    volatile int gen;		/* bumped before and after filling in,
+				   0 if never used */
+    volatile int offset;	/* of the value, or the pin's data pointer */
+    volatile int owner;		/* the pin's component, 0 for a signal: the
+				   data pointer is in its address space */
+    volatile hal_type_t type;
+    int reported;		/* gen that 'last' was reported for */
+    hal_data_u last;		/* value last reported */
+} hal_notify_watch_t;
+
+/* a change, as the client reads it */
+typedef struct {
+    int watch;			/* index of the watch, from hal_notify_add() */
+    hal_type_t type;
+    hal_data_u value;
+} hal_notify_event_t;
+
+/* a change, as it is in the ring */
+typedef struct {
+    int seq;			/* of the claim it was written for */
+    hal_notify_event_t event;
+} hal_notify_record_t;
+
+typedef struct {
+    volatile int pid;		/* of the client, 0 if the slot is free */
+    volatile int seq;		/* bumped each time the slot is claimed */
+    volatile int num_watches;	/* bumped after the watch is filled in */
+    volatile int doorbell;	/* futex: 1 while the client waits */
+    volatile unsigned int overruns;	/* changes held back, ring full */
+    int watches;		/* offset of the watch table in the segment */
+    int ring;			/* offset of the ring in the segment */
+} hal_notify_client_t;
+
+typedef struct {
+    int magic;
+    unsigned long shm_size;
+    int num_clients;
+    int max_watches;		/* per client */
+    int can_wake;		/* the funct rings doorbells */
+    hal_notify_client_t client[0];
+} hal_notify_shm_t;
+
+#define HAL_NOTIFY_WATCHES(shm, c) \
+    ((hal_notify_watch_t *) ((char *) (shm) + (c)->watches))
+#define HAL_NOTIFY_RING(shm, c) \
+    ((ringheader_t *) ((char *) (shm) + (c)->ring))
+
+#ifdef ULAPI
+/** The client side, in the HAL library.
+
+    'hal_notify_open()' claims a slot of the 'notify' component for
+    the HAL component 'comp_id', and starts a thread that turns the
+    doorbell into a file descriptor, see hal_notify_fd().  It returns
+    0 and sets *notify, or a negative error code: -ENOENT if 'notify'
+    is not loaded, -EBUSY if all its slots are in use.
+
+    'hal_notify_add()' watches the pin or signal 'name', and returns
+    the index of the watch, or a negative error code.  The current
+    value is reported as a first change.
+
+    'hal_notify_fd()' is readable while there are changes to read; it
+    can be passed to select(), poll() or a GLib io watch.  Read them
+    with 'hal_notify_read()', which returns 1 and fills in *event, or
+    0 once there are none left.  Call it until it returns 0, as only
+    then is the descriptor made unreadable.
+
+    'hal_notify_close()' stops the thread and frees the slot.
+*/
+typedef struct hal_notify hal_notify_t;
+
+extern int hal_notify_open(int comp_id, hal_notify_t **notify);
+extern int hal_notify_add(hal_notify_t *notify, const char *name);
+extern int hal_notify_fd(hal_notify_t *notify);
+extern int hal_notify_read(hal_notify_t *notify, hal_notify_event_t *event);
+extern void hal_notify_close(hal_notify_t *notify);
+#endif
+
+#endif /* HAL_NOTIFY_H */
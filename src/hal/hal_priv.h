@@ -513,6 +513,133 @@ extern hal_pin_t *halpr_find_pin_by_sig(hal_sig_t * sig, hal_pin_t * start);
 void halpr_autorelease_mutex(void *variable);
 
 #ifdef ULAPI
+/** HAL snapshots.
+    A snapshot is a private copy of the component, pin, signal and
+    parameter lists, values included.  halpr_snapshot_take() gets the
+    mutex only to copy the lists, which is a single pass over each;
+    everything else - resolving links, sorting, grouping the pins of
+    each signal, and whatever the caller does with the result - runs
+    without it.  So long listings and saves of a large configuration
+    do not hold up other HAL operations.
+
+    The snapshot is consistent: it reflects the HAL at one instant.
+    Pins, signals and parameters are sorted by name, components are
+    in HAL list order.  Links between objects are indices into the
+    snapshot arrays, -1 meaning none.
+
+    Unlike the functions above, these get and release the mutex
+    themselves, so the caller must NOT hold it.
+*/
+typedef struct {
+    char name[HAL_NAME_LEN + 1];
+    int comp_id;
+    int type;			/* TYPE_RT, TYPE_USER, etc */
+    int state;
+    int pid;
+    long int last_update;
+    long int last_bound;
+    long int last_unbound;
+    int parent;			/* for instances, the component, else -1 */
+    char *insmod_args;		/* NULL if not loaded by loadrt */
+} hal_comp_snap_t;
+
+typedef struct {
+    char name[HAL_NAME_LEN + 1];
+    char oldname[HAL_NAME_LEN + 1];	/* original name if aliased, or "" */
+    int owner;			/* index in comps */
+    int signal;			/* index in sigs, or -1 */
+    hal_type_t type;
+    hal_pin_dir_t dir;
+    hal_data_u value;		/* value of the pin or its signal */
+#ifdef USE_PIN_USER_ATTRIBUTES
+    double epsilon;
+    int flags;
+#endif
+} hal_pin_snap_t;
+
+typedef struct {
+    char name[HAL_NAME_LEN + 1];
+    hal_type_t type;
+    int readers;
+    int writers;
+    int bidirs;
+    hal_data_u value;
+    int num_pins;		/* number of linked pins */
+    int *pins;			/* their indices in pins, in name order */
+} hal_sig_snap_t;
+
+typedef struct {
+    char name[HAL_NAME_LEN + 1];
+    char oldname[HAL_NAME_LEN + 1];	/* original name if aliased, or "" */
+    int owner;			/* index in comps */
+    hal_type_t type;
+    hal_param_dir_t dir;
+    hal_data_u value;
+} hal_param_snap_t;
+
+typedef struct {
+    int num_comps;
+    int num_pins;
+    int num_sigs;
+    int num_params;
+    hal_comp_snap_t *comps;
+    hal_pin_snap_t *pins;
+    hal_sig_snap_t *sigs;
+    hal_param_snap_t *params;
+    void *mem;			/* one block holding all of the above */
+} hal_snapshot_t;
+
+/** 'halpr_snapshot_take()' returns a new snapshot, or NULL if out of
+    memory.  'halpr_snapshot_free()' releases it.
+*/
+extern hal_snapshot_t *halpr_snapshot_take(void);
+extern void halpr_snapshot_free(hal_snapshot_t *snap);
+
+/** The 'halpr_snapshot_find_xxx()' functions do a binary search of a
+    snapshot by name, and return the index of the object, or -1.
+*/
+extern int halpr_snapshot_find_pin(const hal_snapshot_t *snap,
+    const char *name);
+extern int halpr_snapshot_find_sig(const hal_snapshot_t *snap,
+    const char *name);
+extern int halpr_snapshot_find_param(const hal_snapshot_t *snap,
+    const char *name);
+
+/** Bulk restore of a saved configuration, for 'halcmd snapshot restore'.
+    'halpr_restore()' creates the signals, links the pins to them and
+    sets the values of signals, parameters and unlinked pins, all under
+    the mutex, taken once.  Signals are merged into the signal list in
+    one pass, and pins and parameters are found by binary search, so a
+    large configuration is restored without a list walk per name.
+    It stops at the first error and returns it, or returns 0.
+
+    Signals already in the HAL with the same type are used as they are.
+    The caller must NOT hold the mutex.
+*/
+typedef struct {
+    char name[HAL_NAME_LEN + 1];
+    hal_type_t type;
+    hal_data_u value;
+} hal_restore_value_t;
+
+typedef struct {
+    char pin[HAL_NAME_LEN + 1];
+    int sig;			/* index in sigs */
+} hal_restore_link_t;
+
+typedef struct {
+    int num_sigs;
+    int num_links;
+    int num_params;
+    int num_pins;
+    hal_restore_value_t *sigs;	/* signals and their values, by name */
+    hal_restore_link_t *links;
+    hal_restore_value_t *params;	/* parameter values */
+    hal_restore_value_t *pins;	/* values of unlinked pins */
+} hal_restore_t;
+
+extern int halpr_restore(const hal_restore_t *r);
+
 // set in hal_lib.c:ulapi_hal_lib_init()
 // needed in using code (halcmd) to do the right thing (eg insmod vs call rtapi_app
 // to load a module)
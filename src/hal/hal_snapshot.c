@@ -0,0 +1,437 @@
+/********************************************************************
+* Description:  hal_snapshot.c
+*               Consistent, private copies of the HAL object lists,
+*               for utilities like halcmd that list or save a large
+*               configuration without holding the HAL mutex for long.
+*
+* License: LGPL Version 2
+********************************************************************/
+
+/** This library is free software; you can redistribute it and/or
+    modify it under the terms of version 2.1 of the GNU Lesser General
+    Public License as published by the Free Software Foundation.
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111 USA
+*/
+
+/** How it works: the lists are counted under the mutex, the memory
+    for the copy is allocated without it, and then the lists are
+    copied under the mutex in one pass each.  If a list grew between
+    the count and the copy, the copy is abandoned and the whole thing
+    starts over with more room.  Links between objects are copied as
+    shared memory offsets, and turned into indices after the mutex is
+    released.
+
+    The pin, signal and parameter lists are kept sorted by name by
+    hal_lib, so the copies are sorted too.
+*/
+
+#include "config.h"
+#include "rtapi.h"		/* RTAPI realtime OS API */
+#include "hal.h"		/* HAL public API decls */
+#include "hal_priv.h"		/* HAL private decls */
+
+#include <stdlib.h>
+#include <string.h>
+
+/* maps the shmem offset of a component or signal to its index */
+typedef struct {
+    int offset;
+    int index;
+} offset_map_t;
+
+static int cmp_offset(const void *a, const void *b)
+{
+    const offset_map_t *x = a, *y = b;
+
+    return (x->offset > y->offset) - (x->offset < y->offset);
+}
+
+static int find_offset(const offset_map_t *map, int n, int offset)
+{
+    offset_map_t key, *found;
+
+    if (offset == 0) {
+	return -1;
+    }
+    key.offset = offset;
+    found = bsearch(&key, map, n, sizeof(*map), cmp_offset);
+    return found ? found->index : -1;
+}
+
+static void copy_value(hal_data_u *dst, hal_type_t type, void *src)
+{
+    memset(dst, 0, sizeof(*dst));
+    switch (type) {
+    case HAL_BIT:
+	dst->b = *((hal_bit_t *) src);
+	break;
+    case HAL_FLOAT:
+	dst->f = *((hal_float_t *) src);
+	break;
+    case HAL_S32:
+	dst->s = *((hal_s32_t *) src);
+	break;
+    case HAL_U32:
+	*((hal_u32_t *) &dst->u) = *((hal_u32_t *) src);
+	break;
+    default:
+	break;
+    }
+}
+
+/* sizes of the lists, as counted under the mutex */
+typedef struct {
+    int comps;
+    int pins;
+    int sigs;
+    int params;
+    int args;			/* bytes of insmod args, with the NULs */
+} snap_size_t;
+
+static void count_lists(snap_size_t *size)
+{
+    int next;
+    hal_comp_t *comp;
+
+    memset(size, 0, sizeof(*size));
+    for (next = hal_data->comp_list_ptr; next != 0; next = comp->next_ptr) {
+	comp = SHMPTR(next);
+	size->comps++;
+	if (comp->insmod_args != 0) {
+	    size->args += strlen(SHMPTR(comp->insmod_args)) + 1;
+	}
+    }
+    for (next = hal_data->pin_list_ptr; next != 0;
+	 next = ((hal_pin_t *) SHMPTR(next))->next_ptr) {
+	size->pins++;
+    }
+    for (next = hal_data->sig_list_ptr; next != 0;
+	 next = ((hal_sig_t *) SHMPTR(next))->next_ptr) {
+	size->sigs++;
+    }
+    for (next = hal_data->param_list_ptr; next != 0;
+	 next = ((hal_param_t *) SHMPTR(next))->next_ptr) {
+	size->params++;
+    }
+}
+
+/* everything in one block: the snapshot, its arrays, the signals' pin
+   lists, the insmod args, and the offset maps used while linking */
+typedef struct {
+    hal_snapshot_t snap;
+    offset_map_t *comp_map;
+    offset_map_t *sig_map;
+    int *pin_lists;		/* the signals' pin lists, back to back */
+    char *args;			/* the components' insmod args */
+} snap_block_t;
+
+static snap_block_t *alloc_block(const snap_size_t *size)
+{
+    snap_block_t *block;
+    char *p;
+    size_t bytes;
+
+    bytes = sizeof(snap_block_t)
+	+ size->comps * (sizeof(hal_comp_snap_t) + sizeof(offset_map_t))
+	+ size->pins * (sizeof(hal_pin_snap_t) + sizeof(int))
+	+ size->sigs * (sizeof(hal_sig_snap_t) + sizeof(offset_map_t))
+	+ size->params * sizeof(hal_param_snap_t)
+	+ size->args;
+    block = calloc(1, bytes);
+    if (block == 0) {
+	return 0;
+    }
+    /* largest alignment first */
+    p = (char *) (block + 1);
+    block->snap.pins = (hal_pin_snap_t *) p;
+    p += size->pins * sizeof(hal_pin_snap_t);
+    block->snap.sigs = (hal_sig_snap_t *) p;
+    p += size->sigs * sizeof(hal_sig_snap_t);
+    block->snap.params = (hal_param_snap_t *) p;
+    p += size->params * sizeof(hal_param_snap_t);
+    block->snap.comps = (hal_comp_snap_t *) p;
+    p += size->comps * sizeof(hal_comp_snap_t);
+    block->comp_map = (offset_map_t *) p;
+    p += size->comps * sizeof(offset_map_t);
+    block->sig_map = (offset_map_t *) p;
+    p += size->sigs * sizeof(offset_map_t);
+    /* the signals' pin lists share one array, one entry per pin */
+    block->pin_lists = (int *) p;
+    p += size->pins * sizeof(int);
+    block->args = p;
+    block->snap.mem = block;
+    return block;
+}
+
+/* Copies the lists into 'block', which was sized by 'size'.  Must be
+   called with the mutex held.  Returns 0, or -1 if something did not
+   fit because the HAL changed since it was counted.  Links are left
+   as shmem offsets in pin->owner, pin->signal and param->owner.
+*/
+static int copy_lists(snap_block_t *block, const snap_size_t *size)
+{
+    hal_snapshot_t *snap = &block->snap;
+    int next, n, args_used = 0;
+    hal_comp_t *comp;
+    hal_pin_t *pin;
+    hal_sig_t *sig;
+    hal_param_t *param;
+    hal_oldname_t *oldname;
+    hal_comp_snap_t *cs;
+    hal_pin_snap_t *ps;
+    hal_sig_snap_t *ss;
+    hal_param_snap_t *as;
+    void *dptr;
+
+    n = 0;
+    for (next = hal_data->comp_list_ptr; next != 0; next = comp->next_ptr) {
+	comp = SHMPTR(next);
+	if (n == size->comps) {
+	    return -1;
+	}
+	cs = &snap->comps[n];
+	memcpy(cs->name, comp->name, sizeof(cs->name));
+	cs->comp_id = comp->comp_id;
+	cs->type = comp->type;
+	cs->state = comp->state;
+	cs->pid = comp->pid;
+	cs->last_update = comp->last_update;
+	cs->last_bound = comp->last_bound;
+	cs->last_unbound = comp->last_unbound;
+	cs->insmod_args = 0;
+	if (comp->insmod_args != 0) {
+	    char *args = SHMPTR(comp->insmod_args);
+	    int len = strlen(args) + 1;
+	    if (args_used + len > size->args) {
+		return -1;
+	    }
+	    cs->insmod_args = block->args + args_used;
+	    memcpy(cs->insmod_args, args, len);
+	    args_used += len;
+	}
+	block->comp_map[n].offset = next;
+	block->comp_map[n].index = n;
+	n++;
+    }
+    snap->num_comps = n;
+
+    n = 0;
+    for (next = hal_data->pin_list_ptr; next != 0; next = pin->next_ptr) {
+	pin = SHMPTR(next);
+	if (n == size->pins) {
+	    return -1;
+	}
+	ps = &snap->pins[n];
+	memcpy(ps->name, pin->name, sizeof(ps->name));
+	ps->oldname[0] = '\0';
+	if (pin->oldname != 0) {
+	    oldname = SHMPTR(pin->oldname);
+	    memcpy(ps->oldname, oldname->name, sizeof(ps->oldname));
+	}
+	ps->owner = pin->owner_ptr;
+	ps->signal = pin->signal;
+	ps->type = pin->type;
+	ps->dir = pin->dir;
+	if (pin->signal != 0) {
+	    sig = SHMPTR(pin->signal);
+	    dptr = SHMPTR(sig->data_ptr);
+	} else {
+	    dptr = &(pin->dummysig);
+	}
+	copy_value(&ps->value, pin->type, dptr);
+#ifdef USE_PIN_USER_ATTRIBUTES
+	ps->epsilon = pin->epsilon;
+	ps->flags = pin->flags;
+#endif
+	n++;
+    }
+    snap->num_pins = n;
+
+    n = 0;
+    for (next = hal_data->sig_list_ptr; next != 0; next = sig->next_ptr) {
+	sig = SHMPTR(next);
+	if (n == size->sigs) {
+	    return -1;
+	}
+	ss = &snap->sigs[n];
+	memcpy(ss->name, sig->name, sizeof(ss->name));
+	ss->type = sig->type;
+	ss->readers = sig->readers;
+	ss->writers = sig->writers;
+	ss->bidirs = sig->bidirs;
+	copy_value(&ss->value, sig->type, SHMPTR(sig->data_ptr));
+	block->sig_map[n].offset = next;
+	block->sig_map[n].index = n;
+	n++;
+    }
+    snap->num_sigs = n;
+
+    n = 0;
+    for (next = hal_data->param_list_ptr; next != 0; next = param->next_ptr) {
+	param = SHMPTR(next);
+	if (n == size->params) {
+	    return -1;
+	}
+	as = &snap->params[n];
+	memcpy(as->name, param->name, sizeof(as->name));
+	as->oldname[0] = '\0';
+	if (param->oldname != 0) {
+	    oldname = SHMPTR(param->oldname);
+	    memcpy(as->oldname, oldname->name, sizeof(as->oldname));
+	}
+	as->owner = param->owner_ptr;
+	as->type = param->type;
+	as->dir = param->dir;
+	copy_value(&as->value, param->type, SHMPTR(param->data_ptr));
+	n++;
+    }
+    snap->num_params = n;
+    return 0;
+}
+
+/* turns the offsets left by copy_lists() into indices, and builds the
+   signals' pin lists; runs without the mutex */
+static void link_lists(snap_block_t *block)
+{
+    hal_snapshot_t *snap = &block->snap;
+    int n, m, id, *next_pin;
+
+    qsort(block->comp_map, snap->num_comps, sizeof(offset_map_t),
+	cmp_offset);
+    qsort(block->sig_map, snap->num_sigs, sizeof(offset_map_t),
+	cmp_offset);
+    for (n = 0; n < snap->num_comps; n++) {
+	snap->comps[n].parent = -1;
+	if (snap->comps[n].type == TYPE_INSTANCE) {
+	    id = snap->comps[n].comp_id & 0xffff;
+	    for (m = 0; m < snap->num_comps; m++) {
+		if (snap->comps[m].comp_id == id) {
+		    snap->comps[n].parent = m;
+		    break;
+		}
+	    }
+	}
+    }
+    for (n = 0; n < snap->num_params; n++) {
+	snap->params[n].owner = find_offset(block->comp_map,
+	    snap->num_comps, snap->params[n].owner);
+    }
+    for (n = 0; n < snap->num_sigs; n++) {
+	snap->sigs[n].num_pins = 0;
+    }
+    for (n = 0; n < snap->num_pins; n++) {
+	snap->pins[n].owner = find_offset(block->comp_map,
+	    snap->num_comps, snap->pins[n].owner);
+	snap->pins[n].signal = find_offset(block->sig_map,
+	    snap->num_sigs, snap->pins[n].signal);
+	if (snap->pins[n].signal >= 0) {
+	    snap->sigs[snap->pins[n].signal].num_pins++;
+	}
+    }
+    /* give each signal its slice of the shared pin list, then fill
+       them in pin order, so each signal's pins are sorted too */
+    next_pin = block->pin_lists;
+    for (n = 0; n < snap->num_sigs; n++) {
+	snap->sigs[n].pins = next_pin;
+	next_pin += snap->sigs[n].num_pins;
+	snap->sigs[n].num_pins = 0;
+    }
+    for (n = 0; n < snap->num_pins; n++) {
+	m = snap->pins[n].signal;
+	if (m >= 0) {
+	    snap->sigs[m].pins[snap->sigs[m].num_pins++] = n;
+	}
+    }
+}
+
+hal_snapshot_t *halpr_snapshot_take(void)
+{
+    snap_size_t size, room;
+    snap_block_t *block;
+    int retval;
+
+    if (hal_data == 0) {
+	rtapi_print_msg(RTAPI_MSG_ERR,
+	    "HAL: ERROR: halpr_snapshot_take called before init\n");
+	return 0;
+    }
+    while (1) {
+	rtapi_mutex_get(&(hal_data->mutex));
+	count_lists(&size);
+	rtapi_mutex_give(&(hal_data->mutex));
+	/* some slack, in case things are added before the copy */
+	room.comps = size.comps + 4;
+	room.pins = size.pins + size.pins / 8 + 16;
+	room.sigs = size.sigs + size.sigs / 8 + 16;
+	room.params = size.params + size.params / 8 + 16;
+	room.args = size.args + 256;
+	block = alloc_block(&room);
+	if (block == 0) {
+	    rtapi_print_msg(RTAPI_MSG_ERR,
+		"HAL: ERROR: no memory for snapshot\n");
+	    return 0;
+	}
+	rtapi_mutex_get(&(hal_data->mutex));
+	retval = copy_lists(block, &room);
+	rtapi_mutex_give(&(hal_data->mutex));
+	if (retval == 0) {
+	    break;
+	}
+	/* the HAL grew past the slack, try again */
+	free(block);
+    }
+    link_lists(block);
+    return &block->snap;
+}
+
+void halpr_snapshot_free(hal_snapshot_t *snap)
+{
+    if (snap != 0) {
+	free(snap->mem);
+    }
+}
+
+/* binary search of an array of structs that start with a name */
+static int find_name(const void *array, int num, size_t size,
+    const char *name)
+{
+    int lo = 0, hi = num - 1, mid, cmp;
+
+    while (lo <= hi) {
+	mid = (lo + hi) / 2;
+	cmp = strcmp((const char *) array + mid * size, name);
+	if (cmp == 0) {
+	    return mid;
+	} else if (cmp < 0) {
+	    lo = mid + 1;
+	} else {
+	    hi = mid - 1;
+	}
+    }
+    return -1;
+}
+
+int halpr_snapshot_find_pin(const hal_snapshot_t *snap, const char *name)
+{
+    return find_name(snap->pins, snap->num_pins, sizeof(hal_pin_snap_t),
+	name);
+}
+
+int halpr_snapshot_find_sig(const hal_snapshot_t *snap, const char *name)
+{
+    return find_name(snap->sigs, snap->num_sigs, sizeof(hal_sig_snap_t),
+	name);
+}
+
+int halpr_snapshot_find_param(const hal_snapshot_t *snap, const char *name)
+{
+    return find_name(snap->params, snap->num_params,
+	sizeof(hal_param_snap_t), name);
+}
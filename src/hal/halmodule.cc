@@ -19,12 +19,14 @@
 #include <Python.h>
 #include <string>
 #include <map>
+#include <vector>
 using namespace std;
 
 #include "config.h"
 #include "rtapi.h"
 #include "hal.h"
 #include "hal_priv.h"
+#include "hal_notify.h"
 
 #if PY_VERSION_HEX < 0x02050000 && !defined(PY_SSIZE_T_MIN)
 typedef int Py_ssize_t;
@@ -1069,6 +1071,400 @@ PyTypeObject shm_type = {
 };
 
 
+struct notifyobject {
+    PyObject_HEAD
+    halobject *comp;
+    hal_notify_t *notify;
+    std::vector<std::string> *names;
+};
+
+static int pynotify_init(PyObject *_self, PyObject *args, PyObject *kw) {
+    notifyobject *self = (notifyobject *)_self;
+    halobject *comp;
+
+    if(!PyArg_ParseTuple(args, "O!:hal.notifier", &halobject_type, &comp))
+	return -1;
+    if(self->notify) {
+	PyErr_SetString(PyExc_RuntimeError, "notifier already open");
+	return -1;
+    }
+
+    int res = hal_notify_open(comp->hal_id, &self->notify);
+    if(res) {
+	self->notify = 0;
+	pyhal_error(res);
+	return -1;
+    }
+    self->comp = comp;
+    Py_INCREF(self->comp);
+    self->names = new std::vector<std::string>();
+    return 0;
+}
+
+static void pynotify_delete(PyObject *_self) {
+    notifyobject *self = (notifyobject *)_self;
+    if(self->notify)
+	hal_notify_close(self->notify);
+    delete self->names;
+    Py_XDECREF(self->comp);
+    self->ob_type->tp_free(self);
+}
+
+#define EXCEPTION_IF_NOT_OPEN(retval) do { \
+    if(!self->notify) { \
+        PyErr_SetString(PyExc_RuntimeError, "Invalid operation on closed HAL notifier"); \
+	return retval; \
+    } \
+} while(0)
+
+static PyObject *notify_add(PyObject *_self, PyObject *args) {
+    notifyobject *self = (notifyobject *)_self;
+    char *name;
+
+    if(!PyArg_ParseTuple(args, "s", &name)) return NULL;
+    EXCEPTION_IF_NOT_OPEN(NULL);
+    int res = hal_notify_add(self->notify, name);
+    if(res == -ENOENT) {
+	PyErr_Format(PyExc_NameError, "Pin or signal `%s' does not exist", name);
+	return NULL;
+    }
+    if(res < 0) return pyhal_error(res);
+    self->names->push_back(name);
+    return PyInt_FromLong(res);
+}
+
+static PyObject *notify_fileno(PyObject *_self, PyObject *o) {
+    notifyobject *self = (notifyobject *)_self;
+    EXCEPTION_IF_NOT_OPEN(NULL);
+    return PyInt_FromLong(hal_notify_fd(self->notify));
+}
+
+static PyObject *notify_value(hal_notify_event_t *ev) {
+    switch(ev->type) {
+	case HAL_BIT: return PyBool_FromLong(ev->value.b);
+	case HAL_U32: return PyLong_FromUnsignedLong((hal_u32_t)ev->value.u);
+	case HAL_S32: return PyInt_FromLong(ev->value.s);
+	case HAL_FLOAT: return PyFloat_FromDouble(ev->value.f);
+	default: break;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *notify_read(PyObject *_self, PyObject *o) {
+    notifyobject *self = (notifyobject *)_self;
+    hal_notify_event_t ev;
+    int res;
+
+    EXCEPTION_IF_NOT_OPEN(NULL);
+    PyObject *result = PyList_New(0);
+    if(!result) return NULL;
+    while((res = hal_notify_read(self->notify, &ev)) > 0) {
+	if(ev.watch < 0 || ev.watch >= (int)self->names->size())
+	    continue;
+	PyObject *item = Py_BuildValue("(sN)",
+	    (*self->names)[ev.watch].c_str(), notify_value(&ev));
+	if(!item || PyList_Append(result, item) < 0) {
+	    Py_XDECREF(item);
+	    Py_DECREF(result);
+	    return NULL;
+	}
+	Py_DECREF(item);
+    }
+    if(res < 0) {
+	Py_DECREF(result);
+	return pyhal_error(res);
+    }
+    return result;
+}
+
+static PyObject *notify_close(PyObject *_self, PyObject *o) {
+    notifyobject *self = (notifyobject *)_self;
+    if(self->notify)
+	hal_notify_close(self->notify);
+    self->notify = 0;
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef notify_methods[] = {
+    {"add", notify_add, METH_VARARGS,
+	"Watch a pin or signal, and return the index of the watch"},
+    {"fileno", notify_fileno, METH_NOARGS,
+	"Get a file descriptor that is readable while there are changes"},
+    {"read", notify_read, METH_NOARGS,
+	"Get the changes as a list of (name, value), and clear the descriptor"},
+    {"close", notify_close, METH_NOARGS,
+	"Stop watching, and free the notify slot"},
+    {NULL},
+};
+
+static 
+PyTypeObject notify_type = {
+    PyObject_HEAD_INIT(NULL)
+    0,                         /*ob_size*/
+    "hal.notifier",            /*tp_name*/
+    sizeof(notifyobject),      /*tp_basicsize*/
+    0,                         /*tp_itemsize*/
+    pynotify_delete,           /*tp_dealloc*/
+    0,                         /*tp_print*/
+    0,                         /*tp_getattr*/
+    0,                         /*tp_setattr*/
+    0,                         /*tp_compare*/
+    0,                         /*tp_repr*/
+    0,                         /*tp_as_number*/
+    0,                         /*tp_as_sequence*/
+    0,                         /*tp_as_mapping*/
+    0,                         /*tp_hash */
+    0,                         /*tp_call*/
+    0,                         /*tp_str*/
+    0,                         /*tp_getattro*/
+    0,                         /*tp_setattro*/
+    0,                         /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT,        /*tp_flags*/
+    "HAL change notification, needs the notify component",  /*tp_doc*/
+    0,                         /*tp_traverse*/
+    0,                         /*tp_clear*/
+    0,                         /*tp_richcompare*/
+    0,                         /*tp_weaklistoffset*/
+    0,                         /*tp_iter*/
+    0,                         /*tp_iternext*/
+    notify_methods,            /*tp_methods*/
+    0,                         /*tp_members*/
+    0,                         /*tp_getset*/
+    0,                         /*tp_base*/
+    0,                         /*tp_dict*/
+    0,                         /*tp_descr_get*/
+    0,                         /*tp_descr_set*/
+    0,                         /*tp_dictoffset*/
+    pynotify_init,             /*tp_init*/
+    0,                         /*tp_alloc*/
+    PyType_GenericNew,         /*tp_new*/
+    0,                         /*tp_free*/
+    0,                         /*tp_is_gc*/
+};
+
+
+struct groupobject {
+    PyObject_HEAD
+    halobject *comp;
+    std::vector<halitem> *items;
+};
+
+static int pygroup_init(PyObject *_self, PyObject *args, PyObject *kw) {
+    groupobject *self = (groupobject *)_self;
+    halobject *comp;
+    PyObject *names;
+
+    if(!PyArg_ParseTuple(args, "O!O:hal.pingroup",
+		&halobject_type, &comp, &names))
+	return -1;
+    if(comp->hal_id <= 0) {
+        PyErr_SetString(PyExc_RuntimeError, "Invalid operation on closed HAL component");
+	return -1;
+    }
+    PyObject *seq = PySequence_Fast(names, "names must be a sequence");
+    if(!seq) return -1;
+
+    // resolve the names once; the items stay in the component's map
+    std::vector<halitem> *items = new std::vector<halitem>();
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+    for(Py_ssize_t i = 0; i < n; i++) {
+	halitem *item =
+	    find_item(comp, PyString_AsString(PySequence_Fast_GET_ITEM(seq, i)));
+	if(!item) {
+	    delete items;
+	    Py_DECREF(seq);
+	    return -1;
+	}
+	items->push_back(*item);
+    }
+    Py_DECREF(seq);
+
+    delete self->items;
+    self->items = items;
+    Py_XDECREF(self->comp);
+    self->comp = comp;
+    Py_INCREF(self->comp);
+    return 0;
+}
+
+static void pygroup_delete(PyObject *_self) {
+    groupobject *self = (groupobject *)_self;
+    delete self->items;
+    Py_XDECREF(self->comp);
+    self->ob_type->tp_free(self);
+}
+
+#define EXCEPTION_IF_NOT_BOUND(retval) do { \
+    if(!self->comp || self->comp->hal_id <= 0) { \
+        PyErr_SetString(PyExc_RuntimeError, "Invalid operation on closed HAL component"); \
+	return retval; \
+    } \
+} while(0)
+
+// the value of an item as a double, for the buffer forms of get and set
+static double group_read_double(halitem *item) {
+    paramunion *v = item->is_pin ?
+	(paramunion *)item->u->pin.v : &item->u->param;
+    switch(item->type) {
+	case HAL_BIT: return v->b ? 1.0 : 0.0;
+	case HAL_U32: return v->u32;
+	case HAL_S32: return v->s32;
+	case HAL_FLOAT: return v->f;
+	default: return 0.0;
+    }
+}
+
+static void group_write_double(halitem *item, double d) {
+    paramunion *v = item->is_pin ?
+	(paramunion *)item->u->pin.v : &item->u->param;
+    switch(item->type) {
+	case HAL_BIT: v->b = d != 0.0; break;
+	case HAL_U32: v->u32 = (hal_u32_t)d; break;
+	case HAL_S32: v->s32 = (hal_s32_t)d; break;
+	case HAL_FLOAT: v->f = d; break;
+	default: break;
+    }
+}
+
+static PyObject *group_get(PyObject *_self, PyObject *args) {
+    groupobject *self = (groupobject *)_self;
+    PyObject *buffer = 0;
+
+    if(!PyArg_ParseTuple(args, "|O", &buffer)) return NULL;
+    EXCEPTION_IF_NOT_BOUND(NULL);
+    size_t n = self->items->size();
+
+    if(buffer) {
+	void *buf;
+	Py_ssize_t len;
+	if(PyObject_AsWriteBuffer(buffer, &buf, &len) < 0) return NULL;
+	if((size_t)len < n * sizeof(double)) {
+	    PyErr_Format(PyExc_ValueError,
+		    "buffer too small: %d doubles needed", (int)n);
+	    return NULL;
+	}
+	double *d = (double *)buf;
+	for(size_t i = 0; i < n; i++)
+	    d[i] = group_read_double(&(*self->items)[i]);
+	return PyInt_FromLong(n);
+    }
+
+    PyObject *result = PyTuple_New(n);
+    if(!result) return NULL;
+    for(size_t i = 0; i < n; i++) {
+	PyObject *v = pyhal_read_common(&(*self->items)[i]);
+	if(!v) {
+	    Py_DECREF(result);
+	    return NULL;
+	}
+	PyTuple_SET_ITEM(result, i, v);
+    }
+    return result;
+}
+
+static PyObject *group_set(PyObject *_self, PyObject *args) {
+    groupobject *self = (groupobject *)_self;
+    PyObject *values;
+
+    if(!PyArg_ParseTuple(args, "O", &values)) return NULL;
+    EXCEPTION_IF_NOT_BOUND(NULL);
+    size_t n = self->items->size();
+
+    if(PyObject_CheckReadBuffer(values) && !PyString_Check(values)) {
+	const void *buf;
+	Py_ssize_t len;
+	if(PyObject_AsReadBuffer(values, &buf, &len) < 0) return NULL;
+	if((size_t)len != n * sizeof(double)) {
+	    PyErr_Format(PyExc_ValueError,
+		    "buffer size mismatch: %d doubles expected", (int)n);
+	    return NULL;
+	}
+	const double *d = (const double *)buf;
+	for(size_t i = 0; i < n; i++)
+	    group_write_double(&(*self->items)[i], d[i]);
+	Py_RETURN_NONE;
+    }
+
+    PyObject *seq = PySequence_Fast(values, "values must be a sequence or buffer");
+    if(!seq) return NULL;
+    if((size_t)PySequence_Fast_GET_SIZE(seq) != n) {
+	PyErr_Format(PyExc_ValueError, "%d values expected", (int)n);
+	Py_DECREF(seq);
+	return NULL;
+    }
+    for(size_t i = 0; i < n; i++) {
+	if(pyhal_write_common(&(*self->items)[i],
+		    PySequence_Fast_GET_ITEM(seq, i)) < 0) {
+	    Py_DECREF(seq);
+	    return NULL;
+	}
+    }
+    Py_DECREF(seq);
+    Py_RETURN_NONE;
+}
+
+static Py_ssize_t pygroup_len(PyObject *_self) {
+    groupobject *self = (groupobject *)_self;
+    return self->items ? self->items->size() : 0;
+}
+
+static PySequenceMethods group_sequence = {
+    pygroup_len,               /*sq_length*/
+};
+
+static PyMethodDef group_methods[] = {
+    {"get", group_get, METH_VARARGS,
+	"Get all values as a tuple, or as doubles into a writable buffer"},
+    {"set", group_set, METH_VARARGS,
+	"Set all values from a sequence, or from a buffer of doubles"},
+    {NULL},
+};
+
+static 
+PyTypeObject group_type = {
+    PyObject_HEAD_INIT(NULL)
+    0,                         /*ob_size*/
+    "hal.pingroup",            /*tp_name*/
+    sizeof(groupobject),       /*tp_basicsize*/
+    0,                         /*tp_itemsize*/
+    pygroup_delete,            /*tp_dealloc*/
+    0,                         /*tp_print*/
+    0,                         /*tp_getattr*/
+    0,                         /*tp_setattr*/
+    0,                         /*tp_compare*/
+    0,                         /*tp_repr*/
+    0,                         /*tp_as_number*/
+    &group_sequence,           /*tp_as_sequence*/
+    0,                         /*tp_as_mapping*/
+    0,                         /*tp_hash */
+    0,                         /*tp_call*/
+    0,                         /*tp_str*/
+    0,                         /*tp_getattro*/
+    0,                         /*tp_setattro*/
+    0,                         /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT,        /*tp_flags*/
+    "Pins and params of a HAL component, read and written together",  /*tp_doc*/
+    0,                         /*tp_traverse*/
+    0,                         /*tp_clear*/
+    0,                         /*tp_richcompare*/
+    0,                         /*tp_weaklistoffset*/
+    0,                         /*tp_iter*/
+    0,                         /*tp_iternext*/
+    group_methods,             /*tp_methods*/
+    0,                         /*tp_members*/
+    0,                         /*tp_getset*/
+    0,                         /*tp_base*/
+    0,                         /*tp_dict*/
+    0,                         /*tp_descr_get*/
+    0,                         /*tp_descr_set*/
+    0,                         /*tp_dictoffset*/
+    pygroup_init,              /*tp_init*/
+    0,                         /*tp_alloc*/
+    PyType_GenericNew,         /*tp_new*/
+    0,                         /*tp_free*/
+    0,                         /*tp_is_gc*/
+};
+
 PyMethodDef module_methods[] = {
     {"pin_has_writer", pin_has_writer, METH_VARARGS,
 	"Return a FALSE value if a pin has no writers and TRUE if it does"},
@@ -1126,9 +1522,13 @@ void init_hal(void) {
     PyType_Ready(&halobject_type);
     PyType_Ready(&shm_type);
     PyType_Ready(&halpin_type);
+    PyType_Ready(&notify_type);
+    PyType_Ready(&group_type);
     PyModule_AddObject(m, "component", (PyObject*)&halobject_type);
     PyModule_AddObject(m, "shm", (PyObject*)&shm_type);
     PyModule_AddObject(m, "item", (PyObject*)&halpin_type);
+    PyModule_AddObject(m, "notifier", (PyObject*)&notify_type);
+    PyModule_AddObject(m, "pingroup", (PyObject*)&group_type);
 
     PyModule_AddIntConstant(m, "MSG_NONE", RTAPI_MSG_NONE);
     PyModule_AddIntConstant(m, "MSG_ERR", RTAPI_MSG_ERR);
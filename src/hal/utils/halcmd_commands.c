@@ -59,19 +59,20 @@
 
 
 static int unloadrt_comp(char *mod_name);
-static void print_comp_info(char **patterns);
-static void print_pin_info(int type, char **patterns);
-static void print_pin_aliases(char **patterns);
-static void print_param_aliases(char **patterns);
-static void print_sig_info(int type, char **patterns);
-static void print_script_sig_info(int type, char **patterns);
-static void print_param_info(int type, char **patterns);
+static void print_comp_info(hal_snapshot_t *snap, char **patterns);
+static void print_pin_info(hal_snapshot_t *snap, int type, char **patterns);
+static void print_pin_aliases(hal_snapshot_t *snap, char **patterns);
+static void print_param_aliases(hal_snapshot_t *snap, char **patterns);
+static void print_sig_info(hal_snapshot_t *snap, int type, char **patterns);
+static void print_script_sig_info(hal_snapshot_t *snap, int type,
+    char **patterns);
+static void print_param_info(hal_snapshot_t *snap, int type, char **patterns);
 static void print_funct_info(char **patterns);
 static void print_thread_info(char **patterns);
-static void print_comp_names(char **patterns);
-static void print_pin_names(char **patterns);
-static void print_sig_names(char **patterns);
-static void print_param_names(char **patterns);
+static void print_comp_names(hal_snapshot_t *snap, char **patterns);
+static void print_pin_names(hal_snapshot_t *snap, char **patterns);
+static void print_sig_names(hal_snapshot_t *snap, char **patterns);
+static void print_param_names(hal_snapshot_t *snap, char **patterns);
 static void print_funct_names(char **patterns);
 static void print_thread_names(char **patterns);
 
@@ -86,12 +87,12 @@ static const char *data_arrow1(int dir);
 static const char *data_arrow2(int dir);
 static char *data_value(int type, void *valptr);
 static char *data_value2(int type, void *valptr);
-static void save_comps(FILE *dst);
-static void save_aliases(FILE *dst);
-static void save_signals(FILE *dst, int only_unlinked);
-static void save_links(FILE *dst, int arrows);
-static void save_nets(FILE *dst, int arrows);
-static void save_params(FILE *dst);
+static void save_comps(hal_snapshot_t *snap, FILE *dst);
+static void save_aliases(hal_snapshot_t *snap, FILE *dst);
+static void save_signals(hal_snapshot_t *snap, FILE *dst, int only_unlinked);
+static void save_links(hal_snapshot_t *snap, FILE *dst, int arrows);
+static void save_nets(hal_snapshot_t *snap, FILE *dst, int arrows);
+static void save_params(hal_snapshot_t *snap, FILE *dst);
 static void save_threads(FILE *dst);
 static void print_help_commands(void);
 
@@ -110,6 +111,24 @@ static int match(char **patterns, char *value) {
     return 0;
 }
 
+/* show, list and save work from a snapshot of the HAL, so the mutex is
+   only held while it is copied, not while the output is written.
+   Functions and threads are few and still read under the mutex, so
+   commands that only touch those don't need a snapshot.
+*/
+static int needs_snapshot(char *type) {
+    return !type || (strcmp(type, "funct") != 0 &&
+	strcmp(type, "function") != 0 && strcmp(type, "thread") != 0);
+}
+
+static hal_snapshot_t *take_snapshot(void) {
+    hal_snapshot_t *snap = halpr_snapshot_take();
+    if (!snap) {
+	halcmd_error("can't take a snapshot of the HAL: out of memory\n");
+    }
+    return snap;
+}
+
 int do_lock_cmd(char *command)
 {
     int retval=0;
@@ -976,49 +995,57 @@ int do_log_cmd(char *type, char *level)
 
 int do_show_cmd(char *type, char **patterns)
 {
+    hal_snapshot_t *snap = 0;
+    int retval = 0;
 
     if (rtapi_get_msg_level() == RTAPI_MSG_NONE) {
 	/* must be -Q, don't print anything */
 	return 0;
     }
+    if (needs_snapshot(type)) {
+	snap = take_snapshot();
+	if (!snap) {
+	    return -ENOMEM;
+	}
+    }
     if (!type || *type == '\0') {
 	/* print everything */
-	print_comp_info(NULL);
-	print_pin_info(-1, NULL);
-	print_pin_aliases(NULL);
-	print_sig_info(-1, NULL);
-	print_param_info(-1, NULL);
-	print_param_aliases(NULL);
+	print_comp_info(snap, NULL);
+	print_pin_info(snap, -1, NULL);
+	print_pin_aliases(snap, NULL);
+	print_sig_info(snap, -1, NULL);
+	print_param_info(snap, -1, NULL);
+	print_param_aliases(snap, NULL);
 	print_funct_info(NULL);
 	print_thread_info(NULL);
     } else if (strcmp(type, "all") == 0) {
 	/* print everything, using the pattern */
-	print_comp_info(patterns);
-	print_pin_info(-1, patterns);
-	print_pin_aliases(patterns);
-	print_sig_info(-1, patterns);
-	print_param_info(-1, patterns);
-	print_param_aliases(patterns);
+	print_comp_info(snap, patterns);
+	print_pin_info(snap, -1, patterns);
+	print_pin_aliases(snap, patterns);
+	print_sig_info(snap, -1, patterns);
+	print_param_info(snap, -1, patterns);
+	print_param_aliases(snap, patterns);
 	print_funct_info(patterns);
 	print_thread_info(patterns);
     } else if (strcmp(type, "comp") == 0) {
-	print_comp_info(patterns);
+	print_comp_info(snap, patterns);
 
     } else if (strcmp(type, "pin") == 0) {
 	int type = get_type(&patterns);
-	print_pin_info(type, patterns);
+	print_pin_info(snap, type, patterns);
     } else if (strcmp(type, "sig") == 0) {
 	int type = get_type(&patterns);
-	print_sig_info(type, patterns);
+	print_sig_info(snap, type, patterns);
     } else if (strcmp(type, "signal") == 0) {
 	int type = get_type(&patterns);
-	print_sig_info(type, patterns);
+	print_sig_info(snap, type, patterns);
     } else if (strcmp(type, "param") == 0) {
 	int type = get_type(&patterns);
-	print_param_info(type, patterns);
+	print_param_info(snap, type, patterns);
     } else if (strcmp(type, "parameter") == 0) {
 	int type = get_type(&patterns);
-	print_param_info(type, patterns);
+	print_param_info(snap, type, patterns);
     } else if (strcmp(type, "funct") == 0) {
 	print_funct_info(patterns);
     } else if (strcmp(type, "function") == 0) {
@@ -1026,17 +1053,21 @@ int do_show_cmd(char *type, char **patterns)
     } else if (strcmp(type, "thread") == 0) {
 	print_thread_info(patterns);
     } else if (strcmp(type, "alias") == 0) {
-	print_pin_aliases(patterns);
-	print_param_aliases(patterns);
+	print_pin_aliases(snap, patterns);
+	print_param_aliases(snap, patterns);
     } else {
 	halcmd_error("Unknown 'show' type '%s'\n", type);
-	return -1;
+	retval = -1;
     }
-    return 0;
+    halpr_snapshot_free(snap);
+    return retval;
 }
 
 int do_list_cmd(char *type, char **patterns)
 {
+    hal_snapshot_t *snap = 0;
+    int retval = 0;
+
     if ( !type) {
 	halcmd_error("'list' requires type'\n");
 	return -1;
@@ -1045,18 +1076,24 @@ int do_list_cmd(char *type, char **patterns)
 	/* must be -Q, don't print anything */
 	return 0;
     }
+    if (needs_snapshot(type)) {
+	snap = take_snapshot();
+	if (!snap) {
+	    return -ENOMEM;
+	}
+    }
     if (strcmp(type, "comp") == 0) {
-	print_comp_names(patterns);
+	print_comp_names(snap, patterns);
     } else if (strcmp(type, "pin") == 0) {
-	print_pin_names(patterns);
+	print_pin_names(snap, patterns);
     } else if (strcmp(type, "sig") == 0) {
-	print_sig_names(patterns);
+	print_sig_names(snap, patterns);
     } else if (strcmp(type, "signal") == 0) {
-	print_sig_names(patterns);
+	print_sig_names(snap, patterns);
     } else if (strcmp(type, "param") == 0) {
-	print_param_names(patterns);
+	print_param_names(snap, patterns);
     } else if (strcmp(type, "parameter") == 0) {
-	print_param_names(patterns);
+	print_param_names(snap, patterns);
     } else if (strcmp(type, "funct") == 0) {
 	print_funct_names(patterns);
     } else if (strcmp(type, "function") == 0) {
@@ -1065,9 +1102,10 @@ int do_list_cmd(char *type, char **patterns)
 	print_thread_names(patterns);
     } else {
 	halcmd_error("Unknown 'list' type '%s'\n", type);
-	return -1;
+	retval = -1;
     }
-    return 0;
+    halpr_snapshot_free(snap);
+    return retval;
 }
 
 int do_status_cmd(char *type)
@@ -1093,17 +1131,131 @@ int do_status_cmd(char *type)
     return 0;
 }
 
-int do_loadrt_cmd(char *mod_name, char *args[])
+/* keep the args a module was loaded with, up to a NULL, "" or ";" */
+static int link_insmod_args(char *mod_name, char *args[])
 {
     char arg_string[MAX_CMD_LEN+1];
-    int m=0, n=0, retval;
+    int n;
     hal_comp_t *comp;
-    char *argv[MAX_TOK+3];
     char *cp1;
+
+    /* make the args that were passed to the module into a single string */
+    n = 0;
+    arg_string[0] = '\0';
+    while ( args[n] && args[n][0] != '\0' && strcmp(args[n], ";") != 0 ) {
+	strncat(arg_string, args[n++], MAX_CMD_LEN);
+	strncat(arg_string, " ", MAX_CMD_LEN);
+    }
+    /* allocate HAL shmem for the string */
+    cp1 = hal_malloc(strlen(arg_string)+1);
+    if ( cp1 == NULL ) {
+	halcmd_error("failed to allocate memory for module args\n");
+	return -1;
+    }
+    /* copy string to shmem */
+    strcpy (cp1, arg_string);
+    /* get mutex before accessing shared data */
+    rtapi_mutex_get(&(hal_data->mutex));
+    /* search component list for the newly loaded component */
+    comp = halpr_find_comp_by_name(mod_name);
+    if (comp == 0) {
+	rtapi_mutex_give(&(hal_data->mutex));
+	halcmd_error("module '%s' not loaded\n", mod_name);
+	return -EINVAL;
+    }
+    /* link args to comp struct */
+    comp->insmod_args = SHMOFF(cp1);
+    rtapi_mutex_give(&(hal_data->mutex));
+    /* print success message */
+    halcmd_info("Realtime module '%s' loaded\n", mod_name);
+    return 0;
+}
+
+/* loadrt mod1 [args] ; mod2 [args] ; ...
+
+   userland flavors hand the whole list to rtapi_app in one request,
+   which reads the module files ahead and loads the modules in order,
+   stopping at the first that fails; kernel flavors load them one by
+   one */
+static int do_loadrt_batch(char *mod_name, char *args[])
+{
+    char *argv[MAX_TOK+5];
+    char *names[MAX_TOK+1];
+    char **modargs[MAX_TOK+1];
+    char executable[PATH_MAX];
+    char inst[50];
+    int m = 0, n, nmods = 0, retval, result = 0;
+
+    /* split the list into modules and their args */
+    names[nmods] = mod_name;
+    modargs[nmods++] = args;
+    for (n = 0; args[n] && args[n][0] != '\0'; n++) {
+	if (strcmp(args[n], ";") == 0 && args[n+1] && args[n+1][0] != '\0'
+	    && strcmp(args[n+1], ";") != 0) {
+	    names[nmods] = args[n+1];
+	    modargs[nmods++] = &args[n+2];
+	    n++;
+	}
+    }
+
+    if (flavor->flags & FLAVOR_KERNEL_BUILD) {
+	for (n = 0; n < nmods; n++) {
+	    char *single[MAX_TOK+1];
+
+	    for (m = 0; modargs[n][m] && modargs[n][m][0] != '\0' &&
+		     strcmp(modargs[n][m], ";") != 0; m++)
+		single[m] = modargs[n][m];
+	    single[m] = NULL;
+	    if ((retval = do_loadrt_cmd(names[n], single)) != 0)
+		return retval;
+	}
+	return 0;
+    }
+
+    if (get_rtapi_config(executable,"rtapi_app",PATH_MAX) != 0) {
+	halcmd_error("rtapi_app executable path not found in rtapi.ini\n");
+	return -ENOENT;
+    }
+    snprintf(inst,sizeof(inst),"--instance=%d", rtapi_instance);
+    argv[m++] = executable;
+    argv[m++] = inst;
+    argv[m++] = "loadbatch";
+    argv[m++] = mod_name;
+    for (n = 0; args[n] && args[n][0] != '\0'; n++)
+	argv[m++] = args[n];
+    argv[m] = NULL;
+    retval = hal_systemv(argv);
+    if (retval != 0)
+	halcmd_error("loadbatch failed, returned %d\n"
+		     "See the log for more information.\n", retval);
+
+    /* keep the args of the modules that did load */
+    for (n = 0; n < nmods; n++) {
+	rtapi_mutex_get(&(hal_data->mutex));
+	m = halpr_find_comp_by_name(names[n]) != 0;
+	rtapi_mutex_give(&(hal_data->mutex));
+	if (!m)
+	    break;
+	if ((result = link_insmod_args(names[n], modargs[n])) != 0)
+	    break;
+    }
+    return retval ? -1 : result;
+}
+
+int do_loadrt_cmd(char *mod_name, char *args[])
+{
+    int m=0, n=0, retval;
+    char *argv[MAX_TOK+3];
     char executable[PATH_MAX];
     char mod_path[PATH_MAX];
     char inst[50];
 
+    for (n = 0; args[n] && args[n][0] != '\0'; n++) {
+	if (strcmp(args[n], ";") == 0)
+	    return do_loadrt_batch(mod_name, args);
+    }
+    n = 0;
+
     if (!(flavor->flags & FLAVOR_KERNEL_BUILD)) {
 	if (get_rtapi_config(executable,"rtapi_app",PATH_MAX) != 0) {
 	    halcmd_error("rtapi_app executable path not found in rtapi.ini\n");
@@ -1165,36 +1317,7 @@ int do_loadrt_cmd(char *mod_name, char *args[])
         , retval );
 	return -1;
     }
-    /* make the args that were passed to the module into a single string */
-    n = 0;
-    arg_string[0] = '\0';
-    while ( args[n] && args[n][0] != '\0' ) {
-	strncat(arg_string, args[n++], MAX_CMD_LEN);
-	strncat(arg_string, " ", MAX_CMD_LEN);
-    }
-    /* allocate HAL shmem for the string */
-    cp1 = hal_malloc(strlen(arg_string)+1);
-    if ( cp1 == NULL ) {
-	halcmd_error("failed to allocate memory for module args\n");
-	return -1;
-    }
-    /* copy string to shmem */
-    strcpy (cp1, arg_string);
-    /* get mutex before accessing shared data */
-    rtapi_mutex_get(&(hal_data->mutex));
-    /* search component list for the newly loaded component */
-    comp = halpr_find_comp_by_name(mod_name);
-    if (comp == 0) {
-	rtapi_mutex_give(&(hal_data->mutex));
-	halcmd_error("module '%s' not loaded\n", mod_name);
-	return -EINVAL;
-    }
-    /* link args to comp struct */
-    comp->insmod_args = SHMOFF(cp1);
-    rtapi_mutex_give(&(hal_data->mutex));
-    /* print success message */
-    halcmd_info("Realtime module '%s' loaded\n", mod_name);
-    return 0;
+    return link_insmod_args(mod_name, args);
 }
 
 int do_delsig_cmd(char *mod_name)
@@ -1668,24 +1791,22 @@ static const char *state_name(int state)
     }
 }
 
-static void print_comp_info(char **patterns)
+static void print_comp_info(hal_snapshot_t *snap, char **patterns)
 {
-    int next;
-    hal_comp_t *comp;
+    int n;
+    hal_comp_snap_t *comp;
 
     if (scriptmode == 0) {
 	halcmd_output("Loaded HAL Components:\n");
 	halcmd_output("ID      Type  %-*s PID   State\n", HAL_NAME_LEN, "Name");
     }
-    rtapi_mutex_get(&(hal_data->mutex));
-    next = hal_data->comp_list_ptr;
-    while (next != 0) {
-	comp = SHMPTR(next);
+    for (n = 0; n < snap->num_comps; n++) {
+	comp = &snap->comps[n];
 	if ( match(patterns, comp->name) ) {
             if(comp->type == TYPE_INSTANCE) {
-                hal_comp_t *comp1 = halpr_find_comp_by_id(comp->comp_id & 0xffff);
                 halcmd_output("    INST %s %s",
-                        comp1 ? comp1->name : "(unknown)", 
+                        comp->parent >= 0 ?
+			    snap->comps[comp->parent].name : "(unknown)",
                         comp->name);
             } else {
                 halcmd_output(" %5d  %-4s  %-*s",
@@ -1722,19 +1843,16 @@ static void print_comp_info(char **patterns)
             }
             halcmd_output("\n");
 	}
-	next = comp->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
     halcmd_output("\n");
 }
 
-static void print_pin_info(int type, char **patterns)
+static void print_pin_info(hal_snapshot_t *snap, int type, char **patterns)
 {
-    int next;
-    hal_pin_t *pin;
-    hal_comp_t *comp;
-    hal_sig_t *sig;
-    void *dptr;
+    int n;
+    hal_pin_snap_t *pin;
+    hal_comp_snap_t *comp;
+    hal_sig_snap_t *sig;
 
     if (scriptmode == 0) {
 	halcmd_output("Component Pins:\n");
@@ -1744,26 +1862,18 @@ static void print_pin_info(int type, char **patterns)
 	halcmd_output("Owner   Type  Dir         Value  Name\n");
 #endif
     }
-    rtapi_mutex_get(&(hal_data->mutex));
-    next = hal_data->pin_list_ptr;
-    while (next != 0) {
-	pin = SHMPTR(next);
+    for (n = 0; n < snap->num_pins; n++) {
+	pin = &snap->pins[n];
 	if ( tmatch(type, pin->type) && match(patterns, pin->name) ) {
-	    comp = SHMPTR(pin->owner_ptr);
-	    if (pin->signal != 0) {
-		sig = SHMPTR(pin->signal);
-		dptr = SHMPTR(sig->data_ptr);
-	    } else {
-		sig = 0;
-		dptr = &(pin->dummysig);
-	    }
+	    comp = &snap->comps[pin->owner];
+	    sig = pin->signal >= 0 ? &snap->sigs[pin->signal] : 0;
 	    if (scriptmode == 0) {
 #ifdef USE_PIN_USER_ATTRIBUTES
 		halcmd_output(" %5d  %5s %-3s  %9s  %s\t%f\t%d",
 			      comp->comp_id,
 			      data_type((int) pin->type),
 			      pin_data_dir((int) pin->dir),
-			      data_value((int) pin->type, dptr),
+			      data_value((int) pin->type, &pin->value),
 			      pin->name,
 			      pin->epsilon, pin->flags);
 #else
@@ -1771,7 +1881,7 @@ static void print_pin_info(int type, char **patterns)
 		    comp->comp_id,
 		    data_type((int) pin->type),
 		    pin_data_dir((int) pin->dir),
-		    data_value((int) pin->type, dptr),
+		    data_value((int) pin->type, &pin->value),
 		    pin->name);
 #endif
 	    } else {
@@ -1779,7 +1889,7 @@ static void print_pin_info(int type, char **patterns)
 		    comp->name,
 		    data_type((int) pin->type),
 		    pin_data_dir((int) pin->dir),
-		    data_value2((int) pin->type, dptr),
+		    data_value2((int) pin->type, &pin->value),
 		    pin->name);
 	    } 
 	    if (sig == 0) {
@@ -1788,175 +1898,144 @@ static void print_pin_info(int type, char **patterns)
 		halcmd_output(" %s %s\n", data_arrow1((int) pin->dir), sig->name);
 	    }
 	}
-	next = pin->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
     halcmd_output("\n");
 }
 
-static void print_pin_aliases(char **patterns)
+static void print_pin_aliases(hal_snapshot_t *snap, char **patterns)
 {
-    int next;
-    hal_oldname_t *oldname;
-    hal_pin_t *pin;
+    int n;
+    hal_pin_snap_t *pin;
 
     if (scriptmode == 0) {
 	halcmd_output("Pin Aliases:\n");
 	halcmd_output(" %-*s  %s\n", HAL_NAME_LEN, "Alias", "Original Name");
     }
-    rtapi_mutex_get(&(hal_data->mutex));
-    next = hal_data->pin_list_ptr;
-    while (next != 0) {
-	pin = SHMPTR(next);
-	if ( pin->oldname != 0 ) {
+    for (n = 0; n < snap->num_pins; n++) {
+	pin = &snap->pins[n];
+	if ( pin->oldname[0] != '\0' ) {
 	    /* name is an alias */
-	    oldname = SHMPTR(pin->oldname);
-	    if ( match(patterns, pin->name) || match(patterns, oldname->name) ) {
+	    if ( match(patterns, pin->name) || match(patterns, pin->oldname) ) {
 		if (scriptmode == 0) {
-		    halcmd_output(" %-*s  %s\n", HAL_NAME_LEN, pin->name, oldname->name);
+		    halcmd_output(" %-*s  %s\n", HAL_NAME_LEN, pin->name, pin->oldname);
 		} else {
-		    halcmd_output(" %s  %s\n", pin->name, oldname->name);
+		    halcmd_output(" %s  %s\n", pin->name, pin->oldname);
 		}
 	    }
 	}
-	next = pin->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
     halcmd_output("\n");
 }
 
-static void print_sig_info(int type, char **patterns)
+static void print_sig_info(hal_snapshot_t *snap, int type, char **patterns)
 {
-    int next;
-    hal_sig_t *sig;
-    void *dptr;
-    hal_pin_t *pin;
+    int n, i;
+    hal_sig_snap_t *sig;
+    hal_pin_snap_t *pin;
 
     if (scriptmode != 0) {
-    	print_script_sig_info(type, patterns);
+    	print_script_sig_info(snap, type, patterns);
 	return;
     }
     halcmd_output("Signals:\n");
     halcmd_output("Type          Value  Name     (linked to)\n");
-    rtapi_mutex_get(&(hal_data->mutex));
-    next = hal_data->sig_list_ptr;
-    while (next != 0) {
-	sig = SHMPTR(next);
+    for (n = 0; n < snap->num_sigs; n++) {
+	sig = &snap->sigs[n];
 	if ( tmatch(type, sig->type) && match(patterns, sig->name) ) {
-	    dptr = SHMPTR(sig->data_ptr);
 	    halcmd_output("%s  %s  %s\n", data_type((int) sig->type),
-		data_value((int) sig->type, dptr), sig->name);
-	    /* look for pin(s) linked to this signal */
-	    pin = halpr_find_pin_by_sig(sig, 0);
-	    while (pin != 0) {
+		data_value((int) sig->type, &sig->value), sig->name);
+	    /* pin(s) linked to this signal */
+	    for (i = 0; i < sig->num_pins; i++) {
+		pin = &snap->pins[sig->pins[i]];
 		halcmd_output("                         %s %s\n",
 		    data_arrow2((int) pin->dir), pin->name);
-		pin = halpr_find_pin_by_sig(sig, pin);
 	    }
 	}
-	next = sig->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
     halcmd_output("\n");
 }
 
-static void print_script_sig_info(int type, char **patterns)
+static void print_script_sig_info(hal_snapshot_t *snap, int type,
+    char **patterns)
 {
-    int next;
-    hal_sig_t *sig;
-    void *dptr;
-    hal_pin_t *pin;
+    int n, i;
+    hal_sig_snap_t *sig;
+    hal_pin_snap_t *pin;
 
     if (scriptmode == 0) {
     	return;
     }
-    rtapi_mutex_get(&(hal_data->mutex));
-    next = hal_data->sig_list_ptr;
-    while (next != 0) {
-	sig = SHMPTR(next);
+    for (n = 0; n < snap->num_sigs; n++) {
+	sig = &snap->sigs[n];
 	if ( tmatch(type, sig->type) && match(patterns, sig->name) ) {
-	    dptr = SHMPTR(sig->data_ptr);
 	    halcmd_output("%s  %s  %s", data_type((int) sig->type),
-		data_value2((int) sig->type, dptr), sig->name);
-	    /* look for pin(s) linked to this signal */
-	    pin = halpr_find_pin_by_sig(sig, 0);
-	    while (pin != 0) {
+		data_value2((int) sig->type, &sig->value), sig->name);
+	    /* pin(s) linked to this signal */
+	    for (i = 0; i < sig->num_pins; i++) {
+		pin = &snap->pins[sig->pins[i]];
 		halcmd_output(" %s %s",
 		    data_arrow2((int) pin->dir), pin->name);
-		pin = halpr_find_pin_by_sig(sig, pin);
 	    }
 	    halcmd_output("\n");
 	}
-	next = sig->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
     halcmd_output("\n");
 }
 
-static void print_param_info(int type, char **patterns)
+static void print_param_info(hal_snapshot_t *snap, int type, char **patterns)
 {
-    int next;
-    hal_param_t *param;
-    hal_comp_t *comp;
+    int n;
+    hal_param_snap_t *param;
+    hal_comp_snap_t *comp;
 
     if (scriptmode == 0) {
 	halcmd_output("Parameters:\n");
 	halcmd_output("Owner   Type  Dir         Value  Name\n");
     }
-    rtapi_mutex_get(&(hal_data->mutex));
-    next = hal_data->param_list_ptr;
-    while (next != 0) {
-	param = SHMPTR(next);
+    for (n = 0; n < snap->num_params; n++) {
+	param = &snap->params[n];
 	if ( tmatch(type, param->type), match(patterns, param->name) ) {
-	    comp = SHMPTR(param->owner_ptr);
+	    comp = &snap->comps[param->owner];
 	    if (scriptmode == 0) {
 		halcmd_output(" %5d  %5s %-3s  %9s  %s\n",
 		    comp->comp_id, data_type((int) param->type),
 		    param_data_dir((int) param->dir),
-		    data_value((int) param->type, SHMPTR(param->data_ptr)),
+		    data_value((int) param->type, &param->value),
 		    param->name);
 	    } else {
 		halcmd_output("%s %s %s %s %s\n",
 		    comp->name, data_type((int) param->type),
 		    param_data_dir((int) param->dir),
-		    data_value2((int) param->type, SHMPTR(param->data_ptr)),
+		    data_value2((int) param->type, &param->value),
 		    param->name);
 	    } 
 	}
-	next = param->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
     halcmd_output("\n");
 }
 
-static void print_param_aliases(char **patterns)
+static void print_param_aliases(hal_snapshot_t *snap, char **patterns)
 {
-    int next;
-    hal_oldname_t *oldname;
-    hal_param_t *param;
+    int n;
+    hal_param_snap_t *param;
 
     if (scriptmode == 0) {
 	halcmd_output("Parameter Aliases:\n");
 	halcmd_output(" %-*s  %s\n", HAL_NAME_LEN, "Alias", "Original Name");
     }
-    rtapi_mutex_get(&(hal_data->mutex));
-    next = hal_data->param_list_ptr;
-    while (next != 0) {
-	param = SHMPTR(next);
-	if ( param->oldname != 0 ) {
+    for (n = 0; n < snap->num_params; n++) {
+	param = &snap->params[n];
+	if ( param->oldname[0] != '\0' ) {
 	    /* name is an alias */
-	    oldname = SHMPTR(param->oldname);
-	    if ( match(patterns, param->name) || match(patterns, oldname->name) ) {
+	    if ( match(patterns, param->name) || match(patterns, param->oldname) ) {
 		if (scriptmode == 0) {
-		    halcmd_output(" %-*s  %s\n", HAL_NAME_LEN, param->name, oldname->name);
+		    halcmd_output(" %-*s  %s\n", HAL_NAME_LEN, param->name, param->oldname);
 		} else {
-		    halcmd_output(" %s  %s\n", param->name, oldname->name);
+		    halcmd_output(" %s  %s\n", param->name, param->oldname);
 		}
 	    }
 	}
-	next = param->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
     halcmd_output("\n");
 }
 
@@ -1996,6 +2075,31 @@ static void print_funct_info(char **patterns)
     halcmd_output("\n");
 }
 
+// the wakeup latency histogram of an rt-preempt or posix thread,
+// bucket n holds wakeups from 2^(n-1) to 2^n uS late
+static void print_latency_hist(rtapi_threadstatus_t *ts)
+{
+    unsigned long *hist = ts->flavor.rtpreempt.latency_hist;
+    int n;
+
+    halcmd_output("    wakeup latency: max=%ldnS\t",
+		  ts->flavor.rtpreempt.latency_max);
+    if (ts->flavor.rtpreempt.spin_margin)
+	halcmd_output("spin margin=%dnS\n",
+		      ts->flavor.rtpreempt.spin_margin);
+    else
+	halcmd_output("no spin\n");
+    for (n = 0; n < RTAPI_LATENCY_BUCKETS; n++) {
+	if (hist[n] == 0)
+	    continue;
+	if (n == RTAPI_LATENCY_BUCKETS - 1)
+	    halcmd_output("    %6d -       uS: %lu\n", 1 << (n - 1), hist[n]);
+	else
+	    halcmd_output("    %6d - %6duS: %lu\n", n ? 1 << (n - 1) : 0,
+			  1 << n, hist[n]);
+    }
+}
+
 static void print_thread_stats(hal_thread_t *tptr)
 {
     int flavor = global_data->rtapi_thread_flavor;
@@ -2054,6 +2158,7 @@ static void print_thread_stats(hal_thread_t *tptr)
 	halcmd_output("    majflt=%ld\n",
 		      ts->flavor.rtpreempt.ru_majflt -
 		      ts->flavor.rtpreempt.startup_ru_majflt);
+	print_latency_hist(ts);
 	break;
 
     default:
@@ -2074,6 +2179,9 @@ static void print_thread_info(char **patterns)
 
     if (scriptmode == 0) {
 	halcmd_output("Realtime Threads (flavor: %s) :\n",  flavor->name);
+	if (global_data->rt_sim_time)
+	    halcmd_output("Simulated time: %.6f s\n",
+			  global_data->sim_clock * 1e-9);
 	halcmd_output("     Period  FP     Name               (     Time, Max-Time )\n");
     }
     rtapi_mutex_get(&(hal_data->mutex));
@@ -2117,75 +2225,51 @@ static void print_thread_info(char **patterns)
     halcmd_output("\n");
 }
 
-static void print_comp_names(char **patterns)
+static void print_comp_names(hal_snapshot_t *snap, char **patterns)
 {
-    int next;
-    hal_comp_t *comp;
+    int n;
 
-    rtapi_mutex_get(&(hal_data->mutex));
-    next = hal_data->comp_list_ptr;
-    while (next != 0) {
-	comp = SHMPTR(next);
-	if ( match(patterns, comp->name) ) {
-	    halcmd_output("%s ", comp->name);
+    for (n = 0; n < snap->num_comps; n++) {
+	if ( match(patterns, snap->comps[n].name) ) {
+	    halcmd_output("%s ", snap->comps[n].name);
 	}
-	next = comp->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
     halcmd_output("\n");
 }
 
-static void print_pin_names(char **patterns)
+static void print_pin_names(hal_snapshot_t *snap, char **patterns)
 {
-    int next;
-    hal_pin_t *pin;
+    int n;
 
-    rtapi_mutex_get(&(hal_data->mutex));
-    next = hal_data->pin_list_ptr;
-    while (next != 0) {
-	pin = SHMPTR(next);
-	if ( match(patterns, pin->name) ) {
-	    halcmd_output("%s ", pin->name);
+    for (n = 0; n < snap->num_pins; n++) {
+	if ( match(patterns, snap->pins[n].name) ) {
+	    halcmd_output("%s ", snap->pins[n].name);
 	}
-	next = pin->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
     halcmd_output("\n");
 }
 
-static void print_sig_names(char **patterns)
+static void print_sig_names(hal_snapshot_t *snap, char **patterns)
 {
-    int next;
-    hal_sig_t *sig;
+    int n;
 
-    rtapi_mutex_get(&(hal_data->mutex));
-    next = hal_data->sig_list_ptr;
-    while (next != 0) {
-	sig = SHMPTR(next);
-	if ( match(patterns, sig->name) ) {
-	    halcmd_output("%s ", sig->name);
+    for (n = 0; n < snap->num_sigs; n++) {
+	if ( match(patterns, snap->sigs[n].name) ) {
+	    halcmd_output("%s ", snap->sigs[n].name);
 	}
-	next = sig->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
     halcmd_output("\n");
 }
 
-static void print_param_names(char **patterns)
+static void print_param_names(hal_snapshot_t *snap, char **patterns)
 {
-    int next;
-    hal_param_t *param;
+    int n;
 
-    rtapi_mutex_get(&(hal_data->mutex));
-    next = hal_data->param_list_ptr;
-    while (next != 0) {
-	param = SHMPTR(next);
-	if ( match(patterns, param->name) ) {
-	    halcmd_output("%s ", param->name);
+    for (n = 0; n < snap->num_params; n++) {
+	if ( match(patterns, snap->params[n].name) ) {
+	    halcmd_output("%s ", snap->params[n].name);
 	}
-	next = param->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
     halcmd_output("\n");
 }
 
@@ -2316,6 +2400,8 @@ static void print_mem_status()
   
     halcmd_output("RTAPI message level:  RT:%d User:%d\n", 
 		  global_data->rt_msg_level, global_data->user_msg_level);
+    halcmd_output("RTAPI messages dropped:  ring full:%d ring locked:%d\n",
+		  global_data->error_ring_full, global_data->error_ring_locked);
 }
 
 /* Switch function for pin/sig/param type for the print_*_list functions */
@@ -2521,6 +2607,7 @@ static char *data_value2(int type, void *valptr)
 int do_save_cmd(char *type, char *filename)
 {
     FILE *dst;
+    hal_snapshot_t *snap = 0;
 
     if (rtapi_get_msg_level() == RTAPI_MSG_NONE) {
 	/* must be -Q, don't print anything */
@@ -2538,47 +2625,58 @@ int do_save_cmd(char *type, char *filename)
     if (type == 0 || *type == '\0') {
 	type = "all";
     }
+    /* one snapshot for everything, so a save of a running system is
+       consistent with itself */
+    if (needs_snapshot(type)) {
+	snap = take_snapshot();
+	if (!snap) {
+	    if (dst != stdout) fclose(dst);
+	    return -ENOMEM;
+	}
+    }
     if (strcmp(type, "all" ) == 0) {
 	/* save everything */
-	save_comps(dst);
-	save_aliases(dst);
-        save_signals(dst, 1);
-        save_nets(dst, 3);
-	save_params(dst);
+	save_comps(snap, dst);
+	save_aliases(snap, dst);
+        save_signals(snap, dst, 1);
+        save_nets(snap, dst, 3);
+	save_params(snap, dst);
 	save_threads(dst);
     } else if (strcmp(type, "comp") == 0) {
-	save_comps(dst);
+	save_comps(snap, dst);
     } else if (strcmp(type, "alias") == 0) {
-	save_aliases(dst);
+	save_aliases(snap, dst);
     } else if (strcmp(type, "sig") == 0) {
-	save_signals(dst, 0);
+	save_signals(snap, dst, 0);
     } else if (strcmp(type, "signal") == 0) {
-	save_signals(dst, 0);
+	save_signals(snap, dst, 0);
     } else if (strcmp(type, "sigu") == 0) {
-	save_signals(dst, 1);
+	save_signals(snap, dst, 1);
     } else if (strcmp(type, "link") == 0) {
-	save_links(dst, 0);
+	save_links(snap, dst, 0);
     } else if (strcmp(type, "linka") == 0) {
-	save_links(dst, 1);
+	save_links(snap, dst, 1);
     } else if (strcmp(type, "net") == 0) {
-	save_nets(dst, 0);
+	save_nets(snap, dst, 0);
     } else if (strcmp(type, "neta") == 0) {
-	save_nets(dst, 1);
+	save_nets(snap, dst, 1);
     } else if (strcmp(type, "netl") == 0) {
-	save_nets(dst, 2);
+	save_nets(snap, dst, 2);
     } else if (strcmp(type, "netla") == 0 || strcmp(type, "netal") == 0) {
-	save_nets(dst, 3);
+	save_nets(snap, dst, 3);
     } else if (strcmp(type, "param") == 0) {
-	save_params(dst);
+	save_params(snap, dst);
     } else if (strcmp(type, "parameter") == 0) {
-	save_params(dst);
+	save_params(snap, dst);
     } else if (strcmp(type, "thread") == 0) {
 	save_threads(dst);
     } else {
 	halcmd_error("Unknown 'save' type '%s'\n", type);
+	halpr_snapshot_free(snap);
         if (dst != stdout) fclose(dst);
 	return -1;
     }
+    halpr_snapshot_free(snap);
     if (dst != stdout) {
 	fclose(dst);
     }
@@ -2586,6 +2684,533 @@ int do_save_cmd(char *type, char *filename)
 }
 
 
+/* 'snapshot save' writes the RT part of the configuration as a binary
+   file: a header, then each section as an array of fixed size records,
+   in the layout and byte order of this machine.  'snapshot restore'
+   loads the components, then hands the signals, links and values to
+   halpr_restore() in one go, and 'snapshot show' prints a file as
+   halcmd commands, so that two can be compared with diff.
+*/
+#define HALSNAP_MAGIC "HALSNAP1"
+
+typedef struct {
+    char magic[8];
+    int name_len;		/* HAL_NAME_LEN of the halcmd that wrote it */
+    int num_comps;
+    int num_aliases;
+    int num_sigs;
+    int num_links;
+    int num_params;
+    int num_pins;
+    int num_functs;
+} halsnap_header_t;
+
+typedef struct {
+    char name[HAL_NAME_LEN + 1];
+    char args[MAX_CMD_LEN + 1];
+} halsnap_comp_t;
+
+typedef struct {
+    int param;			/* 1 for a parameter, 0 for a pin */
+    char name[HAL_NAME_LEN + 1];	/* original name */
+    char alias[HAL_NAME_LEN + 1];
+} halsnap_alias_t;
+
+typedef struct {
+    char funct[HAL_NAME_LEN + 1];
+    char thread[HAL_NAME_LEN + 1];
+} halsnap_funct_t;
+
+typedef struct {
+    halsnap_header_t h;
+    halsnap_comp_t *comps;	/* in load order */
+    halsnap_alias_t *aliases;
+    hal_restore_value_t *sigs;
+    hal_restore_link_t *links;
+    hal_restore_value_t *params;
+    hal_restore_value_t *pins;
+    halsnap_funct_t *functs;	/* in thread order */
+} halsnap_t;
+
+static void halsnap_free(halsnap_t *s)
+{
+    free(s->comps);
+    free(s->aliases);
+    free(s->sigs);
+    free(s->links);
+    free(s->params);
+    free(s->pins);
+    free(s->functs);
+    memset(s, 0, sizeof(*s));
+}
+
+static int halsnap_alloc(halsnap_t *s)
+{
+    halsnap_header_t *h = &s->h;
+
+    /* one more than needed, so none is 0 when a section is empty */
+    s->comps = calloc(h->num_comps + 1, sizeof(*s->comps));
+    s->aliases = calloc(h->num_aliases + 1, sizeof(*s->aliases));
+    s->sigs = calloc(h->num_sigs + 1, sizeof(*s->sigs));
+    s->links = calloc(h->num_links + 1, sizeof(*s->links));
+    s->params = calloc(h->num_params + 1, sizeof(*s->params));
+    s->pins = calloc(h->num_pins + 1, sizeof(*s->pins));
+    s->functs = calloc(h->num_functs + 1, sizeof(*s->functs));
+    if (!s->comps || !s->aliases || !s->sigs || !s->links || !s->params
+	|| !s->pins || !s->functs) {
+	halcmd_error("snapshot: out of memory\n");
+	return -ENOMEM;
+    }
+    return 0;
+}
+
+/* only what loadrt made can be restored, so user space components, and
+   their pins and parameters, are left out */
+static int halsnap_rt(hal_snapshot_t *snap, int owner)
+{
+    return snap->comps[owner].type == TYPE_RT;
+}
+
+/* counts the functions in the threads, and once s->functs is there,
+   copies up to h.num_functs of them into it */
+static int halsnap_functs(halsnap_t *s)
+{
+    int next_thread, n;
+    hal_thread_t *tptr;
+    hal_list_t *list_root, *list_entry;
+    hal_funct_t *funct;
+
+    n = 0;
+    rtapi_mutex_get(&(hal_data->mutex));
+    for (next_thread = hal_data->thread_list_ptr; next_thread != 0;
+	 next_thread = tptr->next_ptr) {
+	tptr = SHMPTR(next_thread);
+	list_root = &(tptr->funct_list);
+	for (list_entry = list_next(list_root); list_entry != list_root;
+	     list_entry = list_next(list_entry)) {
+	    if (s->functs && n < s->h.num_functs) {
+		funct = SHMPTR(((hal_funct_entry_t *) list_entry)->funct_ptr);
+		strcpy(s->functs[n].funct, funct->name);
+		strcpy(s->functs[n].thread, tptr->name);
+	    }
+	    n++;
+	}
+    }
+    rtapi_mutex_give(&(hal_data->mutex));
+    return n;
+}
+
+static int halsnap_take(halsnap_t *s)
+{
+    hal_snapshot_t *snap;
+    hal_restore_value_t *v;
+    int n, retval;
+
+    memset(s, 0, sizeof(*s));
+    snap = take_snapshot();
+    if (!snap) {
+	return -ENOMEM;
+    }
+    memcpy(s->h.magic, HALSNAP_MAGIC, sizeof(s->h.magic));
+    s->h.name_len = HAL_NAME_LEN;
+    for (n = 0; n < snap->num_comps; n++) {
+	if (halsnap_rt(snap, n) && snap->comps[n].insmod_args == 0) {
+	    halcmd_warning("snapshot: '%s' was not loaded by loadrt, "
+		"it won't be restored\n", snap->comps[n].name);
+	} else if (halsnap_rt(snap, n)) {
+	    s->h.num_comps++;
+	}
+    }
+    for (n = 0; n < snap->num_pins; n++) {
+	if (!halsnap_rt(snap, snap->pins[n].owner)) {
+	    continue;
+	}
+	if (snap->pins[n].oldname[0] != '\0') {
+	    s->h.num_aliases++;
+	}
+	if (snap->pins[n].signal >= 0) {
+	    s->h.num_links++;
+	} else if (snap->pins[n].dir != HAL_OUT) {
+	    s->h.num_pins++;
+	}
+    }
+    for (n = 0; n < snap->num_params; n++) {
+	if (!halsnap_rt(snap, snap->params[n].owner)) {
+	    continue;
+	}
+	if (snap->params[n].oldname[0] != '\0') {
+	    s->h.num_aliases++;
+	}
+	if (snap->params[n].dir != HAL_RO) {
+	    s->h.num_params++;
+	}
+    }
+    s->h.num_sigs = snap->num_sigs;
+    s->h.num_functs = halsnap_functs(s);
+    if ((retval = halsnap_alloc(s)) != 0) {
+	halpr_snapshot_free(snap);
+	return retval;
+    }
+
+    /* the comp list is newest first, so loading goes from the end */
+    s->h.num_comps = 0;
+    for (n = snap->num_comps - 1; n >= 0; n--) {
+	if (halsnap_rt(snap, n) && snap->comps[n].insmod_args != 0) {
+	    halsnap_comp_t *c = &s->comps[s->h.num_comps++];
+	    strcpy(c->name, snap->comps[n].name);
+	    snprintf(c->args, sizeof(c->args), "%s",
+		snap->comps[n].insmod_args);
+	}
+    }
+    for (n = 0; n < snap->num_sigs; n++) {
+	v = &s->sigs[n];
+	strcpy(v->name, snap->sigs[n].name);
+	v->type = snap->sigs[n].type;
+	v->value = snap->sigs[n].value;
+    }
+    s->h.num_aliases = s->h.num_links = s->h.num_pins = 0;
+    for (n = 0; n < snap->num_pins; n++) {
+	hal_pin_snap_t *pin = &snap->pins[n];
+
+	if (!halsnap_rt(snap, pin->owner)) {
+	    continue;
+	}
+	if (pin->oldname[0] != '\0') {
+	    halsnap_alias_t *a = &s->aliases[s->h.num_aliases++];
+	    a->param = 0;
+	    strcpy(a->name, pin->oldname);
+	    strcpy(a->alias, pin->name);
+	}
+	if (pin->signal >= 0) {
+	    hal_restore_link_t *l = &s->links[s->h.num_links++];
+	    strcpy(l->pin, pin->name);
+	    l->sig = pin->signal;
+	} else if (pin->dir != HAL_OUT) {
+	    v = &s->pins[s->h.num_pins++];
+	    strcpy(v->name, pin->name);
+	    v->type = pin->type;
+	    v->value = pin->value;
+	}
+    }
+    s->h.num_params = 0;
+    for (n = 0; n < snap->num_params; n++) {
+	hal_param_snap_t *param = &snap->params[n];
+
+	if (!halsnap_rt(snap, param->owner)) {
+	    continue;
+	}
+	if (param->oldname[0] != '\0') {
+	    halsnap_alias_t *a = &s->aliases[s->h.num_aliases++];
+	    a->param = 1;
+	    strcpy(a->name, param->oldname);
+	    strcpy(a->alias, param->name);
+	}
+	if (param->dir != HAL_RO) {
+	    v = &s->params[s->h.num_params++];
+	    strcpy(v->name, param->name);
+	    v->type = param->type;
+	    v->value = param->value;
+	}
+    }
+    halpr_snapshot_free(snap);
+    /* a thread may have been added to in between, take no more */
+    n = s->h.num_functs;
+    if (halsnap_functs(s) != n) {
+	halcmd_error("snapshot: the threads changed while saving\n");
+	return -EAGAIN;
+    }
+    return 0;
+}
+
+#define HALSNAP_SECTIONS(s) { \
+    { (s)->comps, sizeof(*(s)->comps), &(s)->h.num_comps }, \
+    { (s)->aliases, sizeof(*(s)->aliases), &(s)->h.num_aliases }, \
+    { (s)->sigs, sizeof(*(s)->sigs), &(s)->h.num_sigs }, \
+    { (s)->links, sizeof(*(s)->links), &(s)->h.num_links }, \
+    { (s)->params, sizeof(*(s)->params), &(s)->h.num_params }, \
+    { (s)->pins, sizeof(*(s)->pins), &(s)->h.num_pins }, \
+    { (s)->functs, sizeof(*(s)->functs), &(s)->h.num_functs } }
+
+typedef struct {
+    void *records;
+    size_t size;
+    int *count;
+} halsnap_section_t;
+
+static int halsnap_write(halsnap_t *s, const char *filename)
+{
+    FILE *dst;
+    int n, ok;
+
+    dst = fopen(filename, "wb");
+    if (dst == NULL) {
+	halcmd_error("Can't open snapshot file '%s': %s\n", filename,
+	    strerror(errno));
+	return -1;
+    }
+    {
+	halsnap_section_t sections[] = HALSNAP_SECTIONS(s);
+
+	ok = fwrite(&s->h, sizeof(s->h), 1, dst) == 1;
+	for (n = 0; ok && n < (int) (sizeof(sections) / sizeof(sections[0]));
+	     n++) {
+	    ok = fwrite(sections[n].records, sections[n].size,
+		*sections[n].count, dst) == (size_t) *sections[n].count;
+	}
+    }
+    if (fclose(dst) != 0 || !ok) {
+	halcmd_error("Can't write snapshot file '%s'\n", filename);
+	return -1;
+    }
+    return 0;
+}
+
+static int halsnap_read(halsnap_t *s, const char *filename)
+{
+    FILE *src;
+    int n, i, ok;
+
+    memset(s, 0, sizeof(*s));
+    src = fopen(filename, "rb");
+    if (src == NULL) {
+	halcmd_error("Can't open snapshot file '%s': %s\n", filename,
+	    strerror(errno));
+	return -1;
+    }
+    if (fread(&s->h, sizeof(s->h), 1, src) != 1
+	|| memcmp(s->h.magic, HALSNAP_MAGIC, sizeof(s->h.magic)) != 0) {
+	halcmd_error("'%s' is not a HAL snapshot\n", filename);
+	fclose(src);
+	return -1;
+    }
+    if (s->h.name_len != HAL_NAME_LEN) {
+	halcmd_error("'%s' was saved by a HAL with %d character names, "
+	    "this one has %d\n", filename, s->h.name_len, HAL_NAME_LEN);
+	fclose(src);
+	return -1;
+    }
+    if (s->h.num_comps < 0 || s->h.num_aliases < 0 || s->h.num_sigs < 0
+	|| s->h.num_links < 0 || s->h.num_params < 0 || s->h.num_pins < 0
+	|| s->h.num_functs < 0 || halsnap_alloc(s) != 0) {
+	halcmd_error("'%s' is damaged\n", filename);
+	fclose(src);
+	halsnap_free(s);
+	return -1;
+    }
+    {
+	halsnap_section_t sections[] = HALSNAP_SECTIONS(s);
+
+	ok = 1;
+	for (n = 0; ok && n < (int) (sizeof(sections) / sizeof(sections[0]));
+	     n++) {
+	    ok = fread(sections[n].records, sections[n].size,
+		*sections[n].count, src) == (size_t) *sections[n].count;
+	}
+    }
+    fclose(src);
+    if (!ok) {
+	halcmd_error("'%s' is truncated\n", filename);
+	halsnap_free(s);
+	return -1;
+    }
+    /* don't trust the names to be terminated */
+    for (i = 0; i < s->h.num_comps; i++) {
+	s->comps[i].name[HAL_NAME_LEN] = '\0';
+	s->comps[i].args[MAX_CMD_LEN] = '\0';
+    }
+    for (i = 0; i < s->h.num_aliases; i++) {
+	s->aliases[i].name[HAL_NAME_LEN] = '\0';
+	s->aliases[i].alias[HAL_NAME_LEN] = '\0';
+    }
+    for (i = 0; i < s->h.num_sigs; i++)
+	s->sigs[i].name[HAL_NAME_LEN] = '\0';
+    for (i = 0; i < s->h.num_links; i++)
+	s->links[i].pin[HAL_NAME_LEN] = '\0';
+    for (i = 0; i < s->h.num_params; i++)
+	s->params[i].name[HAL_NAME_LEN] = '\0';
+    for (i = 0; i < s->h.num_pins; i++)
+	s->pins[i].name[HAL_NAME_LEN] = '\0';
+    for (i = 0; i < s->h.num_functs; i++) {
+	s->functs[i].funct[HAL_NAME_LEN] = '\0';
+	s->functs[i].thread[HAL_NAME_LEN] = '\0';
+    }
+    return 0;
+}
+
+static void halsnap_show(halsnap_t *s, FILE *dst)
+{
+    int n;
+    hal_restore_value_t *v;
+
+    fprintf(dst, "# components\n");
+    for (n = 0; n < s->h.num_comps; n++)
+	fprintf(dst, "loadrt %s %s\n", s->comps[n].name, s->comps[n].args);
+    fprintf(dst, "# aliases\n");
+    for (n = 0; n < s->h.num_aliases; n++)
+	fprintf(dst, "alias %s %s %s\n", s->aliases[n].param ? "param" : "pin",
+	    s->aliases[n].name, s->aliases[n].alias);
+    fprintf(dst, "# signals\n");
+    for (n = 0; n < s->h.num_sigs; n++) {
+	v = &s->sigs[n];
+	fprintf(dst, "newsig %s %s\n", v->name, data_type((int) v->type));
+	fprintf(dst, "sets %s %s\n", v->name,
+	    data_value2((int) v->type, &v->value));
+    }
+    fprintf(dst, "# links\n");
+    for (n = 0; n < s->h.num_links; n++) {
+	if (s->links[n].sig >= 0 && s->links[n].sig < s->h.num_sigs)
+	    fprintf(dst, "linkps %s %s\n", s->links[n].pin,
+		s->sigs[s->links[n].sig].name);
+	else
+	    fprintf(dst, "# linkps %s (bad signal %d)\n", s->links[n].pin,
+		s->links[n].sig);
+    }
+    fprintf(dst, "# parameter values\n");
+    for (n = 0; n < s->h.num_params; n++) {
+	v = &s->params[n];
+	fprintf(dst, "setp %s %s\n", v->name,
+	    data_value2((int) v->type, &v->value));
+    }
+    fprintf(dst, "# unlinked pin values\n");
+    for (n = 0; n < s->h.num_pins; n++) {
+	v = &s->pins[n];
+	fprintf(dst, "setp %s %s\n", v->name,
+	    data_value2((int) v->type, &v->value));
+    }
+    fprintf(dst, "# realtime thread/function links\n");
+    for (n = 0; n < s->h.num_functs; n++)
+	fprintf(dst, "addf %s %s\n", s->functs[n].funct, s->functs[n].thread);
+}
+
+/* loads the components that aren't there yet, in as few loadrt batches
+   as the token limit allows */
+static int halsnap_load_comps(halsnap_t *s)
+{
+    char *args[MAX_TOK+1], *mine[MAX_TOK], **copies, *first = 0, *tok;
+    int n, i, nargs = 0, ntok, present, retval = 0;
+
+    copies = calloc(s->h.num_comps + 1, sizeof(char *));
+    if (!copies) {
+	halcmd_error("snapshot: out of memory\n");
+	return -ENOMEM;
+    }
+    for (n = 0; n < s->h.num_comps; n++) {
+	rtapi_mutex_get(&(hal_data->mutex));
+	present = halpr_find_comp_by_name(s->comps[n].name) != 0;
+	rtapi_mutex_give(&(hal_data->mutex));
+	if (present)
+	    continue;
+	copies[n] = strdup(s->comps[n].args);
+	if (!copies[n]) {
+	    halcmd_error("snapshot: out of memory\n");
+	    retval = -ENOMEM;
+	    break;
+	}
+	/* as many as a loadrt of one module can pass on to rtapi_app */
+	ntok = 0;
+	for (tok = strtok(copies[n], " \t"); tok; tok = strtok(NULL, " \t")) {
+	    if (ntok == MAX_TOK - 4) {
+		halcmd_error("snapshot: too many args for '%s'\n",
+		    s->comps[n].name);
+		retval = -EINVAL;
+		break;
+	    }
+	    mine[ntok++] = tok;
+	}
+	if (retval)
+	    break;
+	/* no room after a ';' and its name: load the batch so far */
+	if (first && nargs + 2 + ntok > MAX_TOK) {
+	    args[nargs] = NULL;
+	    if ((retval = do_loadrt_cmd(first, args)) != 0)
+		break;
+	    first = 0;
+	    nargs = 0;
+	}
+	if (first) {
+	    args[nargs++] = ";";
+	    args[nargs++] = s->comps[n].name;
+	} else {
+	    first = s->comps[n].name;
+	}
+	for (i = 0; i < ntok; i++)
+	    args[nargs++] = mine[i];
+    }
+    if (first && retval == 0) {
+	args[nargs] = NULL;
+	retval = do_loadrt_cmd(first, args);
+    }
+    for (n = 0; n < s->h.num_comps; n++)
+	free(copies[n]);
+    free(copies);
+    return retval;
+}
+
+static int halsnap_restore(halsnap_t *s)
+{
+    hal_restore_t r;
+    int n, retval;
+
+    if ((retval = halsnap_load_comps(s)) != 0)
+	return retval;
+    for (n = 0; n < s->h.num_aliases; n++) {
+	if (s->aliases[n].param)
+	    retval = hal_param_alias(s->aliases[n].name, s->aliases[n].alias);
+	else
+	    retval = hal_pin_alias(s->aliases[n].name, s->aliases[n].alias);
+	if (retval != 0) {
+	    halcmd_error("snapshot: can't alias %s '%s' to '%s'\n",
+		s->aliases[n].param ? "param" : "pin", s->aliases[n].name,
+		s->aliases[n].alias);
+	    return retval;
+	}
+    }
+    r.num_sigs = s->h.num_sigs;
+    r.num_links = s->h.num_links;
+    r.num_params = s->h.num_params;
+    r.num_pins = s->h.num_pins;
+    r.sigs = s->sigs;
+    r.links = s->links;
+    r.params = s->params;
+    r.pins = s->pins;
+    if ((retval = halpr_restore(&r)) != 0) {
+	halcmd_error("snapshot: restore failed\n");
+	return retval;
+    }
+    for (n = 0; n < s->h.num_functs; n++) {
+	retval = hal_add_funct_to_thread(s->functs[n].funct,
+	    s->functs[n].thread, -1);
+	if (retval != 0) {
+	    halcmd_error("snapshot: can't add '%s' to thread '%s'\n",
+		s->functs[n].funct, s->functs[n].thread);
+	    return retval;
+	}
+    }
+    return 0;
+}
+
+int do_snapshot_cmd(char *op, char *filename)
+{
+    halsnap_t s;
+    int retval;
+
+    if (strcmp(op, "save") == 0) {
+	if ((retval = halsnap_take(&s)) == 0)
+	    retval = halsnap_write(&s, filename);
+    } else if (strcmp(op, "restore") == 0) {
+	if ((retval = halsnap_read(&s, filename)) == 0)
+	    retval = halsnap_restore(&s);
+    } else if (strcmp(op, "show") == 0) {
+	if ((retval = halsnap_read(&s, filename)) == 0)
+	    halsnap_show(&s, stdout);
+    } else {
+	halcmd_error("Unknown 'snapshot' operation '%s'\n", op);
+	return -EINVAL;
+    }
+    halsnap_free(&s);
+    return retval;
+}
+
 // --- remote comp support
 
 int do_newcomp_cmd(char *comp, char *args[])
@@ -2791,16 +3416,14 @@ int do_waitunbound_cmd(char *comp_name, char *tokens[])
 }
 // --- end remote comp support
 
-static void save_comps(FILE *dst)
+static void save_comps(hal_snapshot_t *snap, FILE *dst)
 {
-    int next;
-    hal_comp_t *comp;
+    int n;
+    hal_comp_snap_t *comp;
 
     fprintf(dst, "# components\n");
-    rtapi_mutex_get(&(hal_data->mutex));
-    next = hal_data->comp_list_ptr;
-    while (next != 0) {
-	comp = SHMPTR(next);
+    for (n = 0; n < snap->num_comps; n++) {
+	comp = &snap->comps[n];
 	if ( comp->type == TYPE_RT ) {
 
 	    // FIXME XXX MAH - save halcmd defined remote comps!!
@@ -2808,89 +3431,70 @@ static void save_comps(FILE *dst)
 	    if ( comp->insmod_args == 0 ) {
 		fprintf(dst, "#loadrt %s  (not loaded by loadrt, no args saved)\n", comp->name);
 	    } else {
-		fprintf(dst, "loadrt %s %s\n", comp->name,
-		    (char *)SHMPTR(comp->insmod_args));
+		fprintf(dst, "loadrt %s %s\n", comp->name, comp->insmod_args);
 	    }
 	}
-	next = comp->next_ptr;
     }
 #if 0  /* newinst deferred to version 2.2 */
-    next = hal_data->comp_list_ptr;
-    while (next != 0) {
-	comp = SHMPTR(next);
-	if ( comp->type == 2 ) {
-            hal_comp_t *comp1 = halpr_find_comp_by_id(comp->comp_id & 0xffff);
-            fprintf(dst, "newinst %s %s\n", comp1->name, comp->name);
+    for (n = 0; n < snap->num_comps; n++) {
+	comp = &snap->comps[n];
+	if ( comp->type == 2 && comp->parent >= 0 ) {
+            fprintf(dst, "newinst %s %s\n",
+		snap->comps[comp->parent].name, comp->name);
         }
-	next = comp->next_ptr;
     }
 #endif
-    rtapi_mutex_give(&(hal_data->mutex));
 }
 
-static void save_aliases(FILE *dst)
+static void save_aliases(hal_snapshot_t *snap, FILE *dst)
 {
-    int next;
-    hal_pin_t *pin;
-    hal_param_t *param;
-    hal_oldname_t *oldname;
+    int n;
+    hal_pin_snap_t *pin;
+    hal_param_snap_t *param;
 
     fprintf(dst, "# pin aliases\n");
-    rtapi_mutex_get(&(hal_data->mutex));
-    next = hal_data->pin_list_ptr;
-    while (next != 0) {
-	pin = SHMPTR(next);
-	if ( pin->oldname != 0 ) {
+    for (n = 0; n < snap->num_pins; n++) {
+	pin = &snap->pins[n];
+	if ( pin->oldname[0] != '\0' ) {
 	    /* name is an alias */
-	    oldname = SHMPTR(pin->oldname);
-	    fprintf(dst, "alias pin %s %s\n", oldname->name, pin->name);
+	    fprintf(dst, "alias pin %s %s\n", pin->oldname, pin->name);
 	}
-	next = pin->next_ptr;
     }
     fprintf(dst, "# param aliases\n");
-    next = hal_data->param_list_ptr;
-    while (next != 0) {
-	param = SHMPTR(next);
-	if ( param->oldname != 0 ) {
+    for (n = 0; n < snap->num_params; n++) {
+	param = &snap->params[n];
+	if ( param->oldname[0] != '\0' ) {
 	    /* name is an alias */
-	    oldname = SHMPTR(param->oldname);
-	    fprintf(dst, "alias param %s %s\n", oldname->name, param->name);
+	    fprintf(dst, "alias param %s %s\n", param->oldname, param->name);
 	}
-	next = param->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
 }
 
-static void save_signals(FILE *dst, int only_unlinked)
+static void save_signals(hal_snapshot_t *snap, FILE *dst, int only_unlinked)
 {
-    int next;
-    hal_sig_t *sig;
+    int n;
+    hal_sig_snap_t *sig;
 
     fprintf(dst, "# signals\n");
-    rtapi_mutex_get(&(hal_data->mutex));
-    
-    for( next = hal_data->sig_list_ptr; next; next = sig->next_ptr) {
-	sig = SHMPTR(next);
+    for (n = 0; n < snap->num_sigs; n++) {
+	sig = &snap->sigs[n];
         if(only_unlinked && (sig->readers || sig->writers)) continue;
 	fprintf(dst, "newsig %s %s\n", sig->name, data_type((int) sig->type));
     }
-    rtapi_mutex_give(&(hal_data->mutex));
 }
 
-static void save_links(FILE *dst, int arrow)
+static void save_links(hal_snapshot_t *snap, FILE *dst, int arrow)
 {
-    int next;
-    hal_pin_t *pin;
-    hal_sig_t *sig;
+    int n;
+    hal_pin_snap_t *pin;
+    hal_sig_snap_t *sig;
     const char *arrow_str;
 
     fprintf(dst, "# links\n");
-    rtapi_mutex_get(&(hal_data->mutex));
-    next = hal_data->pin_list_ptr;
-    while (next != 0) {
-	pin = SHMPTR(next);
-	if (pin->signal != 0) {
-	    sig = SHMPTR(pin->signal);
+    for (n = 0; n < snap->num_pins; n++) {
+	pin = &snap->pins[n];
+	if (pin->signal >= 0) {
+	    sig = &snap->sigs[pin->signal];
 	    if (arrow != 0) {
 		arrow_str = data_arrow1((int) pin->dir);
 	    } else {
@@ -2898,44 +3502,39 @@ static void save_links(FILE *dst, int arrow)
 	    }
 	    fprintf(dst, "linkps %s %s %s\n", pin->name, arrow_str, sig->name);
 	}
-	next = pin->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
 }
 
-static void save_nets(FILE *dst, int arrow)
+static void save_nets(hal_snapshot_t *snap, FILE *dst, int arrow)
 {
-    int next;
-    hal_pin_t *pin;
-    hal_sig_t *sig;
+    int n, i;
+    hal_pin_snap_t *pin;
+    hal_sig_snap_t *sig;
     const char *arrow_str;
 
     fprintf(dst, "# nets\n");
-    rtapi_mutex_get(&(hal_data->mutex));
-    
-    for (next = hal_data->sig_list_ptr; next != 0; next = sig->next_ptr) {
-	sig = SHMPTR(next);
+    for (n = 0; n < snap->num_sigs; n++) {
+	sig = &snap->sigs[n];
         if(arrow == 3) {
             int state = 0, first = 1;
 
             /* If there are no pins connected to this signal, do nothing */
-            pin = halpr_find_pin_by_sig(sig, 0);
-            if(!pin) continue;
+            if(sig->num_pins == 0) continue;
 
             fprintf(dst, "net %s", sig->name);
 
             /* Step 1: Output pin, if any */
             
-            for(pin = halpr_find_pin_by_sig(sig, 0); pin;
-                    pin = halpr_find_pin_by_sig(sig, pin)) {
+            for(i = 0; i < sig->num_pins; i++) {
+                pin = &snap->pins[sig->pins[i]];
                 if(pin->dir != HAL_OUT) continue;
                 fprintf(dst, " %s", pin->name);
                 state = 1;
             }
             
             /* Step 2: I/O pins, if any */
-            for(pin = halpr_find_pin_by_sig(sig, 0); pin;
-                    pin = halpr_find_pin_by_sig(sig, pin)) {
+            for(i = 0; i < sig->num_pins; i++) {
+                pin = &snap->pins[sig->pins[i]];
                 if(pin->dir != HAL_IO) continue;
                 fprintf(dst, " ");
                 if(state) { fprintf(dst, "=> "); state = 0; }
@@ -2946,8 +3545,8 @@ static void save_nets(FILE *dst, int arrow)
             if(!first) state = 1;
 
             /* Step 3: Input pins, if any */
-            for(pin = halpr_find_pin_by_sig(sig, 0); pin;
-                    pin = halpr_find_pin_by_sig(sig, pin)) {
+            for(i = 0; i < sig->num_pins; i++) {
+                pin = &snap->pins[sig->pins[i]];
                 if(pin->dir != HAL_IN) continue;
                 fprintf(dst, " ");
                 if(state) { fprintf(dst, "=> "); state = 0; }
@@ -2957,21 +3556,18 @@ static void save_nets(FILE *dst, int arrow)
             fprintf(dst, "\n");
         } else if(arrow == 2) {
             /* If there are no pins connected to this signal, do nothing */
-            pin = halpr_find_pin_by_sig(sig, 0);
-            if(!pin) continue;
+            if(sig->num_pins == 0) continue;
 
             fprintf(dst, "net %s", sig->name);
-            pin = halpr_find_pin_by_sig(sig, 0);
-            while (pin != 0) {
-                fprintf(dst, " %s", pin->name);
-                pin = halpr_find_pin_by_sig(sig, pin);
+            for(i = 0; i < sig->num_pins; i++) {
+                fprintf(dst, " %s", snap->pins[sig->pins[i]].name);
             }
             fprintf(dst, "\n");
         } else {
             fprintf(dst, "newsig %s %s\n",
                     sig->name, data_type((int) sig->type));
-            pin = halpr_find_pin_by_sig(sig, 0);
-            while (pin != 0) {
+            for(i = 0; i < sig->num_pins; i++) {
+                pin = &snap->pins[sig->pins[i]];
                 if (arrow != 0) {
                     arrow_str = data_arrow2((int) pin->dir);
                 } else {
@@ -2979,31 +3575,25 @@ static void save_nets(FILE *dst, int arrow)
                 }
                 fprintf(dst, "linksp %s %s %s\n",
                         sig->name, arrow_str, pin->name);
-                pin = halpr_find_pin_by_sig(sig, pin);
             }
         }
     }
-    rtapi_mutex_give(&(hal_data->mutex));
 }
 
-static void save_params(FILE *dst)
+static void save_params(hal_snapshot_t *snap, FILE *dst)
 {
-    int next;
-    hal_param_t *param;
+    int n;
+    hal_param_snap_t *param;
 
     fprintf(dst, "# parameter values\n");
-    rtapi_mutex_get(&(hal_data->mutex));
-    next = hal_data->param_list_ptr;
-    while (next != 0) {
-	param = SHMPTR(next);
+    for (n = 0; n < snap->num_params; n++) {
+	param = &snap->params[n];
 	if (param->dir != HAL_RO) {
 	    /* param is writable, save its value */
 	    fprintf(dst, "setp %s %s\n", param->name,
-		data_value((int) param->type, SHMPTR(param->data_ptr)));
+		data_value((int) param->type, &param->value));
 	}
-	next = param->next_ptr;
     }
-    rtapi_mutex_give(&(hal_data->mutex));
 }
 
 static void save_threads(FILE *dst)
@@ -3207,6 +3797,14 @@ int do_help_cmd(char *command)
 	printf("  or 'thread'.  ('linka' and 'neta' show arrows for pin\n");
 	printf("  direction.)  If 'type' is omitted or 'all', does the\n");
 	printf("  equivalent of 'comp', 'netl', 'param', and 'thread'.\n");
+    } else if (strcmp(command, "snapshot") == 0) {
+	printf("snapshot save|restore|show filename\n");
+	printf("  'save' writes the realtime configuration to 'filename' in\n");
+	printf("  binary: loadrt components and their args, aliases, signals,\n");
+	printf("  links, values and thread functions.  'restore' loads the\n");
+	printf("  components not loaded yet, then links and sets everything\n");
+	printf("  in one pass.  'show' prints a snapshot as HAL commands, for\n");
+	printf("  diff.  User space components are not included.\n");
     } else if (strcmp(command, "start") == 0) {
 	printf("start\n");
 	printf("  Starts all realtime threads.\n");
@@ -3264,6 +3862,7 @@ static void print_help_commands(void)
     printf("  source              Execute commands from another .hal file\n");
     printf("  status              Display status information\n");
     printf("  save                Print config as commands\n");
+    printf("  snapshot            Save, restore or show a binary config\n");
     printf("  start, stop         Start/stop realtime threads\n");
     printf("  alias, unalias      Add or remove pin or parameter name aliases\n");
     printf("  quit, exit          Exit from halcmd\n");
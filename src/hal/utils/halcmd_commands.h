@@ -79,6 +79,7 @@ extern int do_unloadusr_cmd(char *mod_name);
 extern int do_loadusr_cmd(char *args[]);
 extern int do_waitusr_cmd(char *comp_name);
 extern int do_save_cmd(char *type, char *filename);
+extern int do_snapshot_cmd(char *op, char *filename);
 extern int do_setexact_cmd(void);
 
 extern int do_newcomp_cmd(char *comp, char *args[]);
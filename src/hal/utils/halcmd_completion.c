@@ -49,7 +49,7 @@ static const char *command_table[] = {
     "loadrt", "loadusr", "unload", "lock", "unlock",
     "linkps", "linksp", "linkpp", "unlinkp",
     "net", "newsig", "delsig", "getp", "gets", "setp", "sets", "ptype", "stype",
-    "addf", "delf", "show", "list", "status", "save", "source",
+    "addf", "delf", "show", "list", "status", "save", "snapshot", "source",
     "start", "stop", "quit", "exit", "help", "alias", "unalias", 
     "newg"," delg", "newm", "delm",
     "newcomp","newpin","ready","waitbound", "waitunbound",
@@ -72,6 +72,11 @@ static const char *show_table[] = {
     NULL,
 };
 
+static const char *snapshot_table[] = {
+    "save", "restore", "show",
+    NULL,
+};
+
 static const char *save_table[] = {
     "all", "alias", "comp", "sig", "link", "linka", "net", "neta", "param", "thread",
     "group", "member",
@@ -126,6 +131,23 @@ static char **completion_matches_table(const char *text, const char **table, hal
     return func(text, table_generator);
 }
 
+/* pins, signals, parameters and components are completed from a
+   snapshot, so the HAL mutex isn't held while readline works through
+   them.  Functions and threads are few, they are read in place under
+   the mutex.
+*/
+static hal_snapshot_t *snap;
+
+static char **complete_locked(const char *text, hal_completer_func func,
+    hal_generator_func gen) {
+    char **result;
+
+    rtapi_mutex_get(&(hal_data->mutex));
+    result = func(text, gen);
+    rtapi_mutex_give(&(hal_data->mutex));
+    return result;
+}
+
 static hal_type_t match_type = -1;
 static int match_writers = -1;
 static hal_pin_dir_t match_direction = HAL_DIR_UNSPECIFIED;
@@ -142,32 +164,32 @@ static int writer_match(hal_pin_dir_t dir, int writers) {
 }
 
 static void check_match_type_pin(const char *name) {
-    int next = hal_data->pin_list_ptr;
+    char buf[HAL_NAME_LEN + 1];
     int sz = strcspn(name, " \t");
+    int n;
 
-    while(next) {
-        hal_pin_t *pin = SHMPTR(next);
-        next = pin->next_ptr;
-	if ( sz == strlen(pin->name) && strncmp(name, pin->name, sz) == 0 ) {
-            match_type = pin->type;
-            match_direction = pin->dir;
-            return;
-        }
+    if(sz > HAL_NAME_LEN) return;
+    memcpy(buf, name, sz);
+    buf[sz] = '\0';
+    n = halpr_snapshot_find_pin(snap, buf);
+    if(n >= 0) {
+        match_type = snap->pins[n].type;
+        match_direction = snap->pins[n].dir;
     }
 }
 
 static void check_match_type_signal(const char *name) {
-    int next = hal_data->sig_list_ptr;
+    char buf[HAL_NAME_LEN + 1];
     int sz = strcspn(name, " \t");
+    int n;
 
-    while(next) {
-        hal_sig_t *sig = SHMPTR(next);
-        next = sig->next_ptr;
-	if ( sz == strlen(sig->name) && strncmp(name, sig->name, sz) == 0 ) {
-            match_type = sig->type;
-            match_writers = sig->writers;
-            return;
-        }
+    if(sz > HAL_NAME_LEN) return;
+    memcpy(buf, name, sz);
+    buf[sz] = '\0';
+    n = halpr_snapshot_find_sig(snap, buf);
+    if(n >= 0) {
+        match_type = snap->sigs[n].type;
+        match_writers = snap->sigs[n].writers;
     }
 }
 
@@ -195,36 +217,21 @@ static char *parameter_generator(const char *text, int state) {
     char *name;
 
     if(!state) {
-        next = hal_data->param_list_ptr;
+        next = 0;
         len = strlen(text);
         aliased = 0;
     }
 
-    while(next) {
-        hal_param_t *param = SHMPTR(next);
-        switch (aliased) {
-            case 0: // alias (if any) has not been output
-                if (param->oldname != 0) {
-                    // there's an alias, so use that and do not update the pin pointer
-                    hal_oldname_t *oldname = SHMPTR(param->oldname);
-                    name = oldname->name;
-                    aliased = 1;
-                } else {
-                    // no alias, so use the name and update the pin pointer
-                    name = param->name;
-                    next = param->next_ptr;
-                }
-            break;
-            case 1:  // there is an alias, and it has been processed already
-                name = param->name;
-                next = param->next_ptr;
-                aliased = 0;
-            break;
-            default:
-                // shouldn't be able to get here, so assume we're done
-                rl_attempted_completion_over = 1;
-                return NULL;
-            break;
+    while(next < snap->num_params) {
+        hal_param_snap_t *param = &snap->params[next];
+        if (!aliased && param->oldname[0] != '\0') {
+            // there's an alias, so use that and stay on this param
+            name = param->oldname;
+            aliased = 1;
+        } else {
+            name = param->name;
+            next++;
+            aliased = 0;
         }
         if ( strncmp(text, name, len) == 0 )
             return strdup(name);
@@ -262,13 +269,12 @@ static char *signal_generator(const char *text, int state) {
     static int len;
     static int next;
     if(!state) {
-        next = hal_data->sig_list_ptr;
+        next = 0;
         len = strlen(text);
     }
 
-    while(next) {
-        hal_sig_t *sig = SHMPTR(next);
-        next = sig->next_ptr;
+    while(next < snap->num_sigs) {
+        hal_sig_snap_t *sig = &snap->sigs[next++];
         if ( match_type != HAL_TYPE_UNSPECIFIED && match_type != sig->type ) continue; 
         if ( !writer_match( match_direction, sig->writers ) ) continue;
 	if ( strncmp(text, sig->name, len) == 0 )
@@ -283,23 +289,21 @@ static char *getp_generator(const char *text, int state) {
     static int what;
     if(!state) {
         what = 0;
-        next = hal_data->param_list_ptr;
+        next = 0;
         len = strlen(text);
     }
 
     if(what == 0) {
-        while(next) {
-            hal_param_t *param = SHMPTR(next);
-            next = param->next_ptr;
+        while(next < snap->num_params) {
+            hal_param_snap_t *param = &snap->params[next++];
             if ( strncmp(text, param->name, len) == 0 )
                 return strdup(param->name);
         }
         what = 1;
-        next = hal_data->pin_list_ptr;
+        next = 0;
     }
-    while(next) {
-        hal_pin_t *pin = SHMPTR(next);
-        next = pin->next_ptr;
+    while(next < snap->num_pins) {
+        hal_pin_snap_t *pin = &snap->pins[next++];
         if ( strncmp(text, pin->name, len) == 0 )
             return strdup(pin->name);
     }
@@ -313,24 +317,22 @@ static char *setp_generator(const char *text, int state) {
     static int what;
     if(!state) {
         what = 0;
-        next = hal_data->param_list_ptr;
+        next = 0;
         len = strlen(text);
     }
 
     if(what == 0) {
-        while(next) {
-            hal_param_t *param = SHMPTR(next);
-            next = param->next_ptr;
+        while(next < snap->num_params) {
+            hal_param_snap_t *param = &snap->params[next++];
             if ( param->dir != HAL_RO && strncmp(text, param->name, len) == 0 )
                 return strdup(param->name);
         }
         what = 1;
-        next = hal_data->pin_list_ptr;
+        next = 0;
     }
-    while(next) {
-        hal_pin_t *pin = SHMPTR(next);
-        next = pin->next_ptr;
-        if ( pin->dir != HAL_OUT && pin->signal == 0 && 
+    while(next < snap->num_pins) {
+        hal_pin_snap_t *pin = &snap->pins[next++];
+        if ( pin->dir != HAL_OUT && pin->signal < 0 && 
                  strncmp(text, pin->name, len) == 0 )
             return strdup(pin->name);
     }
@@ -343,17 +345,16 @@ static char *usrcomp_generator(const char *text, int state) {
     static int len;
     static int next;
     if(!state) {
-        next = hal_data->comp_list_ptr;
+        next = 0;
         len = strlen(text);
         if(strncmp(text, "all", len) == 0)
             return strdup("all");
     }
 
-    while(next) {
-        hal_comp_t *comp = SHMPTR(next);
-        next = comp->next_ptr;
+    while(next < snap->num_comps) {
+        hal_comp_snap_t *comp = &snap->comps[next++];
         if(comp->type == TYPE_RT) continue;
-	if(strncmp(text, comp->name, len) == 0)
+	if ( strncmp(text, comp->name, len) == 0 )
             return strdup(comp->name);
     }
     rl_attempted_completion_over = 1;
@@ -366,15 +367,14 @@ static char *comp_generator(const char *text, int state) {
     static int len;
     static int next;
     if(!state) {
-        next = hal_data->comp_list_ptr;
+        next = 0;
         len = strlen(text);
         if(strncmp(text, "all", len) == 0)
             return strdup("all");
     }
 
-    while(next) {
-        hal_comp_t *comp = SHMPTR(next);
-        next = comp->next_ptr;
+    while(next < snap->num_comps) {
+        hal_comp_snap_t *comp = &snap->comps[next++];
 	if ( strncmp(text, comp->name, len) == 0 )
             return strdup(comp->name);
     }
@@ -387,15 +387,14 @@ static char *rtcomp_generator(const char *text, int state) {
     static int len;
     static int next;
     if(!state) {
-        next = hal_data->comp_list_ptr;
+        next = 0;
         len = strlen(text);
         if(strncmp(text, "all", len) == 0)
             return strdup("all");
     }
 
-    while(next) {
-        hal_comp_t *comp = SHMPTR(next);
-        next = comp->next_ptr;
+    while(next < snap->num_comps) {
+        hal_comp_snap_t *comp = &snap->comps[next++];
         if(comp->type != TYPE_RT) continue;
 	if ( strncmp(text, comp->name, len) == 0 )
             return strdup(comp->name);
@@ -409,14 +408,13 @@ static char *parameter_alias_generator(const char *text, int state) {
     static int next;
 
     if(!state) {
-        next = hal_data->param_list_ptr;
+        next = 0;
         len = strlen(text);
     }
 
-    while(next) {
-        hal_param_t *param = SHMPTR(next);
-        next = param->next_ptr;
-        if (param->oldname==0) continue;  // no alias here, move along
+    while(next < snap->num_params) {
+        hal_param_snap_t *param = &snap->params[next++];
+        if (param->oldname[0] == '\0') continue;  // no alias here, move along
         if ( strncmp(text, param->name, len) == 0 )
             return strdup(param->name);
     }
@@ -428,14 +426,13 @@ static char *pin_alias_generator(const char *text, int state) {
     static int next;
 
     if(!state) {
-        next = hal_data->pin_list_ptr;
+        next = 0;
         len = strlen(text);
     }
 
-    while(next) {
-        hal_pin_t *pin = SHMPTR(next);
-        next = pin->next_ptr;
-        if (pin->oldname==0) continue;  // no alias here, move along
+    while(next < snap->num_pins) {
+        hal_pin_snap_t *pin = &snap->pins[next++];
+        if (pin->oldname[0] == '\0') continue;  // no alias here, move along
         if ( strncmp(text, pin->name, len) == 0 )
             return strdup(pin->name);
     }
@@ -449,36 +446,21 @@ static char *pin_generator(const char *text, int state) {
     char *name;
 
     if(!state) {
-        next = hal_data->pin_list_ptr;
+        next = 0;
         len = strlen(text);
         aliased = 0;
     }
 
-    while(next) {
-        hal_pin_t *pin = SHMPTR(next);
-        switch (aliased) {
-            case 0: // alias (if any) has not been output
-                if (pin->oldname != 0) {
-                    // there's an alias, so use that and do not update the pin pointer
-                    hal_oldname_t *oldname = SHMPTR(pin->oldname);
-                    name = oldname->name;
-                    aliased = 1;
-                } else {
-                    // no alias, so use the name and update the pin pointer
-                    name = pin->name;
-                    next = pin->next_ptr;
-                }
-            break;
-            case 1:  // there is an alias, and it has been processed already
-                name = pin->name;
-                next = pin->next_ptr;
-                aliased = 0;
-            break;
-            default:
-                // shouldn't be able to get here, so assume we're done
-                rl_attempted_completion_over = 1;
-                return NULL;
-            break;
+    while(next < snap->num_pins) {
+        hal_pin_snap_t *pin = &snap->pins[next];
+        if (!aliased && pin->oldname[0] != '\0') {
+            // there's an alias, so use that and stay on this pin
+            name = pin->oldname;
+            aliased = 1;
+        } else {
+            name = pin->name;
+            next++;
+            aliased = 0;
         }
         if ( !writer_match( pin->dir, match_writers ) ) continue;
         if ( !direction_match( pin->dir, match_direction ) ) continue;
@@ -610,7 +592,11 @@ char **halcmd_completer(const char *text, int start, int end, hal_completer_func
     match_writers = -1;
     match_direction = -1;
 
-    rtapi_mutex_get(&(hal_data->mutex));
+    snap = halpr_snapshot_take();
+    if (!snap) {
+        rl_attempted_completion_over = 1;
+        return NULL;
+    }
 
     if(startswith(buffer, "delsig ") && argno == 1) {
         result = func(text, signal_generator);
@@ -691,9 +677,9 @@ char **halcmd_completer(const char *text, int start, int end, hal_completer_func
             } else if (startswith(n, "param")) {
                 result = func(text, parameter_generator);
             } else if (startswith(n, "funct")) {
-                result = func(text, funct_generator);
+                result = complete_locked(text, func, funct_generator);
             } else if (startswith(n, "thread")) {
-                result = func(text, thread_generator);
+                result = complete_locked(text, func, thread_generator);
 	    }
         }
     } else if(startswith(buffer, "show ")) {
@@ -708,13 +694,15 @@ char **halcmd_completer(const char *text, int start, int end, hal_completer_func
             } else if (startswith(n, "param")) {
                 result = func(text, parameter_generator);
             } else if (startswith(n, "funct")) {
-                result = func(text, funct_generator);
+                result = complete_locked(text, func, funct_generator);
             } else if (startswith(n, "thread")) {
-                result = func(text, thread_generator);
+                result = complete_locked(text, func, thread_generator);
 	    }
         }
     } else if(startswith(buffer, "save ") && argno == 1) {
         result = completion_matches_table(text, save_table, func);
+    } else if(startswith(buffer, "snapshot ") && argno == 1) {
+        result = completion_matches_table(text, snapshot_table, func);
     } else if(startswith(buffer, "status ") && argno == 1) {
         result = completion_matches_table(text, status_table, func);
     } else if(startswith(buffer, "newsig ") && argno == 2) {
@@ -726,13 +714,13 @@ char **halcmd_completer(const char *text, int start, int end, hal_completer_func
     } else if(startswith(buffer, "unlock ") && argno == 1) {
         result = completion_matches_table(text, unlock_table, func);
     } else if(startswith(buffer, "addf ") && argno == 1) {
-        result = func(text, funct_generator);
+        result = complete_locked(text, func, funct_generator);
     } else if(startswith(buffer, "addf ") && argno == 2) {
-        result = func(text, thread_generator);
+        result = complete_locked(text, func, thread_generator);
     } else if(startswith(buffer, "delf ") && argno == 1) {
-        result = func(text, attached_funct_generator);
+        result = complete_locked(text, func, attached_funct_generator);
     } else if(startswith(buffer, "delf ") && argno == 2) {
-        result = func(text, thread_generator);
+        result = complete_locked(text, func, thread_generator);
     } else if(startswith(buffer, "help ") && argno == 1) {
         result = completion_matches_table(text, command_table, func);
     } else if(startswith(buffer, "unloadusr ") && argno == 1) {
@@ -744,18 +732,18 @@ char **halcmd_completer(const char *text, int start, int end, hal_completer_func
     } else if(startswith(buffer, "unload ") && argno == 1) {
         result = func(text, comp_generator);
     } else if(startswith(buffer, "source ") && argno == 1) {
-        rtapi_mutex_give(&(hal_data->mutex));
+        halpr_snapshot_free(snap);
         // leaves rl_attempted_completion_over = 0 to complete from filesystem
         return 0;
     } else if(startswith(buffer, "loadusr ") && argno < 3) {
-        rtapi_mutex_give(&(hal_data->mutex));
+        halpr_snapshot_free(snap);
         // leaves rl_attempted_completion_over = 0 to complete from filesystem
         return func(text, loadusr_generator);
     } else if(startswith(buffer, "loadrt ") && argno == 1) {
         result = func(text, loadrt_generator);
     }
 
-    rtapi_mutex_give(&(hal_data->mutex));
+    halpr_snapshot_free(snap);
 
     rl_attempted_completion_over = 1;
     return result;
@@ -0,0 +1,1103 @@
+/** This file, 'scope_cli.c', is a command line program that together
+    with 'scope_rt.c' captures HAL pins, signals, and parameters to a
+    file.  It uses the same shared memory protocol as the GUI scope
+    ('scope.c'), but does not depend on GTK, so it can be used on
+    headless machines and from scripts.
+
+    Invoking:
+
+    halscope-cli [options] [source ...]
+
+    Each 'source' names a pin, signal, or parameter, optionally
+    prefixed with 'pin:', 'sig:' or 'param:'.  Sources are assigned
+    to channels 1..16 in order.  A saved '.halscope' file can be
+    used instead of (or in addition to) sources on the command
+    line, see the manpage halscope-cli(1) for details.
+*/
+
+/** This program is free software; you can redistribute it and/or
+    modify it under the terms of version 2 of the GNU General
+    Public License as published by the Free Software Foundation.
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111 USA
+
+    THE AUTHORS OF THIS LIBRARY ACCEPT ABSOLUTELY NO LIABILITY FOR
+    ANY HARM OR LOSS RESULTING FROM ITS USE.  IT IS _EXTREMELY_ UNWISE
+    TO RELY ON SOFTWARE ALONE FOR SAFETY.  Any machinery capable of
+    harming persons must have provisions for completely removing power
+    from all motors, etc, before persons enter any danger area.  All
+    machinery must be designed to comply with local and national safety
+    codes, and the authors of this software can not, and do not, take
+    any responsibility for such compliance.
+
+    This code was written as part of the EMC HAL project.  For more
+    information, go to www.linuxcnc.org.
+*/
+
+#include "config.h"
+#include <sys/types.h>
+#include <unistd.h>		/* getopt() */
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include "rtapi.h"		/* RTAPI realtime OS API */
+#include "hal.h"		/* HAL public API decls */
+#include "../hal_priv.h"	/* HAL private API decls */
+#include "scope_shm.h"		/* scope shared memory declarations */
+
+/***********************************************************************
+*                         TYPEDEFS AND DEFINES                         *
+************************************************************************/
+
+/* binary output file layout, all values in host byte order:
+
+   file header:
+	char[4]		"HSCB"
+	u32		format version (HSCB_VERSION)
+	u32		number of channels (N)
+	u32		sample period in nsec
+	N channel descriptors:
+	    u32		HAL type (HAL_BIT, HAL_FLOAT, HAL_S32, HAL_U32)
+	    char[HAL_NAME_LEN+1] source name, NUL padded
+   each capture:
+	u32		capture number, starting at 0
+	u32		number of samples (S)
+	u32		number of samples before the trigger
+	S samples, each containing N values in channel order:
+	    HAL_BIT	u8
+	    HAL_FLOAT	double
+	    HAL_S32	s32
+	    HAL_U32	u32
+*/
+#define HSCB_MAGIC "HSCB"
+#define HSCB_VERSION 1
+
+typedef enum { FMT_CSV, FMT_BINARY } out_format_t;
+
+/* this struct holds the setup of one channel */
+
+typedef struct {
+    int source_type;		/* 0 = pin, 1 = signal, 2 = param,
+				   -1 = no source assigned */
+    char name[HAL_NAME_LEN + 1];	/* name of pin/sig/parameter */
+    hal_type_t data_type;	/* data type */
+    int data_len;		/* data length, 0 if not acquired */
+    /* vertical setup, only used to interpret TLEVEL in a config file */
+    int scale_index;
+    double position;
+    double vert_offset;
+} cli_chan_t;
+
+/***********************************************************************
+*                         LOCAL VARIABLES                              *
+************************************************************************/
+
+static int comp_id = -1;	/* component ID, -1 means not connected */
+static int shm_id = -1;		/* shared memory ID */
+static scope_shm_control_t *ctrl_shm;	/* shared mem control struct */
+static scope_data_t *shm_buffer;	/* shared mem sample buffer */
+static scope_data_t *cap_buf;	/* local copy of one capture */
+static char thread_name[HAL_NAME_LEN + 1];
+static long thread_period_ns;
+static int thread_attached;
+static volatile int done;	/* set by signal handler */
+
+static cli_chan_t chans[16];
+static int selected_chan;	/* channel for config file commands */
+static int trig_chan;		/* trigger channel, 0 = none */
+static int trig_edge = 1;	/* 1 = rising, 0 = falling */
+static int auto_trig;		/* non-zero to enable auto trigger */
+static int have_trig_abs;	/* trig_level_abs set on command line */
+static double trig_level_abs;	/* trigger level in signal units */
+static double trig_level_rel = 0.5;	/* TLEVEL from config file */
+static double trig_pos = 0.5;	/* pre-trigger fraction 0.0-1.0 */
+static int mult = 1;		/* sample every N runs of thread */
+static int sample_len;		/* channels per sample, 0 = auto */
+
+/* command line settings, applied on top of the config file;
+   negative (or empty) means not given */
+static char opt_thread[HAL_NAME_LEN + 1];
+static int opt_mult = -1;
+static int opt_sample_len = -1;
+static int opt_trig_chan = -1;
+static int opt_trig_edge = -1;
+static int opt_auto_trig = -1;
+static double opt_trig_pos = -1.0;
+
+/***********************************************************************
+*                  LOCAL FUNCTION PROTOTYPES                           *
+************************************************************************/
+
+static void quit(int sig);
+static void exit_from_hal(void);
+static int read_config_file(char *filename);
+static int set_channel_source(int chan_num, int type, char *name);
+static int add_source(char *arg);
+static double chan_scale(cli_chan_t *chan);
+static int setup_capture(void);
+static void set_trigger_level(void);
+static int start_capture(void);
+static int wait_capture(void);
+static int copy_capture(void);
+static void write_header(FILE *fp, out_format_t fmt);
+static void write_capture(FILE *fp, out_format_t fmt, int count, int samples);
+
+/***********************************************************************
+*                        MAIN() FUNCTION                               *
+************************************************************************/
+
+static void usage(void)
+{
+    fprintf(stderr,
+	"Usage:\n"
+	"  halscope-cli [options] [[pin:|sig:|param:]name ...]\n"
+	"Options:\n"
+	"  -i file       read channel/trigger setup from a .halscope file\n"
+	"  -t thread     thread to sample in\n"
+	"  -m mult       sample every 'mult' runs of the thread\n"
+	"  -c maxchan    channels per sample (1, 2, 4, 8, 16)\n"
+	"  -T chan       trigger channel (1-16), 0 for none\n"
+	"  -l level      trigger level, in signal units\n"
+	"  -e edge       trigger edge, 'rise' or 'fall'\n"
+	"  -a            auto trigger if no trigger within one record\n"
+	"  -p pos        trigger position in record, 0.0-1.0\n"
+	"  -n count      number of captures, 0 to run until killed\n"
+	"  -f format     output format, 'csv' (default) or 'bin'\n"
+	"  -o file       output file (default stdout)\n"
+	"  -N samples    size of scope_rt buffer if it must be loaded\n");
+}
+
+int main(int argc, char **argv)
+{
+    int retval, c, n, count, captures;
+    int num_samples = SCOPE_NUM_SAMPLES_DEFAULT;
+    char *ifilename = NULL;
+    char *ofilename = NULL;
+    char *cp;
+    out_format_t fmt = FMT_CSV;
+    FILE *fp;
+    void *shm_base;
+    int skip;
+
+    for (n = 0; n < 16; n++) {
+	chans[n].source_type = -1;
+    }
+    captures = 1;
+    while ((c = getopt(argc, argv, "hi:t:m:c:T:l:e:ap:n:f:o:N:")) != -1) {
+	switch (c) {
+	case 'i':
+	    ifilename = optarg;
+	    break;
+	case 't':
+	    strncpy(opt_thread, optarg, HAL_NAME_LEN);
+	    opt_thread[HAL_NAME_LEN] = '\0';
+	    break;
+	case 'm':
+	    opt_mult = strtol(optarg, &cp, 10);
+	    if ((*cp != '\0') || (opt_mult < 1)) {
+		fprintf(stderr, "halscope-cli: invalid multiplier '%s'\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'c':
+	    opt_sample_len = strtol(optarg, &cp, 10);
+	    if ((*cp != '\0') || (opt_sample_len < 1) ||
+		(opt_sample_len > 16) ||
+		(opt_sample_len & (opt_sample_len - 1))) {
+		fprintf(stderr, "halscope-cli: invalid channel count '%s'\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'T':
+	    opt_trig_chan = strtol(optarg, &cp, 10);
+	    if ((*cp != '\0') || (opt_trig_chan < 0) ||
+		(opt_trig_chan > 16)) {
+		fprintf(stderr, "halscope-cli: invalid trigger channel '%s'\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'l':
+	    trig_level_abs = strtod(optarg, &cp);
+	    if (*cp != '\0') {
+		fprintf(stderr, "halscope-cli: invalid trigger level '%s'\n", optarg);
+		return 1;
+	    }
+	    have_trig_abs = 1;
+	    break;
+	case 'e':
+	    if (strncasecmp(optarg, "rise", 4) == 0) {
+		opt_trig_edge = 1;
+	    } else if (strncasecmp(optarg, "fall", 4) == 0) {
+		opt_trig_edge = 0;
+	    } else {
+		fprintf(stderr, "halscope-cli: invalid trigger edge '%s'\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'a':
+	    opt_auto_trig = 1;
+	    break;
+	case 'p':
+	    opt_trig_pos = strtod(optarg, &cp);
+	    if ((*cp != '\0') || (opt_trig_pos < 0.0) ||
+		(opt_trig_pos > 1.0)) {
+		fprintf(stderr, "halscope-cli: invalid trigger position '%s'\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'n':
+	    captures = strtol(optarg, &cp, 10);
+	    if ((*cp != '\0') || (captures < 0)) {
+		fprintf(stderr, "halscope-cli: invalid capture count '%s'\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'f':
+	    if (strcasecmp(optarg, "csv") == 0) {
+		fmt = FMT_CSV;
+	    } else if ((strcasecmp(optarg, "bin") == 0) ||
+		(strcasecmp(optarg, "binary") == 0)) {
+		fmt = FMT_BINARY;
+	    } else {
+		fprintf(stderr, "halscope-cli: invalid format '%s'\n", optarg);
+		return 1;
+	    }
+	    break;
+	case 'o':
+	    ofilename = optarg;
+	    break;
+	case 'N':
+	    num_samples = atoi(optarg);
+	    if (num_samples <= 0) {
+		num_samples = SCOPE_NUM_SAMPLES_DEFAULT;
+	    }
+	    break;
+	case 'h':
+	default:
+	    usage();
+	    return 1;
+	}
+    }
+
+    /* connect to the HAL */
+    comp_id = hal_init("halscope-cli");
+    if (comp_id < 0) {
+	fprintf(stderr, "halscope-cli: ERROR: hal_init() failed\n");
+	return 1;
+    }
+    /* from here on, exit through exit_from_hal() */
+    atexit(exit_from_hal);
+    signal(SIGINT, quit);
+    signal(SIGTERM, quit);
+    signal(SIGPIPE, quit);
+
+    if (!halpr_find_funct_by_name("scope.sample")) {
+	char buf[1000];
+	snprintf(buf, sizeof(buf),
+	    EMC2_BIN_DIR "/halcmd loadrt scope_rt num_samples=%d", num_samples);
+	if (system(buf) != 0) {
+	    fprintf(stderr, "halscope-cli: ERROR: loadrt scope_rt failed\n");
+	    return 1;
+	}
+    }
+    /* attach to the shared memory region set up by scope_rt */
+    shm_id = rtapi_shmem_new(SCOPE_SHM_KEY, comp_id, 0);
+    if (shm_id < 0) {
+	fprintf(stderr, "halscope-cli: ERROR: failed to get shared memory\n");
+	return 1;
+    }
+    retval = rtapi_shmem_getptr(shm_id, &shm_base);
+    if (retval < 0) {
+	fprintf(stderr, "halscope-cli: ERROR: failed to map shared memory\n");
+	return 1;
+    }
+    ctrl_shm = shm_base;
+    if (ctrl_shm->shm_size == 0) {
+	fprintf(stderr, "halscope-cli: ERROR: realtime component not loaded?\n");
+	return 1;
+    }
+    /* round size of shared struct up to a multiple of 4 for alignment */
+    skip = (sizeof(scope_shm_control_t) + 3) & ~3;
+    shm_buffer = (scope_data_t *) (((char *) (shm_base)) + skip);
+    if ((ctrl_shm->state != IDLE) || (ctrl_shm->thread_name[0] != '\0')) {
+	fprintf(stderr, "halscope-cli: ERROR: scope_rt is in use "
+	    "(is halscope running?)\n");
+	/* don't touch the other client's setup on the way out */
+	ctrl_shm = NULL;
+	return 1;
+    }
+    hal_ready(comp_id);
+
+    /* setup from config file first, command line overrides it */
+    if (ifilename != NULL) {
+	if (read_config_file(ifilename) < 0) {
+	    return 1;
+	}
+    }
+    for (n = optind; n < argc; n++) {
+	if (add_source(argv[n]) < 0) {
+	    return 1;
+	}
+    }
+    if (opt_thread[0] != '\0') {
+	strcpy(thread_name, opt_thread);
+    }
+    if (opt_mult > 0) {
+	mult = opt_mult;
+    }
+    if (opt_sample_len > 0) {
+	sample_len = opt_sample_len;
+    }
+    if (opt_trig_chan >= 0) {
+	trig_chan = opt_trig_chan;
+    }
+    if (opt_trig_edge >= 0) {
+	trig_edge = opt_trig_edge;
+    }
+    if (opt_auto_trig >= 0) {
+	auto_trig = opt_auto_trig;
+    }
+    if (opt_trig_pos >= 0.0) {
+	trig_pos = opt_trig_pos;
+    }
+    if (setup_capture() < 0) {
+	return 1;
+    }
+
+    if (ofilename != NULL) {
+	fp = fopen(ofilename, (fmt == FMT_BINARY) ? "wb" : "w");
+	if (fp == NULL) {
+	    fprintf(stderr, "halscope-cli: output file '%s' could not be "
+		"created\n", ofilename);
+	    return 1;
+	}
+    } else {
+	fp = stdout;
+    }
+    write_header(fp, fmt);
+
+    /* the RT code stops sampling when a record is complete, so there
+       is a gap between records, until the next start_capture() */
+    count = 0;
+    while (!done && ((captures == 0) || (count < captures))) {
+	if (start_capture() < 0) {
+	    break;
+	}
+	retval = wait_capture();
+	if (retval < 0) {
+	    break;
+	}
+	if (retval == 0) {
+	    /* interrupted */
+	    continue;
+	}
+	write_capture(fp, fmt, count, copy_capture());
+	count++;
+    }
+    if (fp != stdout) {
+	fclose(fp);
+    } else {
+	fflush(fp);
+    }
+    if ((captures != 0) && (count < captures)) {
+	return 1;
+    }
+    return 0;
+}
+
+/***********************************************************************
+*                    LOCAL CALLBACK FUNCTION CODE                      *
+************************************************************************/
+
+static void quit(int sig)
+{
+    done = 1;
+}
+
+static void exit_from_hal(void)
+{
+    if (ctrl_shm != NULL) {
+	if (ctrl_shm->state != IDLE) {
+	    /* RT code is sampling, tell it to stop */
+	    ctrl_shm->state = RESET;
+	}
+	if (thread_attached) {
+	    hal_del_funct_from_thread("scope.sample", ctrl_shm->thread_name);
+	    ctrl_shm->thread_name[0] = '\0';
+	}
+    }
+    if (shm_id >= 0) {
+	rtapi_shmem_delete(shm_id, comp_id);
+    }
+    if (comp_id >= 0) {
+	hal_exit(comp_id);
+    }
+    free(cap_buf);
+}
+
+/***********************************************************************
+*                      CHANNEL AND TRIGGER SETUP                       *
+************************************************************************/
+
+/* parses 'pin:name', 'sig:name', 'param:name' or a bare 'name'.
+   A bare name is looked up as a pin first, then a signal, then a
+   parameter.  The source goes to the first unassigned channel.
+*/
+static int add_source(char *arg)
+{
+    int n, chan_num;
+
+    chan_num = 0;
+    for (n = 0; n < 16; n++) {
+	if (chans[n].source_type < 0) {
+	    chan_num = n + 1;
+	    break;
+	}
+    }
+    if (chan_num == 0) {
+	fprintf(stderr, "halscope-cli: too many channels\n");
+	return -1;
+    }
+    if (strncmp(arg, "pin:", 4) == 0) {
+	n = set_channel_source(chan_num, 0, arg + 4);
+    } else if (strncmp(arg, "sig:", 4) == 0) {
+	n = set_channel_source(chan_num, 1, arg + 4);
+    } else if (strncmp(arg, "param:", 6) == 0) {
+	n = set_channel_source(chan_num, 2, arg + 6);
+    } else {
+	n = set_channel_source(chan_num, 0, arg);
+	if (n < 0) {
+	    n = set_channel_source(chan_num, 1, arg);
+	}
+	if (n < 0) {
+	    n = set_channel_source(chan_num, 2, arg);
+	}
+    }
+    if (n < 0) {
+	fprintf(stderr, "halscope-cli: '%s' not found\n", arg);
+	return -1;
+    }
+    return 0;
+}
+
+static int set_channel_source(int chan_num, int type, char *name)
+{
+    cli_chan_t *chan;
+    hal_pin_t *pin;
+    hal_sig_t *sig;
+    hal_param_t *param;
+    hal_type_t data_type;
+
+    if ((chan_num < 1) || (chan_num > 16)) {
+	return -1;
+    }
+    chan = &(chans[chan_num - 1]);
+    rtapi_mutex_get(&(hal_data->mutex));
+    if (type == 0) {
+	pin = halpr_find_pin_by_name(name);
+	if (pin == NULL) {
+	    rtapi_mutex_give(&(hal_data->mutex));
+	    return -1;
+	}
+	data_type = pin->type;
+    } else if (type == 1) {
+	sig = halpr_find_sig_by_name(name);
+	if (sig == NULL) {
+	    rtapi_mutex_give(&(hal_data->mutex));
+	    return -1;
+	}
+	data_type = sig->type;
+    } else if (type == 2) {
+	param = halpr_find_param_by_name(name);
+	if (param == NULL) {
+	    rtapi_mutex_give(&(hal_data->mutex));
+	    return -1;
+	}
+	data_type = param->type;
+    } else {
+	rtapi_mutex_give(&(hal_data->mutex));
+	return -1;
+    }
+    rtapi_mutex_give(&(hal_data->mutex));
+    chan->source_type = type;
+    strncpy(chan->name, name, HAL_NAME_LEN);
+    chan->name[HAL_NAME_LEN] = '\0';
+    chan->data_type = data_type;
+    switch (data_type) {
+    case HAL_BIT:
+	chan->data_len = sizeof(hal_bit_t);
+	break;
+    case HAL_FLOAT:
+	chan->data_len = sizeof(hal_float_t);
+	break;
+    case HAL_S32:
+	chan->data_len = sizeof(hal_s32_t);
+	break;
+    case HAL_U32:
+	chan->data_len = sizeof(hal_u32_t);
+	break;
+    default:
+	chan->data_len = 0;
+	break;
+    }
+    chan->scale_index = 0;
+    chan->position = 0.5;
+    chan->vert_offset = 0.0;
+    return 0;
+}
+
+/* same scaling as set_vert_scale() in scope_vert.c */
+static double chan_scale(cli_chan_t *chan)
+{
+    double scale;
+    int index;
+
+    scale = 1.0;
+    index = chan->scale_index;
+    while (index >= 3) {
+	scale *= 10.0;
+	index -= 3;
+    }
+    while (index <= -3) {
+	scale *= 0.1;
+	index += 3;
+    }
+    switch (index) {
+    case 2:
+	scale *= 5.0;
+	break;
+    case 1:
+	scale *= 2.0;
+	break;
+    case -1:
+	scale *= 0.5;
+	break;
+    case -2:
+	scale *= 0.2;
+	break;
+    default:
+	break;
+    }
+    return scale;
+}
+
+static void set_trigger_level(void)
+{
+    cli_chan_t *chan;
+    double fp_level;
+
+    chan = &(chans[trig_chan - 1]);
+    if (have_trig_abs) {
+	fp_level = trig_level_abs;
+    } else {
+	/* same conversion as refresh_trigger() in scope_trig.c */
+	fp_level = chan_scale(chan) * ((chan->position - trig_level_rel) * 10)
+	    + chan->vert_offset;
+    }
+    switch (chan->data_type) {
+    case HAL_FLOAT:
+	ctrl_shm->trig_level.d_real = fp_level;
+	break;
+    case HAL_S32:
+	if (fp_level > 2147483647.0) {
+	    fp_level = 2147483647.0;
+	}
+	if (fp_level < -2147483648.0) {
+	    fp_level = -2147483648.0;
+	}
+	ctrl_shm->trig_level.d_s32 = fp_level;
+	break;
+    case HAL_U32:
+	if (fp_level > 4294967295.0) {
+	    fp_level = 4294967295.0;
+	}
+	if (fp_level < 0.0) {
+	    fp_level = 0.0;
+	}
+	ctrl_shm->trig_level.d_u32 = fp_level;
+	break;
+    default:
+	break;
+    }
+}
+
+/* validates the setup, copies it to shared memory, and hooks the
+   sample function to the thread */
+static int setup_capture(void)
+{
+    hal_thread_t *thread;
+    long max_mult;
+    int n, count, retval;
+
+    count = 0;
+    for (n = 0; n < 16; n++) {
+	if (chans[n].source_type >= 0) {
+	    count++;
+	}
+    }
+    if (count == 0) {
+	fprintf(stderr, "halscope-cli: no channels to capture\n");
+	return -1;
+    }
+    if (sample_len == 0) {
+	/* smallest record width that holds all channels */
+	sample_len = 1;
+	while (sample_len < count) {
+	    sample_len <<= 1;
+	}
+    } else if (count > sample_len) {
+	fprintf(stderr, "halscope-cli: %d channels do not fit in a sample "
+	    "of %d\n", count, sample_len);
+	return -1;
+    }
+    if ((trig_chan != 0) && (chans[trig_chan - 1].source_type < 0)) {
+	fprintf(stderr, "halscope-cli: trigger channel %d has no source\n",
+	    trig_chan);
+	return -1;
+    }
+    if (thread_name[0] == '\0') {
+	fprintf(stderr, "halscope-cli: no sample thread specified\n");
+	return -1;
+    }
+    rtapi_mutex_get(&(hal_data->mutex));
+    thread = halpr_find_thread_by_name(thread_name);
+    if (thread != NULL) {
+	thread_period_ns = thread->period;
+    }
+    rtapi_mutex_give(&(hal_data->mutex));
+    if (thread == NULL) {
+	fprintf(stderr, "halscope-cli: thread '%s' not found\n", thread_name);
+	return -1;
+    }
+    /* keep sample period <= 1 sec, same as the GUI */
+    max_mult = 1000000000 / thread_period_ns;
+    if (max_mult > 1000) {
+	max_mult = 1000;
+    }
+    if (mult > max_mult) {
+	mult = max_mult;
+    }
+
+    ctrl_shm->mult = mult;
+    ctrl_shm->sample_len = sample_len;
+    ctrl_shm->rec_len = ctrl_shm->buf_len / ctrl_shm->sample_len;
+    ctrl_shm->pre_trig = (ctrl_shm->rec_len - 2) * trig_pos;
+    ctrl_shm->trig_chan = trig_chan;
+    ctrl_shm->trig_edge = trig_edge;
+    ctrl_shm->auto_trig = auto_trig;
+    if (trig_chan != 0) {
+	set_trigger_level();
+    }
+    cap_buf = malloc(sizeof(scope_data_t) * ctrl_shm->buf_len);
+    if (cap_buf == NULL) {
+	fprintf(stderr, "halscope-cli: out of memory\n");
+	return -1;
+    }
+
+    retval = hal_add_funct_to_thread("scope.sample", thread_name, -1);
+    if (retval < 0) {
+	fprintf(stderr, "halscope-cli: could not add scope.sample to "
+	    "thread '%s'\n", thread_name);
+	return -1;
+    }
+    thread_attached = 1;
+    strncpy(ctrl_shm->thread_name, thread_name, HAL_NAME_LEN);
+    ctrl_shm->thread_name[HAL_NAME_LEN] = '\0';
+    ctrl_shm->watchdog = 0;
+    return 0;
+}
+
+/***********************************************************************
+*                          CAPTURE FUNCTIONS                           *
+************************************************************************/
+
+/* same as start_capture() in scope.c, minus the GUI state */
+static int start_capture(void)
+{
+    int n;
+    hal_pin_t *pin;
+    hal_sig_t *sig;
+    hal_param_t *param;
+    cli_chan_t *chan;
+
+    if (ctrl_shm->state != IDLE) {
+	return -1;
+    }
+    rtapi_mutex_get(&(hal_data->mutex));
+    for (n = 0; n < 16; n++) {
+	chan = &(chans[n]);
+	ctrl_shm->data_len[n] = 0;
+	if (chan->source_type < 0) {
+	    continue;
+	}
+	/* re-resolve the source, it may have been relinked or deleted */
+	if (chan->source_type == 0) {
+	    pin = halpr_find_pin_by_name(chan->name);
+	    if (pin == NULL) {
+		break;
+	    }
+	    if (pin->signal == 0) {
+		/* pin is unlinked, get data from dummysig */
+		ctrl_shm->data_offset[n] = SHMOFF(&(pin->dummysig));
+	    } else {
+		sig = SHMPTR(pin->signal);
+		ctrl_shm->data_offset[n] = sig->data_ptr;
+	    }
+	} else if (chan->source_type == 1) {
+	    sig = halpr_find_sig_by_name(chan->name);
+	    if (sig == NULL) {
+		break;
+	    }
+	    ctrl_shm->data_offset[n] = sig->data_ptr;
+	} else {
+	    param = halpr_find_param_by_name(chan->name);
+	    if (param == NULL) {
+		break;
+	    }
+	    ctrl_shm->data_offset[n] = param->data_ptr;
+	}
+	ctrl_shm->data_type[n] = chan->data_type;
+	ctrl_shm->data_len[n] = chan->data_len;
+    }
+    rtapi_mutex_give(&(hal_data->mutex));
+    if (n < 16) {
+	fprintf(stderr, "halscope-cli: channel %d source '%s' has been "
+	    "deleted\n", n + 1, chans[n].name);
+	return -1;
+    }
+    ctrl_shm->state = INIT;
+    return 0;
+}
+
+/* waits for the RT code to finish a record.  Returns 1 when the
+   capture is done, 0 if interrupted by a signal, -1 if the realtime
+   part of the scope stopped running */
+static int wait_capture(void)
+{
+    struct timespec delay;
+    long poll_ns, idle_ns;
+
+    /* poll about ten times per record, between 1 and 10 mS */
+    poll_ns = (thread_period_ns * ctrl_shm->mult * ctrl_shm->rec_len) / 10;
+    if (poll_ns < 1000000) {
+	poll_ns = 1000000;
+    }
+    if (poll_ns > 10000000) {
+	poll_ns = 10000000;
+    }
+    idle_ns = 0;
+    while (ctrl_shm->state != DONE) {
+	if (done) {
+	    return 0;
+	}
+	/* RT code clears the watchdog every time it runs */
+	if (ctrl_shm->watchdog == 0) {
+	    idle_ns = 0;
+	}
+	ctrl_shm->watchdog = 1;
+	delay.tv_sec = 0;
+	delay.tv_nsec = poll_ns;
+	nanosleep(&delay, NULL);
+	idle_ns += poll_ns;
+	if ((ctrl_shm->watchdog != 0) &&
+	    (idle_ns > 1000000000 + 2 * thread_period_ns * ctrl_shm->mult)) {
+	    fprintf(stderr, "halscope-cli: realtime sample function is not "
+		"running (is thread '%s' started?)\n", thread_name);
+	    return -1;
+	}
+    }
+    return 1;
+}
+
+/* copies the record out of the shared ring buffer and releases the
+   RT code for the next capture.  Returns the number of samples. */
+static int copy_capture(void)
+{
+    scope_data_t *src, *dst, *src_end;
+    int n, samples, samp_len, samp_size;
+
+    samples = ctrl_shm->samples;
+    samp_len = ctrl_shm->sample_len;
+    samp_size = samp_len * sizeof(scope_data_t);
+    dst = cap_buf;
+    src = shm_buffer + ctrl_shm->start;
+    src_end = shm_buffer + (ctrl_shm->rec_len * samp_len);
+    for (n = 0; n < samples; n++) {
+	memcpy(dst, src, samp_size);
+	dst += samp_len;
+	src += samp_len;
+	if (src >= src_end) {
+	    src = shm_buffer;
+	}
+    }
+    ctrl_shm->state = IDLE;
+    return samples;
+}
+
+/***********************************************************************
+*                           OUTPUT FUNCTIONS                           *
+************************************************************************/
+
+static void write_u32(FILE *fp, __u32 val)
+{
+    fwrite(&val, sizeof(val), 1, fp);
+}
+
+static void write_header(FILE *fp, out_format_t fmt)
+{
+    int n, count;
+    char name[HAL_NAME_LEN + 1];
+
+    if (fmt == FMT_CSV) {
+	fprintf(fp, "capture,sample,time");
+	for (n = 0; n < 16; n++) {
+	    if (chans[n].source_type >= 0) {
+		fprintf(fp, ",%s", chans[n].name);
+	    }
+	}
+	fprintf(fp, "\n");
+	return;
+    }
+    count = 0;
+    for (n = 0; n < 16; n++) {
+	if (chans[n].source_type >= 0) {
+	    count++;
+	}
+    }
+    fwrite(HSCB_MAGIC, 4, 1, fp);
+    write_u32(fp, HSCB_VERSION);
+    write_u32(fp, count);
+    write_u32(fp, thread_period_ns * ctrl_shm->mult);
+    for (n = 0; n < 16; n++) {
+	if (chans[n].source_type >= 0) {
+	    write_u32(fp, chans[n].data_type);
+	    memset(name, 0, sizeof(name));
+	    strncpy(name, chans[n].name, HAL_NAME_LEN);
+	    fwrite(name, sizeof(name), 1, fp);
+	}
+    }
+}
+
+static void write_capture(FILE *fp, out_format_t fmt, int count, int samples)
+{
+    scope_data_t *dptr;
+    double period, t0;
+    unsigned char b;
+    int n, s, chan, samp_len, pre_trig;
+
+    samp_len = ctrl_shm->sample_len;
+    /* the RT code discards pre-trigger samples while waiting, so
+       the number of samples before the trigger is always pre_trig */
+    pre_trig = ctrl_shm->pre_trig;
+    if (pre_trig > samples) {
+	pre_trig = samples;
+    }
+    if (fmt == FMT_BINARY) {
+	write_u32(fp, count);
+	write_u32(fp, samples);
+	write_u32(fp, pre_trig);
+    }
+    period = thread_period_ns * ctrl_shm->mult * 1e-9;
+    t0 = -pre_trig * period;
+    for (s = 0; s < samples; s++) {
+	dptr = cap_buf + s * samp_len;
+	if (fmt == FMT_CSV) {
+	    fprintf(fp, "%d,%d,%.9f", count, s, t0 + s * period);
+	}
+	/* acquired channels are packed in channel order */
+	for (chan = 0, n = 0; chan < 16; chan++) {
+	    if (ctrl_shm->data_len[chan] == 0) {
+		continue;
+	    }
+	    if (fmt == FMT_CSV) {
+		switch (chans[chan].data_type) {
+		case HAL_BIT:
+		    fprintf(fp, ",%d", dptr[n].d_u8 ? 1 : 0);
+		    break;
+		case HAL_FLOAT:
+		    fprintf(fp, ",%.14g", (double) dptr[n].d_real);
+		    break;
+		case HAL_S32:
+		    fprintf(fp, ",%ld", (long) dptr[n].d_s32);
+		    break;
+		case HAL_U32:
+		    fprintf(fp, ",%lu", (unsigned long) dptr[n].d_u32);
+		    break;
+		default:
+		    fprintf(fp, ",");
+		    break;
+		}
+	    } else {
+		switch (chans[chan].data_type) {
+		case HAL_BIT:
+		    b = dptr[n].d_u8 ? 1 : 0;
+		    fwrite(&b, 1, 1, fp);
+		    break;
+		case HAL_FLOAT:
+		    fwrite(&(dptr[n].d_real), sizeof(real_t), 1, fp);
+		    break;
+		case HAL_S32:
+		    fwrite(&(dptr[n].d_s32), sizeof(__s32), 1, fp);
+		    break;
+		case HAL_U32:
+		    fwrite(&(dptr[n].d_u32), sizeof(__u32), 1, fp);
+		    break;
+		default:
+		    break;
+		}
+	    }
+	    n++;
+	}
+	if (fmt == FMT_CSV) {
+	    fprintf(fp, "\n");
+	}
+    }
+    fflush(fp);
+}
+
+/***********************************************************************
+*                         CONFIG FILE READER                           *
+************************************************************************/
+
+/* Reads the subset of the '.halscope' commands (see scope_files.c)
+   that affect acquisition.  Display-only commands (HZOOM, HPOS,
+   RMODE) are accepted and ignored.  VSCALE, VPOS and VOFF are kept
+   only to convert a saved TLEVEL into a trigger value.
+*/
+static int read_config_file(char *filename)
+{
+    FILE *fp;
+    char buf[100];
+    char *cp, *arg;
+    int warnings, n;
+    int deferred_chan;
+
+    fp = fopen(filename, "r");
+    if (fp == NULL) {
+	fprintf(stderr, "halscope-cli: config file '%s' could not be "
+	    "opened\n", filename);
+	return -1;
+    }
+    warnings = 0;
+    deferred_chan = 0;
+    while (fgets(buf, sizeof(buf), fp) != NULL) {
+	/* remove trailing newline if present */
+	cp = buf;
+	while ((*cp != '\n') && (*cp != '\0')) {
+	    cp++;
+	}
+	*cp = '\0';
+	/* split keyword and argument */
+	cp = buf;
+	while (isspace(*cp)) {
+	    cp++;
+	}
+	if ((*cp == '\0') || (*cp == '#')) {
+	    continue;
+	}
+	arg = cp;
+	while ((*arg != '\0') && !isspace(*arg)) {
+	    arg++;
+	}
+	if (*arg != '\0') {
+	    *arg++ = '\0';
+	    while (isspace(*arg)) {
+		arg++;
+	    }
+	}
+	if (strcasecmp(cp, "thread") == 0) {
+	    strncpy(thread_name, arg, HAL_NAME_LEN);
+	    thread_name[HAL_NAME_LEN] = '\0';
+	} else if (strcasecmp(cp, "maxchan") == 0) {
+	    sample_len = atoi(arg);
+	    if ((sample_len < 1) || (sample_len > 16) ||
+		(sample_len & (sample_len - 1))) {
+		sample_len = 0;
+	    }
+	} else if (strcasecmp(cp, "hmult") == 0) {
+	    mult = atoi(arg);
+	    if (mult < 1) {
+		mult = 1;
+	    }
+	} else if (strcasecmp(cp, "chan") == 0) {
+	    n = atoi(arg);
+	    if ((n < 1) || (n > 16)) {
+		fprintf(stderr, "halscope-cli: illegal channel number: "
+		    "'%s'\n", arg);
+		warnings++;
+		continue;
+	    }
+	    selected_chan = n;
+	    deferred_chan = (chans[n - 1].source_type < 0) ? n : 0;
+	} else if ((strcasecmp(cp, "pin") == 0) ||
+	    (strcasecmp(cp, "sig") == 0) ||
+	    (strcasecmp(cp, "param") == 0)) {
+	    n = (tolower(cp[0]) == 'p') ? ((tolower(cp[1]) == 'i') ? 0 : 2) : 1;
+	    if (set_channel_source(selected_chan, n, arg) < 0) {
+		fprintf(stderr, "halscope-cli: object not found: '%s %s'\n",
+		    cp, arg);
+		warnings++;
+	    }
+	    deferred_chan = 0;
+	} else if (strcasecmp(cp, "choff") == 0) {
+	    if ((deferred_chan == 0) && (selected_chan > 0)) {
+		chans[selected_chan - 1].source_type = -1;
+	    }
+	    deferred_chan = 0;
+	} else if (strcasecmp(cp, "vscale") == 0) {
+	    if (selected_chan > 0) {
+		chans[selected_chan - 1].scale_index = atoi(arg);
+	    }
+	} else if (strcasecmp(cp, "vpos") == 0) {
+	    if (selected_chan > 0) {
+		chans[selected_chan - 1].position = strtod(arg, NULL);
+	    }
+	} else if ((strcasecmp(cp, "voff") == 0) ||
+	    (strcasecmp(cp, "vac") == 0)) {
+	    if (selected_chan > 0) {
+		chans[selected_chan - 1].vert_offset = strtod(arg, NULL);
+	    }
+	} else if (strcasecmp(cp, "tsource") == 0) {
+	    trig_chan = atoi(arg);
+	    if ((trig_chan < 0) || (trig_chan > 16)) {
+		trig_chan = 0;
+	    }
+	} else if (strcasecmp(cp, "tlevel") == 0) {
+	    trig_level_rel = strtod(arg, NULL);
+	} else if (strcasecmp(cp, "tpos") == 0) {
+	    trig_pos = strtod(arg, NULL);
+	    if ((trig_pos < 0.0) || (trig_pos > 1.0)) {
+		trig_pos = 0.5;
+	    }
+	} else if (strcasecmp(cp, "tpolar") == 0) {
+	    trig_edge = atoi(arg) ? 1 : 0;
+	} else if (strcasecmp(cp, "tmode") == 0) {
+	    auto_trig = atoi(arg) ? 1 : 0;
+	} else if ((strcasecmp(cp, "hzoom") == 0) ||
+	    (strcasecmp(cp, "hpos") == 0) ||
+	    (strcasecmp(cp, "rmode") == 0)) {
+	    /* display settings, nothing to do */
+	} else {
+	    fprintf(stderr, "halscope-cli: unknown config command: '%s'\n",
+		cp);
+	    warnings++;
+	}
+    }
+    fclose(fp);
+    if (warnings > 0) {
+	fprintf(stderr, "halscope-cli: config file '%s' caused %d "
+	    "warnings\n", filename, warnings);
+    }
+    return 0;
+}
@@ -48,6 +48,10 @@ typedef struct {
     unsigned long minfault_base;
     unsigned long majfault_base;
     unsigned int failures;
+
+    /* Simulated time */
+    long long sim_release;  // release point the thread waits for, nS
+    int sim_queued;         // waiting for its turn
 } extra_task_data_t;
 
 extra_task_data_t extra_task_data[RTAPI_MAX_TASKS + 1];
@@ -183,6 +187,75 @@ static void _rtapi_advance_time(struct timespec *tv, unsigned long ns,
     tv->tv_sec += s;
 }
 
+#if defined(RTAPI) && defined(RTAPI_POSIX)
+/* Simulated time: with global_data->rt_sim_time set, threads don't
+   sleep, they take turns on the simulated clock global_data->sim_clock.
+   A thread waiting for its release point is queued, and whenever no
+   thread runs, the queued one with the earliest release point runs, the
+   one of highest priority if several are due at once, and the clock
+   jumps to its release point.  So the threads run one at a time, in the
+   order they would run on one CPU, as fast as that CPU allows, and a
+   run is the same each time. */
+static pthread_mutex_t sim_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sim_cond = PTHREAD_COND_INITIALIZER;
+static int sim_running;  // task running on the simulated clock, 0 for none
+
+/* with sim_lock held: let the next thread run, unless one is running */
+static void _rtapi_sim_schedule(void) {
+    int n, next = 0;
+
+    if (sim_running)
+	return;
+    for (n = 1; n <= RTAPI_MAX_TASKS; n++) {
+	if (!extra_task_data[n].sim_queued)
+	    continue;
+	if (!next
+	    || extra_task_data[n].sim_release < extra_task_data[next].sim_release
+	    || (extra_task_data[n].sim_release == extra_task_data[next].sim_release
+		&& task_array[n].prio > task_array[next].prio))
+	    next = n;
+    }
+    if (!next)
+	return;
+    if (extra_task_data[next].sim_release > global_data->sim_clock)
+	global_data->sim_clock = extra_task_data[next].sim_release;
+    extra_task_data[next].sim_queued = 0;
+    sim_running = next;
+    pthread_cond_broadcast(&sim_cond);
+}
+
+/* with sim_lock held: queue a task for release point 'release' */
+static void _rtapi_sim_queue(int task_id, long long release) {
+    extra_task_data[task_id].sim_release = release;
+    extra_task_data[task_id].sim_queued = 1;
+    if (sim_running == task_id)
+	sim_running = 0;
+    _rtapi_sim_schedule();
+}
+
+/* queue the calling thread for release point 'release', and return
+   when it is its turn, or when the task is deleted */
+static void _rtapi_sim_wait(int task_id, long long release) {
+    pthread_mutex_lock(&sim_lock);
+    if (release >= 0)
+	_rtapi_sim_queue(task_id, release);
+    while (sim_running != task_id && !extra_task_data[task_id].deleted)
+	pthread_cond_wait(&sim_cond, &sim_lock);
+    pthread_mutex_unlock(&sim_lock);
+}
+
+/* take an exiting thread off the simulated clock */
+static void _rtapi_sim_leave(int task_id) {
+    pthread_mutex_lock(&sim_lock);
+    extra_task_data[task_id].sim_queued = 0;
+    if (sim_running == task_id) {
+	sim_running = 0;
+	_rtapi_sim_schedule();
+    }
+    pthread_mutex_unlock(&sim_lock);
+}
+#endif
+
 static void rtapi_key_alloc() {
     pthread_key_create(&task_key, NULL);
 }
@@ -232,6 +305,14 @@ void _rtapi_task_delete_hook(task_data *task, int task_id) {
     /* Signal thread termination and wait for the thread to exit. */
     if (!extra_task_data[task_id].deleted) {
 	extra_task_data[task_id].deleted = 1;
+#ifdef RTAPI_POSIX
+	if (global_data->rt_sim_time) {
+	    // wake it if it waits for its turn on the simulated clock
+	    pthread_mutex_lock(&sim_lock);
+	    pthread_cond_broadcast(&sim_cond);
+	    pthread_mutex_unlock(&sim_lock);
+	}
+#endif
 	err = pthread_join(extra_task_data[task_id].thread, &returncode);
 	if (err)
 	    rtapi_print_msg
@@ -364,6 +445,17 @@ static void *realtime_thread(void *arg) {
 	}
     }
 
+#ifdef RTAPI_POSIX
+    // the task was queued when it was started; wait for its turn
+    if (global_data->rt_sim_time) {
+	_rtapi_sim_wait(task_id(task), -1);
+	if (extra_task_data[task_id(task)].deleted) {
+	    _rtapi_sim_leave(task_id(task));
+	    return NULL;
+	}
+    }
+#endif
+
     /* call the task function with the task argument */
     task->taskcode(task->arg);
 
@@ -372,11 +464,19 @@ static void *realtime_thread(void *arg) {
 	 "ERROR: reached end of realtime thread for task %d\n",
 	 task_id(task));
     extra_task_data[task_id(task)].deleted = 1;
+#ifdef RTAPI_POSIX
+    if (global_data->rt_sim_time)
+	_rtapi_sim_leave(task_id(task));
+#endif
 
     return NULL;
  error:
     /* Signal that we're dead and open the barrier. */
     extra_task_data[task_id(task)].deleted = 1;
+#ifdef RTAPI_POSIX
+    if (global_data->rt_sim_time)
+	_rtapi_sim_leave(task_id(task));
+#endif
     pthread_barrier_wait(&extra_task_data[task_id(task)].thread_init_barrier);
     return NULL;
 }
@@ -387,6 +487,21 @@ int _rtapi_task_start_hook(task_data *task, int task_id) {
 
     extra_task_data[task_id].deleted = 0;
 
+#ifdef RTAPI_POSIX
+    // queue the task before it exists, so that the clock waits for it
+    // to start; its release points are multiples of its period, so
+    // that the threads run in the same order whenever they are started
+    if (global_data->rt_sim_time) {
+	long long p = task->period > period ? task->period : period;
+
+	if (p < 1)
+	    p = 1;
+	pthread_mutex_lock(&sim_lock);
+	_rtapi_sim_queue(task_id, (global_data->sim_clock + p - 1) / p * p);
+	pthread_mutex_unlock(&sim_lock);
+    }
+#endif
+
     pthread_barrier_init(&extra_task_data[task_id].thread_init_barrier,
 			 NULL, 2);
     pthread_attr_init(&attr);
@@ -401,6 +516,10 @@ int _rtapi_task_start_hook(task_data *task, int task_id) {
     if (retval) {
 	pthread_barrier_destroy
 	    (&extra_task_data[task_id].thread_init_barrier);
+#ifdef RTAPI_POSIX
+	if (global_data->rt_sim_time)
+	    _rtapi_sim_leave(task_id);
+#endif
 	rtapi_print_msg(RTAPI_MSG_ERR, "Failed to create realtime thread\n");
 	return -ENOMEM;
     }
@@ -423,30 +542,87 @@ void _rtapi_task_stop_hook(task_data *task, int task_id) {
     extra_task_data[task_id].destroyed = 1;
 }
 
+/* nS from a to b, negative if b is before a */
+static inline long _rtapi_timespec_diff(const struct timespec *a,
+					const struct timespec *b) {
+    return (b->tv_sec - a->tv_sec) * 1000000000L + (b->tv_nsec - a->tv_nsec);
+}
+
+/* count a wakeup 'latency' nS after the release point in the histogram */
+static void _rtapi_record_latency(rtapi_threadstatus_t *ts, long latency,
+				  int margin) {
+    unsigned long us = latency > 0 ? latency / 1000 : 0;
+    int bucket = 0;
+
+    while (us && bucket < RTAPI_LATENCY_BUCKETS - 1) {
+	us >>= 1;
+	bucket++;
+    }
+    ts->flavor.rtpreempt.latency_hist[bucket]++;
+    if (latency > ts->flavor.rtpreempt.latency_max)
+	ts->flavor.rtpreempt.latency_max = latency;
+    ts->flavor.rtpreempt.spin_margin = margin;
+}
+
 int _rtapi_wait_hook(void) {
-    struct timespec ts;
+    struct timespec now;
     task_data *task = rtapi_this_task();
-
-    if (extra_task_data[task_id(task)].deleted)
+    extra_task_data_t *extra = &extra_task_data[task_id(task)];
+    rtapi_threadstatus_t *ts = &global_data->thread_status[task_id(task)];
+    int margin = global_data->rt_spin_margin;
+
+    if (extra->deleted) {
+#ifdef RTAPI_POSIX
+	if (global_data->rt_sim_time)
+	    _rtapi_sim_leave(task_id(task));
+#endif
 	pthread_exit(0);
+    }
 
-    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
-		    &extra_task_data[task_id(task)].next_time, NULL);
-    _rtapi_advance_time(&extra_task_data[task_id(task)].next_time,
-		       task->period, 0);
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    if (ts.tv_sec > extra_task_data[task_id(task)].next_time.tv_sec
-	|| (ts.tv_sec == extra_task_data[task_id(task)].next_time.tv_sec
-	    && ts.tv_nsec > extra_task_data[task_id(task)].next_time.tv_nsec)) {
+#ifdef RTAPI_POSIX
+    if (global_data->rt_sim_time) {
+	// no sleeping and no deadlines: the clock waits for the threads
+	_rtapi_sim_wait(task_id(task), extra->sim_release + task->period);
+	if (extra->deleted) {
+	    _rtapi_sim_leave(task_id(task));
+	    pthread_exit(0);
+	}
+	return 0;
+    }
+#endif
+
+    if (margin > 0 && margin < task->period) {
+	// hybrid wait: the scheduler wakes the thread up to the margin
+	// early, and it spins the rest of the way, which takes the
+	// scheduler's wakeup latency out of the jitter
+	struct timespec wakeup = extra->next_time;
+
+	wakeup.tv_nsec -= margin;
+	while (wakeup.tv_nsec < 0) {
+	    wakeup.tv_nsec += 1000000000;
+	    wakeup.tv_sec--;
+	}
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeup, NULL);
+	do {
+	    clock_gettime(CLOCK_MONOTONIC, &now);
+	} while (_rtapi_timespec_diff(&extra->next_time, &now) < 0);
+    } else {
+	margin = 0;
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+			&extra->next_time, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+    }
+    _rtapi_record_latency(ts, _rtapi_timespec_diff(&extra->next_time, &now),
+			  margin);
+
+    _rtapi_advance_time(&extra->next_time, task->period, 0);
+    if (_rtapi_timespec_diff(&extra->next_time, &now) > 0) {
 
 	// timing went wrong:
 
 	// update stats counters in thread status
 	_rtapi_task_update_stats_hook();
 
-	rtapi_threadstatus_t *ts =
-	    &global_data->thread_status[task_id(task)];
-
 	ts->flavor.rtpreempt.wait_errors++;
 
 	rtapi_exception_detail_t detail = {0};
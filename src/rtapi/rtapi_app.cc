@@ -45,6 +45,7 @@
 #include <assert.h>
 #include <syslog.h>
 #include <limits.h>
+#include <pthread.h>
 
 #include <sys/mman.h>
 #include <sys/prctl.h>
@@ -74,6 +75,22 @@ template<class T> T DLSYM(void *handle, const char *name) {
 }
 
 static std::map<string, void*> modules;
+
+// startup profile: what loading each module took
+struct load_profile {
+    string name;
+    double dlopen_ms;	// dlopen() and setting parameters
+    double main_ms;	// rtapi_app_main()
+    int result;
+};
+static vector<load_profile> load_profiles;
+
+// the per-module status of a loadbatch, and the profile lines of a
+// profile command, which master sends to slave after the result
+static vector<string> reply_lines;
+
+// how many module files loadbatch reads ahead at a time
+#define PREFETCH_THREADS 4
 static struct rusage rusage;
 static unsigned long minflt, majflt;
 static int instance_id;
@@ -240,11 +257,24 @@ static int do_comp_args(void *module, vector<string> args) {
     return 0;
 }
 
-static int do_load_cmd(string name, vector<string> args) {
+// ms since *t, which is set to now
+static double lap_ms(struct timespec *t) {
+    struct timespec now;
+    double ms;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ms = (now.tv_sec - t->tv_sec) * 1e3 + (now.tv_nsec - t->tv_nsec) * 1e-6;
+    *t = now;
+    return ms;
+}
+
+static int load_module(string name, vector<string> args, load_profile &p) {
     void *w = modules[name];
     char module_name[PATH_MAX];
     void *module;
+    struct timespec t;
 
+    clock_gettime(CLOCK_MONOTONIC, &t);
     if(w == NULL) {
 	strncpy(module_name, (name + flavor->mod_ext).c_str(),
 		PATH_MAX);
@@ -285,8 +315,11 @@ static int do_load_cmd(string name, vector<string> args) {
 
         result = do_comp_args(module, args);
         if(result < 0) { dlclose(module); return -1; }
+	p.dlopen_ms = lap_ms(&t);
 
-        if ((result=start()) < 0) {
+        result = start();
+	p.main_ms = lap_ms(&t);
+        if (result < 0) {
             rtapi_print_msg(RTAPI_MSG_ERR, "rtapi_app_main(%s): %d %s\n", 
 		      name.c_str(), result, strerror(-result));
 	    modules.erase(modules.find(name));
@@ -300,6 +333,157 @@ static int do_load_cmd(string name, vector<string> args) {
     return -1;
 }
 
+static int do_load_cmd(string name, vector<string> args) {
+    load_profile p;
+
+    p.name = name;
+    p.dlopen_ms = p.main_ms = 0.0;
+    p.result = load_module(name, args, p);
+    load_profiles.push_back(p);
+    return p.result;
+}
+
+// module files for prefetch_worker() to read, and the next one to read
+struct prefetch_list {
+    vector<string> paths;
+    unsigned next;
+    pthread_mutex_t lock;
+};
+
+static void *prefetch_worker(void *arg) {
+    prefetch_list *list = (prefetch_list *) arg;
+    char buf[65536];
+
+    while (1) {
+	pthread_mutex_lock(&list->lock);
+	if (list->next == list->paths.size()) {
+	    pthread_mutex_unlock(&list->lock);
+	    return NULL;
+	}
+	string path = list->paths[list->next++];
+	pthread_mutex_unlock(&list->lock);
+
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	    continue;  // dlopen() will complain
+	while (read(fd, buf, sizeof(buf)) > 0);
+	close(fd);
+    }
+}
+
+// read the files of the modules into the page cache, several at a
+// time, so that dlopen(), which the loader serializes, doesn't wait
+// for the disk module by module.  The modules are in the directory
+// rtapi was loaded from.
+static void prefetch_modules(const vector<string> &names) {
+    char dir[PATH_MAX];
+    prefetch_list list;
+    pthread_t threads[PREFETCH_THREADS];
+    int n, nthreads = 0;
+
+    std::map<string, void*>::iterator rtapi = modules.find("rtapi");
+    if (rtapi == modules.end() || rtapi->second == NULL ||
+	dlinfo(rtapi->second, RTLD_DI_ORIGIN, dir) != 0)
+	return;
+    for (unsigned i = 0; i < names.size(); i++) {
+	std::map<string, void*>::iterator m = modules.find(names[i]);
+	if (m == modules.end() || m->second == NULL)
+	    list.paths.push_back(string(dir) + "/" + names[i] + flavor->mod_ext);
+    }
+    list.next = 0;
+    pthread_mutex_init(&list.lock, NULL);
+    for (n = 0; n < PREFETCH_THREADS && n < (int) list.paths.size(); n++) {
+	if (pthread_create(&threads[nthreads], NULL, prefetch_worker, &list))
+	    break;
+	nthreads++;
+    }
+    for (n = 0; n < nthreads; n++)
+	pthread_join(threads[n], NULL);
+    pthread_mutex_destroy(&list.lock);
+}
+
+// loadbatch name [args..] [; name [args..]]..
+//
+// prefetches the module files, then loads the modules in order, each
+// as 'load' would, and stops at the first that fails.  reply_lines
+// gets a status line for each module.
+static int do_loadbatch_cmd(vector<string> args) {
+    vector<string> names;
+    vector<vector<string> > modargs;
+    struct timespec t;
+    unsigned i;
+    int result = 0;
+
+    for (i = 0; i < args.size(); i++) {
+	if (args[i] == ";")
+	    continue;
+	if (i == 0 || args[i - 1] == ";") {
+	    names.push_back(args[i]);
+	    modargs.push_back(vector<string>(1, args[i]));
+	} else {
+	    modargs.back().push_back(args[i]);
+	}
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    prefetch_modules(names);
+    rtapi_print_msg(RTAPI_MSG_DBG, "loadbatch: %zu modules prefetched"
+		    " in %.1f ms\n", names.size(), lap_ms(&t));
+
+    for (i = 0; i < names.size(); i++) {
+	char line[200];
+
+	if (result) {
+	    snprintf(line, sizeof(line), "%s: not loaded", names[i].c_str());
+	} else {
+	    result = do_load_cmd(names[i], modargs[i]);
+	    load_profile &p = load_profiles.back();
+	    if (result)
+		snprintf(line, sizeof(line), "%s: failed: %d",
+			 names[i].c_str(), result);
+	    else
+		snprintf(line, sizeof(line), "%s: loaded in %.1f ms",
+			 names[i].c_str(), p.dlopen_ms + p.main_ms);
+	}
+	reply_lines.push_back(line);
+    }
+    rtapi_print_msg(RTAPI_MSG_INFO, "loadbatch: %zu modules in %.1f ms\n",
+		    names.size(), lap_ms(&t));
+    return result;
+}
+
+// the load times of all modules loaded so far, slowest first
+static bool slower(const load_profile &a, const load_profile &b) {
+    return a.dlopen_ms + a.main_ms > b.dlopen_ms + b.main_ms;
+}
+
+static int do_profile_cmd(void) {
+    vector<load_profile> sorted(load_profiles);
+    double dlopen_ms = 0.0, main_ms = 0.0;
+    char line[200];
+
+    sort(sorted.begin(), sorted.end(), slower);
+    snprintf(line, sizeof(line), "%-24s %10s %10s %s",
+	     "module", "dlopen ms", "main ms", "result");
+    reply_lines.push_back(line);
+    for (unsigned i = 0; i < sorted.size(); i++) {
+	snprintf(line, sizeof(line), "%-24s %10.1f %10.1f %d",
+		 sorted[i].name.c_str(), sorted[i].dlopen_ms,
+		 sorted[i].main_ms, sorted[i].result);
+	reply_lines.push_back(line);
+	dlopen_ms += sorted[i].dlopen_ms;
+	main_ms += sorted[i].main_ms;
+    }
+    snprintf(line, sizeof(line), "%-24s %10.1f %10.1f",
+	     "total", dlopen_ms, main_ms);
+    reply_lines.push_back(line);
+    return 0;
+}
+
+// commands whose reply has lines after the result
+static bool has_reply_lines(const vector<string> &args) {
+    return args.size() && (args[0] == "loadbatch" || args[0] == "profile");
+}
+
 static int do_unload_cmd(string name) {
     void *w = modules[name];
     if(w == NULL) {
@@ -382,6 +566,11 @@ static int handle_command(vector<string> args) {
         string name = args[1];
         args.erase(args.begin());
         return do_load_cmd(name, args);
+    } else if(args.size() >= 2 && args[0] == "loadbatch") {
+        args.erase(args.begin());
+        return do_loadbatch_cmd(args);
+    } else if(args.size() == 1 && args[0] == "profile") {
+        return do_profile_cmd();
     } else if(args.size() == 2 && args[0] == "rtlevel") {
 	global_data->rt_msg_level = atoi(args[1].c_str());
 	rtapi_set_msg_level(global_data->rt_msg_level);
@@ -419,6 +608,18 @@ static int slave(int fd, vector<string> args) {
     }
 
     int result = read_number(fd);
+    if (has_reply_lines(args)) {
+	try {
+	    vector<string> lines = read_strings(fd);
+	    for (unsigned i = 0; i < lines.size(); i++)
+		printf("%s\n", lines[i].c_str());
+	}
+	catch (ReadError &e) {
+	    rtapi_print_msg(RTAPI_MSG_ERR,
+			    "rtapi_app: failed to read from master: %s\n",
+			    strerror(errno));
+	}
+    }
     return result;
 }
 
@@ -646,6 +847,8 @@ static int master(size_t  argc, char **argv, int fd, vector<string> args) {
     // execute any command if there was one on the initial command line
     if (args.size()) {
         int result = handle_command(args);
+	for (i = 0; i < reply_lines.size(); i++)
+	    printf("%s\n", reply_lines[i].c_str());
         if (result != 0) {
 	    write_exitcode(statuspipe[1], result);
 	    return result;
@@ -675,8 +878,11 @@ static int master(size_t  argc, char **argv, int fd, vector<string> args) {
             return -1;
         } else {
             int result;
+            vector<string> args;
             try {
-                result = handle_command(read_strings(fd1));
+                args = read_strings(fd1);
+                reply_lines.clear();
+                result = handle_command(args);
             } catch (ReadError &e) {
                 rtapi_print_msg(RTAPI_MSG_ERR,
 			  "rtapi_app: failed to read from slave: %s\n",
@@ -690,7 +896,15 @@ static int master(size_t  argc, char **argv, int fd, vector<string> args) {
                 rtapi_print_msg(RTAPI_MSG_ERR,
 			  "rtapi_app: failed to write to slave: %s\n",
 				strerror(errno));
-            };
+            } else if (has_reply_lines(args)) {
+		try {
+		    write_strings(fd1, reply_lines);
+		} catch (WriteError &e) {
+		    rtapi_print_msg(RTAPI_MSG_ERR,
+			  "rtapi_app: failed to write to slave: %s\n",
+				    strerror(errno));
+		}
+	    }
             close(fd1);
         }
     } while(!force_exit);
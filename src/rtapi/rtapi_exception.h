@@ -79,10 +79,21 @@ typedef struct {
     int wait_errors; // RT deadline missed
 } rtai_stats_t;
 
+// wakeup latency histogram buckets: bucket 0 counts wakeups less than
+// 1uS after the release point, bucket n those from 2^(n-1) to 2^n uS,
+// and the last one all the later ones
+#define RTAPI_LATENCY_BUCKETS 16
+
 typedef struct {
 
     int wait_errors; // RT deadline missed
 
+    // wakeup latency, the time from the release point until the
+    // thread ran again, recorded in rtapi_wait()
+    unsigned long latency_hist[RTAPI_LATENCY_BUCKETS];
+    long latency_max;      // nS
+    int spin_margin;       // margin in effect at the last wakeup, nS
+
     // filled in by rtapi_thread_update_stats() RTAPI method
     long utime_sec;      // user CPU time used
     long utime_usec;
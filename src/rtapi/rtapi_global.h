@@ -66,22 +66,34 @@ typedef struct {
     int hal_size;                  // make HAL data segment size configurable
     int hal_thread_stack_size;     // stack size passed to rtapi_task_new()
                                    // in hal_create_thread()
+    int rt_spin_margin;            // rt-preempt/posix: sleep until this
+                                   // many nS before a release point, then
+                                   // spin; 0 sleeps all the way
+    int rt_sim_time;               // posix: threads run on a simulated
+                                   // clock, sim_clock, as fast as they can
+    long long sim_clock;           // the simulated clock, nS
     int rtapi_app_pid;
     int rtapi_msgd_pid;
 
     // unified thread status monitoring
     rtapi_threadstatus_t thread_status[RTAPI_MAX_TASKS + 1];
 
-    // stats for rtapi_messages
+    // stats for rtapi_messages: messages dropped because the ring
+    // was full, or another writer had it locked
     int error_ring_full;
     int error_ring_locked;
 
+    // msgd's doorbell, a futex: msgd sets it to 1 before it waits
+    // for messages, and the first writer to find it 1 clears it and
+    // wakes msgd
+    int msgd_doorbell;
+
     ringheader_t rtapi_messages;   // ringbuffer for RTAPI messages
     char buf[SIZE_ALIGN(MESSAGE_RING_SIZE)];
     ringtrailer_t rtapi_messages_trailer;
 } global_data_t;
 
-#define GLOBAL_LAYOUT_VERSION 42   // bump on layout changes of global_data_t
+#define GLOBAL_LAYOUT_VERSION 45   // bump on layout changes of global_data_t
 
 // use global_data->magic to reflect rtapi_msgd state
 #define GLOBAL_INITIALIZING  0x0eadbeefU
@@ -28,10 +28,14 @@
 #include <errno.h>
 #include <assert.h>
 #include <syslog.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 #include <rtapi.h>
 #include "rtapi/shmdrv/shmdrv.h"
 #include "ring.h"          // environment autodetection
+#include "dbuf.h"
+#include "stashf.h"        // snprintdbuf(), for MSG_STASHF
 
 #ifndef SYSLOG_FACILITY
 #define SYSLOG_FACILITY LOG_LOCAL1  // where all rtapi/ulapi logging goes
@@ -47,7 +51,12 @@ static int rt_msglevel = RTAPI_MSG_INFO ;
 static int halsize = HAL_SIZE;
 static const char *instance_name;
 static int hal_thread_stack_size = HAL_STACKSIZE;
+static int rt_spin_margin;
+static int rt_sim_time;
 
+// msgd sleeps on the doorbell in the global segment until a writer
+// rings it.  Kernel and Xenomai RT threads can't ring it, so for those
+// flavors msgd also polls:
 // messages tend to come bunched together, e.g during startup and shutdown
 // poll faster if a message was read, and decay the poll timer up to msg_poll_max
 // if no messages are pending
@@ -58,6 +67,13 @@ static int msg_poll_min = 1;   // minimum msgq checking interval
 static int msg_poll_inc = 2;   // increment interval if no message read up to msg_poll_max
 static int msg_poll = 1;       // current delay; startup fast
 static int msgd_exit;          // flag set by signal handler to start shutdown
+static int msg_polled;         // writers may not ring the doorbell
+static int msg_idle = 1000;    // doorbell wait without polling, to notice rtapi_app exit
+static int dropped_full, dropped_locked; // drops reported so far
+
+// room for a MSG_STASHF message once formatted, as much as RT
+// would have formatted itself
+#define MSG_TEXTLEN 1024
 
 int shmdrv_loaded;
 long page_size;
@@ -236,7 +252,8 @@ static int create_global_segment()
 void init_global_data(global_data_t * data, int flavor,
 		      int instance_id, int hal_size, 
 		      int rt_level, int user_level,
-		      const char *name, int stack_size)
+		      const char *name, int stack_size, int spin_margin,
+		      int sim_time)
 {
     // force-lock - we're first, so thats a bit theoretical
     rtapi_mutex_try(&(data->mutex));
@@ -282,6 +299,13 @@ void init_global_data(global_data_t * data, int flavor,
     // stack size passed to rtapi_task_new() in hal_create_thread()
     data->hal_thread_stack_size = stack_size;
 
+    // rt-preempt/posix threads sleep until this many nS before each
+    // release point and spin the rest of the way
+    data->rt_spin_margin = spin_margin;
+
+    // posix threads run on a simulated clock instead of sleeping
+    data->rt_sim_time = sim_time;
+
     // init the error ring
     ringheader_init(&data->rtapi_messages, 0, SIZE_ALIGN(MESSAGE_RING_SIZE), 0);
     memset(&data->rtapi_messages.buf[0], 0, SIZE_ALIGN(MESSAGE_RING_SIZE));
@@ -402,6 +426,36 @@ cleanup_actions(void)
     }
 }
 
+// report messages writers dropped since the last time
+static void report_drops(void)
+{
+    int full = global_data->error_ring_full;
+    int locked = global_data->error_ring_locked;
+
+    if (full != dropped_full)
+	syslog(LOG_ERR, "msgd:%d: %d messages dropped, message ring full",
+	       rtapi_instance, full - dropped_full);
+    if (locked != dropped_locked)
+	syslog(LOG_ERR, "msgd:%d: %d messages dropped, message ring locked",
+	       rtapi_instance, locked - dropped_locked);
+    dropped_full = full;
+    dropped_locked = locked;
+}
+
+// wait for the doorbell, or at most msec milliseconds
+static void wait_for_messages(int msec)
+{
+    struct timespec ts = { msec / 1000, (msec % 1000) * 1000 * 1000 };
+
+    global_data->msgd_doorbell = 1;
+    rtapi_smp_mb();
+    // a message written before the doorbell was set didn't ring it
+    if (record_next_size(&rtapi_msg_buffer) < 0)
+	syscall(SYS_futex, &global_data->msgd_doorbell, FUTEX_WAIT, 1,
+		&ts, NULL, 0);
+    global_data->msgd_doorbell = 0;
+}
+
 static int message_thread()
 {
     rtapi_msgheader_t *msg;
@@ -409,6 +463,9 @@ static int message_thread()
     size_t payload_length;
     int retval;
     char *cp;
+    char text[MSG_TEXTLEN];
+    struct dbuf stash;
+    struct dbuf_iter it;
 
     global_data->magic = GLOBAL_READY;
 
@@ -433,6 +490,22 @@ static int message_thread()
 		       (int) payload_length, msg->buf);
 		break;
 	    case MSG_STASHF:
+		// RT left the formatting to us
+		stash.data = (unsigned char *) msg->buf;
+		stash.sz = payload_length;
+		dbuf_iter_init(&it, &stash);
+		text[0] = '\0';
+		if (snprintdbuf(text, sizeof(text), &it) < 0) {
+		    syslog(LOG_ERR, "%s:%d:%s undecodable message, %zu bytes",
+			   msg->tag, msg->pid, origins[msg->origin],
+			   payload_length);
+		    break;
+		}
+		text[sizeof(text) - 1] = '\0';
+		while ((cp = strrchr(text,'\n')))
+		    *cp = '\0';
+		syslog(rtapi2syslog(msg->level), "%s:%d:%s %s",
+		       msg->tag, msg->pid, origins[msg->origin], text);
 		break;
 	    case MSG_PROTOBUF:
 		break;
@@ -442,9 +515,13 @@ static int message_thread()
 	    record_shift(&rtapi_msg_buffer);
 	    msg_poll = msg_poll_min;
 	}
-	struct timespec ts = {0, msg_poll * 1000 * 1000};
+	report_drops();
 
-	nanosleep(&ts, NULL);
+	if (!msg_polled) {
+	    wait_for_messages(msg_idle);
+	    continue;
+	}
+	wait_for_messages(msg_poll);
 	msg_poll += msg_poll_inc;
 	if (msg_poll > msg_poll_max)
 	    msg_poll = msg_poll_max;
@@ -465,6 +542,8 @@ static struct option long_options[] = {
     {"flavor",   required_argument, 0, 'f'},
     {"halsize",  required_argument, 0, 'H'},
     {"halstacksize",  required_argument, 0, 'R'},
+    {"spinmargin",  required_argument, 0, 'M'},
+    {"simtime",  no_argument,       0, 'T'},
     {"shmdrv",  no_argument,        0, 'S'},
 
     {0, 0, 0, 0}
@@ -498,6 +577,12 @@ int main(int argc, char **argv)
 	case 'R':
 	    hal_thread_stack_size = atoi(optarg);
 	    break;
+	case 'M':
+	    rt_spin_margin = atoi(optarg);
+	    break;
+	case 'T':
+	    rt_sim_time++;
+	    break;
 	case 'i':
 	    instance_name = optarg;
 	    break;
@@ -564,6 +649,13 @@ int main(int argc, char **argv)
 	exit(EXIT_FAILURE);
     }
 
+    // only posix threads can run on a simulated clock
+    if (rt_sim_time && (flavor->id != RTAPI_POSIX_ID)) {
+	fprintf(stderr, "%s: FATAL - --simtime needs the posix flavor, not %s\n",
+		progname, flavor->name);
+	exit(EXIT_FAILURE);
+    }
+
     // catch installation error: user not in xenomai group
     if (flavor->id == RTAPI_XENOMAI_ID) {
 	int retval = user_in_xenomai_group();
@@ -594,6 +686,10 @@ int main(int argc, char **argv)
 	exit(EXIT_FAILURE);
     }
 
+    // RT threads of these flavors can't wake msgd
+    msg_polled = (flavor->flags & FLAVOR_KERNEL_BUILD) ||
+	(flavor->id == RTAPI_XENOMAI_ID);
+
     // the global segment every entity in HAL/RTAPI land attaches to
     if ((retval = create_global_segment()) != 1) // must be a new shm segment
 	exit(retval);
@@ -639,7 +735,8 @@ int main(int argc, char **argv)
     // gets initialized - no reinitialization from elsewhere
     init_global_data(global_data, flavor->id, rtapi_instance,
     		     halsize, rt_msglevel, usr_msglevel,
-		     instance_name,hal_thread_stack_size);
+		     instance_name,hal_thread_stack_size, rt_spin_margin,
+		     rt_sim_time);
 
     syslog(LOG_INFO,
 	   "startup instance=%s pid=%d flavor=%s "
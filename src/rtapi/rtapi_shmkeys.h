@@ -19,6 +19,10 @@
 
 // formerly emcmotcfg.h
 #define DEFAULT_MOTION_SHMEM_KEY 0x00000064
+// motion's compensation tables
+#define MOTION_COMP_SHMEM_KEY 0x00434D50 // "CMP"
+// motion's volumetric compensation grid, see emc/motion/vcomp.h
+#define MOTION_VCOMP_SHMEM_KEY 0x00564350 // "VCP"
 
 // the global segment shm key
 #define GLOBAL_KEY  0x00154711     // key for GLOBAL 
@@ -30,6 +34,12 @@
 #define STREAMER_SHMEM_KEY 	0x00535430
 #define SAMPLER_SHMEM_KEY	0x00534130
 
+// change notification for user space HAL clients, see hal/hal_notify.h
+#define HAL_NOTIFY_SHMEM_KEY	0x004E5446 // "NTF"
+
+// task's copy of EMC_STAT for local GUIs, see emc/nml_intf/emcstatmirror.hh
+#define EMC_STAT_MIRROR_KEY	0x00455354 // "EST"
+
 // from hal/classicladder/arrays.c
 #define CL_SHMEM_KEY 0x004C522b // "CLR+"
 
@@ -16,6 +16,11 @@
 #include "rtapi/shmdrv/shmdrv.h"
 #include "ring.h"
 
+#ifdef RTAPI
+#include "dbuf.h"		/* dbuf_iter_init() */
+#include "stashf.h"		/* vstashf() */
+#endif
+
 #define RTPRINTBUFFERLEN 1024
 
 #ifdef MODULE
@@ -31,6 +36,8 @@
 #include <stdio.h>		/* libc's vsnprintf() */
 #include <sys/types.h>
 #include <unistd.h>
+#include <sys/syscall.h>	/* SYS_futex */
+#include <linux/futex.h>	/* FUTEX_WAKE */
 
 #ifdef RTAPI
 #define MSG_ORIGIN MSG_RTUSER
@@ -60,6 +67,48 @@ static char logtag[TAGSIZE];
 // switch to exclusively using the ringbuffer from RT
 #define USE_MESSAGE_RING 1
 
+// kernel RT and Xenomai RT threads can't make Linux system calls, so
+// msgd finds their messages by polling
+#if !defined(MODULE) && !(defined(RTAPI) && defined(RTAPI_XENOMAI))
+#define RING_DOORBELL 1
+#endif
+
+// wake msgd if it waits for messages: only the first message after
+// it emptied the ring rings the doorbell
+static void ring_doorbell(void)
+{
+#ifdef RING_DOORBELL
+    rtapi_smp_mb();
+    if (global_data->msgd_doorbell &&
+	__sync_bool_compare_and_swap(&global_data->msgd_doorbell, 1, 0))
+	syscall(SYS_futex, &global_data->msgd_doorbell, FUTEX_WAKE, 1,
+		NULL, NULL, 0);
+#endif
+}
+
+#ifdef RTAPI
+// RT messages are not formatted in the RT thread: the format and the
+// arguments are stashed in binary, see stashf.c, and msgd formats
+// them.  Returns the size of the encoding, or -1 if it didn't fit or
+// the format has a conversion stashf doesn't know.
+static int stash_msg(char *buf, int size, const char *format, va_list ap)
+{
+    struct dbuf d;
+    struct dbuf_iter di;
+    va_list aq;
+    int retval;
+
+    // not dbuf_init(), which clears the whole buffer
+    d.data = (unsigned char *) buf;
+    d.sz = size;
+    dbuf_iter_init(&di, &d);
+    va_copy(aq, ap);
+    retval = vstashf(&di, format, aq);
+    va_end(aq);
+    return retval < 0 ? -1 : (int) di.offset;
+}
+#endif
+
 void vs_ring_write(msg_level_t level, const char *format, va_list ap)
 {
     int n;
@@ -95,23 +144,34 @@ void vs_ring_write(msg_level_t level, const char *format, va_list ap)
 	msg->pid  = getpid();
 #endif
 	msg->level = level;
-	msg->encoding = MSG_ASCII;
 	strncpy(msg->tag, logtag, sizeof(msg->tag));
 
-	n = vsnprintf(msg->buf, RTPRINTBUFFERLEN, format, ap);
+#ifdef RTAPI
+	n = stash_msg(msg->buf, RTPRINTBUFFERLEN, format, ap);
+	if (n >= 0) {
+	    msg->encoding = MSG_STASHF;
+	} else
+#endif
+	{
+	    msg->encoding = MSG_ASCII;
+	    n = vsnprintf(msg->buf, RTPRINTBUFFERLEN, format, ap);
+	    if (n >= RTPRINTBUFFERLEN)
+		n = RTPRINTBUFFERLEN - 1; // truncated
+	    n++; // trailing zero
+	}
 	// commit write
 	record_write_end(&rtapi_message_buffer, (void *) msg,
-			       sizeof(rtapi_msgheader_t) + n + 1); // trailing zero
+			       sizeof(rtapi_msgheader_t) + n);
 	rtapi_mutex_give(&rtapi_message_buffer.header->wmutex);
+	ring_doorbell();
     }
 }
 
 #ifdef MODULE
 void default_rtapi_msg_handler(msg_level_t level, const char *fmt,
 			      va_list ap) {
-    char buf[RTPRINTBUFFERLEN];
-    vsnprintf(buf, RTPRINTBUFFERLEN, fmt, ap);
-    vs_ring_write(level, buf, ap);
+    // formatted by msgd, or in vs_ring_write() if it can't be stashed
+    vs_ring_write(level, fmt, ap);
 }
 
 #else /* user land */
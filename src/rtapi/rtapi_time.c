@@ -150,6 +150,10 @@ long long int _rtapi_get_time(void) {
 long long int _rtapi_get_time(void) {
 
     struct timespec ts;
+#ifdef RTAPI_POSIX
+    if (global_data->rt_sim_time)
+	return global_data->sim_clock;
+#endif
     clock_gettime(CLOCK_MONOTONIC, &ts);
     return ts.tv_sec * 1000 * 1000 * 1000 + ts.tv_nsec;
 }
@@ -173,6 +177,11 @@ long long int _rtapi_get_clocks(void) {
 #ifndef HAVE_RTAPI_GET_CLOCKS_HOOK
     long long int retval;
 
+#if defined(RTAPI) && defined(RTAPI_POSIX)
+    // one clock per nS of simulated time
+    if (global_data->rt_sim_time)
+	return global_data->sim_clock;
+#endif
     /* This returns a result in clocks instead of nS, and needs to be
        used with care around CPUs that change the clock speed to save
        power and other disgusting, non-realtime oriented behavior.
@@ -0,0 +1,183 @@
+// Checks encoder's packed input mode against the pin-per-input mode.
+//
+// encoder.c is built into this program against the stand-ins for
+// RTAPI and HAL in tests/include/hal_stubs.h.  Two sets of counters are
+// created, one reading bit pins and one reading encoder.packed-input,
+// and both are fed the same simulated encoders, with index, latch and
+// the three counting modes.  Every output of every counter must match
+// after every capture-position.  The final outputs of each channel go
+// to stdout, and are compared with 'expected'; the time spent in
+// update-counters by each mode goes to stderr.
+//
+// usage: compare [channels [seconds of machine time]]
+
+#include "hal_stubs.h"
+
+#include "../../src/hal/components/encoder.c"
+
+#define BASE 20000
+#define SERVO 1000000
+
+// a simulated encoder, 100 counts/rev, with index and a latch input
+typedef struct {
+    double pos, vel;
+    int latch;
+} sim_t;
+
+static unsigned sim_bits(sim_t *s)
+{
+    static const unsigned char quad[4] = { 0, 1, 3, 2 };
+    long p = (long)(s->pos >= 0 ? s->pos : s->pos - 1);
+    unsigned bits = quad[p & 3];
+
+    if (((p % 100) + 100) % 100 == 0)
+	bits |= IN_PHASE_Z_MASK;
+    if (s->latch)
+	bits |= IN_LATCH_MASK;
+    return bits;
+}
+
+static int check(counter_t *a, counter_t *b, int n, long period)
+{
+#define SAME(field) \
+    if (*(a->field) != *(b->field)) { \
+	printf("period %ld channel %d: " #field " %g != %g\n", period, n, \
+	    (double) *(a->field), (double) *(b->field)); \
+	return 1; \
+    }
+    SAME(raw_counts) SAME(count) SAME(count_latch) SAME(index_ena)
+    SAME(pos) SAME(pos_latch) SAME(vel) SAME(pos_interp)
+    return 0;
+#undef SAME
+}
+
+int main(int argc, char **argv)
+{
+    int chans = 6, n, err = 0;
+    double seconds = 10, start, t_pins = 1e30, t_packed = 1e30, t;
+    long p, periods, per_servo = SERVO / BASE, r, replay;
+    counter_t *pins, *words;
+    sim_t sim[MAX_CHAN];
+    __u32 tb, word, *trace;
+
+    if (argc > 1) chans = atoi(argv[1]);
+    if (argc > 2) seconds = atof(argv[2]);
+    if (chans < 1 || chans > MAX_CHAN) {
+	fprintf(stderr, "usage: %s [channels [seconds]]\n", argv[0]);
+	return 1;
+    }
+
+    // two instances, one of each mode, sharing timebase
+    num_chan = chans;
+    if (rtapi_app_main() != 0)
+	return 1;
+    pins = counter_array;
+    packed = 1;
+    if (rtapi_app_main() != 0)
+	return 1;
+    words = counter_array;
+
+    srand(1);
+    memset(sim, 0, sizeof(sim));
+    for (n = 0; n < chans; n++) {
+	sim[n].vel = (n & 1 ? -1 : 1) * (n + 1) * 0.02;
+	if (n % 3 == 1) {
+	    *(pins[n].x4_mode) = *(words[n].x4_mode) = 0;
+	} else if (n % 3 == 2) {
+	    *(pins[n].counter_mode) = *(words[n].counter_mode) = 1;
+	}
+	*(pins[n].pos_scale) = *(words[n].pos_scale) = 100 + n;
+	*(pins[n].latch_falling) = *(words[n].latch_falling) = n & 1;
+    }
+
+    periods = seconds * 1e9 / BASE;
+    trace = malloc(periods * sizeof(*trace));
+    if (!trace)
+	return 1;
+    for (p = 0; p < periods; p++) {
+	word = 0;
+	for (n = 0; n < chans; n++) {
+	    unsigned bits = sim_bits(&sim[n]);
+	    *(pins[n].phaseA) = (bits & IN_PHASE_A_MASK) != 0;
+	    *(pins[n].phaseB) = (bits & IN_PHASE_B_MASK) != 0;
+	    *(pins[n].phaseZ) = (bits & IN_PHASE_Z_MASK) != 0;
+	    *(pins[n].latch_in) = (bits & IN_LATCH_MASK) != 0;
+	    word |= bits << (n * IN_BITS);
+	}
+	*(packed_data->in) = trace[p] = word;
+
+	tb = timebase;
+	update(pins, BASE);
+	timebase = tb;
+	update_packed(words, BASE);
+
+	// the encoders move along, change speed now and then
+	for (n = 0; n < chans; n++) {
+	    sim[n].pos += sim[n].vel;
+	    if (rand() % 5000 == 0)
+		sim[n].vel = (rand() % 2001 - 1000) * 0.0004;
+	    if (rand() % 3000 == 0)
+		sim[n].latch = !sim[n].latch;
+	}
+
+	if (p % per_servo == per_servo - 1) {
+	    if (p % (per_servo * 50) == 0) {
+		for (n = 0; n < chans; n++)
+		    *(pins[n].index_ena) = *(words[n].index_ena) = 1;
+	    }
+	    capture(pins, SERVO);
+	    capture(words, SERVO);
+	    for (n = 0; n < chans && !err; n++)
+		err = check(&pins[n], &words[n], n, p);
+	    if (err)
+		break;
+	}
+    }
+    if (err)
+	return err;
+    for (n = 0; n < chans; n++) {
+	printf("channel %d: raw %d count %d latched %d pos %.4f vel %.4f\n",
+	    n, *(pins[n].raw_counts), *(pins[n].count),
+	    *(pins[n].count_latch), *(pins[n].pos), *(pins[n].vel));
+	if (*(pins[n].raw_counts) == 0) {
+	    printf("channel %d never counted\n", n);
+	    err = 1;
+	}
+    }
+    if (err)
+	return err;
+
+    // replay the inputs to time update-counters, with the inputs
+    // written the way a driver would write them; the best of a few
+    // runs is reported, so time lost to other processes doesn't count
+    replay = periods < 100000 ? periods : 100000;
+    for (r = 0; r < 5; r++) {
+	start = stub_now();
+	for (p = 0; p < replay; p++) {
+	    for (n = 0; n < chans; n++) {
+		word = trace[p] >> (n * IN_BITS);
+		*(pins[n].phaseA) = (word & IN_PHASE_A_MASK) != 0;
+		*(pins[n].phaseB) = (word & IN_PHASE_B_MASK) != 0;
+		*(pins[n].phaseZ) = (word & IN_PHASE_Z_MASK) != 0;
+		*(pins[n].latch_in) = (word & IN_LATCH_MASK) != 0;
+	    }
+	    update(pins, BASE);
+	}
+	t = stub_now() - start;
+	if (t < t_pins)
+	    t_pins = t;
+	start = stub_now();
+	for (p = 0; p < replay; p++) {
+	    *(packed_data->in) = trace[p];
+	    update_packed(words, BASE);
+	}
+	t = stub_now() - start;
+	if (t < t_packed)
+	    t_packed = t;
+    }
+    fprintf(stderr, "update-counters: %d channels, %ld periods\n",
+	chans, periods);
+    fprintf(stderr, "pins: %.2f ns/period, packed: %.2f ns/period\n",
+	t_pins / replay, t_packed / replay);
+    return 0;
+}
@@ -0,0 +1,5 @@
+#!/bin/sh
+rm -f compare
+set -e
+gcc -O2 -I../include -I../../src/rtapi -I../../src/hal compare.c -o compare
+./compare 6 4
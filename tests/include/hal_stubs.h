@@ -0,0 +1,149 @@
+// Stand-ins for RTAPI and HAL, for tests that build a realtime
+// component's source into a plain program, so that its functions can
+// be called directly, without threads or shared memory:
+//
+//	#include "hal_stubs.h"
+//	#include "../../src/hal/components/stepgen.c"
+//
+// and then rtapi_app_main(), and find_funct() to get the functions it
+// exported.  Pins get their own storage, params are used in place.
+// Messages at RTAPI_MSG_ERR go to stderr.
+
+#ifndef HAL_STUBS_H
+#define HAL_STUBS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+
+// keep the real headers out, the component gets what it needs from here
+#define RTAPI_H
+#define RTAPI_APP_H
+#define HAL_H
+#define RTAPI_MATH_H
+#define RTAPI_STRING_H
+
+#define MODULE_AUTHOR(x)
+#define MODULE_DESCRIPTION(x)
+#define MODULE_LICENSE(x)
+#define RTAPI_MP_INT(var, desc)
+#define RTAPI_MP_ARRAY_INT(var, num, desc)
+#define RTAPI_MP_ARRAY_STRING(var, num, desc)
+
+#define RTAPI_MSG_ERR 1
+#define RTAPI_MSG_WARN 2
+#define RTAPI_MSG_INFO 3
+#define HAL_NAME_LEN 47
+
+#define rtapi_snprintf snprintf
+
+typedef int __s32;
+typedef unsigned int __u32;
+
+typedef volatile unsigned char hal_bit_t;
+typedef volatile __u32 hal_u32_t;
+typedef volatile __s32 hal_s32_t;
+typedef volatile double hal_float_t;
+typedef enum { HAL_IN = 16, HAL_OUT = 32, HAL_IO = 48 } hal_pin_dir_t;
+typedef enum { HAL_RO = 64, HAL_RW = 192 } hal_param_dir_t;
+typedef void (*funct_t)(void *, long);
+
+#define STUB static __attribute__((unused))
+
+static int msg_level = RTAPI_MSG_ERR;
+
+STUB void rtapi_print_msg(int level, const char *fmt, ...)
+{
+    va_list ap;
+
+    if (level > msg_level)
+	return;
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+}
+
+STUB int rtapi_get_msg_level(void) { return msg_level; }
+STUB void rtapi_set_msg_level(int level) { msg_level = level; }
+
+STUB int hal_init(const char *name) { return 1; }
+STUB void hal_exit(int comp_id) { }
+STUB int hal_ready(int comp_id) { return 0; }
+STUB void *hal_malloc(long size) { return calloc(1, size); }
+
+#define MAX_STUB_FUNCTS 64
+
+static struct {
+    char name[HAL_NAME_LEN + 1];
+    funct_t funct;
+    void *arg;
+} stub_functs[MAX_STUB_FUNCTS];
+static int num_stub_functs;
+
+STUB int hal_export_funct(const char *name, funct_t funct, void *arg,
+    int uses_fp, int reentrant, int comp_id)
+{
+    if (num_stub_functs == MAX_STUB_FUNCTS)
+	return -ENOMEM;
+    snprintf(stub_functs[num_stub_functs].name, HAL_NAME_LEN + 1, "%s", name);
+    stub_functs[num_stub_functs].funct = funct;
+    stub_functs[num_stub_functs].arg = arg;
+    num_stub_functs++;
+    return 0;
+}
+
+// the last function exported under 'name'; exits if there is none
+STUB funct_t find_funct(const char *name, void **arg)
+{
+    int n;
+
+    for (n = num_stub_functs - 1; n >= 0; n--) {
+	if (strcmp(stub_functs[n].name, name) == 0) {
+	    *arg = stub_functs[n].arg;
+	    return stub_functs[n].funct;
+	}
+    }
+    fprintf(stderr, "funct %s not exported\n", name);
+    exit(1);
+}
+
+#define STUB_PIN_NEWF(type) \
+STUB int hal_pin_##type##_newf(hal_pin_dir_t dir, hal_##type##_t **p, \
+    int comp_id, const char *fmt, ...) \
+{ \
+    *p = calloc(1, sizeof(**p)); \
+    return *p ? 0 : -ENOMEM; \
+}
+#define STUB_PARAM_NEWF(type) \
+STUB int hal_param_##type##_newf(hal_param_dir_t dir, hal_##type##_t *p, \
+    int comp_id, const char *fmt, ...) \
+{ \
+    return 0; \
+}
+
+STUB_PIN_NEWF(bit)
+STUB_PIN_NEWF(u32)
+STUB_PIN_NEWF(s32)
+STUB_PIN_NEWF(float)
+STUB_PARAM_NEWF(bit)
+STUB_PARAM_NEWF(u32)
+STUB_PARAM_NEWF(s32)
+STUB_PARAM_NEWF(float)
+
+#undef STUB_PIN_NEWF
+#undef STUB_PARAM_NEWF
+
+// monotonic time in ns, for the timings the tests print to stderr
+STUB double stub_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+#endif
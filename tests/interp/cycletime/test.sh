@@ -0,0 +1,3 @@
+#!/bin/bash
+rs274-cycletime -l -j 2 -i test.ini good.ngc bad.ngc
+exit $(($? != 1))
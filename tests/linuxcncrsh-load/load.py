@@ -0,0 +1,116 @@
+#!/usr/bin/env python
+# Load test for linuxcncrsh.
+#
+# Each client opens a connection, says hello, sends a few batches of
+# pipelined get commands, and hangs up, over and over, the way a shop
+# floor system polling many machines does.  Prints the request rate and
+# the latency of the replies, measured from sending a batch to reading
+# the reply.
+#
+# usage: load.py [-p port] [-c clients] [-t seconds] [-b batch]
+#                [-r batches per connection] [command ...]
+
+import getopt
+import socket
+import sys
+import threading
+import time
+
+DEFAULT_COMMANDS = ["get mode", "get machine", "get estop",
+    "get abs_act_pos", "get program_status", "get feed_override"]
+
+class Client(threading.Thread):
+    def __init__(self, port, commands, batch, rounds, end):
+        threading.Thread.__init__(self)
+        self.daemon = True
+        self.port = port
+        self.commands = commands
+        self.batch = batch
+        self.rounds = rounds
+        self.end = end
+        self.latencies = []
+        self.errors = 0
+        self.connections = 0
+        self.buf = b""
+
+    def readline(self, sock):
+        while True:
+            i = self.buf.find(b"\n")
+            if i >= 0:
+                line, self.buf = self.buf[:i], self.buf[i+1:]
+                line = line.strip()
+                if line: return line
+                continue
+            data = sock.recv(4096)
+            if not data: raise IOError("connection closed")
+            self.buf += data
+
+    def session(self):
+        sock = socket.create_connection(("localhost", self.port))
+        sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.buf = b""
+        self.connections += 1
+        try:
+            sock.sendall(b"hello EMC load 1.0\r\nset echo off\r\n")
+            if not self.readline(sock).startswith(b"HELLO ACK"):
+                self.errors += 1
+                return
+            n = 0
+            for r in range(self.rounds):
+                lines = [self.commands[(n + i) % len(self.commands)]
+                    for i in range(self.batch)]
+                n += self.batch
+                start = time.time()
+                sock.sendall(("\r\n".join(lines) + "\r\n").encode())
+                for l in lines:
+                    reply = self.readline(sock)
+                    self.latencies.append(time.time() - start)
+                    if reply.endswith(b"NAK"): self.errors += 1
+            sock.sendall(b"quit\r\n")
+        finally:
+            sock.close()
+
+    def run(self):
+        while time.time() < self.end:
+            try:
+                self.session()
+            except (IOError, socket.error):
+                self.errors += 1
+                time.sleep(.01)
+
+def percentile(values, p):
+    if not values: return 0
+    return values[min(len(values) - 1, int(len(values) * p))]
+
+def main():
+    port, clients, seconds, batch, rounds = 5007, 30, 5.0, 4, 5
+    opts, args = getopt.getopt(sys.argv[1:], "p:c:t:b:r:")
+    for o, a in opts:
+        if o == "-p": port = int(a)
+        if o == "-c": clients = int(a)
+        if o == "-t": seconds = float(a)
+        if o == "-b": batch = int(a)
+        if o == "-r": rounds = int(a)
+    commands = args or DEFAULT_COMMANDS
+
+    start = time.time()
+    threads = [Client(port, commands, batch, rounds, start + seconds)
+        for i in range(clients)]
+    for t in threads: t.start()
+    for t in threads: t.join()
+    elapsed = time.time() - start
+
+    latencies = sorted(l for t in threads for l in t.latencies)
+    errors = sum(t.errors for t in threads)
+    connections = sum(t.connections for t in threads)
+    print("clients %d, batch %d, %d batches per connection" % (clients, batch, rounds))
+    print("%d requests, %d connections in %.1f s" % (len(latencies), connections, elapsed))
+    print("%.0f requests/s" % (len(latencies) / elapsed))
+    print("latency p50 %.2f ms, p99 %.2f ms, max %.2f ms" % (
+        percentile(latencies, .5) * 1e3, percentile(latencies, .99) * 1e3,
+        (latencies[-1] if latencies else 0) * 1e3))
+    print("errors %d" % errors)
+    return errors != 0 or not latencies
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,34 @@
+#!/bin/bash
+
+linuxcnc -r linuxcncrsh-load.ini &
+
+
+# let linuxcnc come up
+TOGO=80
+while [  $TOGO -gt 0 ]; do
+    echo trying to connect to linuxcncrsh TOGO=$TOGO
+    if nc -z localhost 5007; then
+        break
+    fi
+    sleep 0.25
+    TOGO=$(($TOGO - 1))
+done
+if [  $TOGO -eq 0 ]; then
+    echo connection to linuxcncrsh timed out
+    exit 1
+fi
+
+python ./load.py -c 30 -t 5
+RESULT=$?
+
+(
+    echo hello EMC mt 1.0
+    echo set enable EMCTOO
+    echo shutdown
+) | nc localhost 5007
+
+
+# wait for linuxcnc to finish
+wait
+
+exit $RESULT
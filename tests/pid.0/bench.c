@@ -0,0 +1,117 @@
+// Checks and times pid's do-pid-calcs.
+//
+// pid.c is built into this program against the stand-ins for RTAPI
+// and HAL in tests/include/hal_stubs.h.  9 loops, with a mix of gains,
+// limits and deadbands, follow a sine with noisy feedback, while
+// enable, index-enable and error-previous-target are toggled and the
+// period changes now and then.  A hash of every output of every loop
+// after every period goes to stdout, and is compared with 'expected',
+// which was made with pid.c before it read each pin only once.  The
+// median time per loop per period goes to stderr.
+//
+// usage: bench [periods]
+
+#include "hal_stubs.h"
+#include "../../src/hal/components/pid.c"
+
+#define LOOPS 9
+
+static unsigned long long hash = 1469598103934665603ULL;
+
+// FNV-1a over the bits of a double
+static void mix(double d)
+{
+    unsigned long long u;
+    int i;
+
+    memcpy(&u, &d, sizeof(u));
+    for (i = 0; i < 8; i++) {
+	hash ^= (u >> (8 * i)) & 0xff;
+	hash *= 1099511628211ULL;
+    }
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+int main(int argc, char **argv)
+{
+    long periods = 100000, p;
+    int n;
+    char name[HAL_NAME_LEN + 1];
+    funct_t calc[LOOPS];
+    void *arg[LOOPS];
+    double *t, start;
+    hal_pid_t *q;
+
+    if (argc > 1) periods = atol(argv[1]);
+    if (periods < 1) {
+	fprintf(stderr, "usage: %s [periods]\n", argv[0]);
+	return 1;
+    }
+    t = malloc(periods * sizeof(*t));
+    if (!t)
+	return 1;
+
+    num_chan = LOOPS;
+    if (rtapi_app_main() != 0)
+	return 1;
+    for (n = 0; n < LOOPS; n++) {
+	snprintf(name, sizeof(name), "pid.%d.do-pid-calcs", n);
+	calc[n] = find_funct(name, &arg[n]);
+	q = &pid_array[n];
+	*(q->enable) = 1;
+	*(q->pgain) = 10 + n;
+	*(q->igain) = 2;
+	*(q->dgain) = 0.1;
+	*(q->ff1gain) = 1;
+	*(q->ff2gain) = 0.01;
+	*(q->bias) = 0.01 * n;
+	*(q->deadband) = 0.001 * (n % 3);
+	*(q->maxoutput) = n & 1 ? 50 : 0;
+	*(q->maxerror) = n & 2 ? 0.5 : 0;
+	*(q->maxerror_i) = n & 4 ? 1 : 0;
+	*(q->maxerror_d) = n % 3 == 1 ? 3 : 0;
+	*(q->maxcmd_d) = n % 4 == 1 ? 20 : 0;
+	*(q->maxcmd_dd) = n % 5 == 1 ? 1000 : 0;
+    }
+
+    srand(1);
+    for (p = 0; p < periods; p++) {
+	for (n = 0; n < LOOPS; n++) {
+	    q = &pid_array[n];
+	    *(q->command) = sin(p * 1e-3 * (n + 1)) * 10;
+	    *(q->feedback) = *(q->command) + (rand() % 1000 - 500) * 1e-4;
+	    if (p % 5000 == 17)
+		*(q->index_enable) = !*(q->index_enable);
+	    if (p % 7777 == 3)
+		*(q->enable) = !*(q->enable);
+	    if (p % 10000 == 9)
+		*(q->error_previous_target) = !*(q->error_previous_target);
+	}
+	start = stub_now();
+	for (n = 0; n < LOOPS; n++)
+	    calc[n](arg[n], (p / 20000) & 1 ? 1000000 : 500000);
+	t[p] = stub_now() - start;
+	for (n = 0; n < LOOPS; n++) {
+	    q = &pid_array[n];
+	    mix(*(q->output));
+	    mix(*(q->error));
+	    mix(*(q->error_i));
+	    mix(*(q->error_d));
+	    mix(*(q->cmd_d));
+	    mix(*(q->cmd_dd));
+	    mix(*(q->saturated));
+	    mix(*(q->saturated_s));
+	    mix(*(q->saturated_count));
+	}
+    }
+    printf("%d loops, %ld periods: %016llx\n", LOOPS, periods, hash);
+    qsort(t, periods, sizeof(*t), cmp_double);
+    fprintf(stderr, "%.1f ns/loop/period\n", t[periods / 2] / LOOPS);
+    return 0;
+}
@@ -0,0 +1,5 @@
+#!/bin/sh
+rm -f bench
+set -e
+gcc -O2 -I../include -I../../src/rtapi -I../../src/hal bench.c -o bench -lm
+./bench 100000
@@ -0,0 +1,178 @@
+// Benchmark for the encoding of RT messages.
+//
+// rtapi_print_msg() from RT used to format each message with vsnprintf
+// in the RT thread (MSG_ASCII); now it stashes the format and the
+// arguments in binary (MSG_STASHF) and rtapi_msgd formats them.  This
+// checks, for formats RT code uses, that msgd's formatting of the stash
+// is what vsnprintf would have made of it, or that formats stashf can't
+// encode are left to vsnprintf, and prints each result.  The time per
+// message each way goes to stderr.
+//
+// usage: bench [messages per batch [batches]]
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+// dbuf.c and stashf.c need none of RTAPI
+#include "hal_stubs.h"
+
+#include "../../src/emc/motion/dbuf.c"
+#include "../../src/emc/motion/stashf.c"
+
+#define RTPRINTBUFFERLEN 1024
+
+// the two ways vs_ring_write() in rtapi_support.c can fill a message
+static int ascii_msg(char *buf, int size, const char *format, va_list ap)
+{
+    int n = vsnprintf(buf, size, format, ap);
+
+    if (n >= size)
+	n = size - 1;
+    return n + 1;
+}
+
+static int stash_msg(char *buf, int size, const char *format, va_list ap)
+{
+    struct dbuf d;
+    struct dbuf_iter di;
+    va_list aq;
+    int retval;
+
+    d.data = (unsigned char *) buf;
+    d.sz = size;
+    dbuf_iter_init(&di, &d);
+    va_copy(aq, ap);
+    retval = vstashf(&di, format, aq);
+    va_end(aq);
+    return retval < 0 ? -1 : (int) di.offset;
+}
+
+typedef int (*encode_t)(char *buf, int size, const char *format, va_list ap);
+
+static char ring[RTPRINTBUFFERLEN];
+static int bytes;
+
+static void msg(encode_t encode, const char *format, ...)
+{
+    va_list ap;
+
+    va_start(ap, format);
+    bytes += encode(ring, sizeof(ring), format, ap);
+    va_end(ap);
+}
+
+// one of each, as a batch of RT messages might look
+#define MESSAGES 5
+static void messages(encode_t encode, int i)
+{
+    msg(encode, "MOTION: rtapi_shmem_new failed, returned %d\n", -i);
+    msg(encode, "%s: joint %d following error %f > %f\n",
+	"motmod", i & 7, 0.0123 * i, 0.01);
+    msg(encode, "hm2/%s: IO Pin %03d (%s-%02d): %s\n",
+	"hm2_5i25.0", i & 127, "P3", i & 31, "StepGen #0, pin Step (Output)");
+    msg(encode, "%s: overrun by %ld ns (%d%%)\n", "servo-thread",
+	(long) i * 1000, i % 100);
+    msg(encode, "pid.%d: command %g feedback %g error %g output %g\n",
+	i & 3, 1.0 * i, 0.999 * i, 0.001 * i, 12.5);
+}
+
+// what ends up in the log for one message: msgd's formatting of the
+// stash, which must match vsnprintf, or vsnprintf's if it can't be stashed
+static void check(const char *format, ...)
+{
+    char want[RTPRINTBUFFERLEN], got[RTPRINTBUFFERLEN];
+    struct dbuf d;
+    struct dbuf_iter di;
+    va_list ap;
+    int n;
+
+    va_start(ap, format);
+    vsnprintf(want, sizeof(want), format, ap);
+    va_end(ap);
+    va_start(ap, format);
+    n = stash_msg(ring, sizeof(ring), format, ap);
+    va_end(ap);
+    if (n < 0) {
+	printf("vsnprintf: %s", want);
+	return;
+    }
+    d.data = (unsigned char *) ring;
+    d.sz = n;
+    dbuf_iter_init(&di, &d);
+    got[0] = '\0';
+    if (snprintdbuf(got, sizeof(got), &di) < 0 || strcmp(want, got))
+	printf("stashed, wrong: \"%s\" came out as \"%s\"\n", want, got);
+    else
+	printf("stashed: %s", got);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+// median time per message, in ns, over batches of count batches
+static double run(encode_t encode, int count, int batches, int *size)
+{
+    double *batch, start, median;
+    int b, i;
+
+    batch = malloc(batches * sizeof(*batch));
+    if (!batch)
+	exit(1);
+    bytes = 0;
+    for (b = 0; b < batches; b++) {
+	start = stub_now();
+	for (i = 0; i < count; i++)
+	    messages(encode, i);
+	batch[b] = (stub_now() - start) / (count * MESSAGES);
+    }
+    *size = bytes / (batches * count * MESSAGES);
+    qsort(batch, batches, sizeof(*batch), cmp_double);
+    median = batch[batches / 2];
+    free(batch);
+    return median;
+}
+
+int main(int argc, char **argv)
+{
+    int count = 200, batches = 500, ascii_size, stashf_size;
+    double ascii, stashf;
+
+    if (argc > 1) count = atoi(argv[1]);
+    if (argc > 2) batches = atoi(argv[2]);
+    if (count < 1 || batches < 1) {
+	fprintf(stderr, "usage: %s [messages per batch [batches]]\n", argv[0]);
+	return 1;
+    }
+
+    check("MOTION: rtapi_shmem_new failed, returned %d\n", -12);
+    check("%s: joint %d following error %f > %f\n",
+	"motmod", 2, 0.0123, 0.01);
+    check("hm2/%s: IO Pin %03d (%s-%02d): %s\n",
+	"hm2_5i25.0", 7, "P3", 12, "StepGen #0, pin Step (Output)");
+    check("%s: overrun by %ld ns (%d%%)\n", "servo-thread", 5000L, 12);
+    check("pid.%d: command %g feedback %g error %g output %g\n",
+	1, 1.0, 0.999, 0.001, 12.5);
+    check("%-8s|%8.3f|%x|%c|%s\n", "left", -3.14159, 255, 'z', NULL);
+    check("%o %lo %hd %hhu %5.2s|\n", 8, 0777L, -2, 300, "abc");
+    // these take arguments stashf can't encode
+    check("%.*s|\n", 3, "abcdef");
+    check("%*d|\n", 5, 42);
+    check("%zd %zu\n", (ssize_t) -1, (size_t) -1);
+    check("%jd %td\n", (intmax_t) -1, (ptrdiff_t) -1);
+    check("%lld %llu\n", -1LL, 18446744073709551615ULL);
+    check("%Lf\n", (long double) 1.5);
+    check("%ls|\n", L"wide");
+
+    ascii = run(ascii_msg, count, batches, &ascii_size);
+    stashf = run(stash_msg, count, batches, &stashf_size);
+    fprintf(stderr, "MSG_ASCII:  %.1f ns/message, %d bytes\n",
+	ascii, ascii_size);
+    fprintf(stderr, "MSG_STASHF: %.1f ns/message, %d bytes\n",
+	stashf, stashf_size);
+    return 0;
+}
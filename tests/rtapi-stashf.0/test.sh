@@ -0,0 +1,5 @@
+#!/bin/sh
+rm -f bench
+set -e
+gcc -O2 -I../include -I../../src/rtapi -I../../src/emc/motion bench.c -o bench
+./bench 200 500
@@ -0,0 +1,82 @@
+#!/bin/sh
+# Loads a config of components, aliases, nets, parameters and threads
+# with 'halcmd -f', saves a snapshot of it, and restores the snapshot
+# into a fresh realtime.  The restored HAL must 'save' and snapshot the
+# same as the one it came from, have the same values, and have every
+# function config.hal added to a thread.  The load and restore times go to
+# stderr.
+N=200
+
+{
+    echo "loadrt threads name1=fast period1=100000 name2=slow period2=1000000"
+    echo "loadrt edge count=$N"
+    echo "loadrt constant count=2"
+    echo "loadrt and2 count=1"
+    echo "alias param constant.1.value speed"
+    echo "alias pin and2.0.in0 gate"
+    echo "net in0 => edge.0.in"
+    echo "sets in0 TRUE"
+    i=0
+    while [ $i -lt $((N-1)) ]; do
+	echo "net e$i edge.$i.out => edge.$((i+1)).in"
+	echo "setp edge.$i.out-width-ns $i"
+	if [ $((i % 2)) -eq 1 ]; then
+	    echo "setp edge.$i.both TRUE"
+	fi
+	echo "addf edge.$i fast"
+	i=$((i+1))
+    done
+    echo "addf edge.$i fast"
+    echo "net gate constant.0.out => gate"
+    echo "setp speed 1.5"
+    echo "setp and2.0.in1 TRUE"
+    echo "addf constant.0 slow"
+    echo "addf constant.1 slow"
+    echo "addf and2.0 slow"
+} > config.hal
+
+# a few parameters and signals, set through aliases and not, read back
+values() {
+    for p in speed edge.7.out-width-ns edge.7.both edge.8.both and2.0.in1; do
+	halcmd getp $p || echo "$p: missing"
+    done
+    halcmd gets in0 || echo "in0: missing"
+}
+
+ms() {
+    echo $(( ($2 - $1) / 1000000 ))
+}
+
+realtime stop > /dev/null 2>&1
+realtime start || exit 1
+t0=$(date +%s%N)
+halcmd -f config.hal || exit 1
+t1=$(date +%s%N)
+halcmd snapshot save snap.before || exit 1
+halcmd save > save.before
+halcmd snapshot show snap.before > show.before
+values > values.before
+
+realtime stop
+realtime start || exit 1
+t2=$(date +%s%N)
+halcmd snapshot restore snap.before || exit 1
+t3=$(date +%s%N)
+halcmd save > save.after
+halcmd snapshot save snap.after
+halcmd snapshot show snap.after > show.after
+values > values.after
+grep -c '^addf' config.hal > addf.before
+grep -c '^addf' save.after > addf.after
+
+for x in save show values addf; do
+    if cmp -s $x.before $x.after; then
+	echo "$x: same"
+    else
+	diff -u $x.before $x.after
+    fi
+done
+realtime stop
+
+echo "halcmd -f config.hal: $(ms $t0 $t1) ms" 1>&2
+echo "snapshot restore: $(ms $t2 $t3) ms" 1>&2
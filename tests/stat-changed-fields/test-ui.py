@@ -0,0 +1,51 @@
+#!/usr/bin/env python
+
+# Checks that linuxcnc.stat.changed_fields() is empty while the machine
+# is idle, although the heartbeats of task, motion and io keep counting,
+# and that it reports 'task' when the mode changes.
+
+import linuxcnc
+
+import time
+import sys
+
+
+c = linuxcnc.command()
+s = linuxcnc.stat()
+
+c.state(linuxcnc.STATE_ESTOP_RESET)
+c.wait_complete()
+c.state(linuxcnc.STATE_ON)
+c.wait_complete()
+c.mode(linuxcnc.MODE_MANUAL)
+c.wait_complete()
+
+# let the state changes settle, then poll an idle machine; the io
+# cycle is 0.1 s, so each poll spans several heartbeats of each
+time.sleep(1)
+s.poll()
+for i in range(10):
+    time.sleep(0.25)
+    s.poll()
+    changed = s.changed_fields()
+    print "idle poll %d: %s" % (i, changed)
+    if changed != []:
+        print "ERROR: an idle poll reported changes"
+        sys.exit(1)
+
+gen = s.generations()
+c.mode(linuxcnc.MODE_MDI)
+c.wait_complete()
+time.sleep(0.1)
+s.poll()
+changed = s.changed_fields()
+print "after mode change: %s" % changed
+if 'task' not in changed:
+    print "ERROR: a mode change didn't report 'task'"
+    sys.exit(1)
+if s.generations()['task'] == gen['task']:
+    print "ERROR: a mode change didn't bump the 'task' generation"
+    sys.exit(1)
+
+# if we get here it all worked!
+sys.exit(0)
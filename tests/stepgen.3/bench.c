@@ -0,0 +1,167 @@
+// Benchmark for stepgen's make-pulses function.
+//
+// stepgen.c is built into this program against the stand-ins for
+// RTAPI and HAL in tests/include/hal_stubs.h, so make_pulses() can be
+// called in a tight loop, without threads or shared memory.
+// update-freq and capture-position run once per servo period, as they
+// would in a real machine, but only make-pulses is timed.
+//
+// Each channel runs at its own speed, forward for the first 3/4 of the
+// run and backward for the rest, so direction changes with their hold
+// and setup delays are part of it.  The step count and position of
+// each channel go to stdout, and are compared with 'expected'; the
+// timing goes to stderr.  With -t the output pins of every channel are
+// hashed in every base period, and the hash is printed as well, so
+// that two builds of stepgen can be compared pin for pin; the timing
+// is left out then, as the hashing would be in it.
+//
+// usage: bench [-t] [channels [base period ns [seconds of machine time
+//              [step type [v|p]]]]]
+
+#include "hal_stubs.h"
+#include "../../src/hal/components/stepgen.c"
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+// FNV-1a over the output pins of all channels
+static unsigned int trace_pins(unsigned int hash, int chans)
+{
+    int n, p, pins;
+
+    for (n = 0; n < chans; n++) {
+	pins = stepgen_array[n].step_type < 2 ? 2
+	    : stepgen_array[n].num_phases;
+	for (p = 0; p < pins; p++) {
+	    hash ^= *(stepgen_array[n].phase[p]);
+	    hash *= 16777619;
+	}
+    }
+    return hash;
+}
+
+int main(int argc, char **argv)
+{
+    int chans = 9, type = 0, trace = 0, n, err = 0;
+    long base = 20000, servo = 1000000;
+    double seconds = 10, start, *batch, t, speed;
+    long periods, p, b, per_servo, batches;
+    unsigned int hash = 2166136261u;
+    char mode = 'v';
+    funct_t pulses, freq, pos;
+    void *pulses_arg, *freq_arg, *pos_arg;
+    static char ctrl[MAX_CHAN][2];
+
+    if (argc > 1 && strcmp(argv[1], "-t") == 0) {
+	trace = 1;
+	argv++;
+	argc--;
+    }
+    if (argc > 1) chans = atoi(argv[1]);
+    if (argc > 2) base = atol(argv[2]);
+    if (argc > 3) seconds = atof(argv[3]);
+    if (argc > 4) type = atoi(argv[4]);
+    if (argc > 5) mode = argv[5][0];
+    if (chans < 1 || chans > MAX_CHAN || base <= 0 || base > servo
+	|| type < 0 || type >= MAX_STEP_TYPE || (mode != 'v' && mode != 'p')) {
+	fprintf(stderr, "usage: %s [-t] [channels [base period ns [seconds "
+	    "[step type [v|p]]]]]\n", argv[0]);
+	return 1;
+    }
+
+    for (n = 0; n < chans; n++) {
+	step_type[n] = type;
+	ctrl[n][0] = mode;
+	ctrl_type[n] = ctrl[n];
+    }
+    if (rtapi_app_main() != 0)
+	return 1;
+    pulses = find_funct("stepgen.make-pulses", &pulses_arg);
+    freq = find_funct("stepgen.update-freq", &freq_arg);
+    pos = find_funct("stepgen.capture-position", &pos_arg);
+
+    // one period of each, so stepgen knows the base period before
+    // it rounds the timing parameters
+    pulses(pulses_arg, base);
+    freq(freq_arg, servo);
+
+    for (n = 0; n < chans; n++) {
+	stepgen_array[n].step_len = base;
+	stepgen_array[n].step_space = base;
+	stepgen_array[n].dir_hold_dly = base;
+	stepgen_array[n].dir_setup = 2 * base;
+	*(stepgen_array[n].enable) = 1;
+    }
+
+    // make-pulses is timed one servo period at a time, and the median
+    // is reported, so time lost to other processes doesn't count
+    per_servo = servo / base;
+    batches = seconds * 1e9 / servo;
+    periods = batches * per_servo;
+    batch = malloc(batches * sizeof(*batch));
+    if (!batch)
+	return 1;
+    for (p = 0; p < batches; p++) {
+	// a spread of speeds, some of them negative, that reverse
+	// at 3/4 of the run
+	t = (double) p * servo * 1e-9;
+	if (p >= batches * 3 / 4) {
+	    // where the position is after the reversal
+	    t = 1.5 * batches * servo * 1e-9 - t;
+	}
+	for (n = 0; n < chans; n++) {
+	    speed = (n & 1 ? -1 : 1) * (n + 1) * 1000.0;
+	    // only the pin of the control mode is there
+	    if (mode == 'v')
+		*(stepgen_array[n].vel_cmd) =
+		    p < batches * 3 / 4 ? speed : -speed;
+	    else
+		*(stepgen_array[n].pos_cmd) = speed * t;
+	}
+	freq(freq_arg, servo);
+	if (trace) {
+	    for (b = 0; b < per_servo; b++) {
+		pulses(pulses_arg, base);
+		hash = trace_pins(hash, chans);
+	    }
+	} else {
+	    start = stub_now();
+	    for (b = 0; b < per_servo; b++)
+		pulses(pulses_arg, base);
+	    batch[p] = stub_now() - start;
+	}
+	pos(pos_arg, servo);
+    }
+
+    // the generators run at constant speed (no accel limit), so the
+    // step count is known, give or take the rounding of addval, and
+    // what the direction change and position mode lag behind, which
+    // is less than two servo periods' worth
+    for (n = 0; n < chans; n++) {
+	double want;
+
+	speed = (n & 1 ? -1 : 1) * (n + 1) * 1000.0;
+	want = speed * periods * base * 1e-9 / 2;
+	printf("channel %d: %d steps, position %.4f\n", n,
+	    *(stepgen_array[n].count), *(stepgen_array[n].pos_fb));
+	if (fabs(*(stepgen_array[n].count) - want)
+	    > 5 + fabs(speed) * 2 * servo * 1e-9) {
+	    printf("channel %d: expected %.0f steps\n", n, want);
+	    err = 1;
+	}
+    }
+    if (trace) {
+	printf("pin trace: %08x\n", hash);
+	return err;
+    }
+    qsort(batch, batches, sizeof(*batch), cmp_double);
+    fprintf(stderr, "make-pulses: %d channels, %ld ns period, %ld periods\n",
+	chans, base, periods);
+    fprintf(stderr, "%.2f ns/channel/period\n",
+	batch[batches / 2] / per_servo / chans);
+    return err;
+}
@@ -0,0 +1,12 @@
+#!/bin/sh
+rm -f bench
+set -e
+gcc -O2 -ftree-vectorize -I../include -I../../src/rtapi -I../../src/hal bench.c -o bench -lm
+./bench 9 20000 2
+# the other step types and position mode, pin for pin; 5 and 7
+# channels run both the vector kernel and the scalar tail
+for args in "5 20000 1 1 v" "2 20000 1 1 p" "5 20000 1 2 v" \
+    "7 25000 1 5 p" "3 20000 1 0 p" "9 20000 1 11 v" "16 20000 1 14 v"; do
+    echo "bench -t $args"
+    ./bench -t $args
+done
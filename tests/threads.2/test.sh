@@ -0,0 +1,15 @@
+#!/bin/sh
+# threads.0 on the simulated clock, twice.  The threads start at an
+# arbitrary point of the slow period, so the samples before the first
+# reset are dropped; after it, both runs must be the same, and checkresult
+# checks that they count 1..10 exactly, with no jitter.
+export FLAVOR=posix
+export MSGD_OPTS=--simtime
+
+for run in 1 2; do
+    halrun -f threads.hal > samples.$run || exit 1
+    awk 'NR > 1 && $1 == 1 { on = 1 } on && n < 3000 { print; n++ }' \
+	samples.$run > aligned.$run
+done
+cmp -s aligned.1 aligned.2 || { echo "runs differ" 1>&2; exit 1; }
+cat aligned.1
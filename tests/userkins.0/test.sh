@@ -0,0 +1,54 @@
+#!/bin/sh
+python <<EOF2
+import userkins, array, math
+
+def err(a, b):
+    return max(abs(x - y) for x, y in zip(a, b))
+
+k = userkins.kins("trivkins")
+print k.name(), k.type() == userkins.KINEMATICS_IDENTITY, k.params()
+world = array.array('d', [i * 0.5 for i in range(9 * 4)])
+joints = array.array('d', [0] * 9 * 4)
+status = array.array('i', [-1] * 4)
+print "inverse", k.inverse(world, joints, status), list(status)
+print "joints", err(world, joints) == 0
+back = array.array('d', [0] * 9 * 4)
+print "forward", k.forward(joints, back), err(world, back) == 0
+try:
+    k.forward(array.array('d', [0] * 7), back)
+except ValueError:
+    print "short joints: ValueError"
+del k
+
+k = userkins.kins("5axiskins")
+print k.name(), k.params(), k["5axiskins.pivot-length"]
+k["5axiskins.pivot-length"] = 100
+print k["5axiskins.pivot-length"]
+n = 1000
+world = array.array('d')
+for i in range(n):
+    t = i * 2 * math.pi / n
+    world.extend([10 * math.cos(t), 10 * math.sin(t), 5, 0, 30 * math.sin(t), 90 * t, 0, 0, 0])
+joints = array.array('d', [0] * 9 * n)
+print "inverse", k.inverse(world, joints)
+back = array.array('d', [0] * 9 * n)
+print "forward", k.forward(joints, back), err(world, back) < 1e-9
+del k
+
+k = userkins.kins("genhexkins")
+world = array.array('d')
+for i in range(n):
+    t = i * 2 * math.pi / n
+    world.extend([5 * math.cos(t), 5 * math.sin(t), 20, 5 * math.sin(t), 5 * math.cos(t), 0, 0, 0, 0])
+joints = array.array('d', [0] * 6 * n)
+print "inverse", k.inverse(world, joints)
+back = array.array('d', [0] * 9 * n)
+back[2] = 20
+print "forward", k.forward(joints, back), err(world, back) < 1e-9
+print "bad joints", k.forward(array.array('d', [-1] * 6), array.array('d', [0] * 9))
+
+try:
+    userkins.kins("nosuchkins")
+except userkins.error:
+    print "nosuchkins: userkins.error"
+EOF2